@@ -27,6 +27,20 @@ SOURCES += \
     src/data/logfiltereddataworkerthread.cpp \
     src/data/logdataworkerthread.cpp \
     src/data/compressedlinestorage.cpp \
+    src/data/sparselinestorage.cpp \
+    src/data/eliasfanolinestorage.cpp \
+    src/data/linescanner.cpp \
+    src/data/indexcache.cpp \
+    src/data/pipelinedreader.cpp \
+    src/data/pagecacheguard.cpp \
+    src/data/gzipdevice.cpp \
+    src/data/filefingerprint.cpp \
+    src/data/mappedfile.cpp \
+    src/data/linecache.cpp \
+    src/data/linedecoder.cpp \
+    src/data/lineattributes.cpp \
+    src/data/lineprefetcher.cpp \
+    src/data/sigbusguard.cpp \
     src/mainwindow.cpp \
     src/crawlerwidget.cpp \
     src/abstractlogview.cpp \
@@ -64,9 +78,22 @@ HEADERS += \
     src/data/logfiltereddata.h \
     src/data/logfiltereddataworkerthread.h \
     src/data/logdataworkerthread.h \
-    src/data/threadprivatestore.h \
     src/data/compressedlinestorage.h \
+    src/data/sparselinestorage.h \
+    src/data/eliasfanolinestorage.h \
     src/data/linepositionarray.h \
+    src/data/linescanner.h \
+    src/data/indexcache.h \
+    src/data/pipelinedreader.h \
+    src/data/pagecacheguard.h \
+    src/data/gzipdevice.h \
+    src/data/filefingerprint.h \
+    src/data/mappedfile.h \
+    src/data/linecache.h \
+    src/data/linedecoder.h \
+    src/data/lineattributes.h \
+    src/data/lineprefetcher.h \
+    src/data/sigbusguard.h \
     src/mainwindow.h \
     src/session.h \
     src/viewinterface.h \
@@ -132,6 +159,16 @@ else {
     INCLUDEPATH += $$BOOST_PATH
 }
 
+# zlib is used to read gzip compressed files
+isEmpty(ZLIB_PATH) {
+    LIBS += -lz
+}
+else {
+    message(Building using zlib at $$ZLIB_PATH)
+    INCLUDEPATH += $$ZLIB_PATH/include
+    LIBS += -L$$ZLIB_PATH/lib -lz
+}
+
 FORMS += src/optionsdialog.ui
 FORMS += src/filtersdialog.ui
 
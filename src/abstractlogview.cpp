@@ -743,6 +743,12 @@ void AbstractLogView::scrollContentsBy( int dx, int dy )
     const QPoint mouse_pos = mapFromGlobal( QCursor::pos() );
     considerMouseHovering( mouse_pos.x(), mouse_pos.y() );
 
+    // Have the lines we are likely to display next read in the background
+    // (the wheel, the keys and the overview all move the scroll bar)
+    logData->prefetchExpandedLines( readAheadPlanner_.update(
+                firstLine, getNbVisibleLines(), logData->getNbLine(),
+                std::chrono::steady_clock::now() ) );
+
     // Redraw
     update();
 }
@@ -1055,6 +1061,22 @@ void AbstractLogView::updateData()
     update();
 }
 
+void AbstractLogView::shiftLines( LineNumber first_line, LineNumber offset )
+{
+    LOG(logDEBUG) << "AbstractLogView::shiftLines " << first_line
+        << " by " << offset;
+
+    selection_.shift( first_line, offset );
+    if ( firstLine >= first_line )
+        firstLine += offset;
+
+    updateData();
+
+    // The scroll bar follows (in follow mode, it is at the bottom already)
+    if ( ! followMode_ )
+        verticalScrollBar()->setValue( firstLine );
+}
+
 void AbstractLogView::updateDisplaySize()
 {
     // Font is assumed to be mono-space (is restricted by options dialog)
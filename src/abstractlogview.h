@@ -163,6 +163,10 @@ class AbstractLogView :
 
     // Refresh the widget when the data set has changed.
     void updateData();
+    // Refresh the widget when the lines of the data set from first_line
+    // are now numbered offset lines further, keeping the same lines
+    // selected and displayed (unless following the end of the file).
+    void shiftLines( LineNumber first_line, LineNumber offset );
     // Instructs the widget to update it's content geometry,
     // used when the font is changed.
     void updateDisplaySize();
@@ -304,6 +308,9 @@ class AbstractLogView :
     // ElasticHook for follow mode
     ElasticHook followElasticHook_;
 
+    // Plans the lines to read before they are displayed
+    ReadAheadPlanner readAheadPlanner_;
+
     // Whether to show line numbers or not
     bool lineNumbersVisible_;
 
@@ -42,6 +42,16 @@ Configuration::Configuration()
 
     loadLastSession_              = true;
 
+    // Sequential indexing
+    indexingThreads_              = 1;
+    readAheadDepth_               = 2;
+    tailFirstLines_               = 0;
+    indexMemoryBudget_            = 0;
+    preservePageCache_            = false;
+    indexCacheEnabled_            = true;
+    joinRotatedFiles_             = false;
+    lineCacheMemory_              = 16;
+
     overviewVisible_              = true;
     lineNumbersVisibleInMain_     = false;
     lineNumbersVisibleInFiltered_ = true;
@@ -94,6 +104,22 @@ void Configuration::retrieveFromStorage( QSettings& settings )
 
     if ( settings.contains( "session.loadLast" ) )
         loadLastSession_ = settings.value( "session.loadLast" ).toBool();
+    if ( settings.contains( "indexing.threads" ) )
+        indexingThreads_ = settings.value( "indexing.threads" ).toInt();
+    if ( settings.contains( "indexing.readAhead" ) )
+        readAheadDepth_ = settings.value( "indexing.readAhead" ).toInt();
+    if ( settings.contains( "indexing.tailFirstLines" ) )
+        tailFirstLines_ = settings.value( "indexing.tailFirstLines" ).toInt();
+    if ( settings.contains( "indexing.memoryBudget" ) )
+        indexMemoryBudget_ = settings.value( "indexing.memoryBudget" ).toInt();
+    if ( settings.contains( "indexing.preservePageCache" ) )
+        preservePageCache_ = settings.value( "indexing.preservePageCache" ).toBool();
+    if ( settings.contains( "indexing.cache" ) )
+        indexCacheEnabled_ = settings.value( "indexing.cache" ).toBool();
+    if ( settings.contains( "files.joinRotated" ) )
+        joinRotatedFiles_ = settings.value( "files.joinRotated" ).toBool();
+    if ( settings.contains( "files.lineCacheMemory" ) )
+        lineCacheMemory_ = settings.value( "files.lineCacheMemory" ).toInt();
 
     // View settings
     if ( settings.contains( "view.overviewVisible" ) )
@@ -130,6 +156,14 @@ void Configuration::saveToStorage( QSettings& settings ) const
     settings.setValue( "polling.enabled", pollingEnabled_ );
     settings.setValue( "polling.intervalMs", pollIntervalMs_ );
     settings.setValue( "session.loadLast", loadLastSession_);
+    settings.setValue( "indexing.threads", indexingThreads_ );
+    settings.setValue( "indexing.readAhead", readAheadDepth_ );
+    settings.setValue( "indexing.tailFirstLines", tailFirstLines_ );
+    settings.setValue( "indexing.memoryBudget", indexMemoryBudget_ );
+    settings.setValue( "indexing.preservePageCache", preservePageCache_ );
+    settings.setValue( "indexing.cache", indexCacheEnabled_ );
+    settings.setValue( "files.joinRotated", joinRotatedFiles_ );
+    settings.setValue( "files.lineCacheMemory", lineCacheMemory_ );
 
     settings.setValue( "view.overviewVisible", overviewVisible_ );
     settings.setValue( "view.lineNumbersVisibleInMain", lineNumbersVisibleInMain_ );
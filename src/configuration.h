@@ -68,6 +68,41 @@ class Configuration : public Persistable {
     { return loadLastSession_; }
     void setLoadLastSession( bool enabled )
     { loadLastSession_ = enabled; }
+    int indexingThreads() const
+    { return indexingThreads_; }
+    void setIndexingThreads( int nb_threads )
+    { indexingThreads_ = nb_threads; }
+    int readAheadDepth() const
+    { return readAheadDepth_; }
+    void setReadAheadDepth( int depth )
+    { readAheadDepth_ = depth; }
+    int tailFirstLines() const
+    { return tailFirstLines_; }
+    void setTailFirstLines( int nb_lines )
+    { tailFirstLines_ = nb_lines; }
+    // Memory the index of a file can use (in MiB, 0 for no limit)
+    int indexMemoryBudget() const
+    { return indexMemoryBudget_; }
+    void setIndexMemoryBudget( int budget )
+    { indexMemoryBudget_ = budget; }
+    bool preservePageCache() const
+    { return preservePageCache_; }
+    void setPreservePageCache( bool preserve )
+    { preservePageCache_ = preserve; }
+    bool indexCacheEnabled() const
+    { return indexCacheEnabled_; }
+    void setIndexCacheEnabled( bool enabled )
+    { indexCacheEnabled_ = enabled; }
+    // Open a file and its rotated files ('file.1'...) as a single log
+    bool joinRotatedFiles() const
+    { return joinRotatedFiles_; }
+    void setJoinRotatedFiles( bool join )
+    { joinRotatedFiles_ = join; }
+    // Memory used to cache the decoded lines of a file (in MiB, 0 disables it)
+    int lineCacheMemory() const
+    { return lineCacheMemory_; }
+    void setLineCacheMemory( int memory )
+    { lineCacheMemory_ = memory; }
 
     // View settings
     bool isOverviewVisible() const
@@ -106,6 +141,14 @@ class Configuration : public Persistable {
     bool pollingEnabled_;
     uint32_t pollIntervalMs_;
     bool loadLastSession_;
+    int indexingThreads_;
+    int readAheadDepth_;
+    int tailFirstLines_;
+    int indexMemoryBudget_;
+    bool preservePageCache_;
+    bool indexCacheEnabled_;
+    bool joinRotatedFiles_;
+    int lineCacheMemory_;
 
     // View settings
     bool overviewVisible_;
@@ -99,6 +99,7 @@ CrawlerWidget::CrawlerWidget( QWidget *parent )
     // and it's the first time
     firstLoadDone_     = false;
     nbMatches_         = 0;
+    searchRestartPending_ = false;
     dataStatus_        = DataStatus::OLD_DATA;
 
     currentLineNumber_ = 0;
@@ -436,6 +437,9 @@ void CrawlerWidget::applyConfiguration()
     logData_->setPollingInterval(
             config->pollingEnabled() ? config->pollIntervalMs() : 0 );
 
+    // Indexing
+    applyIndexingSettings( *config );
+
     // Update the SearchLine (history)
     updateSearchCombo();
 }
@@ -478,7 +482,11 @@ void CrawlerWidget::loadingFinishedHandler( LoadingStatus status )
     // searchButton->setEnabled( true );
 
     // See if we need to auto-refresh the search
-    if ( searchState_.isAutorefreshAllowed() ) {
+    if ( searchRestartPending_ ) {
+        searchRestartPending_ = false;
+        replaceCurrentSearch( searchLineEdit->currentText() );
+    }
+    else if ( searchState_.isAutorefreshAllowed() ) {
         if ( searchState_.isFileTruncated() )
             // We need to restart the search
             replaceCurrentSearch( searchLineEdit->currentText() );
@@ -498,6 +506,54 @@ void CrawlerWidget::loadingFinishedHandler( LoadingStatus status )
         firstLoadDone_ = true;
 }
 
+void CrawlerWidget::tailLoadedHandler()
+{
+    // Only the end of the file is available until the loading is
+    // finished, we show it and follow the file from there.
+    overview_.updateData( logData_->getNbLine() );
+    logMainView->updateData();
+
+    updateEncoding();
+
+    emit followSet( true );
+}
+
+void CrawlerWidget::tailUpdatedHandler()
+{
+    // The main view follows them if it follows the file
+    overview_.updateData( logData_->getNbLine() );
+    logMainView->updateData();
+}
+
+void CrawlerWidget::tailReplacedHandler( qint64 first_line, qint64 offset )
+{
+    // Called before the lines are read again: whatever refers to the
+    // lines of the tail follows them to their number in the file.
+    if ( offset > 0 ) {
+        logFilteredData_->shiftMarks( first_line, offset );
+        logMainView->shiftLines( first_line, offset );
+        if ( currentLineNumber_ >= first_line )
+            currentLineNumber_ += offset;
+    }
+    else {
+        // The lines marked are not all known anymore
+        logFilteredData_->clearMarks();
+    }
+
+    // The search has only been through the tail, it is run again on the
+    // whole file once loaded.
+    if ( searchState_.getState() == SearchState::Static
+            || searchState_.getState() == SearchState::Autorefreshing ) {
+        logFilteredData_->interruptSearch();
+        logFilteredData_->clearSearch();
+        nbMatches_ = 0;
+        searchRestartPending_ = true;
+    }
+
+    filteredView->updateData();
+    overview_.updateData( logData_->getNbLine() );
+}
+
 void CrawlerWidget::fileChangedHandler( LogData::MonitoredFileStatus status )
 {
     // Handle the case where the file has been truncated
@@ -757,6 +813,9 @@ void CrawlerWidget::setup()
     ignoreCaseCheck->setCheckState( config->isSearchIgnoreCaseDefault() ?
             Qt::Checked : Qt::Unchecked );
 
+    // Indexing settings must be known before the file is attached
+    applyIndexingSettings( *config );
+
     // Connect the signals
     connect(searchLineEdit->lineEdit(), SIGNAL( returnPressed() ),
             searchButton, SIGNAL( clicked() ));
@@ -817,6 +876,12 @@ void CrawlerWidget::setup()
             this, SIGNAL( loadingProgressed( int ) ) );
     connect( logData_, SIGNAL( loadingFinished( LoadingStatus ) ),
             this, SLOT( loadingFinishedHandler( LoadingStatus ) ) );
+    connect( logData_, SIGNAL( tailLoaded() ),
+            this, SLOT( tailLoadedHandler() ) );
+    connect( logData_, SIGNAL( tailUpdated() ),
+            this, SLOT( tailUpdatedHandler() ) );
+    connect( logData_, SIGNAL( tailReplaced( qint64, qint64 ) ),
+            this, SLOT( tailReplacedHandler( qint64, qint64 ) ) );
     connect( logData_, SIGNAL( fileChanged( LogData::MonitoredFileStatus ) ),
             this, SLOT( fileChangedHandler( LogData::MonitoredFileStatus ) ) );
 
@@ -1051,6 +1116,22 @@ void CrawlerWidget::updateEncoding()
     filteredView->forceRefresh();
 }
 
+// Pass the indexing settings to the data, at setup and on each
+// configuration change.
+void CrawlerWidget::applyIndexingSettings( const Configuration& config )
+{
+    logData_->setIndexingThreads( config.indexingThreads() );
+    logData_->setReadAheadDepth( config.readAheadDepth() );
+    logData_->setTailFirstLines( config.tailFirstLines() );
+    logData_->setIndexMemoryBudget(
+            static_cast<qint64>( config.indexMemoryBudget() ) * 1024 * 1024 );
+    logData_->setPreservePageCache( config.preservePageCache() );
+    logData_->setIndexCache( config.indexCacheEnabled() ?
+            IndexCache::defaultCache() : IndexCache() );
+    logData_->setLineCacheMemory(
+            static_cast<qint64>( config.lineCacheMemory() ) * 1024 * 1024 );
+}
+
 // Change the respective size of the two views
 void CrawlerWidget::changeTopViewSize( int32_t delta )
 {
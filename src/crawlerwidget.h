@@ -40,6 +40,7 @@
 #include "loadingstatus.h"
 
 class InfoLine;
+class Configuration;
 class QuickFindPattern;
 class SavedSearches;
 class QStandardItemModel;
@@ -157,6 +158,12 @@ class CrawlerWidget : public QSplitter,
     void markLineFromFiltered( qint64 line );
 
     void loadingFinishedHandler( LoadingStatus status );
+    // Manages the end of the file being loaded (tail-first loading)
+    void tailLoadedHandler();
+    // Shows the lines appended to the file while the tail is shown
+    void tailUpdatedHandler();
+    // Follows the lines of the tail to their number in the whole file
+    void tailReplacedHandler( qint64 first_line, qint64 offset );
     // Manages the info lines to inform the user the file has changed.
     void fileChangedHandler( LogData::MonitoredFileStatus );
 
@@ -231,6 +238,7 @@ class CrawlerWidget : public QSplitter,
     void changeDataStatus( DataStatus status );
     void updateEncoding();
     void changeTopViewSize( int32_t delta );
+    void applyIndexingSettings( const Configuration& config );
 
     // Palette for error notification (yellow background)
     static const QPalette errorPalette;
@@ -289,6 +297,9 @@ class CrawlerWidget : public QSplitter,
     // Current number of matches
     int             nbMatches_;
 
+    // Is the search to be run again once the loading is finished?
+    bool            searchRestartPending_;
+
     // the current dataStatus (whether we have new, not seen, data)
     DataStatus      dataStatus_;
 
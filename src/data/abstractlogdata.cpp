@@ -53,6 +53,13 @@ QStringList AbstractLogData::getExpandedLines( qint64 first_line, int number ) c
     return doGetExpandedLines( first_line, number );
 }
 
+// Simple wrapper in order to use a clean Template Method
+void AbstractLogData::prefetchExpandedLines(
+        const std::vector<LineRange>& ranges ) const
+{
+    doPrefetchExpandedLines( ranges );
+}
+
 // Simple wrapper in order to use a clean Template Method
 qint64 AbstractLogData::getNbLine() const
 {
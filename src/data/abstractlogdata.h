@@ -24,6 +24,8 @@
 #include <QString>
 #include <QStringList>
 
+#include <vector>
+
 #include "utils.h"
 
 // Base class representing a set of data.
@@ -44,6 +46,10 @@ class AbstractLogData : public QObject {
     QStringList getLines( qint64 first_line, int number ) const;
     // Returns a set of lines with tabs expanded
     QStringList getExpandedLines( qint64 first_line, int number ) const;
+    // Read the passed ranges of lines in the background, so they are
+    // quickly returned by getExpandedLines() later, in place of the lines
+    // passed to the previous call not read yet.
+    void prefetchExpandedLines( const std::vector<LineRange>& ranges ) const;
     // Returns the total number of lines
     qint64 getNbLine() const;
     // Returns the visible length of the longest line
@@ -68,6 +74,8 @@ class AbstractLogData : public QObject {
     virtual QStringList doGetLines( qint64 first_line, int number ) const = 0;
     // Internal function called to get a set of expanded lines
     virtual QStringList doGetExpandedLines( qint64 first_line, int number ) const = 0;
+    // Internal function called to prefetch lines (does nothing by default)
+    virtual void doPrefetchExpandedLines( const std::vector<LineRange>& ) const {}
     // Internal function called to get the number of lines
     virtual qint64 doGetNbLine() const = 0;
     // Internal function called to get the maximum length
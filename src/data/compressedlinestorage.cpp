@@ -17,9 +17,17 @@
  * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+#include <new>
 #include <QtEndian>
+#include <QDataStream>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
 
 #include "utils.h"
 
@@ -28,38 +36,39 @@
 namespace {
     // Functions to manipulate blocks
 
-    // Create a new 32 bits block of the passed size,
-    // initialised at the passed position
-    char* block32_new( int block_size, uint32_t initial_position,
+    // Maximum size of the blocks (where every line is >16384)
+    const size_t block32MaxSize = 4 + BLOCK_SIZE * 6;
+    const size_t block64MaxSize = 8 + BLOCK_SIZE * 10;
+
+    // Written as is before the blocks, which are in the byte order of
+    // the machine, to tell if they are read back on another one
+    const uint32_t byteOrderMark = 0x01020304;
+
+    // Size of the first arena, doubled for the next ones up to the
+    // maximum (the size of a huge page on x86)
+    const size_t arenaMinSize = 64*1024;
+    const size_t arenaMaxSize = 2*1024*1024;
+
+    // Start a new 32 bits block in the passed buffer (of the maximum
+    // block size), initialised at the passed position
+    char* block32_new( char* ptr, uint32_t initial_position,
            char** block_ptr )
     {
-        // malloc a block of the maximum possible size
-        // (where every line is >16384)
-        char* ptr = static_cast<char*>( malloc( 4 + block_size * 6 ) );
-
-        if ( ptr ) {
-            // Write the initial_position
-            *(reinterpret_cast<uint32_t*>(ptr)) = initial_position;
-            *block_ptr = ptr + 4;
-        }
+        // Write the initial_position
+        *(reinterpret_cast<uint32_t*>(ptr)) = initial_position;
+        *block_ptr = ptr + 4;
 
         return ptr;
     }
 
-    // Create a new 64 bits block of the passed size,
-    // initialised at the passed position
-    char* block64_new( int block_size, uint64_t initial_position,
+    // Start a new 64 bits block in the passed buffer (of the maximum
+    // block size), initialised at the passed position
+    char* block64_new( char* ptr, uint64_t initial_position,
            char** block_ptr )
     {
-        // malloc a block of the maximum possible size
-        // (where every line is >16384)
-        char* ptr = static_cast<char*>( malloc( 8 + block_size * 10 ) );
-
-        if ( ptr ) {
-            // Write the initial_position
-            *(reinterpret_cast<uint64_t*>(ptr)) = initial_position;
-            *block_ptr = ptr + 8;
-        }
+        // Write the initial_position
+        *(reinterpret_cast<uint64_t*>(ptr)) = initial_position;
+        *block_ptr = ptr + 8;
 
         return ptr;
     }
@@ -187,6 +196,184 @@ namespace {
 
         return pos;
     }
+
+    // Check a block read from a file: its nb_entries entries must be
+    // within its size, each position greater than the previous one (from
+    // previous_pos, if the block is not the first of the storage), so it
+    // can be decoded without reading past its end.
+    // Sets last_pos, and the offsets of the last entry and past it.
+    template <typename Initial, uint64_t (*next_pos)( char**, uint64_t )>
+    bool block_check( char* block, size_t size, uint32_t nb_entries,
+            const uint64_t* previous_pos, uint64_t* last_pos,
+            size_t* last_entry, size_t* end )
+    {
+        if ( size < sizeof( Initial ) )
+            return false;
+
+        uint64_t pos = *(reinterpret_cast<Initial*>(block));
+        if ( previous_pos && pos <= *previous_pos )
+            return false;
+
+        size_t offset = sizeof( Initial );
+        *last_entry = 0;
+        for ( uint32_t i = 1; i < nb_entries; i++ ) {
+            if ( offset >= size )
+                return false;
+
+            const uint8_t byte = block[offset];
+            const size_t entry_size = ( ! ( byte & 0x80 ) ) ? 1 :
+                ( ( byte & 0xC0 ) == 0x80 ) ? 2 : sizeof( uint16_t ) + sizeof( Initial );
+            if ( offset + entry_size > size )
+                return false;
+
+            char* ptr = block + offset;
+            const uint64_t next = next_pos( &ptr, pos );
+            if ( next <= pos )
+                return false;
+
+            *last_entry = offset;
+            offset += entry_size;
+            pos = next;
+        }
+
+        *last_pos = pos;
+        *end = offset;
+
+        return true;
+    }
+
+    // Write the positions of the entries begin (included) to end
+    // (excluded) of the passed block to out.
+    // Runs of one byte deltas (the most common) are found eight at a
+    // time, and added without testing each byte.
+    template <typename Initial, uint64_t (*next_pos)( char**, uint64_t )>
+    void block_get_range( char* block, uint32_t begin, uint32_t end,
+            uint64_t* out )
+    {
+        char* ptr = block + sizeof( Initial );
+        uint64_t pos = *(reinterpret_cast<Initial*>(block));
+
+        if ( begin == 0 )
+            *out++ = pos;
+
+        // Index of the entry at ptr
+        uint32_t i = 1;
+        while ( i < end ) {
+            // Each entry uses at least one byte, so the block has these 8
+            if ( end - i >= 8 ) {
+                uint64_t bytes;
+                memcpy( &bytes, ptr, sizeof( bytes ) );
+                if ( ( bytes & 0x8080808080808080ULL ) == 0 ) {
+                    for ( int k = 0; k < 8; ++k, ++i ) {
+                        pos += static_cast<uint8_t>( ptr[k] );
+                        if ( i >= begin )
+                            *out++ = pos;
+                    }
+                    ptr += 8;
+                    continue;
+                }
+            }
+
+            pos = next_pos( &ptr, pos );
+            if ( i >= begin )
+                *out++ = pos;
+            ++i;
+        }
+    }
+
+    // Number of entries <= offset in the table of the passed blocks
+    // (of nb_entries in total), using the initial position of each
+    // block to find the one to go through.
+    template <typename Initial, uint64_t (*next_pos)( char**, uint64_t )>
+    uint32_t blocks_count_up_to( const std::vector<char*>& index,
+            uint32_t nb_entries, uint64_t offset )
+    {
+        auto after = std::upper_bound( index.begin(), index.end(), offset,
+                []( uint64_t position, char* block ) {
+                    return position < *(reinterpret_cast<Initial*>(block)); } );
+        if ( after == index.begin() )
+            return 0;
+
+        const uint32_t block_index = ( after - index.begin() ) - 1;
+        const uint32_t block_end = std::min( nb_entries,
+                ( block_index + 1 ) * BLOCK_SIZE );
+
+        char* ptr = index[block_index] + sizeof( Initial );
+        uint64_t pos = *(reinterpret_cast<Initial*>(index[block_index]));
+
+        // The initial position is <= offset
+        uint32_t count = block_index * BLOCK_SIZE + 1;
+        while ( count < block_end ) {
+            pos = next_pos( &ptr, pos );
+            if ( pos > offset )
+                break;
+            ++count;
+        }
+
+        return count;
+    }
+
+    // Position of the entry at index, getting the block holding it from
+    // the passed functions and decoding it from its start, ptr is left
+    // after the entry.
+    template <typename Block32Getter, typename Block64Getter>
+    uint64_t blocks_at( uint32_t first_long_line, uint32_t index, char** ptr,
+            Block32Getter block32, Block64Getter block64 )
+    {
+        uint64_t position;
+
+        if ( index < first_long_line ) {
+            position = block32_initial_pos( block32( index / BLOCK_SIZE ), ptr );
+
+            for ( uint32_t i = 0; i < index % BLOCK_SIZE; i++ ) {
+                // Go through all the lines in the block till the one we want
+                position = block32_next_pos( ptr, position );
+            }
+        }
+        else {
+            const uint32_t index_in_64 = index - first_long_line;
+            position = block64_initial_pos( block64( index_in_64 / BLOCK_SIZE ), ptr );
+
+            for ( uint32_t i = 0; i < index_in_64 % BLOCK_SIZE; i++ ) {
+                // Go through all the lines in the block till the one we want
+                position = block64_next_pos( ptr, position );
+            }
+        }
+
+        return position;
+    }
+
+    // Write count positions from first to out, getting the blocks
+    // holding them from the passed functions.
+    template <typename Block32Getter, typename Block64Getter>
+    void blocks_get_range( uint32_t first_long_line, uint32_t first,
+            uint32_t count, uint64_t* out,
+            Block32Getter block32, Block64Getter block64 )
+    {
+        const uint32_t end = first + count;
+        uint32_t index = first;
+
+        while ( index < end ) {
+            const bool is_block64 = ( index >= first_long_line );
+            const uint32_t table_start = is_block64 ? first_long_line : 0;
+            const uint32_t block_index = ( index - table_start ) / BLOCK_SIZE;
+            const uint32_t block_start = table_start + block_index * BLOCK_SIZE;
+
+            uint32_t block_end = std::min( end, block_start + BLOCK_SIZE );
+            if ( ! is_block64 )
+                block_end = std::min( block_end, first_long_line );
+
+            if ( is_block64 )
+                block_get_range<uint64_t, block64_next_pos>( block64( block_index ),
+                        index - block_start, block_end - block_start, out );
+            else
+                block_get_range<uint32_t, block32_next_pos>( block32( block_index ),
+                        index - block_start, block_end - block_start, out );
+
+            out  += block_end - index;
+            index = block_end;
+        }
+    }
 }
 
 void CompressedLinePositionStorage::move_from(
@@ -197,48 +384,120 @@ void CompressedLinePositionStorage::move_from(
     current_pos_     = orig.current_pos_;
     block_pointer_   = orig.block_pointer_;
     previous_block_pointer_ = orig.previous_block_pointer_;
+    used_size_       = orig.used_size_;
+    last_entry_size_ = orig.last_entry_size_;
+    published32_     = orig.published32_;
+    published64_     = orig.published64_;
 
     orig.nb_lines_   = 0;
+    orig.published32_ = 0;
+    orig.published64_ = 0;
 }
 
 // Move constructor
 CompressedLinePositionStorage::CompressedLinePositionStorage(
         CompressedLinePositionStorage&& orig )
     : block32_index_( std::move( orig.block32_index_ ) ),
-      block64_index_( std::move( orig.block64_index_ ) )
+      block64_index_( std::move( orig.block64_index_ ) ),
+      arenas_( std::move( orig.arenas_ ) ),
+      open_block_( std::move( orig.open_block_ ) ),
+      pages32_( std::move( orig.pages32_ ) ),
+      pages64_( std::move( orig.pages64_ ) )
 {
     move_from( std::move( orig ) );
 }
 
-void CompressedLinePositionStorage::free_blocks()
-{
-    for ( char* block : block32_index_ ) {
-        void* p = static_cast<void*>( block );
-        free( p );
-    }
-
-    for ( char* block : block64_index_ ) {
-        void* p = static_cast<void*>( block );
-        free( p );
-    }
-}
-
 // Move assignement
 CompressedLinePositionStorage& CompressedLinePositionStorage::operator=(
         CompressedLinePositionStorage&& orig )
 {
-    free_blocks();
-
     block32_index_ = std::move( orig.block32_index_ );
     block64_index_ = std::move( orig.block64_index_ );
+    arenas_        = std::move( orig.arenas_ );
+    open_block_    = std::move( orig.open_block_ );
+    pages32_       = std::move( orig.pages32_ );
+    pages64_       = std::move( orig.pages64_ );
     move_from( std::move( orig ) );
 
     return *this;
 }
 
+// The arenas are freed when the last snapshot using them is destroyed
 CompressedLinePositionStorage::~CompressedLinePositionStorage()
 {
-    free_blocks();
+}
+
+CompressedLinePositionStorage::Arena::Arena( size_t arena_size )
+    : data( nullptr ), size( arena_size ), used( 0 ), mapped( false )
+{
+#if defined( Q_OS_LINUX ) && defined( MADV_HUGEPAGE )
+    if ( size == arenaMaxSize ) {
+        void* map = mmap( nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( map != MAP_FAILED ) {
+            // Only a hint, depending on the system's settings
+            madvise( map, size, MADV_HUGEPAGE );
+            data = static_cast<char*>( map );
+            mapped = true;
+        }
+    }
+#endif
+
+    if ( ! data )
+        data = static_cast<char*>( malloc( size ) );
+
+    if ( ! data )
+        throw std::bad_alloc();
+}
+
+CompressedLinePositionStorage::Arena::~Arena()
+{
+#ifdef Q_OS_LINUX
+    if ( mapped ) {
+        munmap( data, size );
+        return;
+    }
+#endif
+
+    free( data );
+}
+
+char* CompressedLinePositionStorage::arena_allocate( size_t size )
+{
+    // Blocks start with an absolute position, keep them aligned
+    size = ( size + 7 ) & ~static_cast<size_t>( 7 );
+
+    if ( arenas_.empty() || arenas_.back()->used + size > arenas_.back()->size ) {
+        const size_t arena_size = arenas_.empty() ? arenaMinSize
+            : std::min( arenas_.back()->size * 2, arenaMaxSize );
+        arenas_.push_back( std::make_shared<Arena>( std::max( arena_size, size ) ) );
+    }
+
+    Arena& arena = *arenas_.back();
+    char* ptr = arena.data + arena.used;
+    arena.used += size;
+
+    return ptr;
+}
+
+char* CompressedLinePositionStorage::open_block()
+{
+    if ( ! open_block_ )
+        open_block_.reset( new char[block64MaxSize] );
+
+    return open_block_.get();
+}
+
+char* CompressedLinePositionStorage::store_block( char* block, size_t size )
+{
+    // Already in an arena (e.g. finished again after a pop_back)
+    if ( block != open_block_.get() )
+        return block;
+
+    char* new_location = arena_allocate( size );
+    memcpy( new_location, block, size );
+
+    return new_location;
 }
 
 // template<int BLOCK_SIZE>
@@ -256,6 +515,16 @@ void CompressedLinePositionStorage::append( uint64_t pos )
         if ( first_long_line_ == UINT32_MAX ) {
             // First "big" end of line, we will start a new (64) block
             first_long_line_ = nb_lines_;
+
+            // The unfinished block32 is kept as is (full size)
+            if ( block_pointer_ ) {
+                char* block = block32_index_.back();
+                char* new_location = store_block( block, block32MaxSize );
+                block32_index_.back() = new_location;
+                if ( previous_block_pointer_ )
+                    previous_block_pointer_ = new_location
+                        + ( previous_block_pointer_ - block );
+            }
             block_pointer_ = nullptr;
         }
     }
@@ -264,10 +533,12 @@ void CompressedLinePositionStorage::append( uint64_t pos )
         // We need to start a new block
         if ( ! store_in_big )
             block32_index_.push_back(
-                block32_new( BLOCK_SIZE, pos, &block_pointer_ ) );
+                block32_new( open_block(), pos, &block_pointer_ ) );
         else
             block64_index_.push_back(
-                block64_new( BLOCK_SIZE, pos, &block_pointer_ ) );
+                block64_new( open_block(), pos, &block_pointer_ ) );
+
+        last_entry_size_ = store_in_big ? sizeof( uint64_t ) : sizeof( uint32_t );
     }
     else {
         uint64_t delta = pos - current_pos_;
@@ -286,8 +557,11 @@ void CompressedLinePositionStorage::append( uint64_t pos )
             else
                 block64_add_absolute( &block_pointer_, pos );
         }
+
+        last_entry_size_ = block_pointer_ - previous_block_pointer_;
     }
 
+    used_size_  += last_entry_size_;
     current_pos_ = pos;
     ++nb_lines_;
 
@@ -302,12 +576,11 @@ void CompressedLinePositionStorage::append( uint64_t pos )
             // is replaced by an absolute value in the future (following a pop_back)
             size_t new_size = ( previous_block_pointer_
                     + sizeof( uint16_t ) + sizeof( uint32_t ) ) - block;
-            void* new_location = realloc( block, new_size );
-            if ( new_location )
-                block32_index_[block_index] = static_cast<char*>( new_location );
+            char* new_location = store_block( block, new_size );
+            block32_index_[block_index] = new_location;
 
             block_pointer_ = nullptr;
-            previous_block_pointer_ = static_cast<char*>( new_location ) + ( previous_block_pointer_ - block );
+            previous_block_pointer_ = new_location + ( previous_block_pointer_ - block );
         }
     }
     else {
@@ -321,12 +594,11 @@ void CompressedLinePositionStorage::append( uint64_t pos )
             // is replaced by an absolute value in the future (following a pop_back)
             size_t new_size = ( previous_block_pointer_
                     + sizeof( uint16_t ) + sizeof( uint64_t ) ) - block;
-            void* new_location = realloc( block, new_size );
-            if ( new_location )
-                block64_index_[block_index] = static_cast<char*>( new_location );
+            char* new_location = store_block( block, new_size );
+            block64_index_[block_index] = new_location;
 
             block_pointer_ = nullptr;
-            previous_block_pointer_ = static_cast<char*>( new_location ) + ( previous_block_pointer_ - block );
+            previous_block_pointer_ = new_location + ( previous_block_pointer_ - block );
         }
     }
 }
@@ -335,52 +607,33 @@ void CompressedLinePositionStorage::append( uint64_t pos )
 uint64_t CompressedLinePositionStorage::at( uint32_t index ) const
 {
     char* ptr;
-    uint64_t position;
-
-    Cache* last_read = last_read_.getPtr();
-
-    if ( index < first_long_line_ ) {
-        if ( ( index == last_read->index + 1 ) && ( index % BLOCK_SIZE != 0 ) ) {
-            position = last_read->position;
-            ptr      = last_read->ptr;
-
-            position = block32_next_pos( &ptr, position );
-        }
-        else {
-            char* block = block32_index_[ index / BLOCK_SIZE ];
-            position = block32_initial_pos( block, &ptr );
+    return blocks_at( first_long_line_, index, &ptr,
+            [this]( uint32_t block ) { return block32_index_[block]; },
+            [this]( uint32_t block ) { return block64_index_[block]; } );
+}
 
-            for ( uint32_t i = 0; i < index % BLOCK_SIZE; i++ ) {
-                // Go through all the lines in the block till the one we want
-                position = block32_next_pos( &ptr, position );
-            }
-        }
-    }
-    else {
-        const uint32_t index_in_64 = index - first_long_line_;
-        if ( ( index == last_read->index + 1 ) && ( index_in_64 % BLOCK_SIZE != 0 ) ) {
-            position = last_read->position;
-            ptr      = last_read->ptr;
+void CompressedLinePositionStorage::get_range( uint32_t first,
+        uint32_t count, uint64_t* out ) const
+{
+    assert( first + count <= nb_lines_ );
 
-            position = block64_next_pos( &ptr, position );
-        }
-        else {
-            char* block = block64_index_[ index_in_64 / BLOCK_SIZE ];
-            position = block64_initial_pos( block, &ptr );
+    blocks_get_range( first_long_line_, first, count, out,
+            [this]( uint32_t block ) { return block32_index_[block]; },
+            [this]( uint32_t block ) { return block64_index_[block]; } );
+}
 
-            for ( uint32_t i = 0; i < index_in_64 % BLOCK_SIZE; i++ ) {
-                // Go through all the lines in the block till the one we want
-                position = block64_next_pos( &ptr, position );
-            }
-        }
-    }
+uint32_t CompressedLinePositionStorage::line_for_offset( uint64_t offset ) const
+{
+    const uint32_t nb_lines32 = std::min( nb_lines_, first_long_line_ );
 
-    // Populate our cache ready for next consecutive read
-    last_read->index    = index;
-    last_read->position = position;
-    last_read->ptr      = ptr;
+    // The table64 follows the table32
+    if ( ! block64_index_.empty()
+            && offset >= *(reinterpret_cast<uint64_t*>(block64_index_.front())) )
+        return nb_lines32 + blocks_count_up_to<uint64_t, block64_next_pos>(
+                block64_index_, nb_lines_ - nb_lines32, offset );
 
-    return position;
+    return blocks_count_up_to<uint32_t, block32_next_pos>(
+            block32_index_, nb_lines32, offset );
 }
 
 void CompressedLinePositionStorage::append_list(
@@ -395,6 +648,9 @@ void CompressedLinePositionStorage::append_list(
 // template<int BLOCK_SIZE>
 void CompressedLinePositionStorage::pop_back()
 {
+    used_size_ -= last_entry_size_;
+    last_entry_size_ = 0;
+
     // Removing the last entered data, there are two cases
     if ( previous_block_pointer_ ) {
         // The last append was a normal entry in an existing block,
@@ -404,23 +660,19 @@ void CompressedLinePositionStorage::pop_back()
     }
     else {
         // A new block has been created for the last entry, we need
-        // to de-alloc it.
+        // to drop it (its buffer will be reused).
 
         if ( first_long_line_ == UINT32_MAX ) {
             // If we try to pop_back() twice, we're dead!
             assert( ( nb_lines_ - 1 ) % BLOCK_SIZE == 0 );
 
-            char* block = block32_index_.back();
             block32_index_.pop_back();
-            free( block );
         }
         else {
             // If we try to pop_back() twice, we're dead!
             assert( ( nb_lines_ - first_long_line_ - 1 ) % BLOCK_SIZE == 0 );
 
-            char* block = block64_index_.back();
             block64_index_.pop_back();
-            free( block );
         }
 
         block_pointer_ = nullptr;
@@ -429,3 +681,260 @@ void CompressedLinePositionStorage::pop_back()
     --nb_lines_;
     current_pos_ = at( nb_lines_ - 1 );
 }
+
+size_t CompressedLinePositionStorage::memory_usage() const
+{
+    return used_size_ + ( block32_index_.capacity()
+            + block64_index_.capacity() ) * sizeof( char* );
+}
+
+void CompressedLinePositionStorage::publish_blocks(
+        const std::vector<char*>& index,
+        std::vector<std::shared_ptr<BlockPage>>& pages,
+        uint32_t* published, uint32_t end_block )
+{
+    for ( ; *published < end_block; ++*published ) {
+        const uint32_t page = *published / PAGE_BLOCKS;
+        if ( page == pages.size() )
+            pages.push_back( std::make_shared<BlockPage>() );
+
+        // Readers only see the slots below their snapshot's size
+        pages[page]->blocks[*published % PAGE_BLOCKS] = index[*published];
+    }
+}
+
+std::shared_ptr<const CompressedLinePositionStorage::Snapshot>
+CompressedLinePositionStorage::snapshot()
+{
+    // The last line can be replaced by pop_back (and the entry after it
+    // written in its block), the blocks before it cannot change.
+    const uint32_t frozen_lines = ( nb_lines_ > 0 ) ? nb_lines_ - 1 : 0;
+
+    std::shared_ptr<Snapshot> snapshot( new Snapshot() );
+    snapshot->first_long_line_ = first_long_line_;
+
+    if ( frozen_lines <= first_long_line_ ) {
+        publish_blocks( block32_index_, pages32_, &published32_,
+                frozen_lines / BLOCK_SIZE );
+        snapshot->nb_lines_ = published32_ * BLOCK_SIZE;
+    }
+    else {
+        // The table32 is complete, including its last (partial) block
+        publish_blocks( block32_index_, pages32_, &published32_,
+                block32_index_.size() );
+        publish_blocks( block64_index_, pages64_, &published64_,
+                ( frozen_lines - first_long_line_ ) / BLOCK_SIZE );
+        snapshot->nb_lines_ = first_long_line_ + published64_ * BLOCK_SIZE;
+    }
+
+    snapshot->pages32_.assign( pages32_.begin(), pages32_.end() );
+    snapshot->pages64_.assign( pages64_.begin(), pages64_.end() );
+    snapshot->arenas_.assign( arenas_.begin(), arenas_.end() );
+
+    return snapshot;
+}
+
+uint64_t CompressedLinePositionStorage::Snapshot::at( uint32_t index ) const
+{
+    char* ptr;
+    return blocks_at( first_long_line_, index, &ptr,
+            [this]( uint32_t block_index ) { return block( pages32_, block_index ); },
+            [this]( uint32_t block_index ) { return block( pages64_, block_index ); } );
+}
+
+void CompressedLinePositionStorage::Snapshot::get_range( uint32_t first,
+        uint32_t count, uint64_t* out ) const
+{
+    assert( first + count <= nb_lines_ );
+
+    blocks_get_range( first_long_line_, first, count, out,
+            [this]( uint32_t index ) { return block( pages32_, index ); },
+            [this]( uint32_t index ) { return block( pages64_, index ); } );
+}
+
+size_t CompressedLinePositionStorage::block_size( const char* block,
+        bool is_block64, uint32_t nb_entries ) const
+{
+    const size_t absolute_size = is_block64 ? sizeof( uint64_t ) : sizeof( uint32_t );
+
+    // Go through the entries to find where the last one starts
+    char* ptr = const_cast<char*>( block ) + absolute_size;
+    char* last_entry = ptr;
+    for ( uint32_t i = 1; i < nb_entries; i++ ) {
+        last_entry = ptr;
+        if ( is_block64 )
+            block64_next_pos( &ptr, 0 );
+        else
+            block32_next_pos( &ptr, 0 );
+    }
+
+    if ( nb_entries == BLOCK_SIZE ) {
+        // Finished block, append() has kept extra space after the last
+        // entry in case it becomes absolute.
+        return ( last_entry + sizeof( uint16_t ) + absolute_size ) - block;
+    }
+    else {
+        return ptr - block;
+    }
+}
+
+/*
+ * The serialised format is:
+ * - nb_lines_, first_long_line_, current_pos_
+ * - the byte order mark (raw)
+ * - the number of block32, followed by each block (size and content)
+ * - the number of block64, followed by each block (size and content)
+ * - the offsets of block_pointer_ and previous_block_pointer_ in the
+ *   last block (-1 for nullptr)
+ * Positions are stored in machine endianness in the blocks, so the
+ * result can only be read back on a machine with the same byte order.
+ * As it is read from a file, every block is checked when loaded (see
+ * block_check) and the storage rejected if one is not valid.
+ */
+void CompressedLinePositionStorage::save( QDataStream& out ) const
+{
+    out << nb_lines_ << first_long_line_ << static_cast<quint64>( current_pos_ );
+    out.writeRawData( reinterpret_cast<const char*>( &byteOrderMark ),
+            sizeof( byteOrderMark ) );
+
+    const uint32_t nb_lines32 = qMin( nb_lines_, first_long_line_ );
+    const uint32_t nb_lines64 = nb_lines_ - nb_lines32;
+
+    char* last_block = nullptr;
+    size_t last_block_size = 0;
+
+    for ( int table = 0; table < 2; table++ ) {
+        const bool is_block64 = ( table == 1 );
+        const std::vector<char*>& index = is_block64 ? block64_index_ : block32_index_;
+        const uint32_t nb_lines = is_block64 ? nb_lines64 : nb_lines32;
+
+        out << static_cast<quint32>( index.size() );
+        for ( uint32_t i = 0; i < index.size(); i++ ) {
+            const uint32_t nb_entries = qMin<uint32_t>( BLOCK_SIZE,
+                    nb_lines - i * BLOCK_SIZE );
+            const size_t size = block_size( index[i], is_block64, nb_entries );
+            out << static_cast<quint32>( size );
+            out.writeRawData( index[i], size );
+
+            last_block = index[i];
+            last_block_size = size;
+        }
+    }
+
+    // Pointers outside of the last block (pop_back after the switch to
+    // block64) are saved as nullptr, making pop_back free the new block.
+    auto offset_in_last_block = [last_block, last_block_size]( const char* ptr ) {
+        return ( ptr && ptr >= last_block && ptr <= last_block + last_block_size ) ?
+            static_cast<qint64>( ptr - last_block ) : -1;
+    };
+    out << offset_in_last_block( block_pointer_ )
+        << offset_in_last_block( previous_block_pointer_ );
+}
+
+bool CompressedLinePositionStorage::load( QDataStream& in )
+{
+    assert( nb_lines_ == 0 );
+
+    quint64 current_pos;
+    uint32_t byte_order_mark = 0;
+    in >> nb_lines_ >> first_long_line_ >> current_pos;
+    current_pos_ = current_pos;
+    in.readRawData( reinterpret_cast<char*>( &byte_order_mark ),
+            sizeof( byte_order_mark ) );
+
+    const uint32_t nb_lines32 = qMin( nb_lines_, first_long_line_ );
+    const uint32_t nb_lines64 = nb_lines_ - nb_lines32;
+
+    bool valid = ( in.status() == QDataStream::Ok )
+        && ( byte_order_mark == byteOrderMark )
+        && ( first_long_line_ == UINT32_MAX || first_long_line_ <= nb_lines_ );
+    char* last_block = nullptr;
+    // Where the entries of the last block end, and its last entry starts
+    size_t last_block_end = 0;
+    size_t last_entry = 0;
+    bool last_block_full = false;
+    // Last position decoded
+    uint64_t position = 0;
+
+    for ( int table = 0; valid && table < 2; table++ ) {
+        const bool is_block64 = ( table == 1 );
+        std::vector<char*>& index = is_block64 ? block64_index_ : block32_index_;
+        const uint32_t nb_lines = is_block64 ? nb_lines64 : nb_lines32;
+        // The last block might still be filled, so we allocate the
+        // maximum possible size for it (in the arena, it is not moved
+        // once finished).
+        const size_t max_size = is_block64 ? block64MaxSize : block32MaxSize;
+        const size_t absolute_size = is_block64 ? sizeof( uint64_t ) : sizeof( uint32_t );
+
+        quint32 nb_blocks = 0;
+        in >> nb_blocks;
+        valid = ( in.status() == QDataStream::Ok )
+            && ( nb_blocks == ( nb_lines + BLOCK_SIZE - 1 ) / BLOCK_SIZE );
+
+        for ( uint32_t i = 0; valid && i < nb_blocks; i++ ) {
+            quint32 size = 0;
+            in >> size;
+            valid = ( in.status() == QDataStream::Ok ) && ( size <= max_size );
+            if ( ! valid )
+                break;
+
+            char* block = arena_allocate(
+                        ( i == nb_blocks - 1 ) ? max_size : size );
+            index.push_back( block );
+
+            valid = ( in.readRawData( block, size ) == static_cast<int>( size ) );
+            if ( ! valid )
+                break;
+
+            const uint32_t nb_entries = qMin<uint32_t>( BLOCK_SIZE,
+                    nb_lines - i * BLOCK_SIZE );
+            const uint64_t* previous_pos = last_block ? &position : nullptr;
+            valid = is_block64 ?
+                block_check<uint64_t, block64_next_pos>( block, size, nb_entries,
+                        previous_pos, &position, &last_entry, &last_block_end ) :
+                block_check<uint32_t, block32_next_pos>( block, size, nb_entries,
+                        previous_pos, &position, &last_entry, &last_block_end );
+
+            // A finished block has room for its last entry to be replaced
+            // by an absolute one (after a pop_back)
+            last_block_full = ( nb_entries == BLOCK_SIZE );
+            if ( valid && last_block_full )
+                valid = ( last_entry + sizeof( uint16_t ) + absolute_size <= size );
+
+            used_size_ += size;
+
+            last_block = block;
+        }
+    }
+
+    qint64 block_offset = -1, previous_block_offset = -1;
+    in >> block_offset >> previous_block_offset;
+
+    // The pointers can only be where the next entry is written (if the
+    // block is not finished) and at the last entry (if there is one
+    // after the initial position)
+    valid = valid && in.status() == QDataStream::Ok
+        && ( nb_lines_ == 0 || position == current_pos_ )
+        && ( block_offset == -1 || ( last_block && ! last_block_full
+                    && static_cast<size_t>( block_offset ) == last_block_end ) )
+        && ( previous_block_offset == -1 || ( last_block && last_entry > 0
+                    && static_cast<size_t>( previous_block_offset ) == last_entry ) );
+
+    if ( ! valid ) {
+        arenas_.clear();
+        block32_index_.clear();
+        block64_index_.clear();
+        nb_lines_ = 0;
+        first_long_line_ = UINT32_MAX;
+        current_pos_ = 0;
+        used_size_ = 0;
+
+        return false;
+    }
+
+    block_pointer_ = ( block_offset >= 0 ) ? last_block + block_offset : nullptr;
+    previous_block_pointer_ = ( previous_block_offset >= 0 ) ?
+        last_block + previous_block_offset : nullptr;
+
+    return true;
+}
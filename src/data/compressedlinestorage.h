@@ -17,10 +17,11 @@
  * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <memory>
 #include <vector>
 #include <cstdint>
 
-#include "threadprivatestore.h"
+class QDataStream;
 
 // This class is a compressed storage backend for LinePositionArray
 // It emulates the interface of a vector, but take advantage of the nature
@@ -73,22 +74,42 @@
  * long-ish (30 KB) lines.
  *
  * The table32 always starts at 0, the table64 starts at first_long_line_
+ *
+ * Allocation:
+ * The block being filled is written in a buffer of the maximum block
+ * size, and copied to an 'arena' once finished, using only the bytes
+ * needed (the arenas are big allocations, from 64 KiB up to 2 MiB, using
+ * huge pages on Linux if the system allows it).
+ * There is no allocation per block and the arenas are freed in one go.
+ *
+ * Lock-free reading:
+ * Once a block is finished and does not hold the last line (which pop_back
+ * can replace), it never changes. snapshot() hands these blocks over to
+ * reference counted pages, shared with an immutable Snapshot of the
+ * storage, that other threads can read while the storage is appended to,
+ * moved or destroyed (the snapshot keeps the arenas it reads alive).
  */
 
 #ifndef COMPRESSEDLINESTORAGE_H
 #define COMPRESSEDLINESTORAGE_H
 
 #define BLOCK_SIZE 256
+// Number of blocks per page of published blocks
+#define PAGE_BLOCKS 1024
 
 //template<int BLOCK_SIZE = 128>
 class CompressedLinePositionStorage
 {
   public:
+    class Snapshot;
+
     // Default constructor
     CompressedLinePositionStorage()
     { nb_lines_ = 0; first_long_line_ = UINT32_MAX;
       current_pos_ = 0; block_pointer_ = nullptr;
-      previous_block_pointer_ = nullptr; }
+      previous_block_pointer_ = nullptr;
+      used_size_ = 0; last_entry_size_ = 0;
+      published32_ = 0; published64_ = 0; }
     // Copy constructor would be slow, delete!
     CompressedLinePositionStorage( const CompressedLinePositionStorage& orig ) = delete;
 
@@ -107,8 +128,17 @@ class CompressedLinePositionStorage
     // Size of the array
     uint32_t size() const
     { return nb_lines_; }
-    // Element at index
+    // Element at index (decoded from the start of its block, use
+    // get_range() to read consecutive elements)
     uint64_t at( uint32_t i ) const;
+    // Write the count elements from first to out, decoding each
+    // block once (much faster than at() for more than a few lines),
+    // this is how the consecutive lines are read.
+    void get_range( uint32_t first, uint32_t count, uint64_t* out ) const;
+    // Number of elements lower than or equal to offset, that is the
+    // index of the line holding the byte at offset (size() if it is
+    // past the last line)
+    uint32_t line_for_offset( uint64_t offset ) const;
 
     // Add one list to the other
     void append_list( const std::vector<uint64_t>& positions );
@@ -116,10 +146,56 @@ class CompressedLinePositionStorage
     // Pop the last element of the storage
     void pop_back();
 
+    // Approximate number of bytes of memory used by the storage
+    size_t memory_usage() const;
+
+    // Returns a snapshot of the storage, where all the lines but the
+    // ones in the last block(s) can be read.
+    std::shared_ptr<const Snapshot> snapshot();
+
+    // Write the content of the storage to the passed stream
+    void save( QDataStream& out ) const;
+    // Replace the content of the (empty) storage by what is read from the
+    // stream, returns false if it is not valid.
+    bool load( QDataStream& in );
+
   private:
+    // Blocks that can no longer change, shared with the snapshots
+    struct BlockPage {
+        char* blocks[PAGE_BLOCKS];
+    };
+
+    // A big allocation the blocks are carved from
+    struct Arena {
+        explicit Arena( size_t size );
+        ~Arena();
+
+        Arena( const Arena& ) = delete;
+        Arena& operator=( const Arena& ) = delete;
+
+        char* data;
+        size_t size;
+        size_t used;
+        // Allocated with mmap (to use huge pages) rather than malloc
+        bool mapped;
+    };
+
     // Utility for move ctor/assign
     void move_from( CompressedLinePositionStorage&& orig );
-    void free_blocks();
+    // Get size bytes from the current arena (or a new one)
+    char* arena_allocate( size_t size );
+    // Returns the buffer for a new block
+    char* open_block();
+    // Copy the first size bytes of the passed block to an arena if it is
+    // in the open block buffer (returns its new address)
+    char* store_block( char* block, size_t size );
+    // Move the blocks of the index up to end_block to the pages
+    static void publish_blocks( const std::vector<char*>& index,
+            std::vector<std::shared_ptr<BlockPage>>& pages,
+            uint32_t* published, uint32_t end_block );
+    // Size of the memory allocated for the passed block
+    size_t block_size( const char* block, bool is_block64,
+            uint32_t nb_entries ) const;
 
     // The two indexes
     std::vector<char*> block32_index_;
@@ -144,25 +220,58 @@ class CompressedLinePositionStorage
 
     // Previous pointer to block element, it is restored when we
     // "pop_back" the last element.
-    // A null pointer here means pop_back need to free the block
+    // A null pointer here means pop_back need to drop the block
     // that has just been created.
     char* previous_block_pointer_;
 
-    // Cache the last position read
-    // This is to speed up consecutive reads (whole page)
-    struct Cache {
-        Cache() {
-            index = UINT32_MAX - 1U;
-            position = 0;
-            ptr = nullptr;
-        }
-
-        uint32_t index;
-        uint64_t position;
-        char* ptr;
-    };
-    mutable ThreadPrivateStore<Cache,2> last_read_; // = { UINT32_MAX - 1U, 0, nullptr };
-    // mutable Cache last_read;
+    // Bytes used in the blocks
+    size_t used_size_;
+    // Bytes used by the last entry (to be removed by pop_back)
+    size_t last_entry_size_;
+
+    // Where the finished blocks are, the last arena being filled
+    std::vector<std::shared_ptr<Arena>> arenas_;
+    // The block being filled (maximum size)
+    std::unique_ptr<char[]> open_block_;
+
+    // The pages of published blocks and the number of blocks of each
+    // table they own.
+    std::vector<std::shared_ptr<BlockPage>> pages32_;
+    std::vector<std::shared_ptr<BlockPage>> pages64_;
+    uint32_t published32_;
+    uint32_t published64_;
+};
+
+// An immutable view of the published blocks of a storage, readable from
+// any thread without locking.
+class CompressedLinePositionStorage::Snapshot
+{
+  public:
+    // Number of lines that can be read
+    uint32_t size() const
+    { return nb_lines_; }
+    // Element at index (must be < size())
+    uint64_t at( uint32_t index ) const;
+    // Write the count elements from first to out (first + count
+    // must be <= size())
+    void get_range( uint32_t first, uint32_t count, uint64_t* out ) const;
+
+  private:
+    friend class CompressedLinePositionStorage;
+
+    Snapshot() : pages32_(), pages64_(), arenas_(), nb_lines_( 0 ),
+        first_long_line_( UINT32_MAX ) {}
+
+    char* block( const std::vector<std::shared_ptr<const BlockPage>>& pages,
+            uint32_t block_index ) const
+    { return pages[block_index / PAGE_BLOCKS]->blocks[block_index % PAGE_BLOCKS]; }
+
+    std::vector<std::shared_ptr<const BlockPage>> pages32_;
+    std::vector<std::shared_ptr<const BlockPage>> pages64_;
+    // Holding the blocks
+    std::vector<std::shared_ptr<const Arena>> arenas_;
+    uint32_t nb_lines_;
+    uint32_t first_long_line_;
 };
 
 #endif
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements EliasFanoLinePositionStorage, a succinct storage
+// for the end of lines.
+
+#include <algorithm>
+#include <cassert>
+
+#include "data/eliasfanolinestorage.h"
+
+namespace {
+    // Number of bits set in the word
+    inline uint32_t popcount64( uint64_t word )
+    {
+#ifdef __GNUC__
+        return __builtin_popcountll( word );
+#else
+        word = word - ( ( word >> 1 ) & 0x5555555555555555ULL );
+        word = ( word & 0x3333333333333333ULL )
+            + ( ( word >> 2 ) & 0x3333333333333333ULL );
+        word = ( word + ( word >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+        return ( word * 0x0101010101010101ULL ) >> 56;
+#endif
+    }
+
+    // Index of the lowest bit set in the (non null) word
+    inline uint32_t lowest_bit( uint64_t word )
+    {
+#ifdef __GNUC__
+        return __builtin_ctzll( word );
+#else
+        uint32_t bit = 0;
+        while ( ! ( word & 1 ) ) {
+            word >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // Position of the rank-th (from 0) bit set in the words, starting
+    // from the bit 'from' (which is counted).
+    inline uint64_t select_from( const uint64_t* words, uint64_t from,
+            uint32_t rank )
+    {
+        uint64_t word_index = from / 64;
+        uint64_t word = words[word_index] & ( ~0ULL << ( from % 64 ) );
+
+        for ( ;; ) {
+            const uint32_t nb_set = popcount64( word );
+            if ( rank < nb_set )
+                break;
+            rank -= nb_set;
+            word = words[++word_index];
+        }
+
+        // Remove the lower bits set
+        for ( ; rank > 0; --rank )
+            word &= word - 1;
+
+        return word_index * 64 + lowest_bit( word );
+    }
+
+    // Read the nb_bits (< 64) bits at the passed bit offset
+    inline uint64_t read_bits( const uint64_t* words, uint64_t offset,
+            uint32_t nb_bits )
+    {
+        if ( nb_bits == 0 )
+            return 0;
+
+        const uint64_t word_index = offset / 64;
+        const uint32_t shift = offset % 64;
+        uint64_t value = words[word_index] >> shift;
+        if ( shift + nb_bits > 64 )
+            value |= words[word_index + 1] << ( 64 - shift );
+
+        return value & ( ( 1ULL << nb_bits ) - 1 );
+    }
+
+    inline void write_bits( uint64_t* words, uint64_t offset,
+            uint32_t nb_bits, uint64_t value )
+    {
+        if ( nb_bits == 0 )
+            return;
+
+        const uint64_t word_index = offset / 64;
+        const uint32_t shift = offset % 64;
+        words[word_index] |= value << shift;
+        if ( shift + nb_bits > 64 )
+            words[word_index + 1] |= value >> ( 64 - shift );
+    }
+
+    // Number of words used by the low bits of a chunk
+    inline uint64_t low_words( uint32_t low_bits )
+    {
+        return ( static_cast<uint64_t>( EliasFanoLinePositionStorage::CHUNK_SIZE )
+                * low_bits + 63 ) / 64;
+    }
+}
+
+const uint32_t EliasFanoLinePositionStorage::CHUNK_SIZE;
+const uint32_t EliasFanoLinePositionStorage::SAMPLE_INTERVAL;
+
+EliasFanoLinePositionStorage::EliasFanoLinePositionStorage()
+    : nb_lines_( 0 ), chunks_(), bits_(), tail_()
+{
+}
+
+EliasFanoLinePositionStorage::EliasFanoLinePositionStorage(
+        EliasFanoLinePositionStorage&& orig )
+    : nb_lines_( orig.nb_lines_ ), chunks_( std::move( orig.chunks_ ) ),
+    bits_( std::move( orig.bits_ ) ), tail_( std::move( orig.tail_ ) )
+{
+    orig.nb_lines_ = 0;
+}
+
+EliasFanoLinePositionStorage& EliasFanoLinePositionStorage::operator=(
+        EliasFanoLinePositionStorage&& orig )
+{
+    nb_lines_ = orig.nb_lines_;
+    chunks_   = std::move( orig.chunks_ );
+    bits_     = std::move( orig.bits_ );
+    tail_     = std::move( orig.tail_ );
+
+    orig.nb_lines_ = 0;
+
+    return *this;
+}
+
+void EliasFanoLinePositionStorage::append( uint64_t pos )
+{
+    // Lines must be stored in order
+    assert( nb_lines_ == 0 || pos > at( nb_lines_ - 1 ) );
+
+    // The full tail is only encoded now, so the line before can
+    // still be popped.
+    if ( tail_.size() == CHUNK_SIZE )
+        encode_tail();
+
+    if ( tail_.capacity() < CHUNK_SIZE )
+        tail_.reserve( CHUNK_SIZE );
+
+    tail_.push_back( pos );
+    ++nb_lines_;
+}
+
+uint64_t EliasFanoLinePositionStorage::at( uint32_t index ) const
+{
+    assert( index < nb_lines_ );
+
+    const uint32_t chunk = index / CHUNK_SIZE;
+    if ( chunk < chunks_.size() )
+        return chunk_at( chunks_[chunk], index % CHUNK_SIZE );
+
+    return tail_[index - chunks_.size() * CHUNK_SIZE];
+}
+
+uint32_t EliasFanoLinePositionStorage::rank( uint64_t pos ) const
+{
+    const uint32_t nb_encoded = chunks_.size() * CHUNK_SIZE;
+
+    if ( ! tail_.empty() && pos >= tail_.front() )
+        return nb_encoded + ( std::upper_bound( tail_.begin(), tail_.end(), pos )
+                - tail_.begin() );
+
+    // The last chunk starting at or before pos
+    auto after = std::upper_bound( chunks_.begin(), chunks_.end(), pos,
+            []( uint64_t position, const Chunk& chunk ) {
+                return position < chunk.base; } );
+    if ( after == chunks_.begin() )
+        return 0;
+
+    const uint32_t chunk = ( after - chunks_.begin() ) - 1;
+    return chunk * CHUNK_SIZE + chunk_rank( chunks_[chunk], pos );
+}
+
+void EliasFanoLinePositionStorage::append_list(
+        const std::vector<uint64_t>& positions )
+{
+    for ( uint64_t pos : positions )
+        append( pos );
+}
+
+void EliasFanoLinePositionStorage::pop_back()
+{
+    // If we try to pop_back() twice (right after a chunk has been
+    // encoded), we're dead!
+    assert( ! tail_.empty() );
+
+    tail_.pop_back();
+    --nb_lines_;
+}
+
+size_t EliasFanoLinePositionStorage::memory_usage() const
+{
+    return chunks_.capacity() * sizeof( Chunk )
+        + bits_.capacity() * sizeof( uint64_t )
+        + tail_.capacity() * sizeof( uint64_t );
+}
+
+void EliasFanoLinePositionStorage::encode_tail()
+{
+    assert( tail_.size() == CHUNK_SIZE );
+
+    Chunk chunk;
+    chunk.base   = tail_.front();
+    chunk.offset = bits_.size();
+
+    const uint64_t universe = tail_.back() - chunk.base;
+    chunk.low_bits = 0;
+    while ( ( universe / CHUNK_SIZE ) >> ( chunk.low_bits + 1 ) )
+        ++chunk.low_bits;
+
+    const uint64_t nb_high_bits = CHUNK_SIZE + ( universe >> chunk.low_bits ) + 1;
+    const size_t new_size = bits_.size() + low_words( chunk.low_bits )
+            + ( nb_high_bits + 63 ) / 64;
+    // Grow by 1/8th rather than doubling, to stay close to the size used
+    if ( new_size > bits_.capacity() )
+        bits_.reserve( new_size + bits_.size() / 8 );
+    bits_.resize( new_size, 0 );
+
+    uint64_t* low  = &bits_[chunk.offset];
+    uint64_t* high = low + low_words( chunk.low_bits );
+    const uint64_t low_mask = ( 1ULL << chunk.low_bits ) - 1;
+
+    for ( uint32_t i = 0; i < CHUNK_SIZE; i++ ) {
+        const uint64_t value = tail_[i] - chunk.base;
+        write_bits( low, static_cast<uint64_t>( i ) * chunk.low_bits,
+                chunk.low_bits, value & low_mask );
+
+        const uint64_t bit = ( value >> chunk.low_bits ) + i;
+        high[bit / 64] |= 1ULL << ( bit % 64 );
+        if ( i % SAMPLE_INTERVAL == 0 )
+            chunk.samples[i / SAMPLE_INTERVAL] = static_cast<uint16_t>( bit );
+    }
+
+    chunks_.push_back( chunk );
+    tail_.clear();
+}
+
+uint64_t EliasFanoLinePositionStorage::chunk_at( const Chunk& chunk,
+        uint32_t index ) const
+{
+    const uint64_t* low  = &bits_[chunk.offset];
+    const uint64_t* high = low + low_words( chunk.low_bits );
+
+    const uint64_t bit = select_from( high,
+            chunk.samples[index / SAMPLE_INTERVAL], index % SAMPLE_INTERVAL );
+    const uint64_t value = ( ( bit - index ) << chunk.low_bits )
+        | read_bits( low, static_cast<uint64_t>( index ) * chunk.low_bits,
+                chunk.low_bits );
+
+    return chunk.base + value;
+}
+
+uint32_t EliasFanoLinePositionStorage::chunk_rank( const Chunk& chunk,
+        uint64_t pos ) const
+{
+    // The last sample <= pos (the first one is the base, <= pos)
+    uint32_t first = 0, last = CHUNK_SIZE / SAMPLE_INTERVAL;
+    while ( last - first > 1 ) {
+        const uint32_t middle = ( first + last ) / 2;
+        if ( chunk_at( chunk, middle * SAMPLE_INTERVAL ) <= pos )
+            first = middle;
+        else
+            last = middle;
+    }
+
+    // Then go through the lines after it
+    const uint64_t* low  = &bits_[chunk.offset];
+    const uint64_t* high = low + low_words( chunk.low_bits );
+
+    uint32_t index = first * SAMPLE_INTERVAL;
+    const uint32_t end = index + SAMPLE_INTERVAL;
+    uint64_t bit = chunk.samples[first];
+    for ( ;; ) {
+        const uint64_t value = ( ( bit - index ) << chunk.low_bits )
+            | read_bits( low, static_cast<uint64_t>( index ) * chunk.low_bits,
+                    chunk.low_bits );
+        if ( chunk.base + value > pos )
+            break;
+
+        if ( ++index == end )
+            break;
+        bit = select_from( high, bit + 1, 0 );
+    }
+
+    return index;
+}
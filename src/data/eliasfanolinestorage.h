@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELIASFANOLINESTORAGE_H
+#define ELIASFANOLINESTORAGE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// This class is a storage backend for LinePositionArray using the
+// Elias-Fano encoding of the (increasing) end of lines.
+// It emulates the interface of a vector.
+//
+// The lines are stored in chunks of CHUNK_SIZE lines, each encoded
+// relative to its first position, with a universe u (last - first
+// position of the chunk) and n = CHUNK_SIZE lines:
+// - the 'l' = floor(log2(u/n)) low bits of each position are stored as
+//   is, packed one after the other,
+// - the remaining high bits are stored in unary: the line i sets the
+//   bit (high bits of the line) + i of a bitvector of n + u/2^l bits.
+// That is about 2 + log2(u/n) bits per line, e.g. a bit more than one
+// byte for lines of ~100 bytes, whatever the lengths variations.
+//
+// Reading line i is finding the i-th bit set ('select') in the high
+// bits, helped by the position of one bit every SAMPLE_INTERVAL, and
+// reading its low bits: no decoding from the start of a block.
+// rank() finds the number of lines ending before a position (the line
+// holding this position) with a binary search on the chunks then on the
+// samples of the chunk.
+//
+// The last (partial) chunk is kept uncompressed until it is full, so
+// pop_back() is cheap.
+// Like the other storages, it is not thread-safe.
+class EliasFanoLinePositionStorage
+{
+  public:
+    // Lines per encoded chunk
+    static const uint32_t CHUNK_SIZE = 1024;
+    // Lines between two samples of the high bits
+    static const uint32_t SAMPLE_INTERVAL = 64;
+
+    // Default constructor
+    EliasFanoLinePositionStorage();
+    // Copy constructor would be slow, delete!
+    EliasFanoLinePositionStorage( const EliasFanoLinePositionStorage& orig ) = delete;
+
+    // Move constructor
+    EliasFanoLinePositionStorage( EliasFanoLinePositionStorage&& orig );
+    // Move assignement
+    EliasFanoLinePositionStorage& operator=( EliasFanoLinePositionStorage&& orig );
+
+    // Append the passed end-of-line to the storage
+    void append( uint64_t pos );
+    void push_back( uint64_t pos )
+    { append( pos ); }
+    // Size of the array
+    uint32_t size() const
+    { return nb_lines_; }
+    // Element at index
+    uint64_t at( uint32_t i ) const;
+    // Number of elements lower than or equal to pos, that is the index
+    // of the line holding the byte at pos
+    uint32_t rank( uint64_t pos ) const;
+
+    // Add one list to the other
+    void append_list( const std::vector<uint64_t>& positions );
+
+    // Pop the last element of the storage
+    void pop_back();
+
+    // Approximate number of bytes of memory used by the storage
+    size_t memory_usage() const;
+
+  private:
+    struct Chunk {
+        // First position of the chunk, the others are relative to it
+        uint64_t base;
+        // Index in bits_ of the low bits, the high bits follow them
+        uint64_t offset;
+        // Number of low bits
+        uint32_t low_bits;
+        // Position in the high bits of every SAMPLE_INTERVAL line
+        uint16_t samples[CHUNK_SIZE / SAMPLE_INTERVAL];
+    };
+
+    // Encode the (full) tail as a new chunk
+    void encode_tail();
+    // Element at index of the passed chunk
+    uint64_t chunk_at( const Chunk& chunk, uint32_t index ) const;
+    // Number of elements of the passed chunk <= pos
+    uint32_t chunk_rank( const Chunk& chunk, uint64_t pos ) const;
+
+    uint32_t nb_lines_;
+    std::vector<Chunk> chunks_;
+    // The low and high bits of all the chunks
+    std::vector<uint64_t> bits_;
+    // The lines after the last chunk
+    std::vector<uint64_t> tail_;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "data/filefingerprint.h"
+
+#include <QCryptographicHash>
+
+namespace {
+    // Most bytes hashed at the beginning and at the end
+    const qint64 maxHashedSize = 64*1024;
+}
+
+FileFingerprint::FileFingerprint()
+    : size_( 0 ), lastLineStart_( 0 ), hash_()
+{
+}
+
+FileFingerprint::FileFingerprint( QIODevice* file,
+        qint64 last_line_start, qint64 size )
+    : size_( size ),
+    lastLineStart_( qMax( last_line_start, size - maxHashedSize ) ),
+    hash_()
+{
+    if ( file->isOpen() && file->size() >= size_ )
+        hash_ = hash( file, lastLineStart_, size_ );
+}
+
+bool FileFingerprint::matches( QIODevice* file ) const
+{
+    if ( isNull() || ! file->isOpen() || file->size() < size_ )
+        return false;
+
+    return hash( file, lastLineStart_, size_ ) == hash_;
+}
+
+QByteArray FileFingerprint::hash( QIODevice* file,
+        qint64 last_line_start, qint64 size )
+{
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+
+    if ( ! file->seek( 0 ) )
+        return QByteArray();
+    hash.addData( file->read( qMin( size, maxHashedSize ) ) );
+
+    if ( ! file->seek( last_line_start ) )
+        return QByteArray();
+    hash.addData( file->read( size - last_line_start ) );
+
+    return hash.result();
+}
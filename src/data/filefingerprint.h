@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILEFINGERPRINT_H
+#define FILEFINGERPRINT_H
+
+#include <QByteArray>
+#include <QIODevice>
+
+// The fingerprint of the part of a file that has been indexed: its size
+// and a hash of its first bytes and of its last indexed line (up to
+// 64 KiB each).
+// It tells, without reading the whole file, whether a file has only been
+// appended to since it was indexed, so only the new data is indexed.
+// This object is a simple value that can be copied freely.
+class FileFingerprint
+{
+  public:
+    // Create a null fingerprint, that matches no file
+    FileFingerprint();
+    // Fingerprint the first 'size' bytes of the passed (open) file,
+    // the last line of them starting at last_line_start.
+    FileFingerprint( QIODevice* file, qint64 last_line_start, qint64 size );
+
+    bool isNull() const
+    { return hash_.isEmpty(); }
+    // Size of the fingerprinted data
+    qint64 size() const
+    { return size_; }
+
+    // Returns whether the passed (open) file still starts with the
+    // fingerprinted data (it can be bigger).
+    bool matches( QIODevice* file ) const;
+
+  private:
+    static QByteArray hash( QIODevice* file, qint64 last_line_start, qint64 size );
+
+    qint64 size_;
+    qint64 lastLineStart_;
+    QByteArray hash_;
+};
+
+#endif
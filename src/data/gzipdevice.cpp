@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements GzipIndex and GzipDevice, giving random access
+// to gzip compressed files (the method is the one of zran.c in the zlib
+// examples).
+
+#include "data/gzipdevice.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "log.h"
+
+namespace {
+    // Size of the deflate window (the most data a block can refer to)
+    const qint64 windowSize = 32*1024;
+    // Size of the compressed blocks read from the file
+    const qint64 inputSize = 64*1024;
+    // Size of the buffer for the data skipped when seeking
+    const qint64 skipSize = 64*1024;
+
+    // windowBits for inflateInit2 reading a gzip header and for raw
+    // deflate data (as used after an access point)
+    const int gzipWindowBits = 15 + 16;
+    const int rawWindowBits  = -15;
+}
+
+const qint64 GzipIndex::defaultSpacing = 1024*1024;
+
+GzipIndex::GzipIndex( qint64 spacing )
+    : mutex_(), spacing_( spacing ), points_(), compressedSize_( 0 )
+{
+}
+
+int GzipIndex::size() const
+{
+    QMutexLocker locker( &mutex_ );
+
+    return points_.size();
+}
+
+bool GzipIndex::needsPoint( qint64 out ) const
+{
+    QMutexLocker locker( &mutex_ );
+
+    const qint64 last_out = points_.empty() ? 0 : points_.back().out;
+    return out >= last_out + spacing_;
+}
+
+void GzipIndex::addPoint( AccessPoint point )
+{
+    QMutexLocker locker( &mutex_ );
+
+    const qint64 last_out = points_.empty() ? 0 : points_.back().out;
+    if ( point.out >= last_out + spacing_ )
+        points_.push_back( std::move( point ) );
+}
+
+bool GzipIndex::pointBefore( qint64 out, AccessPoint* point ) const
+{
+    QMutexLocker locker( &mutex_ );
+
+    auto after = std::upper_bound( points_.begin(), points_.end(), out,
+            []( qint64 position, const AccessPoint& p ) {
+                return position < p.out; } );
+
+    if ( after == points_.begin() )
+        return false;
+
+    *point = *( after - 1 );
+    return true;
+}
+
+qint64 GzipIndex::compressedSize() const
+{
+    QMutexLocker locker( &mutex_ );
+
+    return compressedSize_;
+}
+
+void GzipIndex::setCompressedSize( qint64 size )
+{
+    QMutexLocker locker( &mutex_ );
+
+    compressedSize_ = size;
+}
+
+bool GzipIndex::isGzipFile( const QString& file_name )
+{
+    QFile file( file_name );
+    if ( ! file.open( QIODevice::ReadOnly ) || file.isSequential() )
+        return false;
+
+    return file.read( 2 ) == QByteArray( "\x1f\x8b" );
+}
+
+GzipDevice::GzipDevice( const QString& file_name,
+        std::shared_ptr<GzipIndex> index, Mode mode )
+    : QIODevice(), file_( file_name ), index_( std::move( index ) ),
+    mode_( mode ), stream_(), streamReady_( false ), raw_( false ),
+    endOfData_( false ), out_( 0 ), input_(), window_(), windowPos_( 0 ),
+    windowFilled_( 0 )
+{
+}
+
+GzipDevice::~GzipDevice()
+{
+    if ( isOpen() )
+        close();
+}
+
+bool GzipDevice::open( OpenMode mode )
+{
+    if ( ( mode & ~( QIODevice::Unbuffered | QIODevice::Text ) )
+            != QIODevice::ReadOnly ) {
+        setErrorString( "Compressed files are read only" );
+        return false;
+    }
+
+    if ( ! file_.open( QIODevice::ReadOnly | QIODevice::Unbuffered ) ) {
+        setErrorString( file_.errorString() );
+        return false;
+    }
+
+    input_.resize( inputSize );
+    if ( mode_ == Mode::BuildIndex )
+        window_.resize( windowSize );
+
+    if ( ! restartFrom( nullptr ) ) {
+        file_.close();
+        return false;
+    }
+
+    // We are not buffered, so pos() is the position of the data
+    // asked to readData()
+    return QIODevice::open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+}
+
+void GzipDevice::close()
+{
+    if ( streamReady_ ) {
+        inflateEnd( &stream_ );
+        streamReady_ = false;
+    }
+    file_.close();
+
+    QIODevice::close();
+}
+
+qint64 GzipDevice::size() const
+{
+    return out_;
+}
+
+bool GzipDevice::atEnd() const
+{
+    return endOfData_ && pos() >= out_;
+}
+
+qint64 GzipDevice::compressedPos() const
+{
+    return file_.pos() - stream_.avail_in;
+}
+
+qint64 GzipDevice::compressedSize() const
+{
+    return file_.size();
+}
+
+qint64 GzipDevice::readData( char* data, qint64 max_size )
+{
+    if ( ! moveTo( pos() ) )
+        return endOfData_ ? 0 : -1;
+
+    return inflateInto( data, max_size );
+}
+
+qint64 GzipDevice::writeData( const char*, qint64 )
+{
+    return -1;
+}
+
+bool GzipDevice::moveTo( qint64 position )
+{
+    if ( streamReady_ && position == out_ )
+        return true;
+
+    // Continuing is better than restarting, unless there is a closer
+    // access point.
+    GzipIndex::AccessPoint point;
+    const bool has_point = index_->pointBefore( position, &point );
+    const bool can_continue = streamReady_ && ! endOfData_
+        && out_ <= position && ( ! has_point || point.out <= out_ );
+
+    if ( ! can_continue && ! restartFrom( has_point ? &point : nullptr ) )
+        return false;
+
+    char skipped[skipSize];
+    while ( out_ < position ) {
+        if ( inflateInto( skipped, qMin( skipSize, position - out_ ) ) == 0 )
+            return false;
+    }
+
+    return true;
+}
+
+bool GzipDevice::restartFrom( const GzipIndex::AccessPoint* point )
+{
+    if ( streamReady_ ) {
+        inflateEnd( &stream_ );
+        streamReady_ = false;
+    }
+
+    memset( &stream_, 0, sizeof( stream_ ) );
+    endOfData_    = false;
+    windowPos_    = 0;
+    windowFilled_ = 0;
+
+    if ( ! point ) {
+        if ( inflateInit2( &stream_, gzipWindowBits ) != Z_OK
+                || ! file_.seek( 0 ) )
+            return false;
+
+        streamReady_ = true;
+        raw_ = false;
+        out_ = 0;
+
+        return true;
+    }
+
+    if ( inflateInit2( &stream_, rawWindowBits ) != Z_OK )
+        return false;
+    streamReady_ = true;
+    raw_ = true;
+
+    // The first bits of the next block are in the byte before 'in'
+    if ( ! file_.seek( point->in - ( point->bits ? 1 : 0 ) ) )
+        return false;
+    if ( point->bits ) {
+        char byte;
+        if ( ! file_.getChar( &byte ) )
+            return false;
+        inflatePrime( &stream_, point->bits,
+                static_cast<unsigned char>( byte ) >> ( 8 - point->bits ) );
+    }
+
+    QByteArray window( windowSize, '\0' );
+    uLongf window_length = windowSize;
+    if ( uncompress( reinterpret_cast<Bytef*>( window.data() ), &window_length,
+                reinterpret_cast<const Bytef*>( point->window.constData() ),
+                point->window.size() ) != Z_OK ) {
+        LOG(logERROR) << "Corrupted access point in the index of "
+            << file_.fileName().toStdString();
+        return false;
+    }
+    if ( window_length > 0 )
+        inflateSetDictionary( &stream_,
+                reinterpret_cast<const Bytef*>( window.constData() ),
+                window_length );
+
+    out_ = point->out;
+    if ( mode_ == Mode::BuildIndex )
+        updateWindow( window.constData(), window_length );
+
+    return true;
+}
+
+qint64 GzipDevice::inflateInto( char* data, qint64 length )
+{
+    qint64 produced = 0;
+
+    while ( produced < length && ! endOfData_ ) {
+        if ( stream_.avail_in == 0 ) {
+            const qint64 nb_read = file_.read(
+                    reinterpret_cast<char*>( input_.data() ), input_.size() );
+            if ( nb_read <= 0 ) {
+                // A truncated file gives what could be decompressed
+                endOfData_ = true;
+                break;
+            }
+            stream_.next_in  = input_.data();
+            stream_.avail_in = nb_read;
+        }
+
+        const uInt out_length = qMin<qint64>( length - produced, 1 << 30 );
+        stream_.next_out  = reinterpret_cast<Bytef*>( data + produced );
+        stream_.avail_out = out_length;
+
+        // Stop at the end of each block if we are looking for access points
+        const int result = inflate( &stream_,
+                mode_ == Mode::BuildIndex ? Z_BLOCK : Z_NO_FLUSH );
+
+        const qint64 nb_out = out_length - stream_.avail_out;
+        if ( mode_ == Mode::BuildIndex )
+            updateWindow( data + produced, nb_out );
+        produced += nb_out;
+        out_     += nb_out;
+
+        if ( result == Z_STREAM_END ) {
+            // Another gzip member can follow (e.g. concatenated files)
+            if ( raw_ && ! skipTrailer() ) {
+                endOfData_ = true;
+                break;
+            }
+            inflateReset2( &stream_, gzipWindowBits );
+            raw_ = false;
+
+            if ( stream_.avail_in == 0 && file_.atEnd() )
+                endOfData_ = true;
+        }
+        else if ( result != Z_OK && result != Z_BUF_ERROR ) {
+            LOG(logWARNING) << "Cannot decompress " << file_.fileName().toStdString()
+                << " past " << out_ << " ("
+                << ( stream_.msg ? stream_.msg : "error" ) << ")";
+            endOfData_ = true;
+        }
+        else if ( mode_ == Mode::BuildIndex
+                && ( stream_.data_type & 128 ) && ! ( stream_.data_type & 64 )
+                && index_->needsPoint( out_ ) ) {
+            // At the end of a block that is not the last one
+            addAccessPoint();
+        }
+    }
+
+    if ( endOfData_ && mode_ == Mode::BuildIndex )
+        index_->setCompressedSize( file_.size() );
+
+    return produced;
+}
+
+bool GzipDevice::skipTrailer()
+{
+    // CRC32 and size
+    uInt to_skip = 8;
+
+    while ( to_skip > 0 ) {
+        if ( stream_.avail_in == 0 ) {
+            const qint64 nb_read = file_.read(
+                    reinterpret_cast<char*>( input_.data() ), input_.size() );
+            if ( nb_read <= 0 )
+                return false;
+            stream_.next_in  = input_.data();
+            stream_.avail_in = nb_read;
+        }
+
+        const uInt skipped = qMin( to_skip, stream_.avail_in );
+        stream_.next_in  += skipped;
+        stream_.avail_in -= skipped;
+        to_skip          -= skipped;
+    }
+
+    return true;
+}
+
+void GzipDevice::updateWindow( const char* data, qint64 length )
+{
+    if ( length >= windowSize ) {
+        memcpy( window_.data(), data + length - windowSize, windowSize );
+        windowPos_ = 0;
+    }
+    else {
+        const size_t first_part = qMin<qint64>( length, windowSize - windowPos_ );
+        memcpy( window_.data() + windowPos_, data, first_part );
+        memcpy( window_.data(), data + first_part, length - first_part );
+        windowPos_ = ( windowPos_ + length ) % windowSize;
+    }
+
+    windowFilled_ += length;
+}
+
+void GzipDevice::addAccessPoint()
+{
+    // Put the window back in order, the oldest byte first
+    const qint64 window_length = qMin( windowFilled_, windowSize );
+    QByteArray window( window_length, '\0' );
+    const size_t oldest = ( windowPos_ + windowSize - window_length ) % windowSize;
+    const size_t first_part = qMin<qint64>( window_length, windowSize - oldest );
+    memcpy( window.data(), window_.data() + oldest, first_part );
+    memcpy( window.data() + first_part, window_.data(), window_length - first_part );
+
+    uLongf compressed_length = compressBound( window_length );
+    QByteArray compressed( compressed_length, '\0' );
+    if ( compress2( reinterpret_cast<Bytef*>( compressed.data() ), &compressed_length,
+                reinterpret_cast<const Bytef*>( window.constData() ), window_length,
+                Z_BEST_SPEED ) != Z_OK )
+        return;
+    compressed.truncate( compressed_length );
+
+    GzipIndex::AccessPoint point;
+    point.out    = out_;
+    point.in     = compressedPos();
+    point.bits   = stream_.data_type & 7;
+    point.window = compressed;
+
+    index_->addPoint( std::move( point ) );
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GZIPDEVICE_H
+#define GZIPDEVICE_H
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QString>
+
+#include <zlib.h>
+
+// The seek points ('access points') of a gzip file, allowing to start
+// decompressing it from the middle.
+// An access point is the state of the decompressor at the boundary of
+// a deflate block: the position in the compressed and uncompressed data,
+// the bits of the last compressed byte already used and the 32 KiB of
+// uncompressed data preceding it (the 'window', kept compressed).
+// They are added in order, roughly every 'spacing' bytes of uncompressed
+// data, by a GzipDevice reading the file sequentially.
+// This class is thread-safe.
+class GzipIndex
+{
+  public:
+    struct AccessPoint {
+        AccessPoint() : out( 0 ), in( 0 ), bits( 0 ), window() {}
+
+        // Position in the uncompressed data
+        qint64 out;
+        // Position of the first compressed byte not (fully) used
+        qint64 in;
+        // Number of bits of the byte before 'in' not used yet (0-7)
+        int bits;
+        // The uncompressed data before 'out' (compressed with zlib)
+        QByteArray window;
+    };
+
+    // Default distance between access points
+    static const qint64 defaultSpacing;
+
+    GzipIndex( qint64 spacing = defaultSpacing );
+
+    // Distance between access points (in uncompressed bytes)
+    qint64 spacing() const
+    { return spacing_; }
+    // Number of access points
+    int size() const;
+
+    // Returns whether a point at the passed position would be added
+    bool needsPoint( qint64 out ) const;
+    // Add the passed point, unless it is too close to the last one
+    void addPoint( AccessPoint point );
+    // Get the last access point at or before the passed position,
+    // returns false if there is none (start from the beginning)
+    bool pointBefore( qint64 out, AccessPoint* point ) const;
+
+    // Size of the compressed file when it was last read to its end
+    qint64 compressedSize() const;
+    void setCompressedSize( qint64 size );
+
+    // Returns whether the passed file is compressed with gzip
+    static bool isGzipFile( const QString& file_name );
+
+  private:
+    mutable QMutex mutex_;
+    const qint64 spacing_;
+    std::vector<AccessPoint> points_;
+    qint64 compressedSize_;
+};
+
+// A read only device giving random access to the uncompressed content
+// of a gzip file (including files made of several gzip members).
+// Reading sequentially decompresses at full speed, seeking restarts the
+// decompression from the closest access point in the index (or continues
+// the current one if the target is close enough ahead).
+// When created to build the index, access points are added to it as the
+// file is read.
+class GzipDevice : public QIODevice
+{
+  public:
+    enum class Mode { Read, BuildIndex };
+
+    GzipDevice( const QString& file_name, std::shared_ptr<GzipIndex> index,
+            Mode mode = Mode::Read );
+    ~GzipDevice();
+
+    // The device can only be opened ReadOnly (and is always unbuffered)
+    bool open( OpenMode mode ) override;
+    void close() override;
+
+    bool isSequential() const override
+    { return false; }
+    // Uncompressed bytes known, the whole content once read to the end
+    qint64 size() const override;
+    bool atEnd() const override;
+
+    // Position in the compressed file
+    qint64 compressedPos() const;
+    // Size of the compressed file
+    qint64 compressedSize() const;
+
+    const std::shared_ptr<GzipIndex>& index() const
+    { return index_; }
+
+  protected:
+    qint64 readData( char* data, qint64 max_size ) override;
+    qint64 writeData( const char* data, qint64 max_size ) override;
+
+  private:
+    // Get the decompressor to the passed uncompressed position
+    bool moveTo( qint64 position );
+    // Restart the decompression from the passed point, or from the
+    // beginning of the file if null.
+    bool restartFrom( const GzipIndex::AccessPoint* point );
+    // Decompress up to length bytes from the current position,
+    // returns the number of bytes produced (0 at the end).
+    qint64 inflateInto( char* data, qint64 length );
+    // Skip the trailer ending a gzip member inflated as raw data
+    bool skipTrailer();
+    // Keep the last 32 KiB of uncompressed data (to build access points)
+    void updateWindow( const char* data, qint64 length );
+    void addAccessPoint();
+
+    QFile file_;
+    std::shared_ptr<GzipIndex> index_;
+    const Mode mode_;
+
+    z_stream stream_;
+    bool streamReady_;
+    // Decompressing raw deflate data (started from an access point)
+    bool raw_;
+    bool endOfData_;
+    // Uncompressed position of the decompressor
+    qint64 out_;
+    std::vector<unsigned char> input_;
+
+    // Circular buffer of the last uncompressed bytes
+    std::vector<char> window_;
+    size_t windowPos_;
+    qint64 windowFilled_;
+};
+
+#endif
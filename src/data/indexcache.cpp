@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements IndexCache.
+// An index file contains:
+// - a header (magic and format version)
+// - the identity of the indexed file (device, inode, size, modification
+//   time and fingerprint)
+// - the IndexingData and the EncodingSpeculator state
+
+#include "data/indexcache.h"
+
+#include <QtGlobal>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include "log.h"
+
+#include "data/logdataworkerthread.h"
+#include "encodingspeculator.h"
+
+namespace {
+    const quint32 INDEX_MAGIC   = 0x676C6958; // "glIX"
+    const quint32 INDEX_VERSION = 5;
+
+    // Size of the beginning and end of the indexed data used as
+    // a fingerprint
+    const qint64 FINGERPRINT_SIZE = 64*1024;
+
+    // What identifies the file an index was created from
+    struct FileIdentity {
+        quint64 device;
+        quint64 inode;
+        qint64 size;
+        qint64 modification_time;
+        QByteArray fingerprint;
+    };
+
+    void get_device_and_inode( const QString& file_name,
+            quint64* device, quint64* inode )
+    {
+        *device = 0;
+        *inode  = 0;
+#ifdef Q_OS_UNIX
+        struct stat file_stat;
+        if ( stat( QFile::encodeName( file_name ).constData(), &file_stat ) == 0 ) {
+            *device = file_stat.st_dev;
+            *inode  = file_stat.st_ino;
+        }
+#else
+        Q_UNUSED( file_name );
+#endif
+    }
+
+    // Hash of the beginning and the end of the first 'size' bytes
+    // of the file
+    QByteArray get_fingerprint( QFile* file, qint64 size )
+    {
+        QCryptographicHash hash( QCryptographicHash::Md5 );
+
+        file->seek( 0 );
+        hash.addData( file->read( qMin( size, FINGERPRINT_SIZE ) ) );
+
+        const qint64 tail_beginning = qMax<qint64>( 0, size - FINGERPRINT_SIZE );
+        file->seek( tail_beginning );
+        hash.addData( file->read( size - tail_beginning ) );
+
+        return hash.result();
+    }
+
+    // Identity of the file, as it is now, the fingerprint being
+    // calculated on the first indexed_size bytes.
+    bool get_identity( const QString& file_name, qint64 indexed_size,
+            FileIdentity* identity )
+    {
+        QFile file( file_name );
+        if ( ! file.open( QIODevice::ReadOnly ) || file.isSequential() )
+            return false;
+
+        get_device_and_inode( file_name, &identity->device, &identity->inode );
+        identity->size = file.size();
+        identity->modification_time =
+            QFileInfo( file ).lastModified().toMSecsSinceEpoch();
+        identity->fingerprint = get_fingerprint( &file,
+                qMin( indexed_size, identity->size ) );
+
+        return true;
+    }
+
+    QDataStream& operator<<( QDataStream& out, const FileIdentity& identity )
+    {
+        return out << identity.device << identity.inode << identity.size
+            << identity.modification_time << identity.fingerprint;
+    }
+
+    QDataStream& operator>>( QDataStream& in, FileIdentity& identity )
+    {
+        return in >> identity.device >> identity.inode >> identity.size
+            >> identity.modification_time >> identity.fingerprint;
+    }
+}
+
+const qint64 IndexCache::defaultMinFileSize = 64*1024*1024;
+
+IndexCache::IndexCache() : directory_(), minFileSize_( 0 )
+{
+}
+
+IndexCache::IndexCache( const QString& directory, qint64 min_file_size )
+    : directory_( directory ), minFileSize_( min_file_size )
+{
+}
+
+bool IndexCache::load( const QString& file_name, IndexingData* indexing_data,
+        EncodingSpeculator* encoding_speculator ) const
+{
+    if ( ! isEnabled() || QFileInfo( file_name ).size() < minFileSize_ )
+        return false;
+
+    QFile cache_file( cacheFileName( file_name ) );
+    if ( ! cache_file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QDataStream in( &cache_file );
+
+    quint32 magic, version;
+    FileIdentity cached;
+    in >> magic >> version;
+    if ( in.status() != QDataStream::Ok
+            || magic != INDEX_MAGIC || version != INDEX_VERSION )
+        return false;
+    in.setVersion( QDataStream::Qt_4_6 );
+    in >> cached;
+
+    // The file must be the same (not a new file with the same name) and
+    // the indexed part must not have been modified, if the file has
+    // grown, its modification time has changed, obviously.
+    FileIdentity current;
+    if ( in.status() != QDataStream::Ok
+            || ! get_identity( file_name, cached.size, &current )
+            || current.device != cached.device
+            || current.inode != cached.inode
+            || current.size < cached.size
+            || current.fingerprint != cached.fingerprint
+            || ( current.size == cached.size
+                && current.modification_time != cached.modification_time ) ) {
+        LOG(logDEBUG) << "Cached index for " << file_name.toStdString()
+            << " is out of date";
+        return false;
+    }
+
+    EncodingSpeculator speculator;
+    if ( ! speculator.load( in )
+            || ! indexing_data->load( in )
+            || indexing_data->getSize() != cached.size ) {
+        LOG(logWARNING) << "Invalid cached index for " << file_name.toStdString();
+        indexing_data->clear();
+        return false;
+    }
+
+    *encoding_speculator = speculator;
+
+    LOG(logINFO) << "Loaded the cached index for " << file_name.toStdString()
+        << " (" << cached.size << " bytes indexed)";
+
+    return true;
+}
+
+void IndexCache::save( const QString& file_name, const IndexingData& indexing_data,
+        const EncodingSpeculator& encoding_speculator ) const
+{
+    // The tail may still be visible, what is saved is the rest
+    const qint64 indexed_size = indexing_data.getIndexedSize();
+
+    if ( ! isEnabled() || indexed_size < minFileSize_ )
+        return;
+
+    FileIdentity identity;
+    if ( ! get_identity( file_name, indexed_size, &identity ) )
+        return;
+    // Only the indexed data are described by this index
+    identity.size = indexed_size;
+
+    if ( ! QDir().mkpath( directory_ ) ) {
+        LOG(logWARNING) << "Cannot create the index cache "
+            << directory_.toStdString();
+        return;
+    }
+
+    // Write to a temporary file first, so a partially written
+    // index is never used.
+    const QString cache_file_name = cacheFileName( file_name );
+    const QString temporary_file_name = cache_file_name + ".new";
+
+    {
+        QFile cache_file( temporary_file_name );
+        if ( ! cache_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+            LOG(logWARNING) << "Cannot write the index cache "
+                << temporary_file_name.toStdString();
+            return;
+        }
+
+        QDataStream out( &cache_file );
+        out << INDEX_MAGIC << INDEX_VERSION;
+        out.setVersion( QDataStream::Qt_4_6 );
+        out << identity;
+        encoding_speculator.save( out );
+        indexing_data.save( out );
+
+        if ( out.status() != QDataStream::Ok || ! cache_file.flush() ) {
+            cache_file.close();
+            cache_file.remove();
+            return;
+        }
+    }
+
+    QFile::remove( cache_file_name );
+    if ( ! QFile::rename( temporary_file_name, cache_file_name ) )
+        QFile::remove( temporary_file_name );
+    else
+        LOG(logDEBUG) << "Index for " << file_name.toStdString()
+            << " saved to " << cache_file_name.toStdString();
+}
+
+IndexCache IndexCache::defaultCache()
+{
+    return IndexCache( defaultDirectory(), defaultMinFileSize );
+}
+
+QString IndexCache::defaultDirectory()
+{
+#if QT_VERSION >= 0x050000
+    const QString cache_location =
+        QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+#else
+    const QString cache_location =
+        QDesktopServices::storageLocation( QDesktopServices::CacheLocation );
+#endif
+
+    return cache_location.isEmpty() ? QString() : cache_location + "/index";
+}
+
+QString IndexCache::cacheFileName( const QString& file_name ) const
+{
+    const QByteArray path = QFileInfo( file_name ).absoluteFilePath().toUtf8();
+
+    return directory_ + "/" + QString::fromLatin1(
+            QCryptographicHash::hash( path, QCryptographicHash::Sha1 ).toHex() )
+        + ".idx";
+}
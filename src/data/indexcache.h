@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDEXCACHE_H
+#define INDEXCACHE_H
+
+#include <QString>
+
+class IndexingData;
+class EncodingSpeculator;
+
+// The index cache saves the result of the indexing of big files in
+// a file on disk, so they don't need to be indexed again when they are
+// reopened.
+// A cached index is only used if the file has not been replaced or
+// modified since (device, inode, size, modification time and a
+// fingerprint of its beginning and end are checked), except for data
+// appended at the end, which is then indexed as usual.
+// This object is a simple value that can be copied freely.
+class IndexCache
+{
+  public:
+    // Create a disabled cache
+    IndexCache();
+    // Create a cache storing its files in the passed directory, only
+    // files bigger than min_file_size are cached.
+    IndexCache( const QString& directory, qint64 min_file_size );
+
+    bool isEnabled() const
+    { return ! directory_.isEmpty(); }
+
+    // Load the cached indexing data for the passed file into the
+    // (empty) indexing data and encoding speculator.
+    // Returns false and leave the data empty if there is no valid
+    // index in the cache.
+    bool load( const QString& file_name, IndexingData* indexing_data,
+            EncodingSpeculator* encoding_speculator ) const;
+    // Save the indexing data for the passed file, replacing any previous
+    // version.
+    void save( const QString& file_name, const IndexingData& indexing_data,
+            const EncodingSpeculator& encoding_speculator ) const;
+
+    // Returns a cache using the default directory and minimum size
+    static IndexCache defaultCache();
+
+    // Directory where the index files are stored by default
+    static QString defaultDirectory();
+    // Smallest file cached by default (smaller files are indexed
+    // in less time than it takes to check the cache).
+    static const qint64 defaultMinFileSize;
+
+  private:
+    // Name of the file storing the cached index of the passed file
+    QString cacheFileName( const QString& file_name ) const;
+
+    QString directory_;
+    qint64 minFileSize_;
+};
+
+#endif
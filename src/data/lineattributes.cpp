@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements LineAttributeArray and LineExpansionArray,
+// storing what is found of the lines when indexing.
+
+#include "data/lineattributes.h"
+
+#include <algorithm>
+
+const int LineAttributeArray::LINES_PER_GROUP;
+const int LineAttributeArray::GROUPS_PER_PAGE;
+const uint32_t LineAttributeArray::LINES_PER_PAGE;
+
+void LineAttributeArray::append_list( const LineAttributeList& attributes )
+{
+    for ( LineAttributes line_attributes : attributes ) {
+        if ( nb_lines_ % LINES_PER_PAGE == 0 )
+            pages_.push_back( std::make_shared<Page>() );
+
+        const uint32_t group = ( nb_lines_ % LINES_PER_PAGE ) / LINES_PER_GROUP;
+        ( *pages_.back() )[group] |= line_attributes;
+        ++nb_lines_;
+    }
+}
+
+LineAttributes LineAttributeArray::at( uint32_t index ) const
+{
+    if ( index >= nb_lines_ )
+        return LineAttribute::Unknown;
+
+    return ( *pages_[ index / LINES_PER_PAGE ] )
+        [ ( index % LINES_PER_PAGE ) / LINES_PER_GROUP ];
+}
+
+std::shared_ptr<const LineAttributeArray::Snapshot>
+LineAttributeArray::snapshot() const
+{
+    std::shared_ptr<Snapshot> snapshot( new Snapshot() );
+    snapshot->nb_lines_ = nb_lines_;
+
+    // The full pages cannot change, the last one is copied
+    const size_t nb_full_pages = nb_lines_ / LINES_PER_PAGE;
+    snapshot->pages_.assign( pages_.begin(), pages_.begin() + nb_full_pages );
+    if ( pages_.size() > nb_full_pages )
+        snapshot->pages_.push_back( std::make_shared<Page>( *pages_.back() ) );
+
+    return snapshot;
+}
+
+void LineAttributeArray::save( QDataStream& out ) const
+{
+    out << static_cast<quint32>( nb_lines_ );
+
+    for ( const auto& page : pages_ )
+        out.writeRawData( reinterpret_cast<const char*>( page->data() ),
+                page->size() );
+}
+
+bool LineAttributeArray::load( QDataStream& in )
+{
+    quint32 nb_lines;
+    in >> nb_lines;
+    if ( in.status() != QDataStream::Ok )
+        return false;
+
+    const uint32_t nb_pages = ( nb_lines + LINES_PER_PAGE - 1 ) / LINES_PER_PAGE;
+    std::vector<std::shared_ptr<Page>> pages;
+    for ( uint32_t i = 0; i < nb_pages; ++i ) {
+        auto page = std::make_shared<Page>();
+        if ( in.readRawData( reinterpret_cast<char*>( page->data() ), page->size() )
+                != static_cast<int>( page->size() ) )
+            return false;
+        pages.push_back( std::move( page ) );
+    }
+
+    pages_    = std::move( pages );
+    nb_lines_ = nb_lines;
+
+    return true;
+}
+
+void LineAttributeArray::Snapshot::get_range( uint32_t first, uint32_t count,
+        LineAttributes* out ) const
+{
+    for ( uint32_t i = 0; i < count; ++i ) {
+        const uint32_t line = first + i;
+        out[i] = ( line < nb_lines_ ) ?
+            ( *pages_[ line / LINES_PER_PAGE ] )
+                [ ( line % LINES_PER_PAGE ) / LINES_PER_GROUP ]
+            : LineAttribute::Unknown;
+    }
+}
+
+const uint32_t LineExpansionArray::LINES_PER_PAGE;
+const uint8_t LineExpansionArray::DOS_LINE;
+const uint8_t LineExpansionArray::LARGE;
+
+void LineExpansionArray::append_list( const LineExpansionList& expansions )
+{
+    for ( int32_t expansion : expansions ) {
+        if ( nb_lines_ % LINES_PER_PAGE == 0 ) {
+            pages_.emplace_back();
+            large_.emplace_back();
+        }
+
+        if ( expansion != 0 ) {
+            if ( ! pages_.back() )
+                pages_.back() = std::make_shared<Page>();
+
+            uint8_t stored;
+            if ( expansion == -1 )
+                stored = DOS_LINE;
+            else if ( expansion > 0 && expansion < DOS_LINE )
+                stored = expansion;
+            else {
+                stored = LARGE;
+                if ( ! large_.back() )
+                    large_.back() = std::make_shared<LargePage>();
+                large_.back()->push_back( LargeExpansion( nb_lines_, expansion ) );
+            }
+            ( *pages_.back() )[ nb_lines_ % LINES_PER_PAGE ] = stored;
+        }
+        ++nb_lines_;
+    }
+}
+
+int32_t LineExpansionArray::at( uint32_t index ) const
+{
+    return find( pages_[ index / LINES_PER_PAGE ].get(),
+            large_[ index / LINES_PER_PAGE ].get(), index );
+}
+
+std::shared_ptr<const LineExpansionArray::Snapshot>
+LineExpansionArray::snapshot() const
+{
+    std::shared_ptr<Snapshot> snapshot( new Snapshot() );
+    snapshot->nb_lines_ = nb_lines_;
+
+    // The full pages (and their lines kept apart) cannot change, they
+    // are shared, the last one is copied
+    const size_t nb_full_pages = nb_lines_ / LINES_PER_PAGE;
+    snapshot->pages_.assign( pages_.begin(), pages_.begin() + nb_full_pages );
+    snapshot->large_.assign( large_.begin(), large_.begin() + nb_full_pages );
+    if ( pages_.size() > nb_full_pages ) {
+        snapshot->pages_.push_back( pages_.back() ?
+                std::make_shared<Page>( *pages_.back() ) : nullptr );
+        snapshot->large_.push_back( large_.back() ?
+                std::make_shared<LargePage>( *large_.back() ) : nullptr );
+    }
+
+    return snapshot;
+}
+
+void LineExpansionArray::save( QDataStream& out ) const
+{
+    out << static_cast<quint32>( nb_lines_ );
+
+    // Whether each page is stored, followed by its content
+    for ( const auto& page : pages_ ) {
+        out << static_cast<quint8>( page ? 1 : 0 );
+        if ( page )
+            out.writeRawData( reinterpret_cast<const char*>( page->data() ),
+                    page->size() );
+    }
+
+    // The lines kept apart, in line order
+    quint32 nb_large = 0;
+    for ( const auto& large_page : large_ )
+        nb_large += large_page ? large_page->size() : 0;
+
+    out << nb_large;
+    for ( const auto& large_page : large_ ) {
+        if ( ! large_page )
+            continue;
+        for ( const auto& large : *large_page )
+            out << static_cast<quint32>( large.first )
+                << static_cast<qint32>( large.second );
+    }
+}
+
+bool LineExpansionArray::load( QDataStream& in )
+{
+    quint32 nb_lines;
+    in >> nb_lines;
+    if ( in.status() != QDataStream::Ok )
+        return false;
+
+    const uint32_t nb_pages = ( nb_lines + LINES_PER_PAGE - 1 ) / LINES_PER_PAGE;
+    std::vector<std::shared_ptr<Page>> pages;
+    for ( uint32_t i = 0; i < nb_pages; ++i ) {
+        quint8 stored;
+        in >> stored;
+        if ( in.status() != QDataStream::Ok )
+            return false;
+
+        std::shared_ptr<Page> page;
+        if ( stored ) {
+            page = std::make_shared<Page>();
+            if ( in.readRawData( reinterpret_cast<char*>( page->data() ), page->size() )
+                    != static_cast<int>( page->size() ) )
+                return false;
+        }
+        pages.push_back( std::move( page ) );
+    }
+
+    quint32 nb_large;
+    in >> nb_large;
+    std::vector<std::shared_ptr<LargePage>> large( nb_pages );
+    quint32 previous_line = 0;
+    for ( quint32 i = 0; i < nb_large && in.status() == QDataStream::Ok; ++i ) {
+        quint32 line;
+        qint32 expansion;
+        in >> line >> expansion;
+        // In line order, each in its page
+        if ( line >= nb_lines || ( i > 0 && line <= previous_line ) )
+            return false;
+        previous_line = line;
+
+        std::shared_ptr<LargePage>& large_page = large[ line / LINES_PER_PAGE ];
+        if ( ! large_page )
+            large_page = std::make_shared<LargePage>();
+        large_page->push_back( LargeExpansion( line, expansion ) );
+    }
+    if ( in.status() != QDataStream::Ok )
+        return false;
+
+    pages_    = std::move( pages );
+    large_    = std::move( large );
+    nb_lines_ = nb_lines;
+
+    return true;
+}
+
+int32_t LineExpansionArray::find( const Page* page, const LargePage* large,
+        uint32_t index )
+{
+    if ( ! page )
+        return 0;
+
+    const uint8_t stored = ( *page )[ index % LINES_PER_PAGE ];
+    if ( stored == DOS_LINE )
+        return -1;
+    else if ( stored == LARGE ) {
+        if ( ! large )
+            return 0;
+        const auto it = std::lower_bound( large->begin(), large->end(),
+                LargeExpansion( index, INT32_MIN ) );
+        return ( it != large->end() && it->first == index ) ? it->second : 0;
+    }
+
+    return stored;
+}
+
+bool LineExpansionArray::Snapshot::get( uint32_t index, int32_t* expansion ) const
+{
+    if ( index >= nb_lines_ )
+        return false;
+
+    *expansion = find( pages_[ index / LINES_PER_PAGE ].get(),
+            large_[ index / LINES_PER_PAGE ].get(), index );
+    return true;
+}
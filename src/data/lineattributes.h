@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINEATTRIBUTES_H
+#define LINEATTRIBUTES_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <QDataStream>
+
+// The attributes of a line, found when it is indexed, as a combination
+// of the LineAttribute flags.
+// A flag that is not set guarantees the line does not hold the bytes
+// it stands for, so the readers can skip the work they would need.
+typedef uint8_t LineAttributes;
+
+namespace LineAttribute {
+    enum : LineAttributes {
+        // Holds a tab or a NUL byte (changed when the line is expanded)
+        Expandable     = 0x01,
+        // Holds a byte of 0x80 or more
+        NonAscii       = 0x02,
+        // Holds a carriage return (usually ending it)
+        CarriageReturn = 0x04,
+        // What is assumed of a line whose attributes are not known
+        Unknown        = 0x07,
+    };
+}
+
+// The attributes of consecutive lines, one per line
+typedef std::vector<LineAttributes> LineAttributeList;
+
+// The expansion of consecutive lines, one per line: the difference
+// between the length of a line once expanded (its tabs replaced by spaces
+// and the carriage return ending it removed) and its length in bytes.
+typedef std::vector<int32_t> LineExpansionList;
+
+// This class stores the attributes of the lines of a file.
+// To keep it small, the lines are grouped by LINES_PER_GROUP and only
+// the union of the attributes of a group is kept: the attributes read
+// for a line are those of all the lines of its group.
+// The groups are stored in fixed size pages, all but the last one never
+// change once filled and are shared with the immutable snapshots read
+// without locking.
+class LineAttributeArray
+{
+  public:
+    class Snapshot;
+
+    // Number of lines sharing their attributes
+    static const int LINES_PER_GROUP = 16;
+
+    LineAttributeArray() : pages_(), nb_lines_( 0 ) {}
+
+    LineAttributeArray( LineAttributeArray&& orig ) = default;
+    LineAttributeArray& operator=( LineAttributeArray&& orig ) = default;
+
+    // Copy constructor (slow: deleted)
+    LineAttributeArray( const LineAttributeArray& orig ) = delete;
+    LineAttributeArray& operator=( const LineAttributeArray& orig ) = delete;
+
+    // Add the attributes of the lines following the ones already stored
+    void append_list( const LineAttributeList& attributes );
+
+    // Number of lines whose attributes are stored
+    uint32_t size() const
+    { return nb_lines_; }
+
+    // Get the attributes of the line at index
+    LineAttributes at( uint32_t index ) const;
+
+    // Returns a snapshot of the attributes stored so far
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // Save the attributes to the passed stream
+    void save( QDataStream& out ) const;
+    // Load the attributes previously saved into this (empty) array,
+    // returns false if the saved data are not valid.
+    bool load( QDataStream& in );
+
+  private:
+    static const int GROUPS_PER_PAGE = 4096;
+    static const uint32_t LINES_PER_PAGE = LINES_PER_GROUP * GROUPS_PER_PAGE;
+
+    typedef std::array<LineAttributes, GROUPS_PER_PAGE> Page;
+
+    std::vector<std::shared_ptr<Page>> pages_;
+    uint32_t nb_lines_;
+};
+
+// The attributes of the lines stored in an array when the snapshot has
+// been taken, safe to read from any thread.
+class LineAttributeArray::Snapshot
+{
+  public:
+    // Number of lines in the snapshot
+    uint32_t size() const
+    { return nb_lines_; }
+
+    // Get the attributes of count lines from first, the lines past
+    // the snapshot have LineAttribute::Unknown.
+    void get_range( uint32_t first, uint32_t count, LineAttributes* out ) const;
+
+  private:
+    friend class LineAttributeArray;
+
+    Snapshot() : pages_(), nb_lines_( 0 ) {}
+
+    std::vector<std::shared_ptr<const Page>> pages_;
+    uint32_t nb_lines_;
+};
+
+// This class stores the expansion of each line, so the expanded length
+// of a line is known from its position in the file without reading it.
+// It is stored as one byte per line in pages like LineAttributeArray,
+// but the pages where no line is expanded (no tab nor carriage return)
+// are not allocated, nor copied by the snapshots. The few expansions
+// a byte cannot hold are kept apart.
+class LineExpansionArray
+{
+  public:
+    class Snapshot;
+
+    LineExpansionArray() : pages_(), large_(), nb_lines_( 0 ) {}
+
+    LineExpansionArray( LineExpansionArray&& orig ) = default;
+    LineExpansionArray& operator=( LineExpansionArray&& orig ) = default;
+
+    // Copy constructor (slow: deleted)
+    LineExpansionArray( const LineExpansionArray& orig ) = delete;
+    LineExpansionArray& operator=( const LineExpansionArray& orig ) = delete;
+
+    // Add the expansions of the lines following the ones already stored
+    void append_list( const LineExpansionList& expansions );
+
+    // Number of lines whose expansion is stored
+    uint32_t size() const
+    { return nb_lines_; }
+
+    // Get the expansion of the line at index (which must be stored)
+    int32_t at( uint32_t index ) const;
+
+    // Returns a snapshot of the expansions stored so far
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // Save the expansions to the passed stream
+    void save( QDataStream& out ) const;
+    // Load the expansions previously saved into this (empty) array,
+    // returns false if the saved data are not valid.
+    bool load( QDataStream& in );
+
+  private:
+    static const uint32_t LINES_PER_PAGE = 65536;
+    // Stored for a DOS line without tab
+    static const uint8_t DOS_LINE = 0xFE;
+    // Stored for the lines kept apart
+    static const uint8_t LARGE = 0xFF;
+
+    typedef std::array<uint8_t, LINES_PER_PAGE> Page;
+    // Line and expansion of a line kept apart
+    typedef std::pair<uint32_t, int32_t> LargeExpansion;
+    // The lines of a page kept apart, in line order
+    typedef std::vector<LargeExpansion> LargePage;
+
+    // Get the expansion of the line at index from its page (which is
+    // null if no line is expanded there) and the lines of the page kept
+    // apart (null if none)
+    static int32_t find( const Page* page, const LargePage* large,
+            uint32_t index );
+
+    // Null for the pages where no line is expanded
+    std::vector<std::shared_ptr<Page>> pages_;
+    // For each page, null where no line is kept apart
+    std::vector<std::shared_ptr<LargePage>> large_;
+    uint32_t nb_lines_;
+};
+
+// The expansions stored in an array when the snapshot has been taken,
+// safe to read from any thread.
+class LineExpansionArray::Snapshot
+{
+  public:
+    // Number of lines in the snapshot
+    uint32_t size() const
+    { return nb_lines_; }
+
+    // Get the expansion of the line at index, if it is in the snapshot,
+    // returns whether it is.
+    bool get( uint32_t index, int32_t* expansion ) const;
+
+  private:
+    friend class LineExpansionArray;
+
+    Snapshot() : pages_(), large_(), nb_lines_( 0 ) {}
+
+    std::vector<std::shared_ptr<const Page>> pages_;
+    std::vector<std::shared_ptr<const LargePage>> large_;
+    uint32_t nb_lines_;
+};
+
+#endif
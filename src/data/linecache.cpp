@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements LineCache, the cache of the decoded lines of a log.
+
+#include "data/linecache.h"
+
+#include <QMutexLocker>
+
+namespace {
+    // Approximate memory used by a cached line besides its characters
+    // (list node, hash table entry and QString header)
+    const qint64 lineOverhead = 96;
+
+    qint64 lineCost( const QString& line )
+    {
+        return line.size() * static_cast<qint64>( sizeof( QChar ) ) + lineOverhead;
+    }
+
+    // Consecutive lines are in different shards
+    int shardOf( qint64 line_number )
+    {
+        return line_number % LineCache::NB_SHARDS;
+    }
+}
+
+const int LineCache::NB_SHARDS;
+
+LineCache::LineCache( qint64 memory_budget )
+    : shardBudget_( memory_budget / NB_SHARDS ), generation_( 0 ),
+    hits_( 0 ), misses_( 0 )
+{
+}
+
+void LineCache::setMemoryBudget( qint64 memory_budget )
+{
+    shardBudget_ = memory_budget / NB_SHARDS;
+
+    for ( Shard& shard : shards_ ) {
+        QMutexLocker locker( &shard.mutex );
+        evict( shard, shardBudget_ );
+    }
+}
+
+bool LineCache::find( qint64 line_number, QString* line )
+{
+    Shard& shard = shards_[ shardOf( line_number ) ];
+
+    {
+        QMutexLocker locker( &shard.mutex );
+
+        const auto found = shard.index.find( line_number );
+        if ( found != shard.index.end() ) {
+            // Now the most recently used
+            shard.lines.splice( shard.lines.begin(), shard.lines, found->second );
+            *line = found->second->second;
+            ++hits_;
+            return true;
+        }
+    }
+
+    ++misses_;
+    return false;
+}
+
+void LineCache::insert( quint64 generation, qint64 line_number,
+        const QString& line )
+{
+    const qint64 budget = shardBudget_;
+    const qint64 cost = lineCost( line );
+    if ( cost > budget )
+        return;
+
+    Shard& shard = shards_[ shardOf( line_number ) ];
+    QMutexLocker locker( &shard.mutex );
+
+    // Read before the cache was cleared, it might be out of date
+    if ( generation != generation_ )
+        return;
+
+    const auto found = shard.index.find( line_number );
+    if ( found != shard.index.end() ) {
+        shard.memoryUsed -= lineCost( found->second->second );
+        shard.lines.erase( found->second );
+        shard.index.erase( found );
+    }
+
+    evict( shard, budget - cost );
+
+    shard.lines.emplace_front( line_number, line );
+    shard.index.emplace( line_number, shard.lines.begin() );
+    shard.memoryUsed += cost;
+}
+
+void LineCache::clear()
+{
+    // Before clearing, so the lines being read are not inserted
+    ++generation_;
+
+    for ( Shard& shard : shards_ ) {
+        QMutexLocker locker( &shard.mutex );
+
+        shard.lines.clear();
+        shard.index.clear();
+        shard.memoryUsed = 0;
+    }
+}
+
+LineCache::Statistics LineCache::statistics() const
+{
+    Statistics statistics;
+    statistics.hits       = hits_;
+    statistics.misses     = misses_;
+    statistics.nbLines    = 0;
+    statistics.memoryUsed = 0;
+
+    for ( const Shard& shard : shards_ ) {
+        QMutexLocker locker( &shard.mutex );
+
+        statistics.nbLines    += shard.index.size();
+        statistics.memoryUsed += shard.memoryUsed;
+    }
+
+    return statistics;
+}
+
+void LineCache::evict( Shard& shard, qint64 budget )
+{
+    while ( ! shard.lines.empty() && shard.memoryUsed > budget ) {
+        const auto& oldest = shard.lines.back();
+        shard.memoryUsed -= lineCost( oldest.second );
+        shard.index.erase( oldest.first );
+        shard.lines.pop_back();
+    }
+}
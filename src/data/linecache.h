@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINECACHE_H
+#define LINECACHE_H
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QString>
+
+// A cache of the lines of a log, decoded and expanded (as displayed),
+// keyed by their line number and shared by all the users of the log
+// (the views, the quick find, the search...).
+// The least recently used lines are dropped when the memory used by the
+// lines is over the budget.
+//
+// The lines are spread over NB_SHARDS shards, each with its own mutex and
+// LRU list, so the threads reading different lines do not wait for each
+// other.
+// Lines being read while the cache is cleared (e.g. because the encoding
+// has changed) must not be inserted afterwards: the caller takes the
+// generation() before reading them and passes it to insert(), which
+// ignores them if the cache has been cleared since.
+class LineCache
+{
+  public:
+    static const int NB_SHARDS = 16;
+
+    struct Statistics {
+        quint64 hits;
+        quint64 misses;
+        // Lines in the cache and their approximate memory usage
+        int nbLines;
+        qint64 memoryUsed;
+    };
+
+    // Create a cache using up to memory_budget bytes (0 disables it)
+    explicit LineCache( qint64 memory_budget );
+
+    LineCache( const LineCache& ) = delete;
+    LineCache& operator=( const LineCache& ) = delete;
+
+    // Change the budget, dropping lines if needed
+    void setMemoryBudget( qint64 memory_budget );
+    // Returns whether lines are kept (the budget is not 0)
+    bool isEnabled() const
+    { return shardBudget_ > 0; }
+
+    // Returns whether the passed line is cached, copying it to *line
+    // (the copy is cheap, QString being implicitly shared)
+    bool find( qint64 line_number, QString* line );
+    // Add the passed line, read since the generation passed.
+    void insert( quint64 generation, qint64 line_number, const QString& line );
+    // Current generation, to take before reading lines to insert
+    quint64 generation() const
+    { return generation_; }
+
+    // Drop all the lines
+    void clear();
+
+    // Returns the hits, misses and size of the cache
+    Statistics statistics() const;
+
+  private:
+    struct Shard {
+        typedef std::list<std::pair<qint64, QString>> Lines;
+
+        mutable QMutex mutex;
+        // The most recently used first
+        Lines lines;
+        std::unordered_map<qint64, Lines::iterator> index;
+        qint64 memoryUsed = 0;
+    };
+
+    // Drop the least recently used lines until the shard fits in its budget
+    // (called with its mutex held)
+    void evict( Shard& shard, qint64 budget );
+
+    Shard shards_[NB_SHARDS];
+    std::atomic<qint64> shardBudget_;
+    std::atomic<quint64> generation_;
+    std::atomic<quint64> hits_;
+    std::atomic<quint64> misses_;
+};
+
+#endif
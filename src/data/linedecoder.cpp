@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements LineDecoder, decoding the lines read from a file.
+
+#include "data/linedecoder.h"
+
+#include <cstdint>
+
+#include <QTextCodec>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // MIBenum of the codecs decoded directly
+    const int latin1Mib = 4;
+    const int utf8Mib   = 106;
+
+    // Widen the length bytes to UTF-16 code units
+    void widen_latin1( const uint8_t* in, size_t length, uint16_t* out )
+    {
+        size_t i = 0;
+
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        for ( ; i + 16 <= length; i += 16 ) {
+            const __m128i chunk = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>( in + i ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + i ),
+                    _mm_unpacklo_epi8( chunk, zero ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + i + 8 ),
+                    _mm_unpackhi_epi8( chunk, zero ) );
+        }
+#endif
+
+        for ( ; i < length; ++i )
+            out[i] = in[i];
+    }
+
+    // Widen the bytes up to the first one with its high order bit set,
+    // returns the number of bytes widened.
+    size_t widen_ascii( const uint8_t* in, size_t length, uint16_t* out )
+    {
+        size_t i = 0;
+
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        for ( ; i + 16 <= length; i += 16 ) {
+            const __m128i chunk = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>( in + i ) );
+            if ( _mm_movemask_epi8( chunk ) )
+                break;
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + i ),
+                    _mm_unpacklo_epi8( chunk, zero ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + i + 8 ),
+                    _mm_unpackhi_epi8( chunk, zero ) );
+        }
+#endif
+
+        for ( ; i < length && ! ( in[i] & 0x80 ); ++i )
+            out[i] = in[i];
+
+        return i;
+    }
+
+    inline bool is_continuation( uint8_t byte )
+    {
+        return ( byte & 0xC0 ) == 0x80;
+    }
+
+    // Decode the UTF-8 sequence (of more than one byte) at in, writing
+    // its code units to out.
+    // Returns the number of bytes read, 0 if the sequence is not valid
+    // (or is a noncharacter, which the codecs do not all accept).
+    size_t decode_sequence( const uint8_t* in, size_t length,
+            uint16_t* out, size_t* nb_out )
+    {
+        const uint8_t lead = in[0];
+
+        if ( lead >= 0xC2 && lead <= 0xDF ) {
+            if ( length < 2 || ! is_continuation( in[1] ) )
+                return 0;
+
+            out[0] = ( ( lead & 0x1F ) << 6 ) | ( in[1] & 0x3F );
+            *nb_out = 1;
+            return 2;
+        }
+        else if ( lead >= 0xE0 && lead <= 0xEF ) {
+            // No overlong forms nor surrogates
+            const uint8_t min = ( lead == 0xE0 ) ? 0xA0 : 0x80;
+            const uint8_t max = ( lead == 0xED ) ? 0x9F : 0xBF;
+            if ( length < 3 || in[1] < min || in[1] > max
+                    || ! is_continuation( in[2] ) )
+                return 0;
+
+            const uint16_t code = ( ( lead & 0x0F ) << 12 )
+                | ( ( in[1] & 0x3F ) << 6 ) | ( in[2] & 0x3F );
+            if ( ( code >= 0xFDD0 && code <= 0xFDEF ) || code >= 0xFFFE )
+                return 0;
+
+            out[0] = code;
+            *nb_out = 1;
+            return 3;
+        }
+        else if ( lead >= 0xF0 && lead <= 0xF4 ) {
+            // No overlong forms nor code points past U+10FFFF
+            const uint8_t min = ( lead == 0xF0 ) ? 0x90 : 0x80;
+            const uint8_t max = ( lead == 0xF4 ) ? 0x8F : 0xBF;
+            if ( length < 4 || in[1] < min || in[1] > max
+                    || ! is_continuation( in[2] ) || ! is_continuation( in[3] ) )
+                return 0;
+
+            const uint32_t code = ( ( lead & 0x07 ) << 18 )
+                | ( ( in[1] & 0x3F ) << 12 ) | ( ( in[2] & 0x3F ) << 6 )
+                | ( in[3] & 0x3F );
+            if ( ( code & 0xFFFE ) == 0xFFFE )
+                return 0;
+
+            // As a surrogate pair
+            out[0] = 0xD800 + ( ( code - 0x10000 ) >> 10 );
+            out[1] = 0xDC00 + ( ( code - 0x10000 ) & 0x3FF );
+            *nb_out = 2;
+            return 4;
+        }
+
+        // Continuation byte, overlong 2 bytes form or invalid byte
+        return 0;
+    }
+}
+
+LineDecoder::LineDecoder( QTextCodec* codec )
+    : LineDecoder( codec, methodFor( codec ) )
+{
+}
+
+LineDecoder::LineDecoder( QTextCodec* codec, Method method )
+    : codec_( codec ), method_( method )
+{
+}
+
+QString LineDecoder::decode( const char* data, int length ) const
+{
+    switch ( method_ ) {
+        case Method::Latin1:
+            return widen( data, length );
+        case Method::Utf8:
+            return decodeUtf8( data, length );
+        default:
+            return codec_->toUnicode( data, length );
+    }
+}
+
+QString LineDecoder::decodeAscii( const char* data, int length ) const
+{
+    // ASCII is the same in Latin-1 and UTF-8
+    return ( method_ == Method::Codec ) ?
+        codec_->toUnicode( data, length ) : widen( data, length );
+}
+
+LineDecoder::Method LineDecoder::methodFor( QTextCodec* codec )
+{
+    switch ( codec->mibEnum() ) {
+        case latin1Mib:
+            return Method::Latin1;
+        case utf8Mib:
+            return Method::Utf8;
+        default:
+            return Method::Codec;
+    }
+}
+
+QString LineDecoder::widen( const char* data, int length )
+{
+    QString line( length, Qt::Uninitialized );
+    widen_latin1( reinterpret_cast<const uint8_t*>( data ), length,
+            reinterpret_cast<uint16_t*>( line.data() ) );
+    return line;
+}
+
+QString LineDecoder::decodeUtf8( const char* data, int length ) const
+{
+    const uint8_t* in = reinterpret_cast<const uint8_t*>( data );
+    size_t i = 0;
+
+    // The codec skips a byte order mark at the beginning
+    if ( length >= 3 && in[0] == 0xEF && in[1] == 0xBB && in[2] == 0xBF )
+        i = 3;
+
+    // Never more code units than bytes
+    QString line( length - i, Qt::Uninitialized );
+    uint16_t* out = reinterpret_cast<uint16_t*>( line.data() );
+    size_t nb_out = 0;
+
+    while ( i < static_cast<size_t>( length ) ) {
+        const size_t nb_ascii = widen_ascii( in + i, length - i, out + nb_out );
+        i      += nb_ascii;
+        nb_out += nb_ascii;
+        if ( i == static_cast<size_t>( length ) )
+            break;
+
+        size_t nb_units;
+        const size_t nb_read = decode_sequence( in + i, length - i,
+                out + nb_out, &nb_units );
+        if ( nb_read == 0 )
+            return codec_->toUnicode( data, length );
+
+        i      += nb_read;
+        nb_out += nb_units;
+    }
+
+    line.resize( nb_out );
+    return line;
+}
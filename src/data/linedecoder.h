@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINEDECODER_H
+#define LINEDECODER_H
+
+#include <QString>
+
+class QTextCodec;
+
+// The line decoder turns the raw bytes of a line into a QString.
+//
+// The encodings used for most files (ISO-8859-1, used to display the
+// files detected as ASCII or 8 bit, and UTF-8) are decoded directly to
+// the QString, without going through the QTextCodec: the bytes below 0x80
+// are widened 16 at a time (with SSE2, when available), the other bytes
+// are Latin-1 characters or UTF-8 sequences decoded in place.
+// The other encodings are decoded by the codec, as are the UTF-8 lines
+// that are not valid (so the invalid sequences are replaced exactly as
+// the codec does).
+class LineDecoder
+{
+  public:
+    enum class Method {
+        Codec,
+        Latin1,
+        Utf8,
+    };
+
+    // Create a decoder for the passed codec, using the fastest method
+    // available for it.
+    explicit LineDecoder( QTextCodec* codec );
+    // Create a decoder for the passed codec using the passed method
+    // (which must give the same result as the codec).
+    LineDecoder( QTextCodec* codec, Method method );
+
+    // Decode the passed bytes
+    QString decode( const char* data, int length ) const;
+    // Decode the passed bytes, known to be all below 0x80 (e.g. from the
+    // attributes of the line), they are only widened unless the codec
+    // is needed.
+    QString decodeAscii( const char* data, int length ) const;
+
+    // The method used by this decoder
+    Method method() const
+    { return method_; }
+
+    // Returns the fastest method to decode text in the passed codec
+    static Method methodFor( QTextCodec* codec );
+
+  private:
+    static QString widen( const char* data, int length );
+    QString decodeUtf8( const char* data, int length ) const;
+
+    QTextCodec* codec_;
+    Method method_;
+};
+
+#endif
@@ -20,9 +20,14 @@
 #ifndef LINEPOSITIONARRAY_H
 #define LINEPOSITIONARRAY_H
 
+#include <algorithm>
 #include <vector>
 
+#include <QDataStream>
+
 #include "data/compressedlinestorage.h"
+#include "data/eliasfanolinestorage.h"
+#include "data/sparselinestorage.h"
 
 typedef std::vector<uint64_t> SimpleLinePositionStorage;
 
@@ -39,6 +44,9 @@ class LinePosition
     // Default constructor
     LinePosition() : array()
     { fakeFinalLF_ = false; }
+    // Constructor using an initialised storage
+    explicit LinePosition( Storage&& storage ) : array( std::move( storage ) )
+    { fakeFinalLF_ = false; }
     // Copy constructor (slow: deleted)
     LinePosition( const LinePosition& orig ) = delete;
     // Move assignement
@@ -66,6 +74,13 @@ class LinePosition
     { return array.at( i ); }
     inline uint64_t operator[]( int i ) const
     { return array.at( i ); }
+    // Extract count elements from first to out
+    void get_range( int first, int count, uint64_t* out ) const
+    { get_range_from( array, first, count, out ); }
+    // Index of the line holding the byte at offset (the number of
+    // elements lower than or equal to offset), size() if past the end
+    int line_for_offset( uint64_t offset ) const
+    { return line_for_offset_in( array, offset ); }
     // Set the presence of a fake final LF
     // Must be used after 'append'-ing a fake LF at the end.
     void setFakeFinalLF( bool finalLF=true )
@@ -88,7 +103,85 @@ class LinePosition
         this->fakeFinalLF_ = other.fakeFinalLF_;
     }
 
+    // Copy all the elements of another list (using a different storage)
+    // to this (empty) one.
+    template <typename OtherStorage>
+    void copy_from( const LinePosition<OtherStorage>& other )
+    {
+        // Read by batches, each block of the other list is decoded once
+        uint64_t positions[1024];
+        for ( int first = 0; first < other.size(); first += 1024 ) {
+            const int count = std::min( 1024, other.size() - first );
+            other.get_range( first, count, positions );
+            for ( int i = 0; i < count; i++ )
+                array.push_back( positions[i] );
+        }
+
+        fakeFinalLF_ = other.fakeFinalLF_;
+    }
+
+    // Access to the storage itself
+    const Storage& storage() const
+    { return array; }
+    Storage& storage()
+    { return array; }
+
+    // Save the list to the passed stream
+    void save( QDataStream& out ) const
+    {
+        array.save( out );
+        out << fakeFinalLF_;
+    }
+    // Load a list previously saved into this (empty) list,
+    // returns false if the saved data are not valid.
+    bool load( QDataStream& in )
+    {
+        if ( ! array.load( in ) )
+            return false;
+
+        in >> fakeFinalLF_;
+        return ( in.status() == QDataStream::Ok );
+    }
+
   private:
+    // The compressed storage decodes the range in one go,
+    // the others give the elements one by one
+    static void get_range_from( const CompressedLinePositionStorage& storage,
+            int first, int count, uint64_t* out )
+    { storage.get_range( first, count, out ); }
+    template <typename OtherStorage>
+    static void get_range_from( const OtherStorage& storage,
+            int first, int count, uint64_t* out )
+    {
+        for ( int i = 0; i < count; i++ )
+            out[i] = storage.at( first + i );
+    }
+
+    // Likewise, the compressed and Elias-Fano storages know where to
+    // look, the others are searched with at()
+    static int line_for_offset_in( const CompressedLinePositionStorage& storage,
+            uint64_t offset )
+    { return storage.line_for_offset( offset ); }
+    static int line_for_offset_in( const EliasFanoLinePositionStorage& storage,
+            uint64_t offset )
+    { return storage.rank( offset ); }
+    template <typename OtherStorage>
+    static int line_for_offset_in( const OtherStorage& storage, uint64_t offset )
+    {
+        int first = 0, count = storage.size();
+        while ( count > 0 ) {
+            const int step = count / 2;
+            if ( storage.at( first + step ) <= offset ) {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
     Storage array;
     bool fakeFinalLF_;
 };
@@ -99,4 +192,10 @@ typedef LinePosition<SimpleLinePositionStorage> FastLinePositionArray;
 
 typedef LinePosition<CompressedLinePositionStorage> LinePositionArray;
 
+// Sparse storage, for the files whose index would use too much memory
+typedef LinePosition<SparseLinePositionStorage> SparseLinePositionArray;
+
+// Succinct storage, smaller than the compressed one for most files
+typedef LinePosition<EliasFanoLinePositionStorage> EliasFanoLinePositionArray;
+
 #endif
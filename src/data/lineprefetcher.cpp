@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements LinePrefetcher, reading the lines of a log in
+// the background.
+
+#include "data/lineprefetcher.h"
+
+const int LinePrefetcher::LINES_PER_READ;
+
+LinePrefetcher::LinePrefetcher( ReadLines read_lines )
+    : readLines_( std::move( read_lines ) ), mutex_(), requestCond_(),
+    pending_(), nbLinesRead_( 0 ), stop_( false ), thread_()
+{
+    thread_ = std::thread( &LinePrefetcher::run, this );
+}
+
+LinePrefetcher::~LinePrefetcher()
+{
+    {
+        QMutexLocker locker( &mutex_ );
+        stop_ = true;
+        requestCond_.wakeAll();
+    }
+
+    thread_.join();
+}
+
+void LinePrefetcher::request( const std::vector<LineRange>& ranges )
+{
+    QMutexLocker locker( &mutex_ );
+
+    pending_.clear();
+    for ( const LineRange& range : ranges ) {
+        if ( range.first >= 0 && range.number > 0 )
+            pending_.push_back( range );
+    }
+
+    requestCond_.wakeAll();
+}
+
+qint64 LinePrefetcher::nbLinesRead() const
+{
+    QMutexLocker locker( &mutex_ );
+
+    return nbLinesRead_;
+}
+
+void LinePrefetcher::run()
+{
+    forever {
+        LineRange read;
+        {
+            QMutexLocker locker( &mutex_ );
+
+            while ( ! stop_ && pending_.empty() )
+                requestCond_.wait( &mutex_ );
+
+            if ( stop_ )
+                return;
+
+            // Take the beginning of the first range
+            LineRange& range = pending_.front();
+            read.first  = range.first;
+            read.number = qMin( range.number, LINES_PER_READ );
+            range.first  += read.number;
+            range.number -= read.number;
+            if ( range.number == 0 )
+                pending_.pop_front();
+        }
+
+        readLines_( read.first, read.number );
+
+        QMutexLocker locker( &mutex_ );
+        nbLinesRead_ += read.number;
+    }
+}
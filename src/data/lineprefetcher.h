@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINEPREFETCHER_H
+#define LINEPREFETCHER_H
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "utils.h"
+
+// The line prefetcher reads lines of a log in a dedicated thread, before
+// they are displayed, so they are in the line cache when the view needs
+// them (e.g. the next pages while scrolling).
+// Each request replaces the lines of the previous one still to be read,
+// the ranges are read in order, a few lines at a time, so a new request
+// is taken into account quickly.
+class LinePrefetcher
+{
+  public:
+    // Read (and cache) the passed lines, called in the prefetching thread
+    typedef std::function<void( qint64 first_line, int number )> ReadLines;
+
+    // Number of lines read in one go
+    static const int LINES_PER_READ = 64;
+
+    explicit LinePrefetcher( ReadLines read_lines );
+    // Stop prefetching, waiting for the lines being read if any
+    ~LinePrefetcher();
+
+    LinePrefetcher( const LinePrefetcher& ) = delete;
+    LinePrefetcher& operator=( const LinePrefetcher& ) = delete;
+
+    // Read the passed ranges, instead of what is left of the previous
+    // request
+    void request( const std::vector<LineRange>& ranges );
+
+    // Number of lines read so far
+    qint64 nbLinesRead() const;
+
+  private:
+    // Loop of the prefetching thread
+    void run();
+
+    const ReadLines readLines_;
+
+    // Everything below is protected by mutex_
+    mutable QMutex mutex_;
+    QWaitCondition requestCond_;
+    std::deque<LineRange> pending_;
+    qint64 nbLinesRead_;
+    bool stop_;
+
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements LineScanner and its scanning kernels.
+
+#include "data/linescanner.h"
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define GLOGG_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+    typedef LineScanner::State State;
+
+    // Process one interesting character ('\n', '\t' or '\r') found
+    // at the absolute position pos.
+    inline void process_special( char c, qint64 pos, State* state,
+            FastLinePositionArray* line_positions,
+            LineAttributeList* line_attributes,
+            LineExpansionList* line_expansions, int* max_length )
+    {
+        if ( c == '\n' ) {
+            const int length = pos - state->line_start + state->additional_spaces;
+            if ( length > *max_length )
+                *max_length = length;
+            line_positions->append( pos + 1 );
+            if ( line_attributes )
+                line_attributes->push_back( state->attributes );
+            if ( line_expansions ) {
+                // A carriage return ending the line is not displayed
+                const bool dos_line = ( state->last_cr == pos - 1 );
+                line_expansions->push_back(
+                        state->additional_spaces - ( dos_line ? 1 : 0 ) );
+            }
+            state->line_start = pos + 1;
+            state->additional_spaces = 0;
+            state->attributes = 0;
+        }
+        else if ( c == '\r' ) {
+            state->last_cr = pos;
+            state->attributes |= LineAttribute::CarriageReturn;
+        }
+        else {
+            state->additional_spaces += state->tab_stop -
+                ( ( pos - state->line_start + state->additional_spaces )
+                  % state->tab_stop ) - 1;
+            state->attributes |= LineAttribute::Expandable;
+        }
+    }
+
+    // Byte by byte scan, also used for the tail of the SIMD kernels
+    void scan_scalar( const char* block, size_t length, qint64 block_beginning,
+            State* state, FastLinePositionArray* line_positions,
+            LineAttributeList* line_attributes,
+            LineExpansionList* line_expansions, int* max_length )
+    {
+        for ( size_t i = 0; i < length; ++i ) {
+            const unsigned char c = block[i];
+            if ( c > '\r' && c < 0x80 )
+                continue;
+
+            if ( c == '\n' || c == '\t' || c == '\r' )
+                process_special( c, block_beginning + i, state, line_positions,
+                        line_attributes, line_expansions, max_length );
+            else if ( c == '\0' )
+                state->attributes |= LineAttribute::Expandable;
+            else if ( c & 0x80 )
+                state->attributes |= LineAttribute::NonAscii;
+        }
+    }
+
+#ifdef GLOGG_X86_KERNELS
+    // Walk the bits set in the mask, in order, each bit representing
+    // a '\n', a '\t' or a '\r' at the corresponding offset from 'base'.
+    // The bits of nul and non_ascii are the NUL and non ASCII bytes,
+    // they are given to the line they belong to.
+    inline void process_mask( uint32_t mask, uint32_t nul, uint32_t non_ascii,
+            const char* block, size_t base, qint64 block_beginning,
+            State* state, FastLinePositionArray* line_positions,
+            LineAttributeList* line_attributes,
+            LineExpansionList* line_expansions, int* max_length )
+    {
+        while ( mask ) {
+            const int bit = __builtin_ctz( mask );
+            const size_t i = base + bit;
+
+            if ( block[i] == '\n' && ( nul | non_ascii ) ) {
+                const uint32_t before = ( 1u << bit ) - 1;
+                if ( nul & before )
+                    state->attributes |= LineAttribute::Expandable;
+                if ( non_ascii & before )
+                    state->attributes |= LineAttribute::NonAscii;
+                nul       &= ~before;
+                non_ascii &= ~before;
+            }
+
+            process_special( block[i], block_beginning + i, state,
+                    line_positions, line_attributes, line_expansions,
+                    max_length );
+            mask &= mask - 1;
+        }
+
+        // The rest belongs to the current line
+        if ( nul )
+            state->attributes |= LineAttribute::Expandable;
+        if ( non_ascii )
+            state->attributes |= LineAttribute::NonAscii;
+    }
+
+    __attribute__((target("sse2")))
+    void scan_sse2( const char* block, size_t length, qint64 block_beginning,
+            State* state, FastLinePositionArray* line_positions,
+            LineAttributeList* line_attributes,
+            LineExpansionList* line_expansions, int* max_length )
+    {
+        const __m128i lf   = _mm_set1_epi8( '\n' );
+        const __m128i tab  = _mm_set1_epi8( '\t' );
+        const __m128i cr   = _mm_set1_epi8( '\r' );
+        const __m128i zero = _mm_setzero_si128();
+        // All the interesting bytes are below, as signed bytes
+        const __m128i limit = _mm_set1_epi8( '\r' + 1 );
+
+        size_t i = 0;
+        for ( ; i + 16 <= length; i += 16 ) {
+            const __m128i chunk = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>( block + i ) );
+            if ( ! _mm_movemask_epi8( _mm_cmplt_epi8( chunk, limit ) ) )
+                continue;
+
+            const uint32_t mask = _mm_movemask_epi8( _mm_or_si128( _mm_or_si128(
+                        _mm_cmpeq_epi8( chunk, lf ),
+                        _mm_cmpeq_epi8( chunk, tab ) ),
+                        _mm_cmpeq_epi8( chunk, cr ) ) );
+            const uint32_t nul = _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, zero ) );
+            const uint32_t non_ascii = _mm_movemask_epi8( chunk );
+            process_mask( mask, nul, non_ascii, block, i, block_beginning,
+                    state, line_positions, line_attributes, line_expansions,
+                    max_length );
+        }
+
+        scan_scalar( block + i, length - i, block_beginning + i, state,
+                line_positions, line_attributes, line_expansions, max_length );
+    }
+
+    __attribute__((target("avx2")))
+    void scan_avx2( const char* block, size_t length, qint64 block_beginning,
+            State* state, FastLinePositionArray* line_positions,
+            LineAttributeList* line_attributes,
+            LineExpansionList* line_expansions, int* max_length )
+    {
+        const __m256i lf   = _mm256_set1_epi8( '\n' );
+        const __m256i tab  = _mm256_set1_epi8( '\t' );
+        const __m256i cr   = _mm256_set1_epi8( '\r' );
+        const __m256i zero = _mm256_setzero_si256();
+        // All the interesting bytes are below, as signed bytes
+        const __m256i limit = _mm256_set1_epi8( '\r' + 1 );
+
+        size_t i = 0;
+        for ( ; i + 32 <= length; i += 32 ) {
+            const __m256i chunk = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>( block + i ) );
+            if ( ! _mm256_movemask_epi8( _mm256_cmpgt_epi8( limit, chunk ) ) )
+                continue;
+
+            const uint32_t mask = _mm256_movemask_epi8( _mm256_or_si256( _mm256_or_si256(
+                        _mm256_cmpeq_epi8( chunk, lf ),
+                        _mm256_cmpeq_epi8( chunk, tab ) ),
+                        _mm256_cmpeq_epi8( chunk, cr ) ) );
+            const uint32_t nul = _mm256_movemask_epi8( _mm256_cmpeq_epi8( chunk, zero ) );
+            const uint32_t non_ascii = _mm256_movemask_epi8( chunk );
+            process_mask( mask, nul, non_ascii, block, i, block_beginning,
+                    state, line_positions, line_attributes, line_expansions,
+                    max_length );
+        }
+
+        scan_scalar( block + i, length - i, block_beginning + i, state,
+                line_positions, line_attributes, line_expansions, max_length );
+    }
+#endif
+}
+
+LineScanner::LineScanner( int tab_stop, qint64 initial_position )
+    : LineScanner( tab_stop, initial_position, bestKernel() )
+{
+}
+
+LineScanner::LineScanner( int tab_stop, qint64 initial_position, Kernel kernel )
+{
+    state_.tab_stop          = tab_stop;
+    state_.line_start        = initial_position;
+    state_.additional_spaces = 0;
+    state_.attributes        = 0;
+    state_.last_cr           = -1;
+
+    kernel_ = isSupported( kernel ) ? kernel : Kernel::Scalar;
+}
+
+LineScanner::LineScanner( int tab_stop, const OpenLine& open_line )
+    : LineScanner( tab_stop, open_line.start )
+{
+    state_.additional_spaces = open_line.additional_spaces;
+    state_.attributes        = open_line.attributes;
+    state_.last_cr           = open_line.last_cr;
+}
+
+void LineScanner::scanBlock( const char* block, size_t length,
+        qint64 block_beginning,
+        FastLinePositionArray* line_positions, int* max_length )
+{
+    scanBlock( block, length, block_beginning, line_positions, nullptr,
+            nullptr, max_length );
+}
+
+void LineScanner::scanBlock( const char* block, size_t length,
+        qint64 block_beginning, FastLinePositionArray* line_positions,
+        LineAttributeList* line_attributes,
+        LineExpansionList* line_expansions, int* max_length )
+{
+    switch ( kernel_ ) {
+#ifdef GLOGG_X86_KERNELS
+        case Kernel::AVX2:
+            scan_avx2( block, length, block_beginning, &state_,
+                    line_positions, line_attributes, line_expansions, max_length );
+            break;
+        case Kernel::SSE2:
+            scan_sse2( block, length, block_beginning, &state_,
+                    line_positions, line_attributes, line_expansions, max_length );
+            break;
+#endif
+        default:
+            scan_scalar( block, length, block_beginning, &state_,
+                    line_positions, line_attributes, line_expansions, max_length );
+            break;
+    }
+}
+
+LineScanner::Kernel LineScanner::bestKernel()
+{
+    static const Kernel best =
+        isSupported( Kernel::AVX2 ) ? Kernel::AVX2 :
+        isSupported( Kernel::SSE2 ) ? Kernel::SSE2 :
+        Kernel::Scalar;
+
+    return best;
+}
+
+bool LineScanner::isSupported( Kernel kernel )
+{
+    switch ( kernel ) {
+#ifdef GLOGG_X86_KERNELS
+        case Kernel::AVX2:
+            return __builtin_cpu_supports( "avx2" );
+        case Kernel::SSE2:
+            return __builtin_cpu_supports( "sse2" );
+#endif
+        case Kernel::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
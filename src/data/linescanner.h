@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINESCANNER_H
+#define LINESCANNER_H
+
+#include <cstddef>
+
+#include <QtGlobal>
+
+#include "linepositionarray.h"
+#include "lineattributes.h"
+
+// The line scanner finds the end of lines in blocks of raw bytes read
+// from a file and computes the expanded length (tabs replaced by spaces)
+// of each line found, and its attributes (tabs, non ASCII bytes...)
+// It remembers the line being scanned, so consecutive blocks of the same
+// file can be passed one after the other.
+//
+// The actual scanning is done by a 'kernel' chosen at run time, depending
+// on what the CPU supports: on x86, SSE2 or AVX2 are used to locate '\n',
+// '\t' and the bytes setting an attribute 16 or 32 bytes at a time, the
+// plain scalar loop is used everywhere else.
+class LineScanner
+{
+  public:
+    enum class Kernel {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    // Create a scanner using the passed tab stop, the line being
+    // scanned starts at initial_position in the file.
+    // The fastest kernel supported by the CPU is used by default.
+    LineScanner( int tab_stop, qint64 initial_position = 0 );
+    LineScanner( int tab_stop, qint64 initial_position, Kernel kernel );
+
+    // What is known of the line being scanned, to carry on its scan
+    // later (e.g. by the next partial indexing)
+    struct OpenLine {
+        // Absolute position of its first byte
+        qint64 start;
+        // Spaces added so far due to tabs
+        int additional_spaces;
+        // Attributes so far
+        LineAttributes attributes;
+        // Absolute position of its last '\r' so far (-1 if none)
+        qint64 last_cr;
+    };
+
+    // Create a scanner carrying on the scan of the passed line, the
+    // next block starts where the previous scan stopped.
+    LineScanner( int tab_stop, const OpenLine& open_line );
+
+    // Scan a block of 'length' bytes, starting at the absolute position
+    // block_beginning in the file.
+    // Blocks must be passed in order and without gap.
+    // The position following every '\n' found is appended to
+    // line_positions, and max_length is updated with the expanded
+    // length of every line completed in this block.
+    void scanBlock( const char* block, size_t length, qint64 block_beginning,
+            FastLinePositionArray* line_positions, int* max_length );
+    // Same as above, the attributes of every line completed in this
+    // block are also appended to line_attributes and its expansion
+    // (see LineExpansionList) to line_expansions (either can be null).
+    void scanBlock( const char* block, size_t length, qint64 block_beginning,
+            FastLinePositionArray* line_positions,
+            LineAttributeList* line_attributes,
+            LineExpansionList* line_expansions, int* max_length );
+
+    // Absolute position of the beginning of the line currently scanned
+    // (i.e. the position following the last '\n' found).
+    qint64 lineStart() const
+    { return state_.line_start; }
+
+    // The line currently scanned, as scanned so far
+    OpenLine openLine() const
+    { return OpenLine { state_.line_start, state_.additional_spaces,
+        state_.attributes, state_.last_cr }; }
+
+    // The kernel used by this scanner
+    Kernel kernel() const
+    { return kernel_; }
+
+    // Returns the fastest kernel the running CPU supports
+    static Kernel bestKernel();
+    // Returns whether the passed kernel can be used on the running CPU
+    static bool isSupported( Kernel kernel );
+
+    // Scanning state, carried from one block to the next.
+    struct State {
+        int tab_stop;
+        // Absolute position of the first byte of the current line
+        qint64 line_start;
+        // Spaces added so far on the current line due to tabs
+        int additional_spaces;
+        // Attributes of the current line
+        LineAttributes attributes;
+        // Absolute position of the last '\r' found (-1 if none)
+        qint64 last_cr;
+    };
+
+  private:
+    State state_;
+    Kernel kernel_;
+};
+
+#endif
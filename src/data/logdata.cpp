@@ -21,6 +21,7 @@
 
 #include <iostream>
 
+#include <algorithm>
 #include <cassert>
 
 #include <QFileInfo>
@@ -29,49 +30,107 @@
 
 #include "logdata.h"
 #include "logfiltereddata.h"
+#include "gzipdevice.h"
+#include "mappedfile.h"
 #if defined(GLOGG_SUPPORTS_INOTIFY) || defined(GLOGG_SUPPORTS_KQUEUE) || defined(WIN32)
 #include "platformfilewatcher.h"
 #else
 #include "qtfilewatcher.h"
 #endif
 
+namespace {
+    // Default memory used by the cache of decoded lines
+    const qint64 defaultLineCacheMemory = 16*1024*1024;
+
+    // Returns the name of the passed rotated file of base_name ('base.1',
+    // possibly compressed as 'base.1.gz') if it exists, empty otherwise.
+    QString rotatedFileName( const QString& base_name, int rotation )
+    {
+        const QString name = QString( "%1.%2" ).arg( base_name ).arg( rotation );
+        if ( QFileInfo( name ).exists() )
+            return name;
+        if ( QFileInfo( name + ".gz" ).exists() )
+            return name + ".gz";
+
+        return QString();
+    }
+
+    // Returns the number of the passed rotated file of base_name
+    // (0 if it is not one)
+    int rotationOf( const QString& file_name, const QString& base_name )
+    {
+        if ( ! file_name.startsWith( base_name + "." ) )
+            return 0;
+
+        QString suffix = file_name.mid( base_name.length() + 1 );
+        if ( suffix.endsWith( ".gz" ) )
+            suffix.chop( 3 );
+
+        bool ok;
+        const int rotation = suffix.toInt( &ok );
+        return ( ok && rotation > 0 ) ? rotation : 0;
+    }
+}
+
+LogData::Segment::Segment( const QString& fileName, int rotation )
+    : fileName( fileName ), rotation( rotation ),
+    file( new QFile( fileName ) ), indexingData( new IndexingData() ),
+    compressedFile(), mappedFile( std::make_shared<MappedFile>( fileName ) ),
+    workerThread()
+{
+    file->open( QIODevice::ReadOnly );
+}
+
+LogData::Segment::Segment( const QString& fileName, int rotation,
+        std::unique_ptr<QFile> openFile,
+        std::shared_ptr<MappedFile> mappedFile )
+    : fileName( fileName ), rotation( rotation ),
+    file( std::move( openFile ) ), indexingData( new IndexingData() ),
+    compressedFile(), mappedFile( std::move( mappedFile ) ),
+    workerThread()
+{
+}
+
 // Implementation of the 'start' functions for each operation
 
-void LogData::AttachOperation::doStart(
+quint64 LogData::AttachOperation::doStart(
         LogDataWorkerThread& workerThread ) const
 {
     LOG(logDEBUG) << "Attaching " << filename_.toStdString();
     workerThread.attachFile( filename_ );
-    workerThread.indexAll();
+    return workerThread.indexAll();
 }
 
-void LogData::FullIndexOperation::doStart(
+quint64 LogData::FullIndexOperation::doStart(
         LogDataWorkerThread& workerThread ) const
 {
     LOG(logDEBUG) << "Reindexing (full)";
-    workerThread.indexAll();
+    return workerThread.indexAll();
 }
 
-void LogData::PartialIndexOperation::doStart(
+quint64 LogData::PartialIndexOperation::doStart(
         LogDataWorkerThread& workerThread ) const
 {
     LOG(logDEBUG) << "Reindexing (partial)";
-    workerThread.indexAdditionalLines();
+    return workerThread.indexAdditionalLines();
 }
 
 
 // Constructs an empty log file.
 // It must be displayed without error.
-LogData::LogData() : AbstractLogData(), indexing_data_(),
-    fileMutex_(), workerThread_( &indexing_data_ )
+LogData::LogData() : AbstractLogData(),
+    mapped_file_(), fileSet_( false ), segments_(), segmentFirstLine_( 1, 0 ), segmentsNbLines_( 0 ),
+    segmentsMaxLength_( 0 ), segmentsSize_( 0 ), segmentsLoading_( 0 ),
+    pendingStatus_( LoadingStatus::Successful ), indexing_data_(),
+    decoder_( QTextCodec::codecForName( "ISO-8859-1" ) ),
+    lineCache_( defaultLineCacheMemory ), fileMutex_(),
+    workerThread_( &indexing_data_ )
 {
     // Start with an "empty" log
     attached_file_ = nullptr;
     currentOperation_ = nullptr;
     nextOperation_    = nullptr;
 
-    codec_ = QTextCodec::codecForName( "ISO-8859-1" );
-
 #if defined(GLOGG_SUPPORTS_INOTIFY) || defined(GLOGG_SUPPORTS_KQUEUE) || defined(WIN32)
     fileWatcher_ = std::make_shared<PlatformFileWatcher>();
 #else
@@ -84,15 +143,40 @@ LogData::LogData() : AbstractLogData(), indexing_data_(),
     // Forward the update signal
     connect( &workerThread_, SIGNAL( indexingProgressed( int ) ),
             this, SIGNAL( loadingProgressed( int ) ) );
-    connect( &workerThread_, SIGNAL( indexingFinished( LoadingStatus ) ),
-            this, SLOT( indexingFinished( LoadingStatus ) ) );
+    // Directly, so the tail is still there when tailLoaded is emitted
+    connect( &workerThread_, SIGNAL( tailIndexed() ),
+            this, SLOT( tailIndexed() ), Qt::DirectConnection );
+    // The file is watched from then on, in this thread
+    connect( &workerThread_, SIGNAL( tailIndexed() ),
+            this, SLOT( tailPublished() ) );
+    connect( &workerThread_, SIGNAL( tailExtended() ),
+            this, SLOT( tailExtended() ) );
+    connect( &workerThread_, SIGNAL( indexingFinished( LoadingStatus, quint64 ) ),
+            this, SLOT( indexingFinished( LoadingStatus, quint64 ) ) );
 
     // Starts the worker thread
     workerThread_.start();
+
+    prefetcher_.reset( new LinePrefetcher( [this]( qint64 first_line, int number ) {
+                // Reading them is enough to cache them
+                const qint64 nb_lines = doGetNbLine();
+                if ( first_line < nb_lines )
+                    doGetExpandedLines( first_line,
+                            qMin<qint64>( number, nb_lines - first_line ) );
+            } ) );
 }
 
 LogData::~LogData()
 {
+    // Stop reading the lines before anything is destroyed
+    const qint64 nb_prefetched = prefetcher_->nbLinesRead();
+    prefetcher_.reset();
+
+    const LineCache::Statistics cache_statistics = lineCache_.statistics();
+    LOG(logDEBUG) << "Line cache: " << cache_statistics.hits << " hits, "
+        << cache_statistics.misses << " misses, "
+        << nb_prefetched << " lines prefetched";
+
     // Remove the current file from the watch list
     if ( attached_file_ )
         fileWatcher_->removeFile( attached_file_->fileName() );
@@ -116,19 +200,64 @@ void LogData::attachFile( const QString& fileName )
 
     attached_file_.reset( new QFile( fileName ) );
     attached_file_->open( QIODevice::ReadOnly );
+    std::atomic_store( &mapped_file_, std::make_shared<MappedFile>( fileName ) );
 
     std::shared_ptr<const LogDataOperation> operation( new AttachOperation( fileName ) );
     enqueueOperation( std::move( operation ) );
 }
 
+void LogData::attachFileSet( const QStringList& fileNames )
+{
+    LOG(logDEBUG) << "LogData::attachFileSet " << fileNames.size() << " files";
+
+    if ( attached_file_ || fileNames.isEmpty() ) {
+        // We cannot reattach
+        throw CantReattachErr();
+    }
+
+    const QString& attached_name = fileNames.last();
+
+    {
+        QMutexLocker locker( &fileMutex_ );
+
+        fileSet_ = true;
+        for ( int i = 0; i < fileNames.size() - 1; i++ )
+            segments_.emplace_back( new Segment( fileNames[i],
+                        rotationOf( fileNames[i], attached_name ) ) );
+    }
+
+    for ( auto& segment : segments_ )
+        startSegmentIndexing( segment.get(), false );
+
+    attachFile( attached_name );
+}
+
+QStringList LogData::rotatedFileSet( const QString& fileName )
+{
+    QStringList file_names( fileName );
+
+    QString rotated_name;
+    for ( int rotation = 1;
+            ! ( rotated_name = rotatedFileName( fileName, rotation ) ).isEmpty();
+            rotation++ )
+        file_names.prepend( rotated_name );
+
+    return file_names;
+}
+
 void LogData::interruptLoading()
 {
     workerThread_.interrupt();
+
+    for ( auto& segment : segments_ ) {
+        if ( segment->workerThread )
+            segment->workerThread->interrupt();
+    }
 }
 
 qint64 LogData::getFileSize() const
 {
-    return indexing_data_.getSize();
+    return segmentsSize_ + indexing_data_.getSize();
 }
 
 QDateTime LogData::getLastModifiedDate() const
@@ -149,9 +278,13 @@ void LogData::reload()
     workerThread_.interrupt();
 
     // Re-open the file, useful in case the file has been moved
-    reOpenFile();
+    // (unless rotated, the index is still that of the file open)
+    if ( ! rotationPending_ )
+        reOpenFile();
 
-    enqueueOperation( std::make_shared<FullIndexOperation>() );
+    // Checked once the current indexing is interrupted
+    reloadPending_ = true;
+    enqueueOperation( std::make_shared<PartialIndexOperation>() );
 }
 
 void LogData::setPollingInterval( uint32_t interval_ms )
@@ -159,6 +292,46 @@ void LogData::setPollingInterval( uint32_t interval_ms )
     fileWatcher_->setPollingInterval( interval_ms );
 }
 
+void LogData::setIndexingThreads( int nb_threads )
+{
+    workerThread_.setIndexingThreads( nb_threads );
+}
+
+void LogData::setReadAheadDepth( int depth )
+{
+    workerThread_.setReadAheadDepth( depth );
+}
+
+void LogData::setTailFirstLines( int nb_lines )
+{
+    workerThread_.setTailFirstLines( nb_lines );
+}
+
+void LogData::setIndexMemoryBudget( qint64 budget )
+{
+    workerThread_.setIndexMemoryBudget( budget );
+}
+
+void LogData::setPreservePageCache( bool preserve )
+{
+    workerThread_.setPreservePageCache( preserve );
+}
+
+void LogData::setIndexCache( const IndexCache& index_cache )
+{
+    workerThread_.setIndexCache( index_cache );
+}
+
+void LogData::setLineCacheMemory( qint64 memory )
+{
+    lineCache_.setMemoryBudget( memory );
+}
+
+LineCache::Statistics LogData::getLineCacheStatistics() const
+{
+    return lineCache_.statistics();
+}
+
 //
 // Private functions
 //
@@ -176,8 +349,10 @@ void LogData::enqueueOperation( std::shared_ptr<const LogDataOperation> new_oper
     else
     {
         // An operation is in progress...
-        // ... we schedule the attach op for later
-        nextOperation_ = new_operation;
+        // ... we schedule the new op for later, unless it is a partial
+        // indexing, done by the one already scheduled anyway.
+        if ( ! ( nextOperation_ && new_operation->isPartial() ) )
+            nextOperation_ = new_operation;
     }
 }
 
@@ -189,8 +364,27 @@ void LogData::startOperation()
     {
         LOG(logDEBUG) << "startOperation found something to do.";
 
+        // Nothing is being indexed, the rotated file can be archived
+        if ( rotationPending_ ) {
+            rotationPending_ = false;
+            archiveAttachedFile();
+        }
+
+        // Only what has been appended is indexed if the rest is unchanged
+        if ( reloadPending_ ) {
+            reloadPending_ = false;
+            if ( ! isIndexUpToDate() ) {
+                LOG(logINFO) << "The indexed data has changed, reindexing";
+                currentOperation_ = std::make_shared<FullIndexOperation>();
+            }
+        }
+
+        // All the lines are read again
+        if ( ! currentOperation_->isPartial() )
+            lineCache_.clear();
+
         // Let the operation do its stuff
-        currentOperation_->start( workerThread_ );
+        currentGeneration_ = currentOperation_->start( workerThread_ );
     }
 }
 
@@ -204,11 +398,25 @@ void LogData::fileChangedOnDisk()
 
     LOG(logDEBUG) << "signalFileChanged: " << name.toStdString();
 
+    // The file open is the one rotated, and the index still its own,
+    // until it is archived: the new file is only looked at then.
+    if ( rotationPending_ ) {
+        LOG(logDEBUG) << "Rotation pending, change ignored";
+        return;
+    }
+
     QFileInfo info( name );
-    qint64 file_size = indexing_data_.getSize();
+    // For compressed files, compare with the size of the compressed data
+    const std::shared_ptr<GzipIndex> gzip_index = indexing_data_.getGzipIndex();
+    qint64 file_size = gzip_index ?
+        gzip_index->compressedSize() : indexing_data_.getSize();
     LOG(logDEBUG) << "current indexed fileSize=" << file_size;
     LOG(logDEBUG) << "info file_->size()=" << info.size();
     LOG(logDEBUG) << "attached_file_->size()=" << attached_file_->size();
+    // In a file set, a rotated file is kept as a segment and only the
+    // new file is indexed.
+    const bool rotated = fileSet_ && isRotated( file_size );
+    bool replaced = false;
     // In absence of any clearer information, we use the following size comparison
     // to determine whether we are following the same file or not (i.e. the file
     // has been moved and the inode we are following is now under a new name, if for
@@ -216,22 +424,38 @@ void LogData::fileChangedOnDisk()
     // the file to ensure we are reading the right one.
     // This is a crude heuristic but necessary for notification services that do not
     // give details (e.g. kqueues)
-    if ( ( info.size() != attached_file_->size() )
-            || ( attached_file_->openMode() == QIODevice::NotOpen ) ) {
+    // A rotated file is kept open with its index, the new one is opened
+    // when it is archived (see archiveAttachedFile()).
+    if ( ! rotated && ( ( info.size() != attached_file_->size() )
+            || ( attached_file_->openMode() == QIODevice::NotOpen ) ) ) {
         LOG(logINFO) << "Inconsistent size, the file might have changed, re-opening";
         reOpenFile();
 
         // We don't force a (slow) full reindex as this routinely happens if
         // the file is appended quickly.
-        // This means we can occasionally have false negatives (should be dealt with at
-        // a lower level): e.g. if a new file is created with the same name as the old one
-        // and with a size greater than the old one (should be rare in practice).
+        // A new file created with the same name as the old one and with a size
+        // greater than the old one is told apart by the fingerprint.
+        if ( ! fingerprint_.isNull() ) {
+            QMutexLocker locker( &fileMutex_ );
+            replaced = ! fingerprintMatches( attached_file_.get() );
+        }
     }
 
     std::shared_ptr<LogDataOperation> newOperation;
 
     qint64 real_file_size = attached_file_->size();
-    if ( real_file_size < file_size ) {
+    if ( rotated ) {
+        fileChangedOnDisk_ = Truncated;
+        LOG(logINFO) << "File rotated";
+        rotationPending_ = true;
+        newOperation = std::make_shared<FullIndexOperation>();
+    }
+    else if ( replaced ) {
+        fileChangedOnDisk_ = Truncated;
+        LOG(logINFO) << "File replaced";
+        newOperation = std::make_shared<FullIndexOperation>();
+    }
+    else if ( real_file_size < file_size ) {
         fileChangedOnDisk_ = Truncated;
         LOG(logINFO) << "File truncated";
         newOperation = std::make_shared<FullIndexOperation>();
@@ -245,6 +469,10 @@ void LogData::fileChangedOnDisk()
         newOperation = std::make_shared<PartialIndexOperation>();
     }
 
+    // The lines cached might not be in the file anymore
+    if ( fileChangedOnDisk_ == Truncated )
+        lineCache_.clear();
+
     if ( newOperation ) {
         enqueueOperation( newOperation );
         lastModifiedDate_ = info.lastModified();
@@ -253,22 +481,42 @@ void LogData::fileChangedOnDisk()
     }
 }
 
-void LogData::indexingFinished( LoadingStatus status )
+void LogData::indexingFinished( LoadingStatus status, quint64 generation )
 {
+    // Not the job of the current operation (interrupted before it ran)
+    if ( generation != currentGeneration_ ) {
+        LOG(logDEBUG) << "indexingFinished: ignoring job " << generation;
+        return;
+    }
+
+    // The loading is only finished once the segments are loaded
+    if ( segmentsLoading_ > 0 ) {
+        LOG(logDEBUG) << "indexingFinished: waiting for "
+            << segmentsLoading_ << " segments";
+        finishPending_ = true;
+        pendingStatus_ = status;
+        return;
+    }
+
     LOG(logDEBUG) << "indexingFinished: " <<
         ( status == LoadingStatus::Successful ) <<
         ", found " << indexing_data_.getNbLines() << " lines.";
 
+    // The tail is replaced here rather than by the indexing thread, so
+    // the views in this thread cannot read the lines renumbered before
+    // the cache is dropped and the client has updated its line numbers.
+    // The other threads do not cache the lines read in the meantime.
+    const qint64 tail_offset = indexing_data_.endTailMode();
+    if ( tail_offset != 0 ) {
+        lineCache_.clear();
+        emit tailReplaced( segmentsNbLines_, tail_offset );
+    }
+
     if ( status == LoadingStatus::Successful ) {
         // Start watching we watch the file for updates
-        fileChangedOnDisk_ = Unchanged;
-        fileWatcher_->addFile( attached_file_->fileName() );
+        startWatching();
 
-        // Update the modified date/time if the file exists
-        lastModifiedDate_ = QDateTime();
-        QFileInfo fileInfo( *attached_file_ );
-        if ( fileInfo.exists() )
-            lastModifiedDate_ = fileInfo.lastModified();
+        updateFingerprint();
     }
 
     // FIXME be cleverer here as a notification might have arrived whilst we
@@ -291,24 +539,84 @@ void LogData::indexingFinished( LoadingStatus status )
     }
 }
 
+void LogData::segmentIndexingFinished( LoadingStatus status )
+{
+    LOG(logDEBUG) << "segmentIndexingFinished: " <<
+        ( status == LoadingStatus::Successful );
+
+    {
+        QMutexLocker locker( &fileMutex_ );
+
+        for ( auto& segment : segments_ ) {
+            // Its thread is not needed anymore
+            if ( segment->workerThread.get() == sender() )
+                segment->workerThread.release()->deleteLater();
+        }
+
+        updateSegments();
+    }
+
+    if ( --segmentsLoading_ == 0 && finishPending_ ) {
+        finishPending_ = false;
+        indexingFinished( pendingStatus_, currentGeneration_ );
+    }
+}
+
+void LogData::tailIndexed()
+{
+    // The lines of the segments are not all known yet
+    if ( segmentsLoading_ == 0 )
+        emit tailLoaded();
+}
+
+void LogData::tailPublished()
+{
+    // Follow the tail until the whole file is loaded, unless the loading
+    // is already over
+    if ( indexing_data_.isTailMode() )
+        startWatching();
+}
+
+void LogData::tailExtended()
+{
+    // Sent before the tail is replaced (by indexingFinished, queued after)
+    if ( segmentsLoading_ == 0 && indexing_data_.isTailMode() )
+        emit tailUpdated();
+}
+
+// Start watching the file for updates, from what is indexed now
+void LogData::startWatching()
+{
+    fileChangedOnDisk_ = Unchanged;
+    fileWatcher_->addFile( attached_file_->fileName() );
+
+    // Update the modified date/time if the file exists
+    lastModifiedDate_ = QDateTime();
+    QFileInfo fileInfo( *attached_file_ );
+    if ( fileInfo.exists() )
+        lastModifiedDate_ = fileInfo.lastModified();
+}
+
 //
 // Implementation of virtual functions
 //
 qint64 LogData::doGetNbLine() const
 {
-    return indexing_data_.getNbLines();
+    return segmentsNbLines_ + indexing_data_.getNbLines();
 }
 
 int LogData::doGetMaxLength() const
 {
-    return indexing_data_.getMaxLength();
+    return qMax<int>( segmentsMaxLength_, indexing_data_.getMaxLength() );
 }
 
 int LogData::doGetLineLength( qint64 line ) const
 {
-    if ( line >= indexing_data_.getNbLines() ) { return 0; /* exception? */ }
+    if ( line >= doGetNbLine() ) { return 0; /* exception? */ }
 
-    int length = doGetExpandedLineString( line ).length();
+    int length;
+    if ( ! getIndexedLineLength( line, &length ) )
+        length = doGetExpandedLineString( line ).length();
 
     return length;
 }
@@ -376,57 +684,51 @@ void LogData::doSetDisplayEncoding( Encoding encoding )
     }
 
     doSetMultibyteEncodingOffsets( before_cr, after_cr );
-    codec_ = QTextCodec::codecForName( qt_encoding );
+    decoder_ = LineDecoder( QTextCodec::codecForName( qt_encoding ) );
+
+    // The lines are decoded differently
+    lineCache_.clear();
 }
 
 void LogData::doSetMultibyteEncodingOffsets( int before_cr, int after_cr )
 {
     before_cr_offset_ = before_cr;
     after_cr_offset_ = after_cr;
+
+    lineCache_.clear();
 }
 
 QString LogData::doGetLineString( qint64 line ) const
 {
-    if ( line >= indexing_data_.getNbLines() ) { return 0; /* exception? */ }
-
-    fileMutex_.lock();
+    if ( line >= doGetNbLine() ) { return 0; /* exception? */ }
 
-    // end_byte is non-inclusive.(is not read)
-    const qint64 first_byte = (line == 0) ?
-        0 : ( indexing_data_.getPosForLine( line-1 ) + after_cr_offset_ );
-    const qint64 end_byte  = endOfLinePosition( line );
-
-    attached_file_->seek( first_byte );
-
-    QString string = codec_->toUnicode( attached_file_->read( end_byte - first_byte ) );
-
-    fileMutex_.unlock();
+    QString string;
+    readRawLines( line, 1, [this, &string]( const char* data, int length,
+                LineAttributes attributes ) {
+            string = decodeLine( data, length, attributes ); } );
 
     return string;
 }
 
 QString LogData::doGetExpandedLineString( qint64 line ) const
 {
-    if ( line >= indexing_data_.getNbLines() ) { return 0; /* exception? */ }
-
-    fileMutex_.lock();
-
-    // end_byte is non-inclusive.(is not read) We also exclude the final \r.
-    const qint64 first_byte = (line == 0) ?
-        0 : ( indexing_data_.getPosForLine( line-1 ) + after_cr_offset_ );
-    const qint64 end_byte  = endOfLinePosition( line );
-
-    attached_file_->seek( first_byte );
+    const qint64 nb_lines = doGetNbLine();
+    if ( line >= nb_lines ) { return 0; /* exception? */ }
 
-    // LOG(logDEBUG) << "LogData::doGetExpandedLineString first_byte:" << first_byte << " end_byte:" << end_byte;
-    QByteArray rawString = attached_file_->read( end_byte - first_byte );
+    QString string;
+    if ( lineCache_.find( line, &string ) )
+        return string;
 
-    fileMutex_.unlock();
-
-    QString string = untabify( codec_->toUnicode( rawString ) );
+    const quint64 generation = lineCache_.generation();
+    readRawLines( line, 1, [this, &string]( const char* data, int length,
+                LineAttributes attributes ) {
+            string = expandLine( data, length, attributes ); } );
 
     // LOG(logDEBUG) << "doGetExpandedLineString Line is: " << string.toStdString();
 
+    if ( isCacheable( line, nb_lines ) )
+        lineCache_.insert( generation, line, string );
+
     return string;
 }
 
@@ -444,32 +746,15 @@ QStringList LogData::doGetLines( qint64 first_line, int number ) const
         return QStringList();
     }
 
-    if ( last_line >= indexing_data_.getNbLines() ) {
+    if ( last_line >= doGetNbLine() ) {
         LOG(logWARNING) << "LogData::doGetLines Lines out of bound asked for";
         return QStringList(); /* exception? */
     }
 
-    fileMutex_.lock();
-
-    const qint64 first_byte = (first_line == 0) ?
-        0 : ( indexing_data_.getPosForLine( first_line-1 ) + after_cr_offset_ );
-    const qint64 end_byte  = endOfLinePosition( last_line );
-    // LOG(logDEBUG) << "LogData::doGetLines first_byte:" << first_byte << " end_byte:" << end_byte;
-    attached_file_->seek( first_byte );
-    QByteArray blob = attached_file_->read( end_byte - first_byte );
-
-    fileMutex_.unlock();
-
-    qint64 beginning = 0;
-    qint64 end = 0;
-    for ( qint64 line = first_line; (line <= last_line); line++ ) {
-        end = endOfLinePosition( line ) - first_byte;
-        // LOG(logDEBUG) << "Getting line " << line << " beginning " << beginning << " end " << end;
-        QByteArray this_line = blob.mid( beginning, end - beginning );
-        // LOG(logDEBUG) << "Line is: " << QString( this_line ).toStdString();
-        list.append( codec_->toUnicode( this_line ) );
-        beginning = beginningOfNextLine( end );
-    }
+    list.reserve( number );
+    readRawLines( first_line, number, [this, &list]( const char* data,
+                int length, LineAttributes attributes ) {
+            list.append( decodeLine( data, length, attributes ) ); } );
 
     return list;
 }
@@ -483,55 +768,124 @@ QStringList LogData::doGetExpandedLines( qint64 first_line, int number ) const
         return QStringList();
     }
 
-    if ( last_line >= indexing_data_.getNbLines() ) {
+    if ( last_line >= doGetNbLine() ) {
         LOG(logWARNING) << "LogData::doGetExpandedLines Lines out of bound asked for";
         return QStringList(); /* exception? */
     }
 
-    fileMutex_.lock();
-
-    // end_byte is non-inclusive.(is not read)
-    const qint64 first_byte = (first_line == 0) ?
-        0 : ( indexing_data_.getPosForLine( first_line-1 ) + after_cr_offset_ );
-    const qint64 end_byte  = endOfLinePosition( last_line );
-    LOG(logDEBUG) << "LogData::doGetExpandedLines first_byte:" << first_byte << " end_byte:" << end_byte;
-
-    attached_file_->seek( first_byte );
-    QByteArray blob = attached_file_->read( end_byte - first_byte );
-
-    fileMutex_.unlock();
+    const qint64 nb_lines = doGetNbLine();
+    const quint64 generation = lineCache_.generation();
+
+    // The cached lines, and the range of the others, which are read
+    // in one go
+    list.reserve( number );
+    int first_missing = number;
+    int end_missing   = 0;
+    for ( int i = 0; i < number; i++ ) {
+        QString cached;
+        if ( ! lineCache_.find( first_line + i, &cached ) ) {
+            first_missing = qMin( first_missing, i );
+            end_missing   = i + 1;
+        }
+        list.append( cached );
+    }
 
-    qint64 beginning = 0;
-    qint64 end = 0;
-    for ( qint64 line = first_line; (line <= last_line); line++ ) {
-        // end is non-inclusive
-        // LOG(logDEBUG) << "EoL " << line << ": " << indexing_data_.getPosForLine( line );
-        end = endOfLinePosition( line ) - first_byte;
-        // LOG(logDEBUG) << "Getting line " << line << " beginning " << beginning << " end " << end;
-        QByteArray this_line = blob.mid( beginning, end - beginning );
-        QString conv_line = codec_->toUnicode( this_line );
-        // LOG(logDEBUG) << "Line is: " << conv_line.toStdString();
-        list.append( untabify( conv_line ) );
-        beginning = beginningOfNextLine( end );
+    if ( first_missing < end_missing ) {
+        int i = first_missing;
+        readRawLines( first_line + first_missing, end_missing - first_missing,
+                [&]( const char* data, int length, LineAttributes attributes ) {
+                    // Lines between two missing ones might be cached
+                    if ( list[i].isNull() ) {
+                        list[i] = expandLine( data, length, attributes );
+                        if ( isCacheable( first_line + i, nb_lines ) )
+                            lineCache_.insert( generation, first_line + i, list[i] );
+                    }
+                    ++i;
+                } );
     }
 
     return list;
 }
 
+// The lines are only worth reading in advance if they are kept
+void LogData::doPrefetchExpandedLines( const std::vector<LineRange>& ranges ) const
+{
+    if ( lineCache_.isEnabled() )
+        prefetcher_->request( ranges );
+}
+
 EncodingSpeculator::Encoding LogData::getDetectedEncoding() const
 {
     return indexing_data_.getEncodingGuess();
 }
 
-// Given a line number, returns the position (offset in file) of
-// the byte immediately past its end.
+QString LogData::decodeLine( const char* data, int length,
+        LineAttributes attributes ) const
+{
+    return ( attributes & LineAttribute::NonAscii ) ?
+        decoder_.decode( data, length ) : decoder_.decodeAscii( data, length );
+}
+
+QString LogData::expandLine( const char* data, int length,
+        LineAttributes attributes ) const
+{
+    QString line = decodeLine( data, length, attributes );
+
+    // The carriage return ending a DOS line is not displayed
+    if ( ( attributes & LineAttribute::CarriageReturn )
+            && line.endsWith( QChar( '\r' ) ) )
+        line.chop( 1 );
+
+    if ( attributes & LineAttribute::Expandable )
+        line = untabify( line );
+
+    // A cached empty line must be told apart from a line not found
+    if ( line.isNull() )
+        line = QLatin1String( "" );
+
+    return line;
+}
+
+// Given the index of a file, returns the position (offset in file) of
+// the first byte of its first line, the other lines start after the
+// end of the previous one, read from the index with it.
+qint64 LogData::startOfFirstLinePosition( const IndexingData& data ) const
+{
+    // The first line starts at the beginning of the file, unless only
+    // the tail of the file is indexed yet.
+    const qint64 first_line_start = data.getStartOfFirstLine();
+    return ( first_line_start > 0 ) ? first_line_start + after_cr_offset_ : 0;
+}
+
+// Given a line number in a file and its index, returns the positions
+// of its first byte and of the byte immediately past its end.
+// Both ends of line are read from the index in one go, a position is
+// decoded from the start of its block when read alone.
+void LogData::linePositions( const IndexingData& data, qint64 line,
+        qint64* begin, qint64* end ) const
+{
+    uint64_t positions[2];
+    if ( line > 0 ) {
+        data.getPosForLines( line - 1, 2, positions );
+        *begin = static_cast<qint64>( positions[0] ) + after_cr_offset_;
+    }
+    else {
+        data.getPosForLines( 0, 1, &positions[1] );
+        *begin = startOfFirstLinePosition( data );
+    }
+
+    *end = endOfLinePosition( positions[1] );
+}
+
+// Given the position of a line in the index (past its end of line),
+// returns the position (offset in file) of the byte immediately past its end.
 // e.g. in utf-16: T e s t \n2 n d l i n e \n
 //                 --------------------------
 //                           ^
-//                   endOfLinePosition( 0 )
-qint64 LogData::endOfLinePosition( qint64 line ) const
+//                   endOfLinePosition( getPosForLine( 0 ) )
+qint64 LogData::endOfLinePosition( uint64_t pos_for_line ) const
 {
-    return indexing_data_.getPosForLine( line ) - 1 - before_cr_offset_;
+    return static_cast<qint64>( pos_for_line ) - 1 - before_cr_offset_;
 }
 
 // Given the position (offset in file) of the end of a line, returns
@@ -549,6 +903,311 @@ void LogData::reOpenFile()
 {
     auto reopened = std::make_unique<QFile>( attached_file_->fileName() );
     reopened->open( QIODevice::ReadOnly );
+    auto remapped = std::make_shared<MappedFile>( attached_file_->fileName() );
     QMutexLocker locker( &fileMutex_ );
     attached_file_ = std::move( reopened );      // This will close the old one and open the new
+    compressed_file_.reset();
+    std::atomic_store( &mapped_file_, std::move( remapped ) );
+}
+
+QByteArray LogData::readContent( Segment* segment,
+        qint64 first_byte, qint64 length ) const
+{
+    const IndexingData& data = segment ? *segment->indexingData : indexing_data_;
+    std::unique_ptr<GzipDevice>& compressed_file =
+        segment ? segment->compressedFile : compressed_file_;
+    QIODevice* device = segment ? segment->file.get() : attached_file_.get();
+
+    // Compressed files are read through the seek points found by the
+    // last indexing.
+    const std::shared_ptr<GzipIndex> gzip_index = data.getGzipIndex();
+    if ( gzip_index ) {
+        if ( ! compressed_file || compressed_file->index() != gzip_index ) {
+            compressed_file.reset( new GzipDevice( segment ?
+                        segment->fileName : attached_file_->fileName(),
+                        gzip_index ) );
+            compressed_file->open( QIODevice::ReadOnly );
+        }
+        device = compressed_file.get();
+    }
+
+    device->seek( first_byte );
+    return device->read( length );
+}
+
+// The lines are read from the segments holding them, using the
+// first line of each segment, then from the attached file.
+// They are copied from the mapped files when possible (which survives
+// the file being truncated meanwhile), locking fileMutex_ only for a
+// file set (its segments can change) or to read a file that is not mapped.
+template <typename Callback>
+void LogData::readRawLines( qint64 first_line, int number, Callback line_read ) const
+{
+    const qint64 end_line = first_line + number;
+    qint64 line = first_line;
+    while ( line < end_line ) {
+        // The end of the line before the first one (if any) and of all
+        // the lines, decoded from the index in one go.
+        std::vector<uint64_t> positions;
+        const uint64_t* end_positions;
+        LineAttributeList attributes;
+        qint64 nb_lines;
+        qint64 first_byte;
+        qint64 end_byte;
+        // The content from first_byte, copied from the mapped file or
+        // read in blob
+        std::shared_ptr<const MappedFile::View> view;
+        QByteArray blob;
+
+        {
+            QMutexLocker set_locker( fileSet_ ? &fileMutex_ : nullptr );
+
+            const size_t index = std::upper_bound( segmentFirstLine_.begin(),
+                    segmentFirstLine_.end(), line ) - segmentFirstLine_.begin() - 1;
+            Segment* segment = ( index < segments_.size() ) ?
+                segments_[index].get() : nullptr;
+            const IndexingData& data = segment ? *segment->indexingData : indexing_data_;
+
+            const qint64 first_in_file = line - segmentFirstLine_[index];
+            const qint64 end_in_file = ( segment ?
+                    qMin( end_line, segmentFirstLine_[index + 1] ) : end_line )
+                - segmentFirstLine_[index];
+
+            const qint64 first_pos = ( first_in_file > 0 ) ? first_in_file - 1 : 0;
+            positions.resize( end_in_file - first_pos );
+            data.getPosForLines( first_pos, positions.size(), positions.data() );
+            end_positions = positions.data() + ( first_in_file - first_pos );
+            nb_lines = end_in_file - first_in_file;
+            attributes.resize( nb_lines );
+            data.getAttributesForLines( first_in_file, nb_lines, attributes.data() );
+
+            // end_byte is non-inclusive.(is not read)
+            first_byte = ( first_in_file > 0 ) ?
+                static_cast<qint64>( positions.front() ) + after_cr_offset_
+                : startOfFirstLinePosition( data );
+            end_byte = endOfLinePosition( positions.back() );
+            // LOG(logDEBUG) << "LogData::readRawLines first_byte:" << first_byte << " end_byte:" << end_byte;
+
+            const std::shared_ptr<MappedFile> mapped_file = segment ?
+                segment->mappedFile : std::atomic_load( &mapped_file_ );
+            if ( mapped_file && ! data.getGzipIndex() )
+                view = mapped_file->view( end_byte );
+
+            if ( ! view ) {
+                QMutexLocker file_locker( fileSet_ ? nullptr : &fileMutex_ );
+                blob = readContent( segment, first_byte, end_byte - first_byte );
+            }
+        }
+
+        // Copied without the lock (less than asked for if the file has
+        // been truncated since the view was returned)
+        if ( view ) {
+            blob.resize( end_byte - first_byte );
+            blob.resize( view->read( first_byte, blob.size(), blob.data() ) );
+        }
+
+        const char* content = blob.constData();
+        // What has been read (less if the file has been truncated)
+        const qint64 content_size = blob.size();
+
+        qint64 beginning = 0;
+        for ( qint64 i = 0; i < nb_lines; i++ ) {
+            // end is non-inclusive
+            const qint64 end = endOfLinePosition( end_positions[i] ) - first_byte;
+            const qint64 line_begin = qMin( beginning, content_size );
+            const qint64 line_end = qMax( line_begin, qMin( end, content_size ) );
+            line_read( content + line_begin,
+                    static_cast<int>( line_end - line_begin ), attributes[i] );
+            beginning = beginningOfNextLine( end );
+        }
+
+        line += nb_lines;
+    }
+}
+
+// The expanded length of a line is its length in bytes plus its expansion,
+// as long as each byte decodes to one character: in Latin-1, or in UTF-8
+// for the lines known to be ASCII.
+bool LogData::getIndexedLineLength( qint64 line, int* length ) const
+{
+    if ( before_cr_offset_ != 0 || after_cr_offset_ != 0
+            || decoder_.method() == LineDecoder::Method::Codec )
+        return false;
+
+    QMutexLocker set_locker( fileSet_ ? &fileMutex_ : nullptr );
+
+    const size_t index = std::upper_bound( segmentFirstLine_.begin(),
+            segmentFirstLine_.end(), line ) - segmentFirstLine_.begin() - 1;
+    const IndexingData& data = ( index < segments_.size() ) ?
+        *segments_[index]->indexingData : indexing_data_;
+    const qint64 line_in_file = line - segmentFirstLine_[index];
+
+    LineAttributes attributes;
+    data.getAttributesForLines( line_in_file, 1, &attributes );
+    int32_t expansion;
+    if ( ( ( attributes & LineAttribute::NonAscii )
+                && decoder_.method() != LineDecoder::Method::Latin1 )
+            || ! data.getExpansionForLine( line_in_file, &expansion ) )
+        return false;
+
+    qint64 begin, end;
+    linePositions( data, line_in_file, &begin, &end );
+    *length = static_cast<int>( end - begin ) + expansion;
+
+    return true;
+}
+
+void LogData::startSegmentIndexing( Segment* segment, bool additional )
+{
+    LOG(logDEBUG) << "Indexing segment " << segment->fileName.toStdString();
+
+    segment->workerThread.reset(
+            new LogDataWorkerThread( segment->indexingData.get() ) );
+    segment->workerThread->copySettings( workerThread_ );
+    // Its lines are only shown once all of them are known
+    segment->workerThread->setTailFirstLines( 0 );
+
+    connect( segment->workerThread.get(), SIGNAL( indexingFinished( LoadingStatus, quint64 ) ),
+            this, SLOT( segmentIndexingFinished( LoadingStatus ) ) );
+
+    ++segmentsLoading_;
+    segment->workerThread->start();
+    segment->workerThread->attachFile( segment->fileName );
+    if ( additional )
+        segment->workerThread->indexAdditionalLines();
+    else
+        segment->workerThread->indexAll();
+}
+
+// Like for the 'inconsistent size' heuristic, we have no details from
+// the notification: the file has been rotated if the first rotated file
+// starts with what we have indexed (checked with the fingerprint if
+// there is one) while the attached file is now a different file (renamed)
+// or smaller (copied and truncated).
+bool LogData::isRotated( qint64 indexed_size ) const
+{
+    const QString name = attached_file_->fileName();
+
+    const QFileInfo rotated_info( name + ".1" );
+    if ( indexed_size == 0 || ! rotated_info.exists()
+            || rotated_info.size() < indexed_size )
+        return false;
+
+    if ( ! fingerprint_.isNull() ) {
+        QFile rotated_file( name + ".1" );
+        rotated_file.open( QIODevice::ReadOnly );
+        if ( ! fingerprint_.matches( &rotated_file ) )
+            return false;
+    }
+
+    const QFileInfo info( name );
+    return ( info.size() != attached_file_->size() )
+        || ( info.size() < indexed_size );
+}
+
+void LogData::archiveAttachedFile()
+{
+    const QString name = attached_file_->fileName();
+    Segment* archived = nullptr;
+
+    // The new file replaces the rotated one along with its index
+    auto reopened = std::make_unique<QFile>( name );
+    reopened->open( QIODevice::ReadOnly );
+    auto remapped = std::make_shared<MappedFile>( name );
+
+    {
+        QMutexLocker locker( &fileMutex_ );
+
+        // The files rotated before have been renamed too
+        for ( auto& segment : segments_ ) {
+            if ( segment->rotation == 0 )
+                continue;
+
+            const QString new_name = rotatedFileName( name, segment->rotation + 1 );
+            if ( ! new_name.isEmpty() ) {
+                segment->rotation++;
+                segment->fileName = new_name;
+                segment->indexingData->setFileName( new_name );
+                segment->compressedFile.reset();
+            }
+        }
+
+        // The file open is the one indexed, whatever its name now
+        std::unique_ptr<Segment> segment( new Segment( name + ".1", 1,
+                    std::move( attached_file_ ),
+                    std::atomic_load( &mapped_file_ ) ) );
+        segment->indexingData->takeFrom( indexing_data_, segment->fileName );
+        attached_file_ = std::move( reopened );
+        compressed_file_.reset();
+        std::atomic_store( &mapped_file_, std::move( remapped ) );
+        fingerprint_ = FileFingerprint();
+        archived = segment.get();
+        segments_.push_back( std::move( segment ) );
+
+        updateSegments();
+    }
+
+    LOG(logINFO) << "Archived " << archived->indexingData->getNbLines()
+        << " lines as " << archived->fileName.toStdString();
+
+    // Index what was written before the rotation
+    if ( ! archived->indexingData->getGzipIndex()
+            && archived->file->size() > archived->indexingData->getSize() )
+        startSegmentIndexing( archived, true );
+}
+
+void LogData::updateFingerprint()
+{
+    QMutexLocker locker( &fileMutex_ );
+
+    // The compressed data cannot be checked without decompressing it all
+    if ( indexing_data_.getGzipIndex() ) {
+        fingerprint_ = FileFingerprint();
+        return;
+    }
+
+    const qint64 nb_lines = indexing_data_.getNbLines();
+    const qint64 last_line_start = ( nb_lines > 1 ) ?
+        indexing_data_.getPosForLine( nb_lines - 2 ) : 0;
+    fingerprint_ = FileFingerprint( attached_file_.get(),
+            last_line_start, indexing_data_.getSize() );
+}
+
+bool LogData::fingerprintMatches( QIODevice* file ) const
+{
+    return ! indexing_data_.getGzipIndex() && fingerprint_.matches( file );
+}
+
+bool LogData::isIndexUpToDate() const
+{
+    QMutexLocker locker( &fileMutex_ );
+
+    // The index can be from an interrupted indexing
+    return fingerprint_.size() == indexing_data_.getSize()
+        && fingerprintMatches( attached_file_.get() );
+}
+
+void LogData::updateSegments()
+{
+    qint64 nb_lines = 0;
+    qint64 size = 0;
+    int max_length = 0;
+
+    segmentFirstLine_.clear();
+    for ( const auto& segment : segments_ ) {
+        segmentFirstLine_.push_back( nb_lines );
+
+        nb_lines  += segment->indexingData->getNbLines();
+        size      += segment->indexingData->getSize();
+        max_length = qMax( max_length, segment->indexingData->getMaxLength() );
+    }
+    segmentFirstLine_.push_back( nb_lines );
+
+    // The lines after the segments are renumbered
+    if ( nb_lines != segmentsNbLines_ )
+        lineCache_.clear();
+
+    segmentsNbLines_   = nb_lines;
+    segmentsSize_      = size;
+    segmentsMaxLength_ = max_length;
 }
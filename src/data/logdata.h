@@ -20,7 +20,9 @@
 #ifndef LOGDATA_H
 #define LOGDATA_H
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include <QObject>
 #include <QString>
@@ -33,11 +35,17 @@
 #include "utils.h"
 
 #include "abstractlogdata.h"
+#include "filefingerprint.h"
 #include "logdataworkerthread.h"
 #include "filewatcher.h"
 #include "loadingstatus.h"
+#include "linecache.h"
+#include "linedecoder.h"
+#include "lineprefetcher.h"
 
 class LogFilteredData;
+class GzipDevice;
+class MappedFile;
 
 // Thrown when trying to attach an already attached LogData
 class CantReattachErr {};
@@ -61,6 +69,16 @@ class LogData : public AbstractLogData {
     // to be empty.
     // Reattaching is forbidden and will throw.
     void attachFile( const QString& fileName );
+    // Attaches the LogData to a set of files shown as a single log, one
+    // after the other, typically a log and its rotated files, the oldest
+    // first. The last one is attached as above, the others (the
+    // 'segments') are only indexed once.
+    // When the attached file is rotated, it becomes the last segment
+    // (without being indexed again) and the new file is attached.
+    void attachFileSet( const QStringList& fileNames );
+    // Returns the set of files made of the passed file and its
+    // rotated files ('file.1', 'file.2.gz'...), the oldest first.
+    static QStringList rotatedFileSet( const QString& fileName );
     // Interrupt the loading and report a null file.
     // Does nothing if no loading in progress.
     void interruptLoading();
@@ -68,16 +86,52 @@ class LogData : public AbstractLogData {
     // ownership is passed to the caller
     LogFilteredData* getNewFilteredData() const;
     // Returns the size if the file in bytes
+    // (of all the files for a file set)
     qint64 getFileSize() const;
     // Returns the last modification date for the file.
     // Null if the file is not on disk.
     QDateTime getLastModifiedDate() const;
-    // Throw away all the file data and reload/reindex.
+    // Reload the file, only indexing what has been appended if the
+    // indexed part of the file is unchanged, else throw away all the
+    // file data and reindex it.
+    // (only the attached file for a file set)
     void reload();
 
     // Update the polling interval (in ms, 0 means disabled)
     void setPollingInterval( uint32_t interval_ms );
 
+    // Set the number of threads used for indexing
+    // (1 is sequential, 0 means one per core)
+    void setIndexingThreads( int nb_threads );
+
+    // Set the number of chunks read in advance while indexing
+    // (0, the default, disables the read ahead)
+    void setReadAheadDepth( int depth );
+
+    // Set the number of lines at the end of a big file that are
+    // loaded (and signaled with tailLoaded()) before the rest
+    // of the file (0, the default, disables it)
+    void setTailFirstLines( int nb_lines );
+
+    // Set the memory (in bytes) the index of the file can use, beyond
+    // it, only some of the end of lines are kept and the others are
+    // read from the file when needed (0, the default, is no limit)
+    void setIndexMemoryBudget( qint64 budget );
+
+    // Set whether the loading of the file drops what it reads from
+    // the system's page cache, leaving it as it was (false by default)
+    void setPreservePageCache( bool preserve );
+
+    // Set the cache used to save the index of the file and to
+    // reload it instead of indexing the file again (disabled by default).
+    void setIndexCache( const IndexCache& index_cache );
+
+    // Set the memory (in bytes) used to keep the lines recently displayed,
+    // decoded and expanded (0 disables the cache)
+    void setLineCacheMemory( qint64 memory );
+    // Returns the hits, misses and size of the cache of lines
+    LineCache::Statistics getLineCacheStatistics() const;
+
     // Get the auto-detected encoding for the indexed text.
     EncodingSpeculator::Encoding getDetectedEncoding() const;
 
@@ -87,6 +141,22 @@ class LogData : public AbstractLogData {
     void loadingProgressed( int percent );
     // Signal the client the file is fully loaded and available.
     void loadingFinished( LoadingStatus status );
+    // Sent during the loading of a big file if tail-first loading is
+    // enabled: the last lines of the file are available, numbered
+    // from the first of them, until loadingFinished is sent.
+    // It is sent from the indexing thread, but not while the segments
+    // of a file set are loaded.
+    void tailLoaded();
+    // Sent just before loadingFinished when the lines of the tail are
+    // replaced by all the lines of the file: the lines from first_line
+    // are now numbered offset lines further, or are lost if offset is
+    // negative (the loading has been interrupted). The lines cached are
+    // already dropped, the line numbers kept by the client must be
+    // updated before the lines are read again.
+    void tailReplaced( qint64 first_line, qint64 offset );
+    // Sent between tailLoaded and loadingFinished when the lines
+    // appended to the file have been added after those of the tail.
+    void tailUpdated();
     // Sent when the file on disk has changed, will be followed
     // by loadingProgressed if needed and then a loadingFinished.
     void fileChanged( LogData::MonitoredFileStatus status );
@@ -95,7 +165,15 @@ class LogData : public AbstractLogData {
     // Consider reloading the file when it changes on disk updated
     void fileChangedOnDisk();
     // Called when the worker thread signals the current operation ended
-    void indexingFinished( LoadingStatus status );
+    void indexingFinished( LoadingStatus status, quint64 generation );
+    // Called when the worker thread of a segment has finished
+    void segmentIndexingFinished( LoadingStatus status );
+    // Called (in the indexing thread) when the tail of the file is indexed
+    void tailIndexed();
+    // Called when the tail has been published, to follow it
+    void tailPublished();
+    // Called when lines appended to the file have been added to the tail
+    void tailExtended();
 
   private:
     // This class models an indexing operation.
@@ -107,12 +185,15 @@ class LogData : public AbstractLogData {
         // Permit each child to have its destructor
         virtual ~LogDataOperation() {};
 
-        void start( LogDataWorkerThread& workerThread ) const
-        { doStart( workerThread ); }
+        // Returns the generation of the indexing job started
+        quint64 start( LogDataWorkerThread& workerThread ) const
+        { return doStart( workerThread ); }
         const QString& getFilename() const { return filename_; }
+        // Returns whether the operation is done by any other one
+        virtual bool isPartial() const { return false; }
 
       protected:
-        virtual void doStart( LogDataWorkerThread& workerThread ) const = 0;
+        virtual quint64 doStart( LogDataWorkerThread& workerThread ) const = 0;
         QString filename_;
     };
 
@@ -124,7 +205,7 @@ class LogData : public AbstractLogData {
         ~AttachOperation() {};
 
       protected:
-        void doStart( LogDataWorkerThread& workerThread ) const;
+        quint64 doStart( LogDataWorkerThread& workerThread ) const;
     };
 
     // Reindexing the current file
@@ -134,7 +215,7 @@ class LogData : public AbstractLogData {
         ~FullIndexOperation() {};
 
       protected:
-        void doStart( LogDataWorkerThread& workerThread ) const;
+        quint64 doStart( LogDataWorkerThread& workerThread ) const;
     };
 
     // Indexing part of the current file (from fileSize)
@@ -143,8 +224,33 @@ class LogData : public AbstractLogData {
         PartialIndexOperation() : LogDataOperation( QString() ) {}
         ~PartialIndexOperation() {};
 
+        bool isPartial() const { return true; }
+
       protected:
-        void doStart( LogDataWorkerThread& workerThread ) const;
+        quint64 doStart( LogDataWorkerThread& workerThread ) const;
+    };
+
+    // A file of a file set before the attached one
+    struct Segment {
+        Segment( const QString& fileName, int rotation );
+        // Keep the file already open and mapped (the attached file once
+        // rotated, still the one its index was built from)
+        Segment( const QString& fileName, int rotation,
+                std::unique_ptr<QFile> openFile,
+                std::shared_ptr<MappedFile> mappedFile );
+
+        QString fileName;
+        // Its number in the rotated files of the attached file
+        // (0 if it is not named after it)
+        int rotation;
+        std::unique_ptr<QFile> file;
+        std::unique_ptr<IndexingData> indexingData;
+        // The content of the file, if it is compressed
+        std::unique_ptr<GzipDevice> compressedFile;
+        // The file mapped in memory (if it is not compressed)
+        std::shared_ptr<MappedFile> mappedFile;
+        // Only while the segment is indexed
+        std::unique_ptr<LogDataWorkerThread> workerThread;
     };
 
     std::shared_ptr<FileWatcher> fileWatcher_;
@@ -155,6 +261,7 @@ class LogData : public AbstractLogData {
     QString doGetExpandedLineString( qint64 line ) const override;
     QStringList doGetLines( qint64 first, int number ) const override;
     QStringList doGetExpandedLines( qint64 first, int number ) const override;
+    void doPrefetchExpandedLines( const std::vector<LineRange>& ranges ) const override;
     qint64 doGetNbLine() const override;
     int doGetMaxLength() const override;
     int doGetLineLength( qint64 line ) const override;
@@ -164,12 +271,88 @@ class LogData : public AbstractLogData {
     void enqueueOperation( std::shared_ptr<const LogDataOperation> newOperation );
     void startOperation();
     void reOpenFile();
-
-    qint64 endOfLinePosition( qint64 line ) const;
+    // Read the passed range of the (uncompressed) content of the
+    // attached file, or of the passed segment (called with fileMutex_ held)
+    QByteArray readContent( Segment* segment,
+            qint64 first_byte, qint64 length ) const;
+    // Read the passed lines of the whole content, without decoding them,
+    // calling line_read( const char* data, int length,
+    // LineAttributes attributes ) for each line
+    // (the data is only valid during the call)
+    template <typename Callback>
+    void readRawLines( qint64 first_line, int number, Callback line_read ) const;
+    // Get the expanded length of the passed line from the index, without
+    // reading it, returns false if it cannot be known that way.
+    bool getIndexedLineLength( qint64 line, int* length ) const;
+
+    // Index the passed segment (a partial indexing if 'additional')
+    void startSegmentIndexing( Segment* segment, bool additional );
+    // Returns whether the attached file has just been rotated
+    bool isRotated( qint64 indexed_size ) const;
+    // Make the attached file the last segment, as its rotated file
+    void archiveAttachedFile();
+    // Fingerprint the indexed part of the attached file
+    void updateFingerprint();
+    // Returns whether the passed file starts with the indexed data
+    bool fingerprintMatches( QIODevice* file ) const;
+    // Returns whether the whole index is valid for the attached file
+    // (it has only been appended to since indexed)
+    bool isIndexUpToDate() const;
+    // Update the lines of the segments, must be called when their
+    // index changes (called with fileMutex_ held)
+    void updateSegments();
+    // Start watching the file for updates
+    void startWatching();
+
+    qint64 startOfFirstLinePosition( const IndexingData& data ) const;
+    void linePositions( const IndexingData& data, qint64 line,
+            qint64* begin, qint64* end ) const;
+    qint64 endOfLinePosition( uint64_t pos_for_line ) const;
     qint64 beginningOfNextLine( qint64 end_pos ) const;
+    // Decode the passed line, skipping what its attributes allow
+    QString decodeLine( const char* data, int length,
+            LineAttributes attributes ) const;
+    // Decode and expand the passed line, as it is displayed
+    QString expandLine( const char* data, int length,
+            LineAttributes attributes ) const;
+    // Returns whether the passed line can be cached (it is not the
+    // last one, which can still be appended to)
+    bool isCacheable( qint64 line, qint64 nb_lines ) const
+    { return line < nb_lines - 1; }
 
     QString indexingFileName_;
     std::unique_ptr<QFile> attached_file_;
+    // The content of the file, if it is compressed
+    mutable std::unique_ptr<GzipDevice> compressed_file_;
+    // The attached file mapped in memory, read without locking fileMutex_
+    // when it is not part of a file set.
+    // Only accessed with std::atomic_load/store.
+    std::shared_ptr<MappedFile> mapped_file_;
+
+    // Whether attached to a file set (only set before attaching)
+    std::atomic<bool> fileSet_;
+    // The files before the attached one if attached to a file set
+    // (protected by fileMutex_)
+    std::vector<std::unique_ptr<Segment>> segments_;
+    // First line of each segment, followed by the first line of the
+    // attached file (protected by fileMutex_)
+    std::vector<qint64> segmentFirstLine_;
+    // Totals for the segments
+    std::atomic<qint64> segmentsNbLines_;
+    std::atomic<int> segmentsMaxLength_;
+    std::atomic<qint64> segmentsSize_;
+    // Number of segments being indexed, the loading is finished once
+    // they and the attached file are indexed.
+    std::atomic<int> segmentsLoading_;
+    bool finishPending_ = false;
+    LoadingStatus pendingStatus_;
+    // Set when the attached file must be archived before the next operation
+    bool rotationPending_ = false;
+    // Set when the next operation must check the index is still valid
+    bool reloadPending_ = false;
+
+    // The attached file when last indexed
+    FileFingerprint fingerprint_;
 
     // Indexing data, read by us, written by the worker thread
     IndexingData indexing_data_;
@@ -177,9 +360,18 @@ class LogData : public AbstractLogData {
     QDateTime lastModifiedDate_;
     std::shared_ptr<const LogDataOperation> currentOperation_;
     std::shared_ptr<const LogDataOperation> nextOperation_;
-
-    // Codec to decode text
-    QTextCodec* codec_;
+    // Generation of the indexing job of the current operation
+    quint64 currentGeneration_ = 0;
+
+    // Decodes the text with the codec of the display encoding (or
+    // directly for the most common ones)
+    LineDecoder decoder_;
+
+    // The lines decoded and expanded, cleared when they might have
+    // changed (encoding change, truncated file, lines renumbered)
+    mutable LineCache lineCache_;
+    // Reads the lines about to be displayed into lineCache_
+    std::unique_ptr<LinePrefetcher> prefetcher_;
 
     // Offset to apply to the newline character
     int before_cr_offset_ = 0;
@@ -17,17 +17,47 @@
  * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include <QFile>
 
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "log.h"
 
 #include "logdata.h"
 #include "logdataworkerthread.h"
+#include "linescanner.h"
+#include "pipelinedreader.h"
+#include "pagecacheguard.h"
+#include "sigbusguard.h"
+#include "gzipdevice.h"
 
 // Size of the chunk to read (5 MiB)
 const int IndexOperation::sizeChunk = 5*1024*1024;
+// Files indexed tail-first must be big enough for it to be worth it
+const qint64 FullIndexOperation::tailFirstMinFileSize = 2*sizeChunk;
+// Maximum size of the tail
+const qint64 FullIndexOperation::tailMaxSize = 64*1024*1024;
+
+const uint32_t IndexingData::sparseInitialInterval = 64;
+const uint32_t IndexingData::sparseMaxInterval = 4096;
 
 qint64 IndexingData::getSize() const
+{
+    return publishedSize_;
+}
+
+qint64 IndexingData::getIndexedSize() const
 {
     QMutexLocker locker( &dataMutex_ );
 
@@ -36,34 +66,116 @@ qint64 IndexingData::getSize() const
 
 int IndexingData::getMaxLength() const
 {
+    return publishedMaxLength_;
+}
+
+LineNumber IndexingData::getNbLines() const
+{
+    return publishedNbLines_;
+}
+
+qint64 IndexingData::getPosForLine( LineNumber line ) const
+{
+    // Most lines are in the published blocks, that cannot change
+    const auto snapshot = std::atomic_load( &published_ );
+    if ( snapshot && line < snapshot->size() )
+        return snapshot->at( line );
+
     QMutexLocker locker( &dataMutex_ );
 
-    return maxLength_;
+    if ( tailMode_ )
+        return tailPosition_.at( line );
+
+    return sparse_ ? sparsePosition_.at( line ) : linePosition_.at( line );
 }
 
-LineNumber IndexingData::getNbLines() const
+void IndexingData::getPosForLines( LineNumber first, LineNumber number,
+        uint64_t* positions ) const
+{
+    LineNumber nb_published = 0;
+
+    const auto snapshot = std::atomic_load( &published_ );
+    if ( snapshot && first < snapshot->size() ) {
+        nb_published = qMin( number, snapshot->size() - first );
+        snapshot->get_range( first, nb_published, positions );
+    }
+
+    if ( nb_published == number )
+        return;
+
+    // The rest is read with the mutex taken once
+    QMutexLocker locker( &dataMutex_ );
+
+    first     += nb_published;
+    number    -= nb_published;
+    positions += nb_published;
+
+    if ( tailMode_ )
+        tailPosition_.get_range( first, number, positions );
+    else if ( sparse_ )
+        sparsePosition_.get_range( first, number, positions );
+    else
+        linePosition_.get_range( first, number, positions );
+}
+
+LineNumber IndexingData::getLineForPos( qint64 pos ) const
 {
     QMutexLocker locker( &dataMutex_ );
 
-    return linePosition_.size();
+    if ( pos < 0 )
+        return 0;
+
+    // The lines before the tail are not visible
+    if ( tailMode_ )
+        return ( pos < tailStart_ ) ? 0 : tailPosition_.line_for_offset( pos );
+
+    return sparse_ ? sparsePosition_.line_for_offset( pos )
+        : linePosition_.line_for_offset( pos );
 }
 
-qint64 IndexingData::getPosForLine( LineNumber line ) const
+void IndexingData::getAttributesForLines( LineNumber first, LineNumber number,
+        LineAttributes* attributes ) const
+{
+    const auto snapshot = std::atomic_load( &publishedAttributes_ );
+    if ( snapshot )
+        snapshot->get_range( first, number, attributes );
+    else
+        std::fill( attributes, attributes + number, LineAttribute::Unknown );
+}
+
+bool IndexingData::getExpansionForLine( LineNumber line,
+        int32_t* expansion ) const
+{
+    const auto snapshot = std::atomic_load( &publishedExpansions_ );
+    return snapshot && snapshot->get( line, expansion );
+}
+
+LineScanner::OpenLine IndexingData::getOpenLine() const
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    return openLine_;
+}
+
+qint64 IndexingData::getStartOfFirstLine() const
 {
     QMutexLocker locker( &dataMutex_ );
 
-    return linePosition_.at( line );
+    return tailMode_ ? tailStart_ : 0;
 }
 
 EncodingSpeculator::Encoding IndexingData::getEncodingGuess() const
 {
     QMutexLocker locker( &dataMutex_ );
 
-    return encoding_;
+    return tailMode_ ? tailEncoding_ : encoding_;
 }
 
 void IndexingData::addAll( qint64 size, int length,
         const FastLinePositionArray& linePosition,
+        const LineAttributeList& lineAttributes,
+        const LineExpansionList& lineExpansions,
+        const LineScanner::OpenLine& openLine,
         EncodingSpeculator::Encoding encoding )
 
 {
@@ -71,26 +183,343 @@ void IndexingData::addAll( qint64 size, int length,
 
     indexedSize_  += size;
     maxLength_     = qMax( maxLength_, length );
-    linePosition_.append_list( linePosition );
+    if ( sparse_ )
+        sparsePosition_.append_list( linePosition );
+    else
+        linePosition_.append_list( linePosition );
+
+    lineAttributes_.append_list( lineAttributes );
+    lineExpansions_.append_list( lineExpansions );
+    openLine_      = openLine;
 
     encoding_      = encoding;
+
+    applyMemoryBudget();
+    publish();
 }
 
 void IndexingData::clear()
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    doClear();
+    publish();
+}
+
+void IndexingData::doClear()
 {
     maxLength_   = 0;
     indexedSize_ = 0;
     linePosition_ = LinePositionArray();
+    sparsePosition_ = SparseLinePositionArray();
+    sparse_      = false;
+    gzipIndex_.reset();
     encoding_    = EncodingSpeculator::Encoding::ASCII7;
+    lineAttributes_ = LineAttributeArray();
+    lineExpansions_ = LineExpansionArray();
+    openLine_    = LineScanner::OpenLine { 0, 0, 0, -1 };
+
+    tailMode_    = false;
+    tailEnd_     = 0;
+    tailOpenLine_ = LineScanner::OpenLine { 0, 0, 0, -1 };
+    tailPosition_ = LinePositionArray();
+    tailAttributes_ = LineAttributeArray();
+    tailExpansions_ = LineExpansionArray();
+}
+
+void IndexingData::setMemoryBudget( const QString& file_name, qint64 budget )
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    fileName_     = file_name;
+    memoryBudget_ = budget;
+}
+
+bool IndexingData::isSparse() const
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    return sparse_;
+}
+
+void IndexingData::setFileName( const QString& file_name )
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    fileName_ = file_name;
+    if ( sparse_ )
+        sparsePosition_.storage().set_file_name( file_name );
+}
+
+void IndexingData::takeFrom( IndexingData& other, const QString& file_name )
+{
+    QMutexLocker locker( &dataMutex_ );
+    QMutexLocker other_locker( &other.dataMutex_ );
+
+    linePosition_   = std::move( other.linePosition_ );
+    sparsePosition_ = std::move( other.sparsePosition_ );
+    sparse_         = other.sparse_;
+    fileName_       = file_name;
+    memoryBudget_   = other.memoryBudget_;
+    gzipIndex_      = std::move( other.gzipIndex_ );
+    maxLength_      = other.maxLength_;
+    indexedSize_    = other.indexedSize_;
+    encoding_       = other.encoding_;
+    lineAttributes_ = std::move( other.lineAttributes_ );
+    lineExpansions_ = std::move( other.lineExpansions_ );
+    openLine_       = other.openLine_;
+
+    if ( sparse_ )
+        sparsePosition_.storage().set_file_name( file_name );
+
+    other.doClear();
+
+    publish();
+    other.publish();
+}
+
+std::shared_ptr<GzipIndex> IndexingData::getGzipIndex() const
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    return gzipIndex_;
+}
+
+void IndexingData::setGzipIndex( std::shared_ptr<GzipIndex> gzip_index )
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    gzipIndex_ = std::move( gzip_index );
+}
+
+void IndexingData::applyMemoryBudget()
+{
+    if ( memoryBudget_ <= 0 )
+        return;
+
+    if ( ! sparse_ ) {
+        if ( static_cast<qint64>( linePosition_.storage().memory_usage() )
+                <= memoryBudget_ )
+            return;
+
+        LOG(logINFO) << "Index of " << fileName_.toStdString()
+            << " over budget with " << linePosition_.size()
+            << " lines, switching to a sparse index";
+
+        sparsePosition_ = SparseLinePositionArray(
+                SparseLinePositionStorage( fileName_, sparseInitialInterval ) );
+        sparsePosition_.copy_from( linePosition_ );
+        linePosition_ = LinePositionArray();
+        sparse_ = true;
+    }
+
+    SparseLinePositionStorage& storage = sparsePosition_.storage();
+    while ( static_cast<qint64>( storage.memory_usage() ) > memoryBudget_
+            && storage.interval() < sparseMaxInterval ) {
+        storage.coarsen();
+        LOG(logDEBUG) << "Sparse index interval now " << storage.interval();
+    }
+}
+
+void IndexingData::publish()
+{
+    std::shared_ptr<const CompressedLinePositionStorage::Snapshot> snapshot;
+    if ( ! tailMode_ && ! sparse_ )
+        snapshot = linePosition_.storage().snapshot();
+
+    // The readers falling outside the snapshot take the mutex anyway
+    std::atomic_store( &published_, snapshot );
+    std::atomic_store( &publishedAttributes_,
+            ( tailMode_ ? tailAttributes_ : lineAttributes_ ).snapshot() );
+    std::atomic_store( &publishedExpansions_,
+            ( tailMode_ ? tailExpansions_ : lineExpansions_ ).snapshot() );
+
+    publishedSize_      = tailMode_ ? tailEnd_ : indexedSize_;
+    publishedMaxLength_ = tailMode_ ? tailMaxLength_ : maxLength_;
+    if ( tailMode_ )
+        publishedNbLines_ = tailPosition_.size();
+    else
+        publishedNbLines_ = sparse_ ? sparsePosition_.size() : linePosition_.size();
+}
+
+void IndexingData::setTail( qint64 tail_start, qint64 tail_end, int length,
+        const FastLinePositionArray& linePosition,
+        const LineAttributeList& lineAttributes,
+        const LineExpansionList& lineExpansions,
+        const LineScanner::OpenLine& openLine,
+        EncodingSpeculator::Encoding encoding )
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    tailMode_      = true;
+    tailStart_     = tail_start;
+    tailEnd_       = tail_end;
+    tailOpenLine_  = openLine;
+    tailMaxLength_ = length;
+    tailPosition_  = LinePositionArray();
+    tailPosition_.append_list( linePosition );
+    tailEncoding_  = encoding;
+    tailAttributes_ = LineAttributeArray();
+    tailAttributes_.append_list( lineAttributes );
+    tailExpansions_ = LineExpansionArray();
+    tailExpansions_.append_list( lineExpansions );
+
+    publish();
+}
+
+void IndexingData::addToTail( qint64 size, int length,
+        const FastLinePositionArray& linePosition,
+        const LineAttributeList& lineAttributes,
+        const LineExpansionList& lineExpansions,
+        const LineScanner::OpenLine& openLine )
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    if ( ! tailMode_ )
+        return;
+
+    tailEnd_       += size;
+    tailMaxLength_  = qMax( tailMaxLength_, length );
+    tailPosition_.append_list( linePosition );
+    tailAttributes_.append_list( lineAttributes );
+    tailExpansions_.append_list( lineExpansions );
+    tailOpenLine_   = openLine;
+
+    publish();
+}
+
+bool IndexingData::getTailEnd( qint64* tail_end,
+        LineScanner::OpenLine* openLine ) const
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    *tail_end = tailEnd_;
+    *openLine = tailOpenLine_;
+
+    return tailMode_;
+}
+
+qint64 IndexingData::endTailMode()
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    if ( ! tailMode_ )
+        return 0;
+
+    // The first line of the tail starts right after the end of a line
+    qint64 nb_lines_before = -1;
+    if ( indexedSize_ >= tailStart_ )
+        nb_lines_before = sparse_ ? sparsePosition_.line_for_offset( tailStart_ )
+            : linePosition_.line_for_offset( tailStart_ );
+
+    tailMode_      = false;
+    tailEnd_       = 0;
+    tailPosition_  = LinePositionArray();
+    tailAttributes_ = LineAttributeArray();
+    tailExpansions_ = LineExpansionArray();
+
+    publish();
+
+    return nb_lines_before;
+}
+
+bool IndexingData::isTailMode() const
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    return tailMode_;
+}
+
+void IndexingData::save( QDataStream& out ) const
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    out << static_cast<qint32>( maxLength_ ) << indexedSize_
+        << static_cast<qint32>( encoding_ ) << sparse_;
+    if ( sparse_ )
+        sparsePosition_.save( out );
+    else
+        linePosition_.save( out );
+
+    lineAttributes_.save( out );
+    lineExpansions_.save( out );
+    out << openLine_.start << static_cast<qint32>( openLine_.additional_spaces )
+        << static_cast<quint8>( openLine_.attributes ) << openLine_.last_cr;
+}
+
+bool IndexingData::load( QDataStream& in )
+{
+    QMutexLocker locker( &dataMutex_ );
+
+    qint32 max_length, encoding;
+    qint64 indexed_size;
+    bool sparse;
+    in >> max_length >> indexed_size >> encoding >> sparse;
+    if ( in.status() != QDataStream::Ok
+            || max_length < 0 || indexed_size < 0
+            || encoding < 0
+            || encoding > static_cast<qint32>( EncodingSpeculator::Encoding::KOI8R ) )
+        return false;
+
+    if ( sparse ) {
+        // The interval is read from the stream
+        sparsePosition_ = SparseLinePositionArray(
+                SparseLinePositionStorage( fileName_, 1 ) );
+        if ( ! sparsePosition_.load( in ) ) {
+            sparsePosition_ = SparseLinePositionArray();
+            return false;
+        }
+    }
+    else if ( ! linePosition_.load( in ) ) {
+        return false;
+    }
+
+    qint64 open_line_start, open_line_last_cr;
+    qint32 open_line_spaces;
+    quint8 open_line_attributes;
+    if ( ! lineAttributes_.load( in ) || ! lineExpansions_.load( in ) )
+        return false;
+    in >> open_line_start >> open_line_spaces >> open_line_attributes
+        >> open_line_last_cr;
+    if ( in.status() != QDataStream::Ok )
+        return false;
+
+    // The parts must agree with each other: the attributes and expansions
+    // are those of every line but a fake final LF one, which ends right
+    // after the indexed size, and the open line is in the indexed part.
+    const uint32_t nb_lines = sparse ? sparsePosition_.size() : linePosition_.size();
+    const uint64_t last_position = ( nb_lines == 0 ) ? 0 :
+        ( sparse ? sparsePosition_.at( nb_lines - 1 )
+                 : linePosition_.at( nb_lines - 1 ) );
+    auto lines_agree = [nb_lines]( uint32_t size ) {
+        return size <= nb_lines && size + 1 >= nb_lines; };
+    if ( ! lines_agree( lineAttributes_.size() )
+            || ! lines_agree( lineExpansions_.size() )
+            || last_position > static_cast<uint64_t>( indexed_size ) + 1
+            || open_line_start < 0 || open_line_start > indexed_size
+            || open_line_last_cr < -1 || open_line_last_cr >= indexed_size )
+        return false;
+
+    sparse_      = sparse;
+    maxLength_   = max_length;
+    indexedSize_ = indexed_size;
+    encoding_    = static_cast<EncodingSpeculator::Encoding>( encoding );
+    openLine_    = LineScanner::OpenLine { open_line_start, open_line_spaces,
+        open_line_attributes, open_line_last_cr };
+
+    publish();
+
+    return true;
 }
 
 LogDataWorkerThread::LogDataWorkerThread( IndexingData* indexing_data )
     : QThread(), mutex_(), operationRequestedCond_(),
-    nothingToDoCond_(), fileName_(), indexing_data_( indexing_data )
+    fileName_(), pendingJob_(), cancelledJobs_(),
+    indexingSettings_(), indexCache_(), indexing_data_( indexing_data )
 {
     terminate_          = false;
     interruptRequested_ = false;
-    operationRequested_ = NULL;
+    lastGeneration_     = 0;
 }
 
 LogDataWorkerThread::~LogDataWorkerThread()
@@ -98,6 +527,8 @@ LogDataWorkerThread::~LogDataWorkerThread()
     {
         QMutexLocker locker( &mutex_ );
         terminate_ = true;
+        // No need to finish the current job
+        interruptRequested_ = true;
         operationRequestedCond_.wakeAll();
     }
     wait();
@@ -110,44 +541,123 @@ void LogDataWorkerThread::attachFile( const QString& fileName )
     fileName_ = fileName;
 }
 
-void LogDataWorkerThread::indexAll()
+quint64 LogDataWorkerThread::indexAll()
 {
-    QMutexLocker locker( &mutex_ );  // to protect operationRequested_
+    QMutexLocker locker( &mutex_ );  // to protect pendingJob_
 
     LOG(logDEBUG) << "FullIndex requested";
 
-    // If an operation is ongoing, we will block
-    while ( (operationRequested_ != NULL) )
-        nothingToDoCond_.wait( &mutex_ );
-
-    interruptRequested_ = false;
-    operationRequested_ = new FullIndexOperation( fileName_,
-            indexing_data_, &interruptRequested_, &encodingSpeculator_ );
-    operationRequestedCond_.wakeAll();
+    return requestJob( Job::Type::Full );
 }
 
-void LogDataWorkerThread::indexAdditionalLines()
+quint64 LogDataWorkerThread::indexAdditionalLines()
 {
-    QMutexLocker locker( &mutex_ );  // to protect operationRequested_
+    QMutexLocker locker( &mutex_ );  // to protect pendingJob_
 
     LOG(logDEBUG) << "AddLines requested";
 
-    // If an operation is ongoing, we will block
-    while ( (operationRequested_ != NULL) )
-        nothingToDoCond_.wait( &mutex_ );
-
-    interruptRequested_ = false;
-    operationRequested_ = new PartialIndexOperation( fileName_,
-            indexing_data_, &interruptRequested_, &encodingSpeculator_ );
-    operationRequestedCond_.wakeAll();
+    return requestJob( Job::Type::Partial );
 }
 
 void LogDataWorkerThread::interrupt()
 {
+    QMutexLocker locker( &mutex_ );  // to protect pendingJob_
+
     LOG(logDEBUG) << "Load interrupt requested";
 
-    // No mutex here, setting a bool is probably atomic!
+    // The operation checks it between chunks
     interruptRequested_ = true;
+
+    if ( pendingJob_ ) {
+        cancelledJobs_.push_back( pendingJob_->generation );
+        pendingJob_.reset();
+        operationRequestedCond_.wakeAll();
+    }
+}
+
+quint64 LogDataWorkerThread::requestJob( Job::Type type )
+{
+    if ( pendingJob_ ) {
+        // Merged with the waiting job
+        if ( type == Job::Type::Full )
+            pendingJob_->type = Job::Type::Full;
+
+        LOG(logDEBUG) << "Merged with job " << pendingJob_->generation;
+    }
+    else {
+        pendingJob_.reset( new Job { type, ++lastGeneration_ } );
+        operationRequestedCond_.wakeAll();
+    }
+
+    return pendingJob_->generation;
+}
+
+void LogDataWorkerThread::setIndexingThreads( int nb_threads )
+{
+    QMutexLocker locker( &mutex_ );  // to protect indexingSettings_
+
+    LOG(logDEBUG) << "Indexing threads set to " << nb_threads;
+
+    indexingSettings_.nbThreads = nb_threads;
+}
+
+void LogDataWorkerThread::setReadAheadDepth( int depth )
+{
+    QMutexLocker locker( &mutex_ );  // to protect indexingSettings_
+
+    LOG(logDEBUG) << "Read ahead depth set to " << depth;
+
+    indexingSettings_.readAheadDepth = depth;
+}
+
+void LogDataWorkerThread::setTailFirstLines( int nb_lines )
+{
+    QMutexLocker locker( &mutex_ );  // to protect indexingSettings_
+
+    LOG(logDEBUG) << "Tail first lines set to " << nb_lines;
+
+    indexingSettings_.tailFirstLines = nb_lines;
+}
+
+void LogDataWorkerThread::setIndexMemoryBudget( qint64 budget )
+{
+    QMutexLocker locker( &mutex_ );  // to protect indexingSettings_
+
+    LOG(logDEBUG) << "Index memory budget set to " << budget;
+
+    indexingSettings_.memoryBudget = budget;
+}
+
+void LogDataWorkerThread::setPreservePageCache( bool preserve )
+{
+    QMutexLocker locker( &mutex_ );  // to protect indexingSettings_
+
+    LOG(logDEBUG) << "Preserve page cache set to " << preserve;
+
+    indexingSettings_.preservePageCache = preserve;
+}
+
+void LogDataWorkerThread::setIndexCache( const IndexCache& index_cache )
+{
+    QMutexLocker locker( &mutex_ );  // to protect indexCache_
+
+    indexCache_ = index_cache;
+}
+
+void LogDataWorkerThread::copySettings( LogDataWorkerThread& other )
+{
+    IndexingSettings settings;
+    IndexCache index_cache;
+    {
+        QMutexLocker locker( &other.mutex_ );
+        settings    = other.indexingSettings_;
+        index_cache = other.indexCache_;
+    }
+
+    QMutexLocker locker( &mutex_ );
+
+    indexingSettings_ = settings;
+    indexCache_       = index_cache;
 }
 
 // This is the thread's main loop
@@ -156,7 +666,8 @@ void LogDataWorkerThread::run()
     QMutexLocker locker( &mutex_ );
 
     forever {
-        while ( (terminate_ == false) && (operationRequested_ == NULL) )
+        while ( (terminate_ == false) && ( ! pendingJob_ )
+                && cancelledJobs_.empty() )
             operationRequestedCond_.wait( &mutex_ );
         LOG(logDEBUG) << "Worker thread signaled";
 
@@ -164,28 +675,59 @@ void LogDataWorkerThread::run()
         if ( terminate_ )
             return;      // We must die
 
-        if ( operationRequested_ ) {
-            connect( operationRequested_, SIGNAL( indexingProgressed( int ) ),
-                    this, SIGNAL( indexingProgressed( int ) ) );
+        // Report the cancelled jobs first, in order
+        std::vector<quint64> cancelled_jobs;
+        cancelled_jobs.swap( cancelledJobs_ );
+        if ( ! cancelled_jobs.empty() ) {
+            locker.unlock();
+            for ( quint64 generation : cancelled_jobs )
+                emit indexingFinished( LoadingStatus::Interrupted, generation );
+            locker.relock();
+        }
 
-            // Run the operation
+        if ( pendingJob_ ) {
+            const Job job = *pendingJob_;
+            pendingJob_.reset();
+
+            // The operation is created when run, so it uses the
+            // latest settings
+            interruptRequested_ = false;
+            std::unique_ptr<IndexOperation> operation;
+            if ( job.type == Job::Type::Full )
+                operation.reset( new FullIndexOperation( fileName_,
+                        indexing_data_, &interruptRequested_, &encodingSpeculator_,
+                        indexingSettings_, indexCache_ ) );
+            else
+                operation.reset( new PartialIndexOperation( fileName_,
+                        indexing_data_, &interruptRequested_, &encodingSpeculator_,
+                        indexingSettings_ ) );
+
+            connect( operation.get(), SIGNAL( indexingProgressed( int ) ),
+                    this, SIGNAL( indexingProgressed( int ) ) );
+            connect( operation.get(), SIGNAL( tailIndexed() ),
+                    this, SIGNAL( tailIndexed() ) );
+            connect( operation.get(), SIGNAL( tailExtended() ),
+                    this, SIGNAL( tailExtended() ) );
+
+            // Run the operation, without blocking the requests
+            locker.unlock();
+            LOG(logDEBUG) << "Running job " << job.generation;
             try {
-                if ( operationRequested_->start() ) {
+                if ( operation->start() ) {
                     LOG(logDEBUG) << "... finished copy in workerThread.";
-                    emit indexingFinished( LoadingStatus::Successful );
+                    emit indexingFinished( LoadingStatus::Successful, job.generation );
                 }
                 else {
-                    emit indexingFinished( LoadingStatus::Interrupted );
+                    emit indexingFinished( LoadingStatus::Interrupted, job.generation );
                 }
             }
             catch ( std::bad_alloc& ba ) {
                 LOG(logERROR) << "Out of memory whilst indexing!";
-                emit indexingFinished( LoadingStatus::NoMemory );
+                emit indexingFinished( LoadingStatus::NoMemory, job.generation );
             }
 
-            delete operationRequested_;
-            operationRequested_ = NULL;
-            nothingToDoCond_.wakeAll();
+            operation.reset();
+            locker.relock();
         }
     }
 }
@@ -196,79 +738,587 @@ void LogDataWorkerThread::run()
 
 IndexOperation::IndexOperation( const QString& fileName,
         IndexingData* indexingData, bool* interruptRequest,
-        EncodingSpeculator* encodingSpeculator )
+        EncodingSpeculator* encodingSpeculator,
+        const IndexingSettings& settings )
     : fileName_( fileName )
 {
     interruptRequest_ = interruptRequest;
     indexing_data_ = indexingData;
     encoding_speculator_ = encodingSpeculator;
+
+    nbThreads_ = ( settings.nbThreads > 0 ) ?
+        settings.nbThreads : QThread::idealThreadCount();
+    readAheadDepth_ = settings.readAheadDepth;
+    preservePageCache_ = settings.preservePageCache;
+}
+
+namespace {
+    // A chunk of the file being indexed, it is mapped in memory when
+    // possible, which saves copying every byte, and otherwise read in a
+    // buffer (e.g. for pipes or files too big for the address space).
+    // A log can be truncated while its chunk is mapped (copytruncate
+    // rotation), the mapping is then scanned through a SigbusGuard, and
+    // read again if the scan cannot complete.
+    class FileChunk {
+      public:
+        // Get (at most) 'size' bytes from the current position of the
+        // file, moving the position past them. If the chunk is mapped,
+        // the kernel is asked to read the 'read_ahead' bytes following
+        // it while it is scanned.
+        FileChunk( QFile* file, qint64 size, bool try_map,
+                qint64 read_ahead = 0 )
+            : file_( file ), position_( file->pos() ), mapped_( nullptr ),
+            mapFailed_( false ), buffer_()
+        {
+            length_ = qMin( size, file->size() - position_ );
+
+            if ( try_map && length_ > 0 ) {
+                mapped_ = file->map( position_, length_ );
+                mapFailed_ = ( mapped_ == nullptr );
+            }
+
+            if ( mapped_ ) {
+                adviseSequential();
+                adviseReadAhead( read_ahead );
+                file->seek( position_ + length_ );
+                data_ = reinterpret_cast<const char*>( mapped_ );
+            }
+            else {
+                buffer_ = file->read( size );
+                data_   = buffer_.constData();
+                length_ = buffer_.length();
+            }
+        }
+
+        // The chunk is unmapped as soon as it has been scanned
+        ~FileChunk()
+        { if ( mapped_ ) file_->unmap( mapped_ ); }
+
+        FileChunk( const FileChunk& ) = delete;
+        FileChunk& operator=( const FileChunk& ) = delete;
+
+        const char* data() const { return data_; }
+        qint64 length() const { return length_; }
+        // Whether the chunk has been read because it could not be mapped
+        bool mapFailed() const { return mapFailed_; }
+
+        // Call scan( data(), length() ), returns false if the scan has
+        // been interrupted because the file has been truncated while the
+        // mapping was read (scan must follow the rules of SigbusGuard).
+        template <typename Scan>
+        bool scan( Scan scan ) const
+        {
+            if ( ! mapped_ ) {
+                scan( data_, length_ );
+                return true;
+            }
+
+            const char* data = data_;
+            const qint64 length = length_;
+            return SigbusGuard::run( [&scan, data, length]() {
+                    scan( data, length ); } );
+        }
+
+        // Read what is left of the chunk in the file instead of mapping
+        // it, after a scan has been interrupted.
+        void readInstead()
+        {
+            if ( ! mapped_ )
+                return;
+
+            LOG(logWARNING) << "File truncated while it was mapped, reading "
+                << length_ << " bytes from " << position_ << " instead";
+
+            file_->unmap( mapped_ );
+            mapped_ = nullptr;
+
+            file_->seek( position_ );
+            buffer_ = file_->read( length_ );
+            data_   = buffer_.constData();
+            length_ = buffer_.length();
+        }
+
+      private:
+        // Tell the kernel we will read the mapping once, from start to end
+        void adviseSequential()
+        {
+#ifdef Q_OS_UNIX
+            // madvise wants a page aligned address, the mapping itself
+            // always starts on a page boundary.
+            static const uintptr_t page_size = sysconf( _SC_PAGESIZE );
+            const uintptr_t address = reinterpret_cast<uintptr_t>( mapped_ );
+            const uintptr_t start   = address & ~( page_size - 1 );
+            madvise( reinterpret_cast<void*>( start ),
+                    length_ + ( address - start ), MADV_SEQUENTIAL );
+#endif
+        }
+
+        // Start reading the next chunks into the page cache, they are not
+        // mapped yet so it is asked for the file rather than the mapping
+        void adviseReadAhead( qint64 read_ahead )
+        {
+#ifdef Q_OS_UNIX
+            const qint64 end = position_ + length_;
+            read_ahead = qMin( read_ahead, file_->size() - end );
+            if ( read_ahead > 0 )
+                posix_fadvise( file_->handle(), end, read_ahead,
+                        POSIX_FADV_WILLNEED );
+#else
+            Q_UNUSED( read_ahead );
+#endif
+        }
+
+        QFile* file_;
+        const qint64 position_;
+        uchar* mapped_;
+        bool mapFailed_;
+        QByteArray buffer_;
+        const char* data_;
+        qint64 length_;
+    };
+
+    // Result of the indexing of one chunk of the file by
+    // a parallel worker.
+    struct ChunkIndex {
+        ChunkIndex() : done( false ), length( 0 ), head(), has_eol( false ),
+            line_positions(), line_attributes(), line_expansions(),
+            max_length( 0 ),
+            scanner( AbstractLogData::tabStop ),
+            speculator( EncodingSpeculator::continuation() ) {}
+
+        bool done;
+        qint64 length;
+        // Bytes up to and including the first '\n' (whole chunk if none),
+        // they belong to a line started in a previous chunk.
+        QByteArray head;
+        bool has_eol;
+        // Lines following the head
+        FastLinePositionArray line_positions;
+        LineAttributeList line_attributes;
+        LineExpansionList line_expansions;
+        int max_length;
+        // State at the end of the chunk
+        LineScanner scanner;
+        EncodingSpeculator speculator;
+    };
+
+    void index_chunk( QFile* file, qint64 chunk_beginning, qint64 chunk_size,
+            ChunkIndex* result )
+    {
+        file->seek( chunk_beginning );
+        FileChunk block( file, chunk_size, ! file->isSequential() );
+
+        // Only reads the chunk and fills the result
+        auto scan = [chunk_beginning, result]( const char* data, qint64 length ) {
+            const char* eol = static_cast<const char*>(
+                    memchr( data, '\n', length ) );
+            const int head_length = eol ? ( eol - data + 1 ) : length;
+
+            result->length  = length;
+            result->has_eol = ( eol != nullptr );
+            result->head.resize( head_length );
+            memcpy( result->head.data(), data, head_length );
+
+            const qint64 body_beginning = chunk_beginning + head_length;
+            result->scanner = LineScanner( AbstractLogData::tabStop, body_beginning );
+            result->scanner.scanBlock( data + head_length,
+                    length - head_length, body_beginning,
+                    &result->line_positions, &result->line_attributes,
+                    &result->line_expansions, &result->max_length );
+
+            result->speculator.inject_block( data + head_length,
+                    length - head_length );
+        };
+
+        if ( ! block.scan( scan ) ) {
+            *result = ChunkIndex();
+            block.readInstead();
+            block.scan( scan );
+        }
+    }
+}
+
+// The file is split in chunks (of sizeChunk) that are indexed by the workers
+// independently, each one starting its work at the first end of line found
+// in its chunk.
+// The results are then stitched in order in the calling thread, which
+// scans the line crossing the boundary between chunks (the 'head') and
+// reconciles the encoding guesses, before adding each chunk to the shared
+// data and reporting progress, exactly as a sequential indexing does.
+void IndexOperation::doParallelIndex( QFile* file, IndexingData* indexing_data,
+        EncodingSpeculator* encoding_speculator, LineScanner* scanner,
+        PageCacheGuard* cache_guard )
+{
+    const qint64 beginning = file->pos();
+    const qint64 end       = file->size();
+    const int nb_chunks = ( end - beginning + sizeChunk - 1 ) / sizeChunk;
+
+    if ( nb_chunks < 2 )
+        return;
+
+    const int nb_workers = qMin( nbThreads_, nb_chunks );
+    // Chunks indexed but not stitched yet are kept in memory, so we
+    // limit how far ahead of the stitching the workers can go.
+    const int max_chunks_ahead = 2 * nb_workers;
+
+    LOG(logDEBUG) << "Parallel indexing of " << nb_chunks << " chunks using "
+        << nb_workers << " threads";
+
+    std::vector<ChunkIndex> chunks( nb_chunks );
+
+    // Protect everything below
+    QMutex mutex;
+    QWaitCondition chunk_done_cond;
+    QWaitCondition chunk_stitched_cond;
+    int next_chunk = 0;
+    int nb_stitched = 0;
+    bool stop = false;
+    bool out_of_memory = false;
+
+    auto worker = [&]() {
+        QFile chunk_file( fileName_ );
+        if ( ! chunk_file.open( QIODevice::ReadOnly ) ) {
+            // Stop everything, the sequential indexing will take over
+            QMutexLocker locker( &mutex );
+            stop = true;
+            chunk_done_cond.wakeAll();
+            chunk_stitched_cond.wakeAll();
+            return;
+        }
+
+        try {
+            forever {
+                int index;
+                {
+                    QMutexLocker locker( &mutex );
+                    while ( ! stop && ( next_chunk < nb_chunks )
+                            && ( next_chunk >= nb_stitched + max_chunks_ahead ) )
+                        chunk_stitched_cond.wait( &mutex );
+
+                    if ( stop || ( next_chunk >= nb_chunks ) )
+                        return;
+
+                    index = next_chunk++;
+                }
+
+                const qint64 chunk_beginning = beginning + (qint64) index * sizeChunk;
+                index_chunk( &chunk_file, chunk_beginning,
+                        qMin<qint64>( sizeChunk, end - chunk_beginning ),
+                        &chunks[index] );
+                if ( cache_guard )
+                    cache_guard->release( chunk_beginning, chunks[index].length );
+
+                QMutexLocker locker( &mutex );
+                chunks[index].done = true;
+                chunk_done_cond.wakeAll();
+            }
+        }
+        catch ( std::bad_alloc& ) {
+            QMutexLocker locker( &mutex );
+            out_of_memory = true;
+            stop = true;
+            chunk_done_cond.wakeAll();
+            chunk_stitched_cond.wakeAll();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for ( int i = 0; i < nb_workers; ++i )
+        workers.emplace_back( worker );
+
+    qint64 position = beginning;
+    for ( int index = 0; index < nb_chunks; ++index ) {
+        bool abort;
+        {
+            QMutexLocker locker( &mutex );
+            while ( ! chunks[index].done && ! stop && ! *interruptRequest_ )
+                chunk_done_cond.wait( &mutex, 100 );
+            abort = stop || *interruptRequest_;
+        }
+
+        if ( abort )
+            break;
+
+        ChunkIndex& chunk = chunks[index];
+        FastLinePositionArray line_positions;
+        LineAttributeList line_attributes;
+        LineExpansionList line_expansions;
+        int max_length = 0;
+
+        // The head completes the line started in the previous chunks
+        scanner->scanBlock( chunk.head.constData(), chunk.head.length(),
+                position, &line_positions, &line_attributes, &line_expansions,
+                &max_length );
+        encoding_speculator->inject_block( chunk.head.constData(),
+                chunk.head.length() );
+
+        if ( chunk.has_eol ) {
+            for ( int i = 0; i < chunk.line_positions.size(); ++i )
+                line_positions.append( chunk.line_positions[i] );
+            line_attributes.insert( line_attributes.end(),
+                    chunk.line_attributes.begin(), chunk.line_attributes.end() );
+            line_expansions.insert( line_expansions.end(),
+                    chunk.line_expansions.begin(), chunk.line_expansions.end() );
+            max_length = qMax( max_length, chunk.max_length );
+
+            *scanner = chunk.scanner;
+            encoding_speculator->merge( chunk.speculator );
+        }
+
+        position += chunk.length;
+
+        // Update the shared data
+        indexing_data->addAll( chunk.length, max_length, line_positions,
+                line_attributes, line_expansions, scanner->openLine(),
+                encoding_speculator->guess() );
+
+        // Free the chunk and let the workers carry on
+        chunk.head = QByteArray();
+        chunk.line_positions = FastLinePositionArray();
+        chunk.line_attributes = LineAttributeList();
+        chunk.line_expansions = LineExpansionList();
+        {
+            QMutexLocker locker( &mutex );
+            ++nb_stitched;
+            chunk_stitched_cond.wakeAll();
+        }
+
+        // Update the caller for progress indication
+        int progress = ( end > 0 ) ? scanner->lineStart()*100 / end : 100;
+        emit indexingProgressed( progress );
+
+        doExtendTail();
+
+        // A short read means the file has been truncated under our feet,
+        // the chunks following this one cannot be trusted.
+        if ( position != qMin( end, beginning + (qint64) ( index + 1 ) * sizeChunk ) )
+            break;
+    }
+
+    {
+        QMutexLocker locker( &mutex );
+        stop = true;
+        chunk_stitched_cond.wakeAll();
+    }
+    for ( auto& thread : workers )
+        thread.join();
+
+    if ( out_of_memory )
+        throw std::bad_alloc();
+
+    // The sequential indexing will carry on from here (the end of the file
+    // or wherever we had to stop)
+    file->seek( position );
+}
+
+// While the tail is shown, the lines appended to the file are added to it
+// as the rest of the file is indexed, so it can be followed.
+void IndexOperation::doExtendTail()
+{
+    qint64 tail_end;
+    LineScanner::OpenLine open_line;
+    if ( ! indexing_data_->getTailEnd( &tail_end, &open_line ) )
+        return;
+
+    QFile file( fileName_ );
+    if ( ! file.open( QIODevice::ReadOnly ) || file.size() <= tail_end )
+        return;
+
+    LineScanner scanner( AbstractLogData::tabStop, open_line );
+    FastLinePositionArray line_positions;
+    LineAttributeList line_attributes;
+    LineExpansionList line_expansions;
+    int max_length = 0;
+
+    file.seek( tail_end );
+    while ( !file.atEnd() ) {
+        if ( *interruptRequest_ )
+            return;
+
+        const qint64 block_beginning = file.pos();
+        const FileChunk block( &file, sizeChunk, true );
+        const bool scanned = block.scan( [&]( const char* data, qint64 length ) {
+                scanner.scanBlock( data, length, block_beginning,
+                        &line_positions, &line_attributes, &line_expansions,
+                        &max_length ); } );
+
+        // Truncated meanwhile, the tail is dropped by the full indexing
+        if ( ! scanned )
+            return;
+    }
+
+    const qint64 new_end = file.pos();
+    if ( new_end > scanner.lineStart() ) {
+        line_positions.append( new_end + 1 );
+        line_positions.setFakeFinalLF();
+    }
+
+    LOG(logDEBUG) << "IndexOperation: " << new_end - tail_end
+        << " bytes appended to the tail";
+
+    indexing_data_->addToTail( new_end - tail_end, max_length, line_positions,
+            line_attributes, line_expansions, scanner.openLine() );
+
+    emit tailExtended();
 }
 
 void IndexOperation::doIndex( IndexingData* indexing_data,
         EncodingSpeculator* encoding_speculator, qint64 initialPosition )
 {
+    // Compressed files can only be read sequentially
+    if ( GzipIndex::isGzipFile( fileName_ ) ) {
+        doIndexCompressed( indexing_data, encoding_speculator, initialPosition );
+        return;
+    }
+
     qint64 pos = initialPosition; // Absolute position of the start of current line
-    qint64 end = 0;               // Absolute position of the end of current line
-    int additional_spaces = 0;    // Additional spaces due to tabs
+
+    // Finds the end of lines and expands the tabs (state is kept between chunks),
+    // the line at pos might have been started by a previous indexing
+    LineScanner scanner( AbstractLogData::tabStop, indexing_data->getOpenLine() );
 
     QFile file( fileName_ );
     if ( file.open( QIODevice::ReadOnly ) ) {
         // Count the number of lines and max length
         // (read big chunks to speed up reading from disk)
         file.seek( pos );
-        while ( !file.atEnd() ) {
-            FastLinePositionArray line_positions;
-            int max_length = 0;
 
-            if ( *interruptRequest_ )   // a bool is always read/written atomically isn't it?
-                break;
+        // Drop what we read from the page cache as we go
+        std::unique_ptr<PageCacheGuard> cache_guard;
+        if ( preservePageCache_ && ! file.isSequential() )
+            cache_guard.reset( new PageCacheGuard( fileName_, pos, file.size() ) );
 
-            // Read a chunk of 5MB
-            const qint64 block_beginning = file.pos();
-            const QByteArray block = file.read( sizeChunk );
-
-            // Count the number of lines in each chunk
-            qint64 pos_within_block = 0;
-            while ( pos_within_block != -1 ) {
-                pos_within_block = qMax( pos - block_beginning, 0LL);
-                // Looking for the next \n, expanding tabs in the process
-                do {
-                    if ( pos_within_block < block.length() ) {
-                        const char c = block.at(pos_within_block);
-                        encoding_speculator->inject_byte( c );
-                        if ( c == '\n' )
-                            break;
-                        else if ( c == '\t' )
-                            additional_spaces += AbstractLogData::tabStop -
-                                ( ( ( block_beginning - pos ) + pos_within_block
-                                    + additional_spaces ) % AbstractLogData::tabStop ) - 1;
-
-                        pos_within_block++;
-                    }
-                    else {
-                        pos_within_block = -1;
-                    }
-                } while ( pos_within_block != -1 );
-
-                // When a end of line has been found...
-                if ( pos_within_block != -1 ) {
-                    end = pos_within_block + block_beginning;
-                    const int length = end-pos + additional_spaces;
-                    if ( length > max_length )
-                        max_length = length;
-                    pos = end + 1;
-                    additional_spaces = 0;
-                    line_positions.append( pos );
-                }
-            }
+        if ( nbThreads_ > 1 ) {
+            doParallelIndex( &file, indexing_data, encoding_speculator, &scanner,
+                    cache_guard.get() );
+            pos = scanner.lineStart();
+        }
+
+        // Lines found in the current chunk
+        FastLinePositionArray line_positions;
+        LineAttributeList line_attributes;
+        LineExpansionList line_expansions;
+        int max_length = 0;
+
+        // Count the number of lines in one chunk (only reads the chunk
+        // and fills the lists above, so it can be guarded)
+        auto scan_block = [&]( const char* data, qint64 length,
+                qint64 block_beginning ) {
+            scanner.scanBlock( data, length, block_beginning,
+                    &line_positions, &line_attributes, &line_expansions,
+                    &max_length );
+            encoding_speculator->inject_block( data, length );
+        };
+
+        auto clear_block = [&]() {
+            line_positions  = FastLinePositionArray();
+            line_attributes = LineAttributeList();
+            line_expansions = LineExpansionList();
+            max_length = 0;
+        };
+
+        // Add the lines found in the chunk to the shared data
+        auto add_block = [&]( qint64 length ) {
+            pos = scanner.lineStart();
 
             // Update the shared data
-            indexing_data->addAll( block.length(), max_length, line_positions,
+            indexing_data->addAll( length, max_length, line_positions,
+                   line_attributes, line_expansions, scanner.openLine(),
                    encoding_speculator->guess() );
+            clear_block();
 
             // Update the caller for progress indication
             int progress = ( file.size() > 0 ) ? pos*100 / file.size() : 100;
             emit indexingProgressed( progress );
+
+            doExtendTail();
+        };
+
+        // Map the file chunk by chunk if we can, the kernel reading the
+        // next chunks into the page cache while we index (see
+        // IndexingSettings::readAheadDepth)
+        bool map_file = ! file.isSequential();
+        bool read_pipelined = false;
+
+        while ( !file.atEnd() ) {
+            if ( *interruptRequest_ )   // a bool is always read/written atomically isn't it?
+                break;
+
+            // If it cannot be mapped, the next chunks are read in buffers
+            // by another thread instead
+            if ( ! map_file && readAheadDepth_ > 0 && ! file.isSequential() ) {
+                read_pipelined = true;
+                break;
+            }
+
+            // Map or read a chunk of 5MB
+            const qint64 block_beginning = file.pos();
+            qint64 block_length;
+            {
+                FileChunk block( &file, sizeChunk, map_file,
+                        static_cast<qint64>( readAheadDepth_ ) * sizeChunk );
+                if ( block.mapFailed() ) {
+                    LOG(logINFO) << "Cannot map " << fileName_.toStdString()
+                        << ", reading it instead";
+                    map_file = false;
+                }
+
+                const LineScanner scanner_before = scanner;
+                const EncodingSpeculator speculator_before = *encoding_speculator;
+                auto scan = [&]( const char* data, qint64 length ) {
+                    scan_block( data, length, block_beginning ); };
+
+                if ( ! block.scan( scan ) ) {
+                    // Start the chunk again from what is left in the file
+                    scanner = scanner_before;
+                    *encoding_speculator = speculator_before;
+                    clear_block();
+
+                    block.readInstead();
+                    block.scan( scan );
+                }
+
+                add_block( block.length() );
+                block_length = block.length();
+            }
+
+            // The pages still mapped would not be dropped
+            if ( cache_guard )
+                cache_guard->release( block_beginning, block_length );
+        }
+
+        if ( read_pipelined ) {
+            // The next chunks are read by another thread while we index
+            PipelinedReader reader( fileName_, file.pos(), sizeChunk,
+                    readAheadDepth_ );
+            PipelinedReader::Chunk chunk;
+            qint64 index_us = 0;
+
+            while ( !*interruptRequest_ && reader.nextChunk( &chunk ) ) {
+                const auto index_start = std::chrono::steady_clock::now();
+                scan_block( chunk.data, chunk.length, chunk.position );
+                add_block( chunk.length );
+                index_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - index_start ).count();
+
+                if ( cache_guard )
+                    cache_guard->release( chunk.position, chunk.length );
+            }
+
+            const PipelinedReader::Timings timings = reader.timings();
+            LOG(logINFO) << "Indexing pipeline: reading " << timings.readUs / 1000
+                << " ms, indexing " << index_us / 1000
+                << " ms, reader waited " << timings.readerWaitUs / 1000
+                << " ms, indexer waited " << timings.consumerWaitUs / 1000 << " ms";
+        }
+
+        if ( cache_guard ) {
+            LOG(logINFO) << "Page cache: "
+                << cache_guard->cachedBeforeBytes() / 1024 << " KiB of "
+                << fileName_.toStdString() << " cached before indexing, "
+                << cache_guard->droppedBytes() / 1024 << " KiB dropped, "
+                << PageCacheGuard::residentBytes( fileName_, initialPosition,
+                        file.size() ) / 1024 << " KiB cached now";
         }
 
         // Check if there is a non LF terminated line at the end of the file
@@ -281,7 +1331,9 @@ void IndexOperation::doIndex( IndexingData* indexing_data,
             line_position.append( file_size + 1 );
             line_position.setFakeFinalLF();
 
-            indexing_data->addAll( 0, 0, line_position, encoding_speculator->guess() );
+            indexing_data->addAll( 0, 0, line_position, LineAttributeList(),
+                LineExpansionList(), scanner.openLine(),
+                encoding_speculator->guess() );
         }
     }
     else {
@@ -293,6 +1345,77 @@ void IndexOperation::doIndex( IndexingData* indexing_data,
     }
 }
 
+// The file is decompressed chunk by chunk, the seek points
+// used to read it later are added to the index as we go.
+void IndexOperation::doIndexCompressed( IndexingData* indexing_data,
+        EncodingSpeculator* encoding_speculator, qint64 initialPosition )
+{
+    // A partial indexing keeps the seek points already found
+    std::shared_ptr<GzipIndex> gzip_index = indexing_data->getGzipIndex();
+    if ( ! gzip_index ) {
+        gzip_index = std::make_shared<GzipIndex>();
+        indexing_data->setGzipIndex( gzip_index );
+    }
+
+    GzipDevice device( fileName_, gzip_index, GzipDevice::Mode::BuildIndex );
+    if ( ! device.open( QIODevice::ReadOnly ) || ! device.seek( initialPosition ) ) {
+        LOG(logWARNING) << "Cannot open file " << fileName_.toStdString();
+
+        emit indexingProgressed( 100 );
+        return;
+    }
+
+    LineScanner scanner( AbstractLogData::tabStop, indexing_data->getOpenLine() );
+    QByteArray block( sizeChunk, '\0' );
+
+    while ( !*interruptRequest_ ) {
+        const qint64 block_beginning = device.pos();
+        const qint64 length = device.read( block.data(), sizeChunk );
+        if ( length <= 0 )
+            break;
+
+        FastLinePositionArray line_positions;
+        LineAttributeList line_attributes;
+        LineExpansionList line_expansions;
+        int max_length = 0;
+
+        scanner.scanBlock( block.constData(), length, block_beginning,
+                &line_positions, &line_attributes, &line_expansions,
+                &max_length );
+
+        encoding_speculator->inject_block( block.constData(), length );
+
+        indexing_data->addAll( length, max_length, line_positions,
+               line_attributes, line_expansions, scanner.openLine(),
+               encoding_speculator->guess() );
+
+        // The uncompressed size is not known until the end
+        const qint64 compressed_size = device.compressedSize();
+        int progress = ( compressed_size > 0 ) ?
+            device.compressedPos()*100 / compressed_size : 100;
+        emit indexingProgressed( progress );
+    }
+
+    LOG(logINFO) << "Decompressed " << device.pos() / 1024 << " KiB of "
+        << fileName_.toStdString() << ", " << gzip_index->size()
+        << " seek points";
+
+    // Check if there is a non LF terminated line at the end of the file
+    const qint64 data_size = device.pos();
+    if ( !*interruptRequest_ && data_size > scanner.lineStart() ) {
+        LOG( logWARNING ) <<
+            "Non LF terminated file, adding a fake end of line";
+
+        FastLinePositionArray line_position;
+        line_position.append( data_size + 1 );
+        line_position.setFakeFinalLF();
+
+        indexing_data->addAll( 0, 0, line_position, LineAttributeList(),
+                LineExpansionList(), scanner.openLine(),
+                encoding_speculator->guess() );
+    }
+}
+
 // Called in the worker thread's context
 bool FullIndexOperation::start()
 {
@@ -306,7 +1429,28 @@ bool FullIndexOperation::start()
     // First empty the index
     indexing_data_->clear();
 
-    doIndex( indexing_data_, encoding_speculator_, 0 );
+    // A compressed file is always decompressed from the beginning, and its
+    // index cannot be sparse (it would have to decompress it again).
+    const bool compressed = GzipIndex::isGzipFile( fileName_ );
+    indexing_data_->setMemoryBudget( fileName_, compressed ? 0 : memory_budget_ );
+
+    // Start from the cached index if we have one, only what has been
+    // appended to the file since it has been saved is then indexed.
+    const bool from_cache = ! compressed && index_cache_.load( fileName_,
+            indexing_data_, encoding_speculator_ );
+    const qint64 initial_position = from_cache ? indexing_data_->getSize() : 0;
+
+    // If the whole file has to be indexed, its end can be shown first
+    if ( ! from_cache && ! compressed && tail_first_lines_ > 0 )
+        doIndexTail( tail_first_lines_ );
+
+    // Everything is indexed now (unless interrupted), the tail is replaced
+    // by LogData, renumbering its lines in the main thread.
+    doIndex( indexing_data_, encoding_speculator_, initial_position );
+
+    if ( ! compressed && ! *interruptRequest_
+            && indexing_data_->getIndexedSize() != initial_position )
+        index_cache_.save( fileName_, *indexing_data_, *encoding_speculator_ );
 
     LOG(logDEBUG) << "FullIndexOperation: ... finished counting."
         "interrupt = " << *interruptRequest_;
@@ -314,12 +1458,103 @@ bool FullIndexOperation::start()
     return ( *interruptRequest_ ? false : true );
 }
 
+bool FullIndexOperation::doIndexTail( int nb_lines )
+{
+    QFile file( fileName_ );
+    if ( ! file.open( QIODevice::ReadOnly ) || file.isSequential()
+            || file.size() < tailFirstMinFileSize )
+        return false;
+
+    const qint64 file_size = file.size();
+
+    // Go backward looking for the beginning of the nb_lines-th line
+    // from the end (the final LF, if any, ends the last line), giving
+    // up after tailMaxSize bytes.
+    const qint64 limit = qMax<qint64>( 0, file_size - tailMaxSize );
+    qint64 tail_start = -1;
+    qint64 block_end = file_size - 1;
+    int nb_eol = 0;
+
+    while ( nb_eol < nb_lines && block_end > limit ) {
+        const qint64 block_beginning = qMax( limit, block_end - 64*1024 );
+        file.seek( block_beginning );
+        const QByteArray block = file.read( block_end - block_beginning );
+        if ( block.size() != block_end - block_beginning )
+            return false;
+
+        for ( int i = block.size() - 1; i >= 0 && nb_eol < nb_lines; --i ) {
+            if ( block[i] == '\n' ) {
+                tail_start = block_beginning + i + 1;
+                ++nb_eol;
+            }
+        }
+
+        block_end = block_beginning;
+    }
+
+    // The file does not have more than nb_lines, or has none we can find
+    if ( tail_start < 0 || ( nb_eol < nb_lines && block_end == 0 ) )
+        return false;
+
+    LOG(logDEBUG) << "FullIndexOperation: indexing the " << nb_eol
+        << " lines from " << tail_start;
+
+    // Encoding is guessed from the tail only, but a BOM at the
+    // beginning of the file is taken into account.
+    EncodingSpeculator speculator = EncodingSpeculator::continuation();
+    file.seek( 0 );
+    const QByteArray bom = file.read( 2 );
+    if ( bom == "\xFF\xFE" || bom == "\xFE\xFF" ) {
+        speculator = EncodingSpeculator();
+        speculator.inject_block( bom.constData(), bom.size() );
+    }
+
+    // Then index the tail as usual
+    LineScanner scanner( AbstractLogData::tabStop, tail_start );
+    FastLinePositionArray line_positions;
+    LineAttributeList line_attributes;
+    LineExpansionList line_expansions;
+    int max_length = 0;
+
+    file.seek( tail_start );
+    while ( !file.atEnd() ) {
+        if ( *interruptRequest_ )
+            return false;
+
+        const qint64 block_beginning = file.pos();
+        const FileChunk block( &file, sizeChunk, true );
+        const bool scanned = block.scan( [&]( const char* data, qint64 length ) {
+                scanner.scanBlock( data, length, block_beginning,
+                        &line_positions, &line_attributes, &line_expansions,
+                        &max_length );
+                speculator.inject_block( data, length ); } );
+
+        // Truncated meanwhile, the full indexing will see what is left
+        if ( ! scanned )
+            return false;
+    }
+
+    const qint64 tail_end = file.pos();
+    if ( tail_end > scanner.lineStart() ) {
+        line_positions.append( tail_end + 1 );
+        line_positions.setFakeFinalLF();
+    }
+
+    indexing_data_->setTail( tail_start, tail_end, max_length,
+            line_positions, line_attributes, line_expansions,
+            scanner.openLine(), speculator.guess() );
+
+    emit tailIndexed();
+
+    return true;
+}
+
 bool PartialIndexOperation::start()
 {
     LOG(logDEBUG) << "PartialIndexOperation::start(), file "
         << fileName_.toStdString();
 
-    qint64 initial_position = indexing_data_->getSize();
+    qint64 initial_position = indexing_data_->getIndexedSize();
 
     LOG(logDEBUG) << "PartialIndexOperation: Starting the count at "
         << initial_position << " ...";
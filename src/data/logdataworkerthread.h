@@ -20,6 +20,10 @@
 #ifndef LOGDATAWORKERTHREAD_H
 #define LOGDATAWORKERTHREAD_H
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include <QObject>
 #include <QThread>
 #include <QMutex>
@@ -28,18 +32,53 @@
 
 #include "loadingstatus.h"
 #include "linepositionarray.h"
+#include "lineattributes.h"
+#include "linescanner.h"
+#include "indexcache.h"
 #include "encodingspeculator.h"
 #include "utils.h"
 
+class GzipIndex;
+
 // This class is a thread-safe set of indexing data.
+// While a file is indexed 'tail-first', the end of the file is indexed
+// first and stored apart (the 'tail'): until the indexing from the
+// beginning of the file is complete and the tail dropped (endTailMode()),
+// the getters only see the lines in the tail, numbered from its start.
+// If a memory budget is set, the end of lines are moved to a sparse
+// storage, reading the file when needed, when the (compressed) index
+// would use more than the budget.
+// For compressed files, the positions are in the uncompressed data and
+// the seek points allowing to read it are kept with the index.
+// The attributes of the lines (LineAttribute) and their expansion (see
+// LineExpansionList) are kept alongside the end of lines, the lines not
+// terminated yet have unknown attributes.
+// The sizes and most of the end of lines are published after each change,
+// so the readers (the GUI) do not wait for the indexing thread adding
+// lines: getSize(), getMaxLength(), getNbLines(), getPosForLine() and
+// getPosForLines() (but for the last block of lines, the tail and the
+// sparse storage), getAttributesForLines() and getExpansionForLine()
+// do not take the mutex.
 class IndexingData
 {
   public:
-    IndexingData() : dataMutex_(), linePosition_(), maxLength_(0),
-        indexedSize_(0), encoding_(EncodingSpeculator::Encoding::ASCII7) { }
-
-    // Get the total indexed size
+    IndexingData() : dataMutex_(), linePosition_(), sparsePosition_(),
+        sparse_(false), fileName_(), memoryBudget_(0), gzipIndex_(), maxLength_(0),
+        indexedSize_(0), encoding_(EncodingSpeculator::Encoding::ASCII7),
+        lineAttributes_(), lineExpansions_(), openLine_{ 0, 0, 0, -1 },
+        tailMode_(false), tailStart_(0), tailEnd_(0), tailOpenLine_{ 0, 0, 0, -1 },
+        tailPosition_(), tailMaxLength_(0),
+        tailEncoding_(EncodingSpeculator::Encoding::ASCII7), tailAttributes_(),
+        tailExpansions_(), published_(), publishedAttributes_(),
+        publishedExpansions_(), publishedSize_(0),
+        publishedMaxLength_(0), publishedNbLines_(0) { }
+
+    // Get the total indexed size (the end of the tail, while only the
+    // tail is visible)
     qint64 getSize() const;
+    // Get the size indexed from the beginning of the file, even while
+    // only the tail is visible
+    qint64 getIndexedSize() const;
 
     // Get the length of the longest line
     int getMaxLength() const;
@@ -48,38 +87,197 @@ class IndexingData
     LineNumber getNbLines() const;
 
     // Get the position (in byte from the beginning of the file)
-    // of the end of the passed line.
+    // of the end of the passed line (decoded from the start of its
+    // block: consecutive lines are read with getPosForLines()).
     qint64 getPosForLine( LineNumber line ) const;
+    // Get the positions of the end of the passed number of lines from
+    // first, in one go.
+    void getPosForLines( LineNumber first, LineNumber number,
+            uint64_t* positions ) const;
+    // Get the line holding the byte at the passed position (the number
+    // of lines if it is past the last one)
+    LineNumber getLineForPos( qint64 pos ) const;
+    // Get the attributes of the passed number of lines from first,
+    // LineAttribute::Unknown for the lines whose attributes are not known.
+    void getAttributesForLines( LineNumber first, LineNumber number,
+            LineAttributes* attributes ) const;
+    // Get the expansion of the passed line, returns false if it is
+    // not known.
+    bool getExpansionForLine( LineNumber line, int32_t* expansion ) const;
+    // Get what is known of the beginning of the line following the last
+    // one, for the indexing carrying on from the indexed size.
+    LineScanner::OpenLine getOpenLine() const;
+
+    // Get the position of the beginning of the first line
+    // (0 unless only the tail is available)
+    qint64 getStartOfFirstLine() const;
 
     // Get the guessed encoding for the content.
     EncodingSpeculator::Encoding getEncodingGuess() const;
 
     // Atomically add to all the existing
     // indexing data.
+    // lineAttributes and lineExpansions are those of the lines
+    // terminated in linePosition (not of a fake final LF), openLine
+    // is the beginning of the line not terminated yet.
     void addAll( qint64 size, int length,
             const FastLinePositionArray& linePosition,
+            const LineAttributeList& lineAttributes,
+            const LineExpansionList& lineExpansions,
+            const LineScanner::OpenLine& openLine,
             EncodingSpeculator::Encoding encoding );
 
     // Completely clear the indexing data.
     void clear();
 
+    // Set the file indexed and the memory the index of its end of lines
+    // should use at most (0 for no limit).
+    void setMemoryBudget( const QString& file_name, qint64 budget );
+    // Returns whether the sparse storage is used
+    bool isSparse() const;
+
+    // Set the name of the file indexed, when it has been renamed
+    void setFileName( const QString& file_name );
+    // Replace our data by the passed ones, now indexing the passed file
+    // (e.g. once rotated), leaving the passed data empty.
+    void takeFrom( IndexingData& other, const QString& file_name );
+
+    // Get the seek points of the file if it is compressed (null otherwise)
+    std::shared_ptr<GzipIndex> getGzipIndex() const;
+    void setGzipIndex( std::shared_ptr<GzipIndex> gzip_index );
+
+    // Make the passed lines, starting at tail_start and indexed up to
+    // tail_end, the only ones visible until endTailMode() is called, the
+    // data added in the meantime are not visible. openLine is the
+    // beginning of the line not terminated yet at tail_end.
+    void setTail( qint64 tail_start, qint64 tail_end, int length,
+            const FastLinePositionArray& linePosition,
+            const LineAttributeList& lineAttributes,
+            const LineExpansionList& lineExpansions,
+            const LineScanner::OpenLine& openLine,
+            EncodingSpeculator::Encoding encoding );
+    // Add to the tail the lines indexed from its end (what has been
+    // appended to the file), like addAll() does to the rest of the data.
+    // Does nothing if the tail has been dropped meanwhile.
+    void addToTail( qint64 size, int length,
+            const FastLinePositionArray& linePosition,
+            const LineAttributeList& lineAttributes,
+            const LineExpansionList& lineExpansions,
+            const LineScanner::OpenLine& openLine );
+    // Get where the tail ends and the line not terminated there,
+    // returns false if not in tail mode.
+    bool getTailEnd( qint64* tail_end, LineScanner::OpenLine* openLine ) const;
+    // Drop the tail, making all the indexed data visible, returns the
+    // number of lines before the tail in them (by how much the lines of
+    // the tail are renumbered), 0 if not in tail mode and -1 if they do
+    // not reach the tail (their indexing has been interrupted).
+    qint64 endTailMode();
+    // Returns whether only the tail is visible
+    bool isTailMode() const;
+
+    // Save all the indexing data to the passed stream
+    void save( QDataStream& out ) const;
+    // Replace the (empty) indexing data by the data read from the
+    // passed stream, returns false if they are not valid.
+    bool load( QDataStream& in );
+
   private:
+    // Interval of the sparse storage when we switch to it, and the
+    // maximum it is coarsened to (the number of lines read for
+    // displaying one)
+    static const uint32_t sparseInitialInterval;
+    static const uint32_t sparseMaxInterval;
+
+    // Move the end of lines to a (sparser) sparse storage if over budget
+    // (must be called with the mutex held)
+    void applyMemoryBudget();
+    // clear() without locking
+    void doClear();
+    // Make the current data visible to the lock-free readers
+    // (must be called with the mutex held, after every change)
+    void publish();
+
     mutable QMutex dataMutex_;
 
     LinePositionArray linePosition_;
+    SparseLinePositionArray sparsePosition_;
+    bool sparse_;
+    QString fileName_;
+    qint64 memoryBudget_;
+
+    std::shared_ptr<GzipIndex> gzipIndex_;
+
     int maxLength_;
     qint64 indexedSize_;
 
     EncodingSpeculator::Encoding encoding_;
+
+    LineAttributeArray lineAttributes_;
+    LineExpansionArray lineExpansions_;
+    LineScanner::OpenLine openLine_;
+
+    // The tail, if tailMode_
+    bool tailMode_;
+    qint64 tailStart_;
+    qint64 tailEnd_;
+    LineScanner::OpenLine tailOpenLine_;
+    LinePositionArray tailPosition_;
+    int tailMaxLength_;
+    EncodingSpeculator::Encoding tailEncoding_;
+    LineAttributeArray tailAttributes_;
+    LineExpansionArray tailExpansions_;
+
+    // What the readers see, null when the end of lines are not in
+    // linePosition_ (tail mode or sparse storage).
+    // Only accessed with std::atomic_load/store.
+    std::shared_ptr<const CompressedLinePositionStorage::Snapshot> published_;
+    // The attributes of the visible lines (null until the first change)
+    // Only accessed with std::atomic_load/store.
+    std::shared_ptr<const LineAttributeArray::Snapshot> publishedAttributes_;
+    std::shared_ptr<const LineExpansionArray::Snapshot> publishedExpansions_;
+    std::atomic<qint64> publishedSize_;
+    std::atomic<int> publishedMaxLength_;
+    std::atomic<LineNumber> publishedNbLines_;
 };
 
+// Tuning of the indexing operations
+struct IndexingSettings {
+    IndexingSettings() : nbThreads( 1 ), readAheadDepth( 0 ),
+        tailFirstLines( 0 ), memoryBudget( 0 ), preservePageCache( false ) {}
+
+    // Number of threads indexing the file
+    // (1 is sequential, 0 means one per core)
+    int nbThreads;
+    // Number of chunks read in advance, while the current one is being
+    // indexed (0 disables the read ahead).
+    // The chunks are mapped rather than copied whenever possible, the
+    // kernel is then asked to read the next ones into the page cache
+    // (posix_fadvise). Only a file that cannot be mapped is read in
+    // buffers by a PipelinedReader.
+    int readAheadDepth;
+    // Number of lines at the end of the file indexed and made available
+    // before the rest of the file when a big file is fully indexed
+    // (0 disables the 'tail-first' indexing)
+    int tailFirstLines;
+    // Memory (in bytes) the index of the end of lines can use before
+    // being made sparse (0 for no limit)
+    qint64 memoryBudget;
+    // Drop the pages read from the page cache once indexed, unless they
+    // were cached before
+    bool preservePageCache;
+};
+
+class QFile;
+class PageCacheGuard;
+
 class IndexOperation : public QObject
 {
   Q_OBJECT
   public:
     IndexOperation( const QString& fileName,
             IndexingData* indexingData, bool* interruptRequest,
-            EncodingSpeculator* encodingSpeculator );
+            EncodingSpeculator* encodingSpeculator,
+            const IndexingSettings& settings );
 
     virtual ~IndexOperation() { }
 
@@ -89,6 +287,10 @@ class IndexOperation : public QObject
 
   signals:
     void indexingProgressed( int );
+    // Sent when the tail of the file is available (tail-first indexing)
+    void tailIndexed();
+    // Sent when lines appended to the file have been added to the tail
+    void tailExtended();
 
   protected:
     static const int sizeChunk;
@@ -97,12 +299,35 @@ class IndexOperation : public QObject
     // Modify the passed linePosition and maxLength
     void doIndex( IndexingData* linePosition, EncodingSpeculator* encodingSpeculator,
             qint64 initialPosition );
+    // Index what has been appended to the file past the end of the tail
+    // (if only the tail is visible), called between the chunks.
+    void doExtendTail();
 
     QString fileName_;
     bool* interruptRequest_;
     IndexingData* indexing_data_;
 
     EncodingSpeculator* encoding_speculator_;
+
+  private:
+    // Index the (gzip) compressed file from the passed position
+    // in its uncompressed data, building its seek points.
+    void doIndexCompressed( IndexingData* indexing_data,
+            EncodingSpeculator* encoding_speculator, qint64 initialPosition );
+    // Index the file from the current position of the passed file
+    // to its current end using nbThreads_ threads.
+    // The scanner is updated as if the data had been scanned sequentially.
+    // The chunks indexed are released to the cache guard, if any.
+    void doParallelIndex( QFile* file, IndexingData* indexing_data,
+            EncodingSpeculator* encoding_speculator, LineScanner* scanner,
+            PageCacheGuard* cache_guard );
+
+    // Number of threads used for indexing (1 is sequential)
+    int nbThreads_;
+    // Number of chunks read ahead by the sequential indexing
+    int readAheadDepth_;
+    // Keep the file out of the page cache
+    bool preservePageCache_;
 };
 
 class FullIndexOperation : public IndexOperation
@@ -110,9 +335,26 @@ class FullIndexOperation : public IndexOperation
   public:
     FullIndexOperation( const QString& fileName,
             IndexingData* indexingData, bool* interruptRequest,
-            EncodingSpeculator* speculator )
-        : IndexOperation( fileName, indexingData, interruptRequest, speculator ) { }
+            EncodingSpeculator* speculator, const IndexingSettings& settings,
+            const IndexCache& indexCache )
+        : IndexOperation( fileName, indexingData, interruptRequest,
+                speculator, settings ), index_cache_( indexCache ),
+        tail_first_lines_( settings.tailFirstLines ),
+        memory_budget_( settings.memoryBudget ) { }
     virtual bool start();
+
+  private:
+    static const qint64 tailFirstMinFileSize;
+    static const qint64 tailMaxSize;
+
+    // Index the last nb_lines of the file and make them available
+    // as the tail of the indexing data.
+    // Returns false if there is no need to (small file).
+    bool doIndexTail( int nb_lines );
+
+    IndexCache index_cache_;
+    int tail_first_lines_;
+    qint64 memory_budget_;
 };
 
 class PartialIndexOperation : public IndexOperation
@@ -120,8 +362,9 @@ class PartialIndexOperation : public IndexOperation
   public:
     PartialIndexOperation( const QString& fileName,
             IndexingData* indexingData, bool* interruptRequest,
-            EncodingSpeculator* speculator )
-        : IndexOperation( fileName, indexingData, interruptRequest, speculator ) { }
+            EncodingSpeculator* speculator, const IndexingSettings& settings )
+        : IndexOperation( fileName, indexingData, interruptRequest,
+                speculator, settings ) { }
     virtual bool start();
 };
 
@@ -130,6 +373,12 @@ class PartialIndexOperation : public IndexOperation
 // per LogData instance.
 // Note everything except the run() function is in the LogData's
 // thread.
+// The indexing requests never block the caller: they are queued as jobs
+// identified by a generation number, and run one after the other by the
+// thread, reporting their completion with indexingFinished.
+// A request made while a job is already waiting is merged with it (a
+// partial indexing is done by any indexing, a full indexing turns the
+// waiting job into a full one).
 class LogDataWorkerThread : public QThread
 {
   Q_OBJECT
@@ -145,12 +394,35 @@ class LogDataWorkerThread : public QThread
     void attachFile( const QString& fileName );
     // Instructs the thread to start a new full indexing of the file, sending
     // signals as it progresses.
-    void indexAll();
+    // Returns the generation of the job that will do it.
+    quint64 indexAll();
     // Instructs the thread to start a partial indexing (starting at
     // the end of the file as indexed).
-    void indexAdditionalLines();
-    // Interrupts the indexing if one is in progress
+    // Returns the generation of the job that will do it.
+    quint64 indexAdditionalLines();
+    // Interrupts the indexing if one is in progress, and cancels the
+    // job waiting for it (reported as interrupted).
     void interrupt();
+    // Set the number of threads used by the following indexing operations,
+    // 1 means sequential indexing, 0 uses as many threads as there are cores.
+    void setIndexingThreads( int nb_threads );
+    // Set the number of chunks read ahead of the one being indexed,
+    // 0 disables the read ahead.
+    void setReadAheadDepth( int depth );
+    // Set the number of lines at the end of the file that are indexed
+    // first when a big file is fully indexed, 0 disables it.
+    void setTailFirstLines( int nb_lines );
+    // Set the memory the index of a file can use, beyond which it is
+    // made sparse, 0 for no limit.
+    void setIndexMemoryBudget( qint64 budget );
+    // Set whether the pages of the file read by the indexing are
+    // dropped from the system's page cache once indexed.
+    void setPreservePageCache( bool preserve );
+    // Set the cache where the full indexing operations look for
+    // an existing index first and save their result.
+    void setIndexCache( const IndexCache& index_cache );
+    // Use the same settings and cache as the passed thread.
+    void copySettings( LogDataWorkerThread& other );
 
     // Returns a copy of the current indexing data
     void getIndexingData( qint64* indexedSize,
@@ -160,26 +432,52 @@ class LogDataWorkerThread : public QThread
     // Sent during the indexing process to signal progress
     // percent being the percentage of completion.
     void indexingProgressed( int percent );
+    // Sent when the end of the file has been indexed, before
+    // the rest of the file (tail-first indexing)
+    void tailIndexed();
+    // Sent when lines appended to the file since have been added to
+    // the end of the file indexed first
+    void tailExtended();
     // Sent when indexing is finished, signals the client
     // to copy the new data back.
-    void indexingFinished( LoadingStatus status );
+    // Sent once per job, whatever the number of requests merged in it.
+    void indexingFinished( LoadingStatus status, quint64 generation );
 
   protected:
     void run();
 
   private:
-    void doIndexAll();
+    // An indexing requested, waiting to be run
+    struct Job {
+        enum class Type { Partial, Full };
+
+        Type type;
+        quint64 generation;
+    };
+
+    // Queue a job of the passed type, or merge it with the waiting one
+    // (called with mutex_ held)
+    quint64 requestJob( Job::Type type );
 
-    // Mutex to protect operationRequested_ and friends
+    // Mutex to protect pendingJob_ and friends
     QMutex mutex_;
     QWaitCondition operationRequestedCond_;
-    QWaitCondition nothingToDoCond_;
     QString fileName_;
 
     // Set when the thread must die
     bool terminate_;
     bool interruptRequested_;
-    IndexOperation* operationRequested_;
+    // The job waiting for the current one to finish (requests are merged,
+    // so there is at most one)
+    std::unique_ptr<Job> pendingJob_;
+    // Jobs cancelled before being run, still to be reported
+    std::vector<quint64> cancelledJobs_;
+    quint64 lastGeneration_;
+
+    // Settings for the next operations
+    IndexingSettings indexingSettings_;
+    // Cache used by the next full indexing operations
+    IndexCache indexCache_;
 
     // Pointer to the owner's indexing data (we modify it)
     IndexingData* indexing_data_;
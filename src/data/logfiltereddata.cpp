@@ -267,6 +267,13 @@ void LogFilteredData::clearMarks()
     maxLengthMarks_ = 0;
 }
 
+void LogFilteredData::shiftMarks( qint64 first_line, qint64 offset )
+{
+    // The lines marked are the same, so is the longest
+    marks_.shift( first_line, offset );
+    filteredItemsCacheDirty_ = true;
+}
+
 void LogFilteredData::setVisibility( Visibility visi )
 {
     visibility_ = visi;
@@ -388,6 +395,38 @@ QStringList LogFilteredData::doGetExpandedLines( qint64 first_line, int number )
     return list;
 }
 
+// Implementation of the virtual function.
+// The lines are prefetched from the source log, the lines close to each
+// other there being read together.
+void LogFilteredData::doPrefetchExpandedLines(
+        const std::vector<LineRange>& ranges ) const
+{
+    // Gap between two lines under which the lines between are read too
+    static const qint64 maxGap = 16;
+
+    const qint64 nb_lines = doGetNbLine();
+    std::vector<LineRange> source_ranges;
+    for ( const LineRange& range : ranges ) {
+        const qint64 end = qMin<qint64>( range.first + range.number, nb_lines );
+        for ( qint64 i = qMax<qint64>( range.first, 0 ); i < end; i++ ) {
+            const qint64 line = findLogDataLine( i );
+
+            if ( ! source_ranges.empty() ) {
+                LineRange& last = source_ranges.back();
+                const qint64 last_end = last.first + last.number;
+                if ( line >= last_end && line < last_end + maxGap ) {
+                    last.number = line - last.first + 1;
+                    continue;
+                }
+            }
+
+            source_ranges.push_back( LineRange { line, 1 } );
+        }
+    }
+
+    sourceLogData_->prefetchExpandedLines( source_ranges );
+}
+
 // Implementation of the virtual function.
 qint64 LogFilteredData::doGetNbLine() const
 {
@@ -427,7 +466,7 @@ int LogFilteredData::doGetMaxLength() const
 int LogFilteredData::doGetLineLength( qint64 lineNum ) const
 {
     qint64 line = findLogDataLine( lineNum );
-    return sourceLogData_->getExpandedLineString( line ).length();
+    return sourceLogData_->getLineLength( line );
 }
 
 void LogFilteredData::doSetDisplayEncoding( Encoding encoding )
@@ -105,6 +105,9 @@ class LogFilteredData : public AbstractLogData {
     void deleteMark( qint64 line );
     // Completely clear the marks list.
     void clearMarks();
+    // Move the marks from the passed line offset lines further, when
+    // the lines of the source have been renumbered.
+    void shiftMarks( qint64 first_line, qint64 offset );
 
     // Changes what the AbstractLogData returns via its getXLines/getNbLines
     // API.
@@ -129,6 +132,7 @@ class LogFilteredData : public AbstractLogData {
     QString doGetExpandedLineString( qint64 line ) const;
     QStringList doGetLines( qint64 first, int number ) const;
     QStringList doGetExpandedLines( qint64 first, int number ) const;
+    void doPrefetchExpandedLines( const std::vector<LineRange>& ranges ) const override;
     qint64 doGetNbLine() const;
     int doGetMaxLength() const;
     int doGetLineLength( qint64 line ) const;
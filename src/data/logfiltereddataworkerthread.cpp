@@ -242,8 +242,8 @@ void SearchOperation::doSearch( SearchData& searchData, qint64 initialLine )
         int j = 0;
         for ( ; j < lines.size(); j++ ) {
             if ( regexp_.match( lines[j] ).hasMatch() ) {
-                // FIXME: increase perf by removing temporary
-                const int length = sourceLogData_->getExpandedLineString(i+j).length();
+                // Known from the index, the line is not read again
+                const int length = sourceLogData_->getLineLength( i+j );
                 if ( length > maxLength )
                     maxLength = length;
                 currentList.push_back( MatchingLine( i+j ) );
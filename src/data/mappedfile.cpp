@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements MappedFile, giving access to the content of a
+// file mapped in memory.
+
+#include "data/mappedfile.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <QFile>
+#include <QMutexLocker>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "data/sigbusguard.h"
+
+#include "log.h"
+
+namespace {
+    // Room left for the file to grow when mapping it, so a file being
+    // appended to is not remapped every time it is read.
+    // (a quarter of its size, up to 64 MiB)
+    const qint64 maxGrowthRoom = 64*1024*1024;
+
+    qint64 growthRoom( qint64 size )
+    {
+        return qMin( size / 4, maxGrowthRoom );
+    }
+}
+
+MappedFile::View::~View()
+{
+#ifdef Q_OS_UNIX
+    munmap( const_cast<char*>( data_ ), size_ );
+    if ( fd_ >= 0 )
+        close( fd_ );
+#endif
+}
+
+qint64 MappedFile::View::read( qint64 position, qint64 length,
+        char* out ) const
+{
+    const char* const content = data_ + position;
+    if ( SigbusGuard::run( [content, length, out]() {
+                memcpy( out, content, length ); } ) )
+        return length;
+
+#ifdef Q_OS_UNIX
+    LOG(logWARNING) << "File truncated while read, reading what is left";
+
+    qint64 nb_read = 0;
+    while ( nb_read < length ) {
+        const ssize_t result = pread( fd_, out + nb_read,
+                length - nb_read, position + nb_read );
+        if ( result < 0 && errno == EINTR )
+            continue;
+        if ( result <= 0 )
+            break;
+
+        nb_read += result;
+    }
+
+    return nb_read;
+#else
+    return 0;
+#endif
+}
+
+MappedFile::MappedFile( const QString& file_name )
+    : fd_( -1 ), remapMutex_(), view_()
+{
+#ifdef Q_OS_UNIX
+    fd_ = open( QFile::encodeName( file_name ).constData(), O_RDONLY );
+
+    struct stat file_stat;
+    if ( fd_ >= 0 && ( fstat( fd_, &file_stat ) != 0
+                || ! S_ISREG( file_stat.st_mode ) ) ) {
+        LOG(logDEBUG) << file_name.toStdString()
+            << " is not a regular file, it will not be mapped";
+        close( fd_ );
+        fd_ = -1;
+    }
+#else
+    Q_UNUSED( file_name );
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef Q_OS_UNIX
+    // The views still used stay mapped
+    if ( fd_ >= 0 )
+        close( fd_ );
+#endif
+}
+
+std::shared_ptr<const MappedFile::View> MappedFile::view( qint64 end ) const
+{
+    if ( fd_ < 0 || end <= 0 )
+        return nullptr;
+
+    std::shared_ptr<const View> current = std::atomic_load( &view_ );
+    if ( ! current || current->size() < end ) {
+        QMutexLocker locker( &remapMutex_ );
+
+        // Another thread might have remapped it
+        current = std::atomic_load( &view_ );
+        if ( ! current || current->size() < end ) {
+            current = map( end );
+            if ( ! current )
+                return nullptr;
+            std::atomic_store( &view_, current );
+        }
+    }
+
+    // The end of the view can be past the end of the file (room to grow
+    // or truncated file), only what is in the file can be read.
+    if ( fileSize() < end )
+        return nullptr;
+
+    return current;
+}
+
+bool MappedFile::isSupported()
+{
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::shared_ptr<const MappedFile::View> MappedFile::map( qint64 end ) const
+{
+#ifdef Q_OS_UNIX
+    const qint64 file_size = fileSize();
+    if ( file_size < end )
+        return nullptr;
+
+    const qint64 length = file_size + growthRoom( file_size );
+    if ( static_cast<quint64>( length ) > SIZE_MAX )
+        return nullptr;
+
+    void* data = mmap( nullptr, length, PROT_READ, MAP_SHARED, fd_, 0 );
+    if ( data == MAP_FAILED ) {
+        LOG(logWARNING) << "Cannot map " << length << " bytes of file";
+        return nullptr;
+    }
+
+    LOG(logDEBUG) << "Mapped " << length << " bytes of file";
+
+    // The view can outlive us
+    return std::shared_ptr<const View>(
+            new View( static_cast<const char*>( data ), length, dup( fd_ ) ) );
+#else
+    Q_UNUSED( end );
+    return nullptr;
+#endif
+}
+
+qint64 MappedFile::fileSize() const
+{
+#ifdef Q_OS_UNIX
+    struct stat file_stat;
+    if ( fstat( fd_, &file_stat ) != 0 )
+        return -1;
+
+    return file_stat.st_size;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <memory>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QString>
+
+// A file mapped in memory (read only), so its content can be read by any
+// number of threads at the same time, without locking and without
+// copying it to a buffer.
+// The content is read through a View, which stays valid as long as the
+// caller keeps it. When asked for a part of the file past the end of
+// the current view (the file has grown), a bigger view is mapped (with
+// some room for the file to grow), the previous one is unmapped once
+// its last reader has released it.
+//
+// A truncated file cannot be read past its end through a mapping (the
+// process would be killed), so the size of the file is checked each
+// time a view is asked for, and no view is returned if the file is
+// now smaller. As the file can still be truncated after this check,
+// the content is copied out of the view with View::read(), which
+// recovers from it (see SigbusGuard) and reads what is left of the file
+// instead.
+//
+// Only implemented on Unix. Elsewhere (and if the file cannot be mapped,
+// e.g. it is not a regular file), no view is ever returned and the
+// caller must read the file as usual.
+class MappedFile
+{
+  public:
+    // The first size() bytes of the file mapped at data(), the end of
+    // the view can be past the end of the file.
+    class View {
+      public:
+        ~View();
+
+        View( const View& ) = delete;
+        View& operator=( const View& ) = delete;
+
+        // The content, not protected from a truncation of the file
+        const char* data() const
+        { return data_; }
+        qint64 size() const
+        { return size_; }
+
+        // Copy the passed part of the view to out, returns the number of
+        // bytes copied (less if the file has been truncated)
+        qint64 read( qint64 position, qint64 length, char* out ) const;
+
+      private:
+        friend class MappedFile;
+        View( const char* data, qint64 size, int fd )
+            : data_( data ), size_( size ), fd_( fd ) {}
+
+        const char* data_;
+        qint64 size_;
+        // Our own descriptor of the file, to read it if truncated
+        int fd_;
+    };
+
+    // Open the passed file, it is only mapped when a view is asked for
+    explicit MappedFile( const QString& file_name );
+    ~MappedFile();
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    // Returns a view of (at least) the first 'end' bytes of the file,
+    // or null if they cannot be mapped.
+    // Can be called from several threads at the same time.
+    std::shared_ptr<const View> view( qint64 end ) const;
+
+    // Returns whether files can be mapped on this platform
+    static bool isSupported();
+
+  private:
+    // Map the file (called with remapMutex_ held)
+    std::shared_ptr<const View> map( qint64 end ) const;
+    // Current size of the file (-1 if unknown)
+    qint64 fileSize() const;
+
+    int fd_;
+    // Protects the mapping of a new view
+    mutable QMutex remapMutex_;
+    // The last view mapped.
+    // Only accessed with std::atomic_load/store.
+    mutable std::shared_ptr<const View> view_;
+};
+
+#endif
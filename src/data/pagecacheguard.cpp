@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements PageCacheGuard, which keeps the indexing from
+// filling the page cache.
+
+#include "data/pagecacheguard.h"
+
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "log.h"
+
+namespace {
+#ifdef Q_OS_LINUX
+    // Pages looked at per call to mincore, limits the address space used
+    // (64 MiB with 4 KiB pages)
+    const qint64 pagesPerWindow = 16*1024;
+
+    // Call 'page_cached( page, cached )' for every page from first_page
+    // (included) to end_page (excluded) of the file.
+    // Returns false if the cache cannot be queried.
+    template <typename Callback>
+    bool for_each_page( int fd, qint64 page_size, qint64 first_page,
+            qint64 end_page, Callback page_cached )
+    {
+        std::vector<unsigned char> residency;
+
+        for ( qint64 window = first_page; window < end_page;
+                window += pagesPerWindow ) {
+            const qint64 nb_pages = qMin( pagesPerWindow, end_page - window );
+            const size_t length = nb_pages * page_size;
+
+            // Mapping the file does not read it, we only need the address
+            void* map = mmap( nullptr, length, PROT_READ, MAP_SHARED,
+                    fd, window * page_size );
+            if ( map == MAP_FAILED )
+                return false;
+
+            residency.resize( nb_pages );
+            const int result = mincore( map, length, residency.data() );
+            munmap( map, length );
+            if ( result != 0 )
+                return false;
+
+            for ( qint64 i = 0; i < nb_pages; ++i )
+                page_cached( window + i, ( residency[i] & 1 ) != 0 );
+        }
+
+        return true;
+    }
+#endif
+}
+
+PageCacheGuard::PageCacheGuard( const QString& file_name,
+        qint64 begin, qint64 end )
+    : fd_( -1 ), pageSize_( 4096 ), firstPage_( 0 ), cachedBefore_(),
+    cachedBeforeBytes_( 0 ), droppedBytes_( 0 )
+{
+#ifdef Q_OS_LINUX
+    pageSize_ = sysconf( _SC_PAGESIZE );
+    fd_ = open( QFile::encodeName( file_name ).constData(), O_RDONLY );
+    if ( fd_ < 0 ) {
+        LOG(logWARNING) << "Cannot open " << file_name.toStdString()
+            << ", the page cache will not be preserved";
+        return;
+    }
+
+    firstPage_ = begin / pageSize_;
+    const qint64 end_page = ( end + pageSize_ - 1 ) / pageSize_;
+    if ( end_page <= firstPage_ )
+        return;
+
+    cachedBefore_.resize( end_page - firstPage_ );
+    qint64 nb_cached = 0;
+    const bool queried = for_each_page( fd_, pageSize_, firstPage_, end_page,
+            [this, &nb_cached]( qint64 page, bool cached ) {
+                cachedBefore_[page - firstPage_] = cached;
+                if ( cached )
+                    ++nb_cached;
+            } );
+
+    if ( ! queried ) {
+        // Then we don't know what to preserve and don't drop anything
+        LOG(logWARNING) << "Cannot query the page cache for "
+            << file_name.toStdString();
+        close( fd_ );
+        fd_ = -1;
+        cachedBefore_.clear();
+        return;
+    }
+
+    cachedBeforeBytes_ = nb_cached * pageSize_;
+#else
+    Q_UNUSED( file_name );
+    Q_UNUSED( begin );
+    Q_UNUSED( end );
+#endif
+}
+
+PageCacheGuard::~PageCacheGuard()
+{
+#ifdef Q_OS_LINUX
+    if ( fd_ >= 0 )
+        close( fd_ );
+#endif
+}
+
+void PageCacheGuard::release( qint64 position, qint64 length )
+{
+#ifdef Q_OS_LINUX
+    if ( fd_ < 0 || length <= 0 )
+        return;
+
+    const qint64 first_page = position / pageSize_;
+    const qint64 end_page   = ( position + length + pageSize_ - 1 ) / pageSize_;
+
+    // Pages beyond the snapshot (appended since) were not cached
+    auto was_cached = [this]( qint64 page ) {
+        const qint64 index = page - firstPage_;
+        return index >= 0 && index < static_cast<qint64>( cachedBefore_.size() )
+            && cachedBefore_[index];
+    };
+
+    // Drop each run of pages that were not cached
+    qint64 page = first_page;
+    while ( page < end_page ) {
+        while ( page < end_page && was_cached( page ) )
+            ++page;
+
+        const qint64 run_start = page;
+        while ( page < end_page && ! was_cached( page ) )
+            ++page;
+
+        if ( page > run_start ) {
+            posix_fadvise( fd_, run_start * pageSize_,
+                    ( page - run_start ) * pageSize_, POSIX_FADV_DONTNEED );
+            droppedBytes_ += ( page - run_start ) * pageSize_;
+        }
+    }
+#else
+    Q_UNUSED( position );
+    Q_UNUSED( length );
+#endif
+}
+
+bool PageCacheGuard::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+qint64 PageCacheGuard::residentBytes( const QString& file_name,
+        qint64 begin, qint64 end )
+{
+#ifdef Q_OS_LINUX
+    const int fd = open( QFile::encodeName( file_name ).constData(), O_RDONLY );
+    if ( fd < 0 )
+        return -1;
+
+    const qint64 page_size = sysconf( _SC_PAGESIZE );
+    qint64 nb_cached = 0;
+    const bool queried = for_each_page( fd, page_size, begin / page_size,
+            ( end + page_size - 1 ) / page_size,
+            [&nb_cached]( qint64, bool cached ) {
+                if ( cached )
+                    ++nb_cached;
+            } );
+    close( fd );
+
+    return queried ? nb_cached * page_size : -1;
+#else
+    Q_UNUSED( file_name );
+    Q_UNUSED( begin );
+    Q_UNUSED( end );
+
+    return -1;
+#endif
+}
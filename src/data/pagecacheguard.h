@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGECACHEGUARD_H
+#define PAGECACHEGUARD_H
+
+#include <atomic>
+#include <vector>
+
+#include <QtGlobal>
+#include <QString>
+
+// The page cache guard keeps the pages of a file read by the indexing
+// out of the system's page cache, so indexing a huge file does not evict
+// what the other processes are using.
+// It remembers which pages of the file were cached when it is created,
+// and when a range of the file has been indexed (released), the pages
+// of this range that were not cached before are dropped from the cache
+// (using posix_fadvise(POSIX_FADV_DONTNEED)), the others are left alone.
+// release() can be called from several threads at the same time.
+//
+// Only implemented on Linux, elsewhere the guard does nothing.
+class PageCacheGuard
+{
+  public:
+    // Take a snapshot of the pages of [begin, end) in the cache
+    PageCacheGuard( const QString& file_name, qint64 begin, qint64 end );
+    ~PageCacheGuard();
+
+    PageCacheGuard( const PageCacheGuard& ) = delete;
+    PageCacheGuard& operator=( const PageCacheGuard& ) = delete;
+
+    // Drop from the cache the pages of this range (rounded to whole pages)
+    // that were not cached when the guard was created.
+    void release( qint64 position, qint64 length );
+
+    // Bytes of [begin, end) that were cached when the guard was created
+    qint64 cachedBeforeBytes() const
+    { return cachedBeforeBytes_; }
+    // Bytes dropped from the cache so far
+    qint64 droppedBytes() const
+    { return droppedBytes_; }
+
+    // Returns whether the guard is implemented on this platform
+    static bool isSupported();
+    // Returns how many bytes of [begin, end) of the file are in the page
+    // cache (-1 if it cannot be known)
+    static qint64 residentBytes( const QString& file_name,
+            qint64 begin, qint64 end );
+
+  private:
+    int fd_;
+    qint64 pageSize_;
+    qint64 firstPage_;
+    // One entry per page from firstPage_
+    std::vector<bool> cachedBefore_;
+    qint64 cachedBeforeBytes_;
+    std::atomic<qint64> droppedBytes_;
+};
+
+#endif
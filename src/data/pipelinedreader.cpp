@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "data/pipelinedreader.h"
+
+#include <chrono>
+
+#include "log.h"
+
+namespace {
+    // Microseconds elapsed since 'start'
+    qint64 elapsed_us( std::chrono::steady_clock::time_point start )
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start ).count();
+    }
+}
+
+PipelinedReader::PipelinedReader( const QString& file_name, qint64 position,
+        qint64 chunk_size, int depth )
+    : file_( file_name ), chunkSize_( chunk_size ), mutex_(),
+    chunkReadCond_(), bufferFreedCond_(), buffers_( qMax( depth, 1 ) + 1 ),
+    nbFilled_( 0 ), consumerIndex_( 0 ), consumerHoldsBuffer_( false ),
+    endOfFile_( false ), stop_( false ), timings_(), reader_()
+{
+    timings_.readUs         = 0;
+    timings_.readerWaitUs   = 0;
+    timings_.consumerWaitUs = 0;
+
+    if ( file_.open( QIODevice::ReadOnly ) && file_.seek( position ) )
+        reader_ = std::thread( &PipelinedReader::read, this );
+    else
+        LOG(logWARNING) << "Cannot open file " << file_name.toStdString();
+}
+
+PipelinedReader::~PipelinedReader()
+{
+    {
+        QMutexLocker locker( &mutex_ );
+        stop_ = true;
+        bufferFreedCond_.wakeAll();
+    }
+
+    if ( reader_.joinable() )
+        reader_.join();
+}
+
+bool PipelinedReader::nextChunk( Chunk* chunk )
+{
+    QMutexLocker locker( &mutex_ );
+
+    // The previous chunk is not needed any more
+    if ( consumerHoldsBuffer_ ) {
+        consumerHoldsBuffer_ = false;
+        consumerIndex_ = ( consumerIndex_ + 1 ) % buffers_.size();
+        --nbFilled_;
+        bufferFreedCond_.wakeAll();
+    }
+
+    const auto wait_start = std::chrono::steady_clock::now();
+    while ( nbFilled_ == 0 && ! endOfFile_ && reader_.joinable() )
+        chunkReadCond_.wait( &mutex_ );
+    timings_.consumerWaitUs += elapsed_us( wait_start );
+
+    if ( nbFilled_ == 0 )
+        return false;
+
+    const Buffer& buffer = buffers_[consumerIndex_];
+    chunk->data     = buffer.data.constData();
+    chunk->length   = buffer.length;
+    chunk->position = buffer.position;
+    consumerHoldsBuffer_ = true;
+
+    return true;
+}
+
+PipelinedReader::Timings PipelinedReader::timings() const
+{
+    QMutexLocker locker( &mutex_ );
+
+    return timings_;
+}
+
+void PipelinedReader::read()
+{
+    int reader_index = 0;
+
+    forever {
+        Buffer* buffer;
+        {
+            QMutexLocker locker( &mutex_ );
+
+            // All the buffers are either ready or being consumed
+            const auto wait_start = std::chrono::steady_clock::now();
+            while ( ! stop_ && nbFilled_ == static_cast<int>( buffers_.size() ) )
+                bufferFreedCond_.wait( &mutex_ );
+            timings_.readerWaitUs += elapsed_us( wait_start );
+
+            if ( stop_ )
+                return;
+
+            buffer = &buffers_[reader_index];
+        }
+
+        // The buffer is ours until it is published, the memory
+        // is allocated the first time only.
+        const auto read_start = std::chrono::steady_clock::now();
+        if ( buffer->data.size() != chunkSize_ )
+            buffer->data.resize( chunkSize_ );
+        buffer->position = file_.pos();
+        buffer->length   = file_.read( buffer->data.data(), chunkSize_ );
+        const qint64 read_us = elapsed_us( read_start );
+
+        QMutexLocker locker( &mutex_ );
+        timings_.readUs += read_us;
+
+        if ( buffer->length <= 0 ) {
+            endOfFile_ = true;
+            chunkReadCond_.wakeAll();
+            return;
+        }
+
+        ++nbFilled_;
+        reader_index = ( reader_index + 1 ) % buffers_.size();
+        chunkReadCond_.wakeAll();
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINEDREADER_H
+#define PIPELINEDREADER_H
+
+#include <thread>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+// The pipelined reader reads a file chunk by chunk in a dedicated thread,
+// keeping a few chunks ready in advance in a ring of buffers, so the disk
+// is kept busy while the consumer processes the current chunk.
+// It also measures the time spent by each side waiting for the other, to
+// tell whether the I/O or the processing is the bottleneck.
+class PipelinedReader
+{
+  public:
+    // A chunk of the file, its data are valid until the next call
+    // to nextChunk() (or the destruction of the reader)
+    struct Chunk {
+        const char* data;
+        qint64 length;
+        // Position of the first byte in the file
+        qint64 position;
+    };
+
+    // Time spent by the two stages of the pipeline (in microseconds)
+    struct Timings {
+        // Reading the file
+        qint64 readUs;
+        // Reader waiting for a free buffer (the consumer is slower)
+        qint64 readerWaitUs;
+        // Consumer waiting for the next chunk (the reader is slower)
+        qint64 consumerWaitUs;
+    };
+
+    // Start reading the file from 'position' in chunks of 'chunk_size',
+    // up to 'depth' chunks are read ahead of the one being consumed.
+    PipelinedReader( const QString& file_name, qint64 position,
+            qint64 chunk_size, int depth );
+    // Stop reading and free the buffers
+    ~PipelinedReader();
+
+    PipelinedReader( const PipelinedReader& ) = delete;
+    PipelinedReader& operator=( const PipelinedReader& ) = delete;
+
+    // Returns whether the file could be opened
+    bool isOpen() const
+    { return reader_.joinable(); }
+
+    // Wait for the next chunk, returns false at the end of the file.
+    // The file is read until there is nothing left to read, including
+    // what is appended while it is being read.
+    bool nextChunk( Chunk* chunk );
+
+    // Time spent so far by each stage
+    Timings timings() const;
+
+  private:
+    struct Buffer {
+        QByteArray data;
+        qint64 length;
+        qint64 position;
+    };
+
+    // Loop of the reading thread
+    void read();
+
+    QFile file_;
+    const qint64 chunkSize_;
+
+    // Ring of depth+1 buffers (the one being consumed and the ones
+    // read ahead), everything below is protected by mutex_
+    mutable QMutex mutex_;
+    QWaitCondition chunkReadCond_;
+    QWaitCondition bufferFreedCond_;
+    std::vector<Buffer> buffers_;
+    // Number of buffers filled by the reader and not consumed yet
+    int nbFilled_;
+    // Next buffer to be consumed
+    int consumerIndex_;
+    // The buffer currently held by the consumer
+    bool consumerHoldsBuffer_;
+    bool endOfFile_;
+    bool stop_;
+    Timings timings_;
+
+    std::thread reader_;
+};
+
+#endif
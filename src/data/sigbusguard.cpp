@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements SigbusGuard, recovering from the reads of a
+// truncated mapped file.
+
+#include "data/sigbusguard.h"
+
+#ifdef Q_OS_UNIX
+#include <csetjmp>
+#include <csignal>
+#endif
+
+#include "log.h"
+
+#ifdef Q_OS_UNIX
+namespace {
+    // Where the thread jumps back to if it raises SIGBUS, null when
+    // it is not running a guarded function.
+    thread_local sigjmp_buf* recoveryPoint = nullptr;
+
+    // The handler installed before ours, for the signals we do not expect
+    struct sigaction previousAction;
+
+    void sigbus_handler( int signal, siginfo_t* info, void* context )
+    {
+        if ( recoveryPoint )
+            siglongjmp( *recoveryPoint, 1 );
+
+        // Not raised by a guarded read
+        if ( previousAction.sa_flags & SA_SIGINFO ) {
+            previousAction.sa_sigaction( signal, info, context );
+        }
+        else if ( previousAction.sa_handler != SIG_DFL
+                && previousAction.sa_handler != SIG_IGN ) {
+            previousAction.sa_handler( signal );
+        }
+        else {
+            // The faulting access is run again on return, this time
+            // with the default action (terminating the process)
+            sigaction( SIGBUS, &previousAction, nullptr );
+        }
+    }
+
+    bool install_handler()
+    {
+        struct sigaction action;
+        action.sa_sigaction = sigbus_handler;
+        action.sa_flags     = SA_SIGINFO;
+        sigemptyset( &action.sa_mask );
+
+        if ( sigaction( SIGBUS, &action, &previousAction ) != 0 ) {
+            LOG(logWARNING) << "Cannot install the SIGBUS handler";
+            return false;
+        }
+
+        return true;
+    }
+}
+#endif
+
+bool SigbusGuard::run( void (*function)( void* ), void* argument )
+{
+#ifdef Q_OS_UNIX
+    // Once for all threads
+    static const bool installed = install_handler();
+    Q_UNUSED( installed );
+
+    // The guards can be nested
+    sigjmp_buf* const outer_point = recoveryPoint;
+    sigjmp_buf recovery_point;
+
+    // The signal mask is saved, so SIGBUS (blocked while it is handled)
+    // is unblocked when jumping back here.
+    if ( sigsetjmp( recovery_point, 1 ) ) {
+        recoveryPoint = outer_point;
+        return false;
+    }
+
+    recoveryPoint = &recovery_point;
+    function( argument );
+    recoveryPoint = outer_point;
+#else
+    function( argument );
+#endif
+
+    return true;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIGBUSGUARD_H
+#define SIGBUSGUARD_H
+
+#include <QtGlobal>
+
+// Reading a file mapped in memory past its end raises SIGBUS, which kills
+// the process. It happens when the file is truncated (e.g. a log rotated
+// with copytruncate) while it is mapped: no check of its size made before
+// the read can rule it out.
+// The reads of a mapping are run through the guard, which turns the
+// signal raised by the thread running them into a failed read the caller
+// can recover from (typically by reading the file with read() instead).
+//
+// The guarded function is interrupted (with siglongjmp) when the signal
+// is raised, so nothing must be left to release when it reads the mapping:
+// no object with a destructor on its stack, no lock held.
+//
+// Only needed on Unix: elsewhere, a mapped file cannot be truncated and
+// the function is simply called.
+class SigbusGuard
+{
+  public:
+    // Call function( argument ), returns false if it has been interrupted
+    // because it read a part of a mapping past the end of the file.
+    static bool run( void (*function)( void* ), void* argument );
+
+    // Same for a function object called without parameter
+    template <typename Function>
+    static bool run( Function function )
+    {
+        return run( []( void* f ) { ( *static_cast<Function*>( f ) )(); },
+                &function );
+    }
+};
+
+#endif
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This file implements SparseLinePositionStorage, the sparse storage
+// for the end of lines of very big files.
+
+#include <cassert>
+#include <cstring>
+#include <QDataStream>
+#include <QFile>
+
+#include "log.h"
+
+#include "data/sparselinestorage.h"
+
+namespace {
+    // Size of the blocks read when looking for end of lines
+    const qint64 readBlockSize = 64*1024;
+}
+
+SparseLinePositionStorage::SparseLinePositionStorage()
+    : file_name_(), interval_( 1 ), nb_lines_( 0 ), checkpoints_(),
+    last_pos_( 0 ), previous_pos_( 0 ), cache_(), file_()
+{
+}
+
+SparseLinePositionStorage::SparseLinePositionStorage(
+        const QString& file_name, uint32_t interval )
+    : file_name_( file_name ), interval_( interval ), nb_lines_( 0 ),
+    checkpoints_(), last_pos_( 0 ), previous_pos_( 0 ), cache_(), file_()
+{
+    assert( interval > 0 );
+}
+
+SparseLinePositionStorage::SparseLinePositionStorage(
+        SparseLinePositionStorage&& orig )
+    : file_name_( std::move( orig.file_name_ ) ), interval_( orig.interval_ ),
+    nb_lines_( orig.nb_lines_ ), checkpoints_( std::move( orig.checkpoints_ ) ),
+    last_pos_( orig.last_pos_ ), previous_pos_( orig.previous_pos_ ),
+    cache_( std::move( orig.cache_ ) ), file_( std::move( orig.file_ ) )
+{
+    orig.nb_lines_ = 0;
+}
+
+SparseLinePositionStorage& SparseLinePositionStorage::operator=(
+        SparseLinePositionStorage&& orig )
+{
+    file_name_    = std::move( orig.file_name_ );
+    interval_     = orig.interval_;
+    nb_lines_     = orig.nb_lines_;
+    checkpoints_  = std::move( orig.checkpoints_ );
+    last_pos_     = orig.last_pos_;
+    previous_pos_ = orig.previous_pos_;
+    cache_        = std::move( orig.cache_ );
+    file_         = std::move( orig.file_ );
+
+    orig.nb_lines_ = 0;
+
+    return *this;
+}
+
+// Out of line for the unique_ptr to the incomplete QFile
+SparseLinePositionStorage::~SparseLinePositionStorage()
+{
+}
+
+void SparseLinePositionStorage::append( uint64_t pos )
+{
+    // Lines must be stored in order
+    assert( ( pos > last_pos_ ) || ( nb_lines_ == 0 ) );
+
+    if ( nb_lines_ % interval_ == 0 )
+        checkpoints_.push_back( pos );
+
+    previous_pos_ = last_pos_;
+    last_pos_     = pos;
+    ++nb_lines_;
+}
+
+uint64_t SparseLinePositionStorage::at( uint32_t index ) const
+{
+    assert( index < nb_lines_ );
+
+    // The last one is not necessarily a real end of line
+    // (a fake final LF), it is always kept.
+    if ( index == nb_lines_ - 1 )
+        return last_pos_;
+
+    const uint32_t checkpoint = index / interval_;
+    const uint32_t index_in_interval = index % interval_;
+
+    if ( index_in_interval == 0 )
+        return checkpoints_[checkpoint];
+
+    return interval_at( checkpoint, index ).positions[index_in_interval - 1];
+}
+
+void SparseLinePositionStorage::append_list(
+        const std::vector<uint64_t>& positions )
+{
+    for ( uint64_t pos : positions )
+        append( pos );
+}
+
+void SparseLinePositionStorage::pop_back()
+{
+    assert( nb_lines_ > 0 );
+
+    --nb_lines_;
+    if ( nb_lines_ % interval_ == 0 )
+        checkpoints_.pop_back();
+
+    // If we try to pop_back() twice, we're dead!
+    last_pos_ = previous_pos_;
+}
+
+void SparseLinePositionStorage::set_file_name( const QString& file_name )
+{
+    file_name_ = file_name;
+    // Opened again on the next read
+    file_.reset();
+}
+
+void SparseLinePositionStorage::coarsen()
+{
+    std::vector<uint64_t> checkpoints;
+    checkpoints.reserve( ( checkpoints_.size() + 1 ) / 2 );
+    for ( size_t i = 0; i < checkpoints_.size(); i += 2 )
+        checkpoints.push_back( checkpoints_[i] );
+
+    checkpoints_ = std::move( checkpoints );
+    interval_ *= 2;
+    cache_.clear();
+}
+
+size_t SparseLinePositionStorage::memory_usage() const
+{
+    size_t usage = checkpoints_.capacity() * sizeof( uint64_t );
+    for ( const Interval& interval : cache_ )
+        usage += interval.positions.capacity() * sizeof( uint64_t );
+
+    return usage;
+}
+
+const SparseLinePositionStorage::Interval&
+SparseLinePositionStorage::interval_at( uint32_t checkpoint, uint32_t index ) const
+{
+    auto it = cache_.begin();
+    while ( it != cache_.end() && it->checkpoint != checkpoint )
+        ++it;
+
+    if ( it == cache_.end() ) {
+        // Evict the least recently used
+        if ( cache_.size() == static_cast<size_t>( cacheSize ) )
+            cache_.pop_back();
+
+        Interval interval;
+        interval.checkpoint = checkpoint;
+        cache_.insert( cache_.begin(), std::move( interval ) );
+    }
+    else if ( it != cache_.begin() ) {
+        Interval interval = std::move( *it );
+        cache_.erase( it );
+        cache_.insert( cache_.begin(), std::move( interval ) );
+    }
+
+    Interval& interval = cache_.front();
+    if ( index - checkpoint * interval_ > interval.positions.size() )
+        read_interval( checkpoint, index, &interval );
+
+    return interval;
+}
+
+void SparseLinePositionStorage::read_interval( uint32_t checkpoint,
+        uint32_t index, Interval* interval ) const
+{
+    const size_t nb_needed = index - checkpoint * interval_;
+
+    // We never need to read past the next checkpoint (or the last line)
+    const uint64_t end = ( checkpoint + 1 < checkpoints_.size() ) ?
+        checkpoints_[checkpoint + 1] : last_pos_;
+
+    // Continue from what has already been read for this interval
+    uint64_t pos = interval->positions.empty() ?
+        checkpoints_[checkpoint] : interval->positions.back();
+
+    if ( ! file_ ) {
+        file_.reset( new QFile( file_name_ ) );
+        if ( ! file_->open( QIODevice::ReadOnly ) )
+            LOG(logERROR) << "Cannot open " << file_name_.toStdString()
+                << " to read its end of lines";
+    }
+
+    if ( file_->isOpen() && file_->seek( pos ) ) {
+        char block[readBlockSize];
+
+        while ( interval->positions.size() < nb_needed && pos < end ) {
+            const qint64 length = file_->read( block,
+                    qMin<qint64>( readBlockSize, end - pos ) );
+            if ( length <= 0 )
+                break;
+
+            const char* current = block;
+            const char* block_end = block + length;
+            while ( interval->positions.size() < nb_needed
+                    && ( current = static_cast<const char*>(
+                            memchr( current, '\n', block_end - current ) ) ) ) {
+                ++current;
+                interval->positions.push_back( pos + ( current - block ) );
+            }
+
+            pos += length;
+        }
+    }
+
+    if ( interval->positions.size() < nb_needed ) {
+        // The file has changed under us, this will be fixed when it is
+        // indexed again.
+        LOG(logERROR) << "Cannot find line " << index << " in "
+            << file_name_.toStdString();
+        interval->positions.resize( nb_needed, end );
+    }
+}
+
+void SparseLinePositionStorage::save( QDataStream& out ) const
+{
+    out << interval_ << nb_lines_ << static_cast<quint64>( last_pos_ )
+        << static_cast<quint64>( previous_pos_ )
+        << static_cast<quint32>( checkpoints_.size() );
+
+    for ( uint64_t pos : checkpoints_ )
+        out << static_cast<quint64>( pos );
+}
+
+bool SparseLinePositionStorage::load( QDataStream& in )
+{
+    assert( nb_lines_ == 0 );
+
+    quint32 interval, nb_lines, nb_checkpoints;
+    quint64 last_pos, previous_pos;
+    in >> interval >> nb_lines >> last_pos >> previous_pos >> nb_checkpoints;
+
+    if ( in.status() != QDataStream::Ok || interval == 0
+            || nb_checkpoints != ( static_cast<quint64>( nb_lines ) + interval - 1 ) / interval )
+        return false;
+
+    std::vector<uint64_t> checkpoints( nb_checkpoints );
+    for ( uint64_t& pos : checkpoints ) {
+        quint64 value;
+        in >> value;
+        pos = value;
+    }
+
+    if ( in.status() != QDataStream::Ok )
+        return false;
+
+    interval_     = interval;
+    nb_lines_     = nb_lines;
+    last_pos_     = last_pos;
+    previous_pos_ = previous_pos;
+    checkpoints_  = std::move( checkpoints );
+    cache_.clear();
+
+    return true;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016 Nicolas Bonnefon and other contributors
+ *
+ * This file is part of glogg.
+ *
+ * glogg is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glogg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glogg.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSELINESTORAGE_H
+#define SPARSELINESTORAGE_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <QString>
+
+class QDataStream;
+class QFile;
+
+// This class is a sparse storage backend for LinePositionArray, used for
+// files whose index would not fit in memory otherwise.
+// It emulates the interface of a vector, but only keeps one end of line
+// out of 'interval' (the 'checkpoints') and the last one, the positions in
+// between are found again by reading the file from the previous checkpoint
+// when needed.
+// The positions found are kept in a small cache, consecutive reads in the
+// same interval (a page of text) only read the file once.
+//
+// The storage must be given the name of the file whose end of lines are
+// stored, and the end of lines must be the '\n' found in the file.
+// Like the other storages, it is not thread-safe.
+class SparseLinePositionStorage
+{
+  public:
+    // Default constructor, keeping all the end of lines in memory
+    // (interval of 1, the file is never read).
+    SparseLinePositionStorage();
+    // Create a storage for the end of lines of the passed file, keeping
+    // one out of 'interval' in memory.
+    SparseLinePositionStorage( const QString& file_name, uint32_t interval );
+    // Copy constructor would be slow, delete!
+    SparseLinePositionStorage( const SparseLinePositionStorage& orig ) = delete;
+
+    // Move constructor
+    SparseLinePositionStorage( SparseLinePositionStorage&& orig );
+    // Move assignement
+    SparseLinePositionStorage& operator=( SparseLinePositionStorage&& orig );
+    // Destructor
+    ~SparseLinePositionStorage();
+
+    // Append the passed end-of-line to the storage
+    void append( uint64_t pos );
+    void push_back( uint64_t pos )
+    { append( pos ); }
+    // Size of the array
+    uint32_t size() const
+    { return nb_lines_; }
+    // Element at index (might read the file)
+    uint64_t at( uint32_t i ) const;
+
+    // Add one list to the other
+    void append_list( const std::vector<uint64_t>& positions );
+
+    // Pop the last element of the storage
+    void pop_back();
+
+    // Change the name of the file (e.g. after it has been renamed)
+    void set_file_name( const QString& file_name );
+
+    // Number of end of lines for each one kept in memory
+    uint32_t interval() const
+    { return interval_; }
+    // Double the interval, halving the memory used.
+    void coarsen();
+
+    // Approximate number of bytes of memory used by the storage
+    size_t memory_usage() const;
+
+    // Write the content of the storage to the passed stream
+    // (the file name is not saved)
+    void save( QDataStream& out ) const;
+    // Replace the content of the (empty) storage by what is read from the
+    // stream, returns false if it is not valid.
+    bool load( QDataStream& in );
+
+  private:
+    // The end of lines between two checkpoints, as read from the file
+    struct Interval {
+        uint32_t checkpoint;
+        std::vector<uint64_t> positions;
+    };
+
+    // Number of intervals kept in the cache
+    static const int cacheSize = 4;
+
+    // Returns the interval following the passed checkpoint, reading
+    // at least up to the line at index, from the cache or the file.
+    const Interval& interval_at( uint32_t checkpoint, uint32_t index ) const;
+    // Read the end of lines following the passed checkpoint in the file,
+    // up to the line at index.
+    void read_interval( uint32_t checkpoint, uint32_t index,
+            Interval* interval ) const;
+
+    QString file_name_;
+    uint32_t interval_;
+
+    // Total number of lines in storage
+    uint32_t nb_lines_;
+    // The position of every interval_-th end of line
+    // (the lines at index 0, interval_, 2*interval_...)
+    std::vector<uint64_t> checkpoints_;
+    // The last end of line (which might not be in the file) and the
+    // one before (for pop_back)
+    uint64_t last_pos_;
+    uint64_t previous_pos_;
+
+    // The intervals recently read, the most recent first
+    mutable std::vector<Interval> cache_;
+    // The file, opened on the first read
+    mutable std::unique_ptr<QFile> file_;
+};
+
+#endif
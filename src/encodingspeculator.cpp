@@ -20,6 +20,59 @@
 #include "encodingspeculator.h"
 
 #include <iostream>
+#include <cstring>
+
+#include <QDataStream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Returns the offset of the first byte of the block with
+    // its high order bit set, or length if there is none.
+    size_t find_non_ascii( const uint8_t* block, size_t length )
+    {
+        size_t i = 0;
+
+#ifdef __SSE2__
+        // 64 bytes at a time, the mask of high order bits is only
+        // examined when one of them is set.
+        for ( ; i + 64 <= length; i += 64 ) {
+            const __m128i* ptr = reinterpret_cast<const __m128i*>( block + i );
+            const __m128i a = _mm_loadu_si128( ptr );
+            const __m128i b = _mm_loadu_si128( ptr + 1 );
+            const __m128i c = _mm_loadu_si128( ptr + 2 );
+            const __m128i d = _mm_loadu_si128( ptr + 3 );
+            if ( _mm_movemask_epi8( _mm_or_si128( _mm_or_si128( a, b ),
+                            _mm_or_si128( c, d ) ) ) )
+                break;
+        }
+
+        for ( ; i + 16 <= length; i += 16 ) {
+            const int mask = _mm_movemask_epi8( _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>( block + i ) ) );
+            if ( mask )
+                return i + __builtin_ctz( mask );
+        }
+#else
+        // 8 bytes at a time in a plain integer
+        for ( ; i + 8 <= length; i += 8 ) {
+            uint64_t word;
+            memcpy( &word, block + i, sizeof( word ) );
+            if ( word & 0x8080808080808080ULL )
+                break;
+        }
+#endif
+
+        for ( ; i < length; ++i ) {
+            if ( block[i] & 0x80 )
+                break;
+        }
+
+        return i;
+    }
+}
 
 void EncodingSpeculator::inject_byte( uint8_t byte )
 {
@@ -112,6 +165,30 @@ void EncodingSpeculator::inject_byte( uint8_t byte )
     }
 }
 
+void EncodingSpeculator::inject_block( const char* block, size_t length )
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>( block );
+    size_t i = 0;
+
+    while ( i < length ) {
+        // Nothing can make us change our mind in these states
+        if ( state_ == State::OtherOrUnknown8Bit
+                || state_ == State::ValidUTF16LE
+                || state_ == State::ValidUTF16BE )
+            return;
+
+        // 7-bit characters leave the state untouched, except at the start
+        const size_t non_ascii = i + find_non_ascii( bytes + i, length - i );
+        if ( non_ascii > i && state_ == State::Start )
+            state_ = State::ASCIIOnly;
+
+        if ( non_ascii < length )
+            inject_byte( bytes[non_ascii] );
+
+        i = non_ascii + 1;
+    }
+}
+
 EncodingSpeculator::Encoding EncodingSpeculator::guess() const
 {
     Encoding guess;
@@ -140,3 +217,66 @@ EncodingSpeculator::Encoding EncodingSpeculator::guess() const
 
     return guess;
 }
+
+EncodingSpeculator EncodingSpeculator::continuation()
+{
+    EncodingSpeculator speculator;
+    speculator.state_ = State::ASCIIOnly;
+
+    return speculator;
+}
+
+void EncodingSpeculator::merge( const EncodingSpeculator& next )
+{
+    if ( next.state_ == State::ASCIIOnly ) {
+        // Nothing but 7-bit characters, the guess is unchanged
+        if ( state_ == State::Start )
+            state_ = State::ASCIIOnly;
+        return;
+    }
+
+    switch ( state_ ) {
+        case State::Start:
+        case State::ASCIIOnly:
+        case State::ValidUTF8:
+            state_              = next.state_;
+            code_point_         = next.code_point_;
+            continuation_left_  = next.continuation_left_;
+            min_value_          = next.min_value_;
+            break;
+        case State::UTF8LeadingByteSeen:
+        case State::UTF16BELeadingBOMByteSeen:
+        case State::UTF16LELeadingBOMByteSeen:
+            state_ = State::OtherOrUnknown8Bit;
+            break;
+        case State::ValidUTF16LE:
+        case State::ValidUTF16BE:
+        case State::OtherOrUnknown8Bit:
+            break;
+    }
+}
+
+void EncodingSpeculator::save( QDataStream& out ) const
+{
+    out << static_cast<quint8>( state_ ) << code_point_
+        << static_cast<qint32>( continuation_left_ ) << min_value_;
+}
+
+bool EncodingSpeculator::load( QDataStream& in )
+{
+    quint8 state;
+    quint32 code_point, min_value;
+    qint32 continuation_left;
+
+    in >> state >> code_point >> continuation_left >> min_value;
+    if ( in.status() != QDataStream::Ok
+            || state > static_cast<quint8>( State::ValidUTF16BE ) )
+        return false;
+
+    state_             = static_cast<State>( state );
+    code_point_        = code_point;
+    continuation_left_ = continuation_left;
+    min_value_         = min_value;
+
+    return true;
+}
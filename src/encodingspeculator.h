@@ -20,8 +20,11 @@
 #ifndef ENCODINGSPECULATOR_H
 #define ENCODINGSPECULATOR_H
 
+#include <cstddef>
 #include <cstdint>
 
+class QDataStream;
+
 // The encoder speculator tries to determine the likely encoding
 // of the stream of bytes which is passed to it.
 
@@ -44,9 +47,31 @@ class EncodingSpeculator {
     // Inject one byte into the speculator
     void inject_byte( uint8_t byte );
 
+    // Inject a block of bytes into the speculator, this gives the same
+    // result as injecting each byte in turn but is much faster as
+    // runs of 7-bit characters are skipped without going through the
+    // state machine.
+    void inject_block( const char* block, size_t length );
+
     // Returns the current guess based on the previously injected bytes
     Encoding guess() const;
 
+    // Returns a speculator for bytes which are not at the beginning
+    // of the stream (no BOM is recognised), it is meant to be merged
+    // afterwards into the speculator of the preceding bytes.
+    static EncodingSpeculator continuation();
+
+    // Merge in the state of a 'continuation' speculator that has been
+    // injected the bytes immediately following ours.
+    // A multi-byte sequence left incomplete here cannot be completed by
+    // the continuation and is considered invalid.
+    void merge( const EncodingSpeculator& next );
+
+    // Save the state of the speculator to the passed stream,
+    // and restore it, returning false if the saved state is invalid.
+    void save( QDataStream& out ) const;
+    bool load( QDataStream& in );
+
   private:
     enum class State {
         Start,
@@ -86,3 +86,12 @@ void Marks::clear()
 {
     marks_.clear();
 }
+
+void Marks::shift( qint64 first_line, qint64 offset )
+{
+    // The order of the list is kept
+    for ( int i = 0; i < marks_.size(); i++ ) {
+        if ( marks_[i].lineNumber() >= first_line )
+            marks_[i] = Mark( marks_[i].lineNumber() + offset );
+    }
+}
@@ -67,6 +67,9 @@ class Marks {
     { return static_cast<unsigned>( marks_.size() ); }
     // Completely clear the marks list.
     void clear();
+    // Move the marks from the passed line offset lines further
+    // (the lines have been renumbered).
+    void shift( qint64 first_line, qint64 offset );
 
     // Iterator
     // Provide a const_iterator for the client to iterate through the marks.
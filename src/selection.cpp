@@ -93,6 +93,23 @@ void Selection::crop( int last_line )
         selectedRange_.startLine = last_line;
 };
 
+void Selection::shift( int first_line, int offset )
+{
+    auto shift_line = [first_line, offset]( int* line ) {
+        if ( *line >= first_line )
+            *line += offset;
+    };
+
+    // No selection is -1, before any line
+    shift_line( &selectedLine_ );
+    shift_line( &selectedPartial_.line );
+    if ( selectedRange_.startLine >= 0 ) {
+        shift_line( &selectedRange_.startLine );
+        shift_line( &selectedRange_.endLine );
+        shift_line( &selectedRange_.firstLine );
+    }
+}
+
 bool Selection::getPortionForLine( int line, int* start_column, int* end_column ) const
 {
     if ( selectedPartial_.line == line ) {
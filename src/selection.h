@@ -74,6 +74,9 @@ class Selection
 
     // Crop selection so that in fit in the range ending with the line passed.
     void crop( int last_line );
+    // Move the selection from the passed line offset lines further
+    // (the lines have been renumbered).
+    void shift( int first_line, int offset );
 
     // Returns whether the selection is empty
     bool isEmpty() const
@@ -27,6 +27,7 @@
 
 #include "viewinterface.h"
 #include "persistentinfo.h"
+#include "configuration.h"
 #include "savedsearches.h"
 #include "sessioninfo.h"
 #include "data/logdata.h"
@@ -195,8 +196,12 @@ ViewInterface* Session::openAlways( const std::string& file_name,
             log_filtered_data,
             view } } );
 
-    // Start loading the file
-    log_data->attachFile( QString( file_name.c_str() ) );
+    // Start loading the file (with its rotated files if asked)
+    if ( Persistent<Configuration>( "settings" )->joinRotatedFiles() )
+        log_data->attachFileSet(
+                LogData::rotatedFileSet( QString( file_name.c_str() ) ) );
+    else
+        log_data->attachFile( QString( file_name.c_str() ) );
 
     return view;
 }
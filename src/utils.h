@@ -27,6 +27,12 @@
 // Line number are unsigned 32 bits for now.
 typedef uint32_t LineNumber;
 
+// A range of consecutive lines
+struct LineRange {
+    qint64 first;
+    int number;
+};
+
 // Use a bisection method to find the given line number
 // in a sorted list.
 // The T type must be a container containing elements that
@@ -19,6 +19,10 @@
 
 #include "viewtools.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
 #include "log.h"
 
 /* ElasticHook */
@@ -89,3 +93,71 @@ void ElasticHook::decreasePosition()
 
     emit lengthChanged();
 }
+
+/* ReadAheadPlanner */
+
+constexpr int ReadAheadPlanner::MAX_PAGES;
+
+std::vector<LineRange> ReadAheadPlanner::update( qint64 first_line,
+        int nb_visible, qint64 nb_lines, std::chrono::steady_clock::time_point now )
+{
+    std::vector<LineRange> ranges;
+    if ( nb_visible <= 0 )
+        return ranges;
+
+    const qint64 page = nb_visible;
+    const qint64 delta = first_line - last_line_;
+    if ( started_ && delta == 0 )
+        return ranges;
+
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(
+            now - last_update_ ).count();
+
+    // Pages read in advance, in the direction of the move (both
+    // directions after a jump)
+    int direction = 0;
+    int nb_pages = 1;
+    if ( ! started_ || std::abs( delta ) > JUMP_PAGES * page ) {
+        velocity_ = 0.0;
+    }
+    else {
+        direction = ( delta > 0 ) ? 1 : -1;
+
+        const double speed = delta * 1000.0 / std::max( elapsed_ms, 1.0 );
+        if ( elapsed_ms > IDLE_MS )
+            velocity_ = 0.0;
+        else if ( velocity_ * delta <= 0 )
+            velocity_ = speed;
+        else
+            velocity_ = ( velocity_ + speed ) / 2;
+
+        const double lookahead = std::abs( velocity_ ) * LOOKAHEAD_MS / 1000;
+        nb_pages = std::max( 1, std::min( MAX_PAGES,
+                    static_cast<int>( std::ceil( lookahead / page ) ) ) );
+    }
+
+    started_     = true;
+    last_line_   = first_line;
+    last_update_ = now;
+
+    auto add_page = [&]( qint64 first ) {
+        const qint64 begin = std::max<qint64>( first, 0 );
+        const qint64 end   = std::min( first + page, nb_lines );
+        if ( end > begin )
+            ranges.push_back( LineRange { begin, static_cast<int>( end - begin ) } );
+    };
+
+    if ( direction == 0 ) {
+        add_page( first_line + page );
+        add_page( first_line - page );
+    }
+    else {
+        for ( int i = 1; i <= nb_pages; ++i )
+            add_page( first_line + direction * i * page );
+    }
+
+    LOG( logDEBUG ) << "ReadAheadPlanner::update: velocity " << velocity_
+        << " lines/s, " << ranges.size() << " pages to read";
+
+    return ranges;
+}
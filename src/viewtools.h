@@ -21,9 +21,12 @@
 #define VIEWTOOLS_H
 
 #include <chrono>
+#include <vector>
 
 #include <QObject>
 
+#include "utils.h"
+
 // This class is a controller for an elastic hook manipulated with
 // the mouse wheel or touchpad.
 // It is used for the "follow" line at the end of the file.
@@ -73,4 +76,38 @@ class ElasticHook : public QObject {
     std::chrono::time_point<std::chrono::steady_clock> last_update_;
 };
 
+// This class guesses the lines a view is about to display from the way
+// it moves (the direction and speed of the scrolling), so they can be
+// read in advance.
+// The further and faster the view scrolls, the more pages ahead are
+// worth reading. After a jump (e.g. a click on the overview), the pages
+// around the new position are.
+class ReadAheadPlanner {
+  public:
+    // The view now shows nb_visible lines from first_line, of the nb_lines
+    // of the log, returns the ranges of lines worth reading in advance,
+    // the most likely to be displayed first.
+    std::vector<LineRange> update( qint64 first_line, int nb_visible,
+            qint64 nb_lines, std::chrono::steady_clock::time_point now );
+
+    // Speed of the scrolling, in lines per second (negative when
+    // scrolling up)
+    double velocity() const { return velocity_; }
+
+  private:
+    // A move after this time (in ms) starts a new scroll
+    static constexpr int IDLE_MS = 500;
+    // A move of more pages than this is a jump
+    static constexpr int JUMP_PAGES = 4;
+    // Scrolling time (in ms) read in advance
+    static constexpr int LOOKAHEAD_MS = 500;
+    // But never more pages than this
+    static constexpr int MAX_PAGES = 8;
+
+    bool started_ = false;
+    qint64 last_line_ = 0;
+    std::chrono::time_point<std::chrono::steady_clock> last_update_;
+    double velocity_ = 0.0;
+};
+
 #endif
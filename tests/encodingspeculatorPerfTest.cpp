@@ -0,0 +1,79 @@
+#include <QSignalSpy>
+
+#include <cstdio>
+#include <string>
+
+#include "log.h"
+#include "test_utils.h"
+
+#include "encodingspeculator.h"
+
+#include "gmock/gmock.h"
+
+using namespace std;
+using namespace testing;
+
+// Same content as the corpus generated by tools/genlogs.sh
+static const int GL_NB_LINES = 4999999;
+static const char* gl_format =
+    "LOGDATA is a part of LogCrawler, we are going to test it thoroughly, this is line %06d\n";
+
+static const size_t CHUNK_SIZE = 5*1024*1024;
+
+class PerfEncodingSpeculator : public testing::Test {
+  public:
+    PerfEncodingSpeculator() {
+        FILELog::setReportingLevel( logERROR );
+
+        if ( corpus_.empty() ) {
+            char newLine[100];
+            corpus_.reserve( GL_NB_LINES * 90 );
+            for ( int i = 0; i < GL_NB_LINES; i++ ) {
+                snprintf( newLine, sizeof( newLine ), gl_format, i );
+                corpus_.append( newLine );
+                // Some UTF-8 here and there
+                if ( i % 1000 == 0 )
+                    corpus_.append( u8"Ceci est une ligne accentuée\n" );
+            }
+        }
+    }
+
+    static EncodingSpeculator::Encoding byteByByte( const string& data ) {
+        EncodingSpeculator speculator;
+        for ( const char c : data )
+            speculator.inject_byte( c );
+
+        return speculator.guess();
+    }
+
+    static EncodingSpeculator::Encoding byBlock( const string& data ) {
+        EncodingSpeculator speculator;
+        for ( size_t block_beginning = 0; block_beginning < data.size();
+                block_beginning += CHUNK_SIZE ) {
+            speculator.inject_block( data.data() + block_beginning,
+                    min( CHUNK_SIZE, data.size() - block_beginning ) );
+        }
+
+        return speculator.guess();
+    }
+
+  protected:
+    static string corpus_;
+};
+
+string PerfEncodingSpeculator::corpus_;
+
+TEST_F( PerfEncodingSpeculator, injectBlock ) {
+    EncodingSpeculator::Encoding byte_guess, block_guess;
+    {
+        TestTimer t( "byte by byte" );
+        byte_guess = byteByByte( corpus_ );
+    }
+    {
+        TestTimer t;
+        block_guess = byBlock( corpus_ );
+    }
+
+    ASSERT_THAT( byte_guess, Eq( EncodingSpeculator::Encoding::UTF8 ) );
+    ASSERT_THAT( block_guess, Eq( byte_guess ) );
+}
@@ -4,6 +4,9 @@
 
 #include "log.h"
 
+#include <cstdlib>
+#include <string>
+
 #include "encodingspeculator.h"
 
 using namespace std;
@@ -210,3 +213,141 @@ TEST_F( EncodingSpeculatorBehaviour, IgnoreNonInitialBOM ) {
 
     ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::ASCII8 ) );
 }
+
+TEST_F( EncodingSpeculatorBehaviour, MergeAsciiContinuationKeepsGuess ) {
+    auto utf8_bytes = utf8encode2bytes( 0x00E9 );
+    speculator.inject_byte( utf8_bytes.first );
+    speculator.inject_byte( utf8_bytes.second );
+
+    EncodingSpeculator continuation = EncodingSpeculator::continuation();
+    continuation.inject_byte( 'a' );
+    speculator.merge( continuation );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::UTF8 ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, MergeUTF8ContinuationIntoAscii ) {
+    speculator.inject_byte( 'a' );
+
+    EncodingSpeculator continuation = EncodingSpeculator::continuation();
+    for ( uint8_t byte: utf8encodeMultiBytes( 0x20AC ) )
+        continuation.inject_byte( byte );
+    speculator.merge( continuation );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::UTF8 ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, ContinuationDoesNotRecogniseBOM ) {
+    speculator.inject_byte( 'a' );
+
+    EncodingSpeculator continuation = EncodingSpeculator::continuation();
+    continuation.inject_byte( 0xFF );
+    continuation.inject_byte( 0xFE );
+    speculator.merge( continuation );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::ASCII8 ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, MergeIntoUTF16KeepsGuess ) {
+    speculator.inject_byte( 0xFF );
+    speculator.inject_byte( 0xFE );
+
+    EncodingSpeculator continuation = EncodingSpeculator::continuation();
+    continuation.inject_byte( 0xC1 );
+    speculator.merge( continuation );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::UTF16LE ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, MergeAfterIncompleteUTF8IsInvalid ) {
+    speculator.inject_byte( 0xCF );
+
+    EncodingSpeculator continuation = EncodingSpeculator::continuation();
+    continuation.inject_byte( 0xCF );
+    continuation.inject_byte( 0x8F );
+    speculator.merge( continuation );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::ASCII8 ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, BlockOfAsciiIsRecognised ) {
+    const string ascii( 1000, 'a' );
+    speculator.inject_block( ascii.data(), ascii.size() );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::ASCII7 ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, BlockWithUTF8AfterLongAsciiRunIsRecognised ) {
+    string block( 999, 'a' );
+    block.append( u8"é" );
+    block.append( 100, 'b' );
+    speculator.inject_block( block.data(), block.size() );
+
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::UTF8 ) );
+}
+
+TEST_F( EncodingSpeculatorBehaviour, UTF8SequenceCanSpanBlocks ) {
+    const string block = string( 63, 'a' ) + u8"€";
+    speculator.inject_block( block.data(), 64 );
+    speculator.inject_block( block.data() + 64, 1 );
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::ASCII8 ) );
+
+    speculator.inject_block( block.data() + 65, block.size() - 65 );
+    ASSERT_THAT( speculator.guess(), Eq( EncodingSpeculator::Encoding::UTF8 ) );
+}
+
+class EncodingSpeculatorBlocks: public testing::TestWithParam<int> {
+  public:
+    string data;
+
+    // Random mix of ASCII runs, valid and invalid UTF-8 sequences
+    // (and possibly a BOM at the beginning)
+    EncodingSpeculatorBlocks() {
+        srand( GetParam() );
+
+        if ( rand() % 4 == 0 )
+            data.append( ( rand() % 2 ) ? "\xFF\xFE" : "\xFE\xFF" );
+
+        for ( int i = 0; i < 500; ++i ) {
+            switch ( rand() % 8 ) {
+                case 0:
+                    data.append( u8"é" );
+                    break;
+                case 1:
+                    data.append( u8"€" );
+                    break;
+                case 2:
+                    data.append( u8"\U0001F600" );
+                    break;
+                case 3:
+                    // Only in some of the files
+                    if ( GetParam() % 3 == 0 )
+                        data.push_back( static_cast<char>( 0x80 + rand() % 128 ) );
+                    break;
+                default:
+                    data.append( rand() % 300, 'a' + rand() % 26 );
+                    break;
+            }
+        }
+    }
+};
+
+TEST_P( EncodingSpeculatorBlocks, GiveTheSameGuessAsBytes ) {
+    EncodingSpeculator byte_speculator;
+    EncodingSpeculator block_speculator;
+
+    size_t begin = 0;
+    while ( begin < data.size() ) {
+        const size_t length = min<size_t>( rand() % 200, data.size() - begin );
+
+        for ( size_t i = begin; i < begin + length; ++i )
+            byte_speculator.inject_byte( data[i] );
+        block_speculator.inject_block( data.data() + begin, length );
+
+        ASSERT_THAT( block_speculator.guess(), Eq( byte_speculator.guess() ) );
+        begin += length;
+    }
+}
+
+INSTANTIATE_TEST_CASE_P( RandomData, EncodingSpeculatorBlocks,
+        Range( 0, 60 ) );
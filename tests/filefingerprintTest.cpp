@@ -0,0 +1,87 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include "data/filefingerprint.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+class FileFingerprintBehaviour: public testing::Test {
+  public:
+    FileFingerprintBehaviour() {
+        for ( int i = 0; i < 20000; ++i )
+            content_.append( QString( "Line %1 of the file\n" ).arg( i ).toLatin1() );
+        write( content_ );
+    }
+
+    void write( const QByteArray& content ) {
+        QFile file( TMPDIR "/filefingerprint.txt" );
+        if ( file.open( QIODevice::WriteOnly ) )
+            file.write( content );
+    }
+
+    // Fingerprint of the whole content, its last line starting at 'last'
+    FileFingerprint fingerprint() {
+        QFile file( TMPDIR "/filefingerprint.txt" );
+        file.open( QIODevice::ReadOnly );
+        return FileFingerprint( &file,
+                content_.lastIndexOf( '\n', content_.size() - 2 ) + 1,
+                content_.size() );
+    }
+
+    bool matches( const FileFingerprint& fingerprint ) {
+        QFile file( TMPDIR "/filefingerprint.txt" );
+        file.open( QIODevice::ReadOnly );
+        return fingerprint.matches( &file );
+    }
+
+    QByteArray content_;
+};
+
+TEST_F( FileFingerprintBehaviour, NullMatchesNothing ) {
+    ASSERT_TRUE( FileFingerprint().isNull() );
+    ASSERT_FALSE( matches( FileFingerprint() ) );
+}
+
+TEST_F( FileFingerprintBehaviour, MatchesTheSameFile ) {
+    const FileFingerprint print = fingerprint();
+
+    ASSERT_FALSE( print.isNull() );
+    ASSERT_THAT( print.size(), Eq( content_.size() ) );
+    ASSERT_TRUE( matches( print ) );
+}
+
+TEST_F( FileFingerprintBehaviour, MatchesAnAppendedFile ) {
+    const FileFingerprint print = fingerprint();
+
+    write( content_ + "Some more\n" );
+    ASSERT_TRUE( matches( print ) );
+}
+
+TEST_F( FileFingerprintBehaviour, DoesNotMatchAChangedFile ) {
+    const FileFingerprint print = fingerprint();
+
+    // At the beginning
+    QByteArray changed = content_;
+    changed[3] = 'x';
+    write( changed );
+    ASSERT_FALSE( matches( print ) );
+
+    // In the last line
+    changed = content_;
+    changed[changed.size() - 3] = 'x';
+    write( changed );
+    ASSERT_FALSE( matches( print ) );
+
+    // Truncated
+    write( content_.left( content_.size() - 1 ) );
+    ASSERT_FALSE( matches( print ) );
+}
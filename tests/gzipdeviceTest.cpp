@@ -0,0 +1,125 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <cstdio>
+#include <string>
+
+#include <QByteArray>
+#include <QFile>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include "data/gzipdevice.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+static const qint64 SPACING = 64*1024;
+
+class GzipDeviceBehaviour: public testing::Test {
+  public:
+    GzipDeviceBehaviour() {
+        char line[100];
+        for ( int i = 0; i < 40000; ++i ) {
+            snprintf( line, sizeof( line ),
+                    "This is line %06d of the compressed file, %d\n",
+                    i, ( i * 7919 ) % 104729 );
+            content_.append( line );
+        }
+
+        writeGzip( TMPDIR "/gzipdevice.gz", { content_ } );
+    }
+
+    // Write each part as a separate gzip member
+    static void writeGzip( const char* file_name, const vector<string>& parts ) {
+        FILE* file = fopen( file_name, "wb" );
+        for ( const string& part : parts ) {
+            gzFile gz = gzdopen( dup( fileno( file ) ), "ab" );
+            gzwrite( gz, part.data(), part.size() );
+            gzclose( gz );
+            fseek( file, 0, SEEK_END );
+        }
+        fclose( file );
+    }
+
+    string readAt( GzipDevice* device, qint64 position, qint64 length ) {
+        device->seek( position );
+        const QByteArray data = device->read( length );
+        return string( data.constData(), data.size() );
+    }
+
+    // Read the whole file sequentially to build the index
+    shared_ptr<GzipIndex> buildIndex( const char* file_name ) {
+        auto index = make_shared<GzipIndex>( SPACING );
+        GzipDevice device( file_name, index, GzipDevice::Mode::BuildIndex );
+        if ( device.open( QIODevice::ReadOnly ) ) {
+            string data;
+            QByteArray block;
+            while ( ! ( block = device.read( 100000 ) ).isEmpty() )
+                data.append( block.constData(), block.size() );
+            read_ = data;
+        }
+        return index;
+    }
+
+    string content_;
+    string read_;
+};
+
+TEST_F( GzipDeviceBehaviour, RecognisesGzipFiles ) {
+    ASSERT_TRUE( GzipIndex::isGzipFile( TMPDIR "/gzipdevice.gz" ) );
+
+    QFile file( TMPDIR "/gzipdevice.txt" );
+    if ( file.open( QIODevice::WriteOnly ) )
+        file.write( QByteArray( "Not compressed\n" ) );
+    file.close();
+
+    ASSERT_FALSE( GzipIndex::isGzipFile( TMPDIR "/gzipdevice.txt" ) );
+}
+
+TEST_F( GzipDeviceBehaviour, BuildsTheIndexWhileReading ) {
+    auto index = buildIndex( TMPDIR "/gzipdevice.gz" );
+
+    ASSERT_THAT( read_.size(), Eq( content_.size() ) );
+    ASSERT_TRUE( read_ == content_ );
+    // Points are at block boundaries, blocks can be bigger than the spacing
+    ASSERT_THAT( index->size(), Gt( 1 ) );
+    ASSERT_THAT( index->compressedSize(), Eq( QFile( TMPDIR "/gzipdevice.gz" ).size() ) );
+}
+
+TEST_F( GzipDeviceBehaviour, ReadsAnywhereUsingTheIndex ) {
+    auto index = buildIndex( TMPDIR "/gzipdevice.gz" );
+
+    GzipDevice device( TMPDIR "/gzipdevice.gz", index );
+    ASSERT_TRUE( device.open( QIODevice::ReadOnly ) );
+
+    // Backward and forward, in and between blocks
+    const qint64 size = content_.size();
+    for ( qint64 position : { size - 100, qint64( 0 ), size / 2, size / 3,
+            SPACING - 10, size / 3 + 50, size - 1 } ) {
+        ASSERT_TRUE( readAt( &device, position, 100 )
+                == content_.substr( position, 100 ) ) << position;
+    }
+}
+
+TEST_F( GzipDeviceBehaviour, ReadsConcatenatedMembers ) {
+    const size_t middle = content_.size() / 2;
+    writeGzip( TMPDIR "/gzipdevice2.gz",
+            { content_.substr( 0, middle ), content_.substr( middle ) } );
+
+    auto index = buildIndex( TMPDIR "/gzipdevice2.gz" );
+    ASSERT_TRUE( read_ == content_ );
+
+    GzipDevice device( TMPDIR "/gzipdevice2.gz", index );
+    ASSERT_TRUE( device.open( QIODevice::ReadOnly ) );
+    ASSERT_TRUE( readAt( &device, middle - 50, 100 )
+            == content_.substr( middle - 50, 100 ) );
+    ASSERT_TRUE( readAt( &device, content_.size() - 200, 200 )
+            == content_.substr( content_.size() - 200 ) );
+}
@@ -0,0 +1,104 @@
+#include <QSignalSpy>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "log.h"
+#include "test_utils.h"
+
+#include "data/logdataworkerthread.h"
+
+#include "gmock/gmock.h"
+
+using namespace std;
+using namespace testing;
+
+static const int NB_CHUNKS = 100;
+static const int LINES_PER_CHUNK = 100000;
+static const uint64_t LINE_LENGTH = 90;
+
+// A reader (the GUI displaying a page) running while the indexing
+// thread adds the lines.
+class PerfIndexingData : public testing::Test {
+  public:
+    PerfIndexingData() {
+        FILELog::setReportingLevel( logERROR );
+    }
+
+    void appendChunks() {
+        for ( int chunk = 0; chunk < NB_CHUNKS; ++chunk ) {
+            FastLinePositionArray line_positions;
+            const uint64_t first_line = static_cast<uint64_t>( chunk ) * LINES_PER_CHUNK;
+            for ( int i = 1; i <= LINES_PER_CHUNK; ++i )
+                line_positions.append( ( first_line + i ) * LINE_LENGTH );
+
+            indexing_data_.addAll( LINES_PER_CHUNK * LINE_LENGTH, LINE_LENGTH - 1,
+                    line_positions, LineAttributeList( LINES_PER_CHUNK ),
+                    LineExpansionList( LINES_PER_CHUNK ),
+                    LineScanner::OpenLine { static_cast<qint64>(
+                        ( first_line + LINES_PER_CHUNK ) * LINE_LENGTH ), 0, 0, -1 },
+                    EncodingSpeculator::Encoding::ASCII7 );
+        }
+    }
+
+    // Read pages of 50 lines until the appender is done, returns the
+    // number of lines read and the longest read of a page.
+    uint64_t readPages( chrono::microseconds* longest_read ) {
+        uint64_t nb_read = 0;
+        uint32_t first_line = 0;
+        *longest_read = chrono::microseconds( 0 );
+
+        while ( ! appendDone_ ) {
+            const LineNumber nb_lines = indexing_data_.getNbLines();
+            if ( nb_lines < 50 )
+                continue;
+
+            // Walk through the file, like when scrolling
+            first_line = ( first_line + 7919 ) % ( nb_lines - 50 );
+
+            const auto start = chrono::steady_clock::now();
+            for ( uint32_t line = first_line; line < first_line + 50; ++line ) {
+                if ( indexing_data_.getPosForLine( line ) != ( line + 1 ) * LINE_LENGTH )
+                    readErrors_++;
+            }
+            *longest_read = max( *longest_read,
+                    chrono::duration_cast<chrono::microseconds>(
+                        chrono::steady_clock::now() - start ) );
+
+            nb_read += 50;
+        }
+
+        return nb_read;
+    }
+
+    IndexingData indexing_data_;
+    atomic<bool> appendDone_ { false };
+    atomic<int> readErrors_ { 0 };
+};
+
+TEST_F( PerfIndexingData, readsWhileAppending ) {
+    chrono::microseconds longest_read;
+    uint64_t nb_read = 0;
+
+    {
+        TestTimer t;
+
+        thread reader( [this, &nb_read, &longest_read]() {
+                nb_read = readPages( &longest_read ); } );
+
+        appendChunks();
+        appendDone_ = true;
+        reader.join();
+    }
+
+    cout << "Read " << nb_read << " lines while appending, longest page read "
+        << longest_read.count() << "us" << endl;
+
+    ASSERT_THAT( readErrors_.load(), Eq( 0 ) );
+    ASSERT_THAT( indexing_data_.getNbLines(),
+            Eq( static_cast<LineNumber>( NB_CHUNKS * LINES_PER_CHUNK ) ) );
+    ASSERT_THAT( indexing_data_.getSize(),
+            Eq( static_cast<qint64>( NB_CHUNKS * LINES_PER_CHUNK * LINE_LENGTH ) ) );
+}
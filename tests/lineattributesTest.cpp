@@ -0,0 +1,153 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QDataStream>
+
+#include "data/lineattributes.h"
+
+using namespace std;
+using namespace testing;
+
+static const int GROUP = LineAttributeArray::LINES_PER_GROUP;
+
+TEST( LineAttributeArrayBehaviour, GivesTheAttributesOfTheGroupOfALine ) {
+    LineAttributeArray array;
+
+    LineAttributeList attributes( 3 * GROUP, 0 );
+    attributes[1] = LineAttribute::Expandable;
+    attributes[2 * GROUP + 5] = LineAttribute::NonAscii;
+    attributes[2 * GROUP + 6] = LineAttribute::CarriageReturn;
+    array.append_list( attributes );
+
+    ASSERT_THAT( array.size(), Eq( 3U * GROUP ) );
+    ASSERT_THAT( array.at( 0 ), Eq( LineAttribute::Expandable ) );
+    ASSERT_THAT( array.at( GROUP - 1 ), Eq( LineAttribute::Expandable ) );
+    ASSERT_THAT( array.at( GROUP ), Eq( 0 ) );
+    ASSERT_THAT( array.at( 2 * GROUP ),
+            Eq( LineAttribute::NonAscii | LineAttribute::CarriageReturn ) );
+    // Past the end
+    ASSERT_THAT( array.at( 3 * GROUP ), Eq( LineAttribute::Unknown ) );
+}
+
+TEST( LineAttributeArrayBehaviour, SnapshotDoesNotChange ) {
+    LineAttributeArray array;
+    // More than a page, ending in the middle of a group
+    array.append_list( LineAttributeList( 100008, 0 ) );
+
+    const auto snapshot = array.snapshot();
+    array.append_list( LineAttributeList( 100000, LineAttribute::NonAscii ) );
+
+    vector<LineAttributes> attributes( 4 );
+    snapshot->get_range( 100006, 4, attributes.data() );
+    ASSERT_THAT( snapshot->size(), Eq( 100008U ) );
+    ASSERT_THAT( attributes, ElementsAre( 0, 0,
+                LineAttribute::Unknown, LineAttribute::Unknown ) );
+
+    array.snapshot()->get_range( 100006, 4, attributes.data() );
+    ASSERT_THAT( attributes, Each( Eq( LineAttribute::NonAscii ) ) );
+}
+
+TEST( LineAttributeArrayBehaviour, CanBeSavedAndLoaded ) {
+    LineAttributeArray array;
+    LineAttributeList attributes;
+    for ( int i = 0; i < 70000; ++i )
+        attributes.push_back( ( i % 1000 == 0 ) ? LineAttribute::Expandable : 0 );
+    array.append_list( attributes );
+
+    QByteArray bytes;
+    {
+        QDataStream out( &bytes, QIODevice::WriteOnly );
+        array.save( out );
+    }
+
+    QDataStream in( bytes );
+    LineAttributeArray loaded;
+    ASSERT_TRUE( loaded.load( in ) );
+
+    ASSERT_THAT( loaded.size(), Eq( array.size() ) );
+    for ( uint32_t i = 0; i < array.size(); ++i )
+        ASSERT_THAT( loaded.at( i ), Eq( array.at( i ) ) );
+}
+
+TEST( LineExpansionArrayBehaviour, GivesTheExpansionOfEachLine ) {
+    LineExpansionArray array;
+    LineExpansionList expansions( 200000, 0 );
+    expansions[1] = 7;
+    expansions[2] = -1;
+    expansions[3] = 253;
+    expansions[4] = 254;
+    expansions[5] = 100000;
+    expansions[150000] = 300;
+    array.append_list( expansions );
+
+    ASSERT_THAT( array.size(), Eq( 200000U ) );
+    for ( uint32_t i = 0; i < array.size(); ++i )
+        ASSERT_THAT( array.at( i ), Eq( expansions[i] ) ) << "line " << i;
+}
+
+TEST( LineExpansionArrayBehaviour, SnapshotDoesNotChange ) {
+    LineExpansionArray array;
+    // More than a page, the second one without expansion yet
+    array.append_list( LineExpansionList( 70000, 1 ) );
+
+    const auto snapshot = array.snapshot();
+    array.append_list( LineExpansionList( 10, 1000 ) );
+    const auto new_snapshot = array.snapshot();
+
+    int32_t expansion;
+    ASSERT_THAT( snapshot->size(), Eq( 70000U ) );
+    ASSERT_TRUE( snapshot->get( 69999, &expansion ) );
+    ASSERT_THAT( expansion, Eq( 1 ) );
+    ASSERT_FALSE( snapshot->get( 70000, &expansion ) );
+
+    ASSERT_TRUE( new_snapshot->get( 70009, &expansion ) );
+    ASSERT_THAT( expansion, Eq( 1000 ) );
+}
+
+TEST( LineExpansionArrayBehaviour, SnapshotKeepsItsLargeExpansions ) {
+    LineExpansionArray array;
+    // A full page and the start of another, both with large expansions
+    array.append_list( LineExpansionList( 65546, 1000 ) );
+
+    const auto snapshot = array.snapshot();
+    array.append_list( LineExpansionList( 10, 2000 ) );
+    const auto new_snapshot = array.snapshot();
+
+    int32_t expansion;
+    ASSERT_TRUE( snapshot->get( 100, &expansion ) );
+    ASSERT_THAT( expansion, Eq( 1000 ) );
+    ASSERT_TRUE( snapshot->get( 65545, &expansion ) );
+    ASSERT_THAT( expansion, Eq( 1000 ) );
+    ASSERT_FALSE( snapshot->get( 65546, &expansion ) );
+
+    ASSERT_TRUE( new_snapshot->get( 100, &expansion ) );
+    ASSERT_THAT( expansion, Eq( 1000 ) );
+    ASSERT_TRUE( new_snapshot->get( 65555, &expansion ) );
+    ASSERT_THAT( expansion, Eq( 2000 ) );
+}
+
+TEST( LineExpansionArrayBehaviour, CanBeSavedAndLoaded ) {
+    LineExpansionArray array;
+    LineExpansionList expansions( 140000, 0 );
+    for ( int i = 0; i < 60000; ++i )
+        expansions[i] = ( i % 100 == 0 ) ? i : -1;
+    array.append_list( expansions );
+
+    QByteArray bytes;
+    {
+        QDataStream out( &bytes, QIODevice::WriteOnly );
+        array.save( out );
+    }
+
+    QDataStream in( bytes );
+    LineExpansionArray loaded;
+    ASSERT_TRUE( loaded.load( in ) );
+
+    ASSERT_THAT( loaded.size(), Eq( array.size() ) );
+    for ( uint32_t i = 0; i < array.size(); ++i )
+        ASSERT_THAT( loaded.at( i ), Eq( expansions[i] ) ) << "line " << i;
+}
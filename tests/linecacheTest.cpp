@@ -0,0 +1,97 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QString>
+
+#include "data/linecache.h"
+
+using namespace std;
+using namespace testing;
+
+// A line using about 1 KiB of the cache
+static QString line( char c )
+{
+    return QString( string( 400, c ).c_str() );
+}
+
+TEST( LineCacheBehaviour, FindsTheInsertedLines ) {
+    LineCache cache( 1024*1024 );
+
+    cache.insert( cache.generation(), 12, line( 'a' ) );
+    cache.insert( cache.generation(), 13, line( 'b' ) );
+
+    QString found;
+    ASSERT_TRUE( cache.find( 12, &found ) );
+    ASSERT_THAT( found, Eq( line( 'a' ) ) );
+    ASSERT_TRUE( cache.find( 13, &found ) );
+    ASSERT_THAT( found, Eq( line( 'b' ) ) );
+    ASSERT_FALSE( cache.find( 14, &found ) );
+
+    const LineCache::Statistics statistics = cache.statistics();
+    ASSERT_THAT( statistics.hits, Eq( 2U ) );
+    ASSERT_THAT( statistics.misses, Eq( 1U ) );
+    ASSERT_THAT( statistics.nbLines, Eq( 2 ) );
+}
+
+TEST( LineCacheBehaviour, DropsTheLeastRecentlyUsedLines ) {
+    // About 4 lines per shard
+    LineCache cache( LineCache::NB_SHARDS * 4 * 1024 );
+
+    // The lines of shard 0
+    for ( qint64 i = 0; i < 4; ++i )
+        cache.insert( cache.generation(), i * LineCache::NB_SHARDS, line( 'a' + i ) );
+
+    QString found;
+    // Line 0 is now the most recently used
+    ASSERT_TRUE( cache.find( 0, &found ) );
+
+    cache.insert( cache.generation(), 4 * LineCache::NB_SHARDS, line( 'e' ) );
+
+    ASSERT_TRUE( cache.find( 0, &found ) );
+    ASSERT_FALSE( cache.find( LineCache::NB_SHARDS, &found ) );
+    ASSERT_TRUE( cache.find( 4 * LineCache::NB_SHARDS, &found ) );
+    ASSERT_THAT( cache.statistics().memoryUsed,
+            Le( LineCache::NB_SHARDS * 4 * 1024 ) );
+}
+
+TEST( LineCacheBehaviour, ReplacesALine ) {
+    LineCache cache( 1024*1024 );
+
+    cache.insert( cache.generation(), 3, line( 'a' ) );
+    cache.insert( cache.generation(), 3, line( 'b' ) );
+
+    QString found;
+    ASSERT_TRUE( cache.find( 3, &found ) );
+    ASSERT_THAT( found, Eq( line( 'b' ) ) );
+    ASSERT_THAT( cache.statistics().nbLines, Eq( 1 ) );
+}
+
+TEST( LineCacheBehaviour, IgnoresTheLinesReadBeforeAClear ) {
+    LineCache cache( 1024*1024 );
+
+    cache.insert( cache.generation(), 1, line( 'a' ) );
+    const quint64 generation = cache.generation();
+    cache.clear();
+    cache.insert( generation, 2, line( 'b' ) );
+
+    QString found;
+    ASSERT_FALSE( cache.find( 1, &found ) );
+    ASSERT_FALSE( cache.find( 2, &found ) );
+    ASSERT_THAT( cache.statistics().nbLines, Eq( 0 ) );
+    ASSERT_THAT( cache.statistics().memoryUsed, Eq( 0 ) );
+}
+
+TEST( LineCacheBehaviour, CanBeDisabled ) {
+    LineCache cache( 1024*1024 );
+    cache.insert( cache.generation(), 1, line( 'a' ) );
+
+    cache.setMemoryBudget( 0 );
+    cache.insert( cache.generation(), 2, line( 'b' ) );
+
+    QString found;
+    ASSERT_FALSE( cache.find( 1, &found ) );
+    ASSERT_FALSE( cache.find( 2, &found ) );
+}
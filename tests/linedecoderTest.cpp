@@ -0,0 +1,89 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QTextCodec>
+
+#include "data/linedecoder.h"
+
+using namespace std;
+using namespace testing;
+
+class LineDecoderBehaviour : public testing::Test {
+  public:
+    LineDecoderBehaviour()
+        : latin1( QTextCodec::codecForName( "iso-8859-1" ) ),
+        utf8( QTextCodec::codecForName( "utf-8" ) ) {}
+
+    // Decode the line and the line with 1 to 20 ASCII characters before,
+    // so it is decoded by both the SIMD and the scalar loops.
+    void expectSameAsCodec( QTextCodec* codec, const QByteArray& line ) {
+        const LineDecoder decoder( codec );
+
+        for ( int prefix = 0; prefix <= 20; ++prefix ) {
+            const QByteArray data = QByteArray( prefix, 'a' ) + line;
+            ASSERT_THAT( decoder.decode( data.constData(), data.size() ),
+                    Eq( codec->toUnicode( data.constData(), data.size() ) ) )
+                << "with prefix " << prefix;
+        }
+    }
+
+    QTextCodec* latin1;
+    QTextCodec* utf8;
+};
+
+TEST_F( LineDecoderBehaviour, ChoosesTheMethodFromTheCodec ) {
+    ASSERT_THAT( LineDecoder( latin1 ).method(), Eq( LineDecoder::Method::Latin1 ) );
+    ASSERT_THAT( LineDecoder( utf8 ).method(), Eq( LineDecoder::Method::Utf8 ) );
+    ASSERT_THAT( LineDecoder( QTextCodec::codecForName( "utf-16le" ) ).method(),
+            Eq( LineDecoder::Method::Codec ) );
+    ASSERT_THAT( LineDecoder( QTextCodec::codecForName( "CP1251" ) ).method(),
+            Eq( LineDecoder::Method::Codec ) );
+}
+
+TEST_F( LineDecoderBehaviour, DecodesLatin1LikeTheCodec ) {
+    QByteArray all_bytes;
+    for ( int byte = 0; byte < 256; ++byte )
+        all_bytes.append( static_cast<char>( byte ) );
+
+    expectSameAsCodec( latin1, all_bytes );
+    expectSameAsCodec( latin1, QByteArray() );
+}
+
+TEST_F( LineDecoderBehaviour, DecodesUtf8LikeTheCodec ) {
+    expectSameAsCodec( utf8, "This is a line with only ASCII characters\tin it" );
+    expectSameAsCodec( utf8, "caf\xc3\xa9, 10\xe2\x82\xac and a smile \xf0\x9f\x98\x80" );
+    expectSameAsCodec( utf8, "\xc2\x80\xdf\xbf\xe0\xa0\x80\xef\xbf\xbd\xf4\x8f\xbf\xbd" );
+    expectSameAsCodec( utf8, "\xef\xbb\xbfStarting with a byte order mark" );
+    expectSameAsCodec( utf8, QByteArray() );
+}
+
+TEST_F( LineDecoderBehaviour, DecodesInvalidUtf8LikeTheCodec ) {
+    // Overlong forms
+    expectSameAsCodec( utf8, "over\xc0\xaflong and \xe0\x80\xaf" );
+    // Surrogate
+    expectSameAsCodec( utf8, "surrogate \xed\xa0\x80" );
+    // Past U+10FFFF
+    expectSameAsCodec( utf8, "too big \xf4\x90\x80\x80" );
+    // Truncated sequences
+    expectSameAsCodec( utf8, "truncated \xe2\x82" );
+    expectSameAsCodec( utf8, "truncated \xe2\x82 in the middle" );
+    // Invalid bytes
+    expectSameAsCodec( utf8, "invalid \xff\xfe and \x80" );
+    // Noncharacter
+    expectSameAsCodec( utf8, "noncharacter \xef\xbf\xbe" );
+}
+
+TEST_F( LineDecoderBehaviour, DecodesAsciiLikeTheCodec ) {
+    const QByteArray line( "A line with only ASCII characters\tin it" );
+    QTextCodec* cp1252 = QTextCodec::codecForName( "CP1252" );
+
+    for ( QTextCodec* codec : { latin1, utf8, cp1252 } ) {
+        const LineDecoder decoder( codec );
+        ASSERT_THAT( decoder.decodeAscii( line.constData(), line.size() ),
+                Eq( codec->toUnicode( line.constData(), line.size() ) ) );
+    }
+}
@@ -0,0 +1,156 @@
+#include <QSignalSpy>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+#include "test_utils.h"
+
+#include "data/linepositionarray.h"
+
+#include "gmock/gmock.h"
+
+using namespace std;
+using namespace testing;
+
+static const uint32_t NB_LINES = 20000000;
+static const uint32_t NB_RANDOM_READS = 1000000;
+
+// Compare the memory used and the lookup speed of the compressed and
+// Elias-Fano storages, for lines of 40 to 200 bytes.
+class PerfLinePositionArray : public testing::Test {
+  public:
+    PerfLinePositionArray() {
+        FILELog::setReportingLevel( logERROR );
+    }
+
+    template <typename Array>
+    void fill( Array* array ) {
+        TestTimer t( "fill" );
+        uint64_t pos = 0;
+        uint32_t random = 1;
+        for ( uint32_t i = 0; i < NB_LINES; ++i ) {
+            random = random * 1103515245 + 12345;
+            pos += 40 + ( random >> 16 ) % 160;
+            array->append( pos );
+        }
+    }
+
+    template <typename Array>
+    uint64_t readSequentially( const Array& array ) {
+        TestTimer t( "sequential reads" );
+        uint64_t sum = 0;
+        for ( uint32_t i = 0; i < NB_LINES; ++i )
+            sum += array[i];
+        return sum;
+    }
+
+    template <typename Array>
+    uint64_t readRandomly( const Array& array ) {
+        TestTimer t( "random reads" );
+        uint64_t sum = 0;
+        uint32_t random = 1;
+        for ( uint32_t i = 0; i < NB_RANDOM_READS; ++i ) {
+            random = random * 1103515245 + 12345;
+            sum += array[random % NB_LINES];
+        }
+        return sum;
+    }
+
+    template <typename Array>
+    void benchmark( const char* name, uint64_t* sequential_sum,
+            uint64_t* random_sum ) {
+        cout << endl << name << endl;
+
+        Array array;
+        fill( &array );
+        cout << "memory used " << array.storage().memory_usage() / 1024
+            << " KiB" << endl;
+
+        *sequential_sum = readSequentially( array );
+        *random_sum     = readRandomly( array );
+    }
+};
+
+TEST_F( PerfLinePositionArray, compressedAndEliasFano ) {
+    uint64_t compressed_sequential, compressed_random;
+    benchmark<LinePositionArray>( "Compressed storage",
+            &compressed_sequential, &compressed_random );
+
+    uint64_t ef_sequential, ef_random;
+    benchmark<EliasFanoLinePositionArray>( "Elias-Fano storage",
+            &ef_sequential, &ef_random );
+
+    ASSERT_THAT( ef_sequential, Eq( compressed_sequential ) );
+    ASSERT_THAT( ef_random, Eq( compressed_random ) );
+}
+
+TEST_F( PerfLinePositionArray, eliasFanoRank ) {
+    EliasFanoLinePositionArray array;
+    fill( &array );
+
+    const uint64_t last_pos = array[NB_LINES - 1];
+    uint32_t random = 1;
+    uint32_t nb_errors = 0;
+    {
+        TestTimer t( "random ranks" );
+        for ( uint32_t i = 0; i < NB_RANDOM_READS; ++i ) {
+            random = random * 1103515245 + 12345;
+            const uint64_t pos = ( static_cast<uint64_t>( random ) * 7 ) % last_pos;
+            const uint32_t line = array.storage().rank( pos );
+            if ( array[line] <= pos || ( line > 0 && array[line - 1] > pos ) )
+                ++nb_errors;
+        }
+    }
+
+    ASSERT_THAT( nb_errors, Eq( 0U ) );
+}
+
+// Each thread reads the whole array sequentially, through at() (which
+// decodes from the start of the block) and by ranges through get_range().
+TEST_F( PerfLinePositionArray, sequentialReadsFromManyThreads ) {
+    LinePositionArray array;
+    fill( &array );
+    const uint64_t expected_sum = readSequentially( array );
+
+    for ( int nb_threads : { 1, 2, 4, 8 } ) {
+        for ( bool use_range : { false, true } ) {
+            vector<uint64_t> sums( nb_threads );
+            vector<thread> readers;
+
+            const auto start = chrono::steady_clock::now();
+            for ( int t = 0; t < nb_threads; ++t ) {
+                readers.emplace_back( [&array, &sums, t, use_range]() {
+                        uint64_t sum = 0;
+                        if ( use_range ) {
+                            uint64_t positions[1024];
+                            for ( uint32_t first = 0; first < NB_LINES; first += 1024 ) {
+                                const uint32_t count = min( 1024U, NB_LINES - first );
+                                array.storage().get_range( first, count, positions );
+                                for ( uint32_t i = 0; i < count; ++i )
+                                    sum += positions[i];
+                            }
+                        }
+                        else {
+                            for ( uint32_t i = 0; i < NB_LINES; ++i )
+                                sum += array.storage().at( i );
+                        }
+                        sums[t] = sum; } );
+            }
+            for ( thread& reader : readers )
+                reader.join();
+            const auto elapsed = chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start );
+
+            cout << nb_threads << " threads, " << ( use_range ? "range" : "at() " )
+                << ": " << static_cast<double>( elapsed.count() ) / NB_LINES
+                << " ns per line" << endl;
+
+            for ( uint64_t sum : sums )
+                ASSERT_THAT( sum, Eq( expected_sum ) );
+        }
+    }
+}
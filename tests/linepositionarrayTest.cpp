@@ -4,8 +4,16 @@
 
 #include "log.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <QFile>
+
 #include "data/linepositionarray.h"
 
+#define TMPDIR "/tmp"
+
 using namespace std;
 using namespace testing;
 
@@ -182,3 +190,590 @@ TEST_F( LinePositionArrayBigConcat, SimpleBigConcat ) {
     ASSERT_THAT( line_array[2], Eq( UINT32_MAX + 10 ) );
     ASSERT_THAT( line_array[3], Eq( UINT32_MAX + 30 ) );
 }
+
+class LinePositionArraySave: public testing::Test {
+  public:
+    LinePositionArray line_array;
+    vector<uint64_t> positions;
+
+    LinePositionArraySave() {
+        // Short and long lines over a few blocks, then lines
+        // beyond 4 GiB, ending in the middle of a block.
+        uint64_t pos = 0;
+        for ( int i = 0; i < 1000; ++i ) {
+            pos += ( i % 10 == 0 ) ? 20000 : ( i % 3 == 0 ) ? 300 : 40;
+            positions.push_back( pos );
+        }
+        pos = (uint64_t) UINT32_MAX + 10LL;
+        for ( int i = 0; i < 600; ++i ) {
+            positions.push_back( pos );
+            pos += ( i % 10 == 0 ) ? 20000 : 40;
+        }
+
+        for ( uint64_t position : positions )
+            line_array.append( position );
+    }
+
+    QByteArray save( const LinePositionArray& array ) {
+        QByteArray bytes;
+        QDataStream out( &bytes, QIODevice::WriteOnly );
+        array.save( out );
+        return bytes;
+    }
+};
+
+TEST_F( LinePositionArraySave, LoadsTheSavedData ) {
+    const QByteArray bytes = save( line_array );
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_TRUE( loaded_array.load( in ) );
+
+    ASSERT_THAT( loaded_array.size(), Eq( positions.size() ) );
+    for ( size_t i = 0; i < positions.size(); ++i )
+        ASSERT_THAT( loaded_array[i], Eq( positions[i] ) );
+}
+
+TEST_F( LinePositionArraySave, CanBeAppendedToAfterLoading ) {
+    line_array.append( positions.back() + 100 );
+    line_array.setFakeFinalLF();
+    const QByteArray bytes = save( line_array );
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_TRUE( loaded_array.load( in ) );
+
+    // Replaces the fake LF
+    uint64_t pos = positions.back() + 50;
+    for ( int i = 0; i < 1000; ++i ) {
+        loaded_array.append( pos );
+        positions.push_back( pos );
+        pos += ( i % 10 == 0 ) ? 20000 : 40;
+    }
+
+    ASSERT_THAT( loaded_array.size(), Eq( positions.size() ) );
+    for ( size_t i = 0; i < positions.size(); ++i )
+        ASSERT_THAT( loaded_array[i], Eq( positions[i] ) );
+}
+
+TEST_F( LinePositionArraySave, RejectsTruncatedData ) {
+    QByteArray bytes = save( line_array );
+    bytes.truncate( bytes.size() / 2 );
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_FALSE( loaded_array.load( in ) );
+    ASSERT_THAT( loaded_array.size(), Eq( 0 ) );
+}
+
+// The saved data start with nb_lines, first_long_line, current_pos
+// and the byte order mark, then the number of block32 and the size
+// of the first one.
+static const int BYTE_ORDER_MARK_OFFSET = 16;
+static const int FIRST_BLOCK_OFFSET = 28;
+
+TEST_F( LinePositionArraySave, RejectsAnotherByteOrder ) {
+    QByteArray bytes = save( line_array );
+    std::reverse( bytes.begin() + BYTE_ORDER_MARK_OFFSET,
+            bytes.begin() + BYTE_ORDER_MARK_OFFSET + 4 );
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_FALSE( loaded_array.load( in ) );
+    ASSERT_THAT( loaded_array.size(), Eq( 0 ) );
+}
+
+TEST_F( LinePositionArraySave, RejectsPositionsOutOfOrder ) {
+    QByteArray bytes = save( line_array );
+    // The first delta (after the initial 32 bits position)
+    bytes[FIRST_BLOCK_OFFSET + 4] = 0;
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_FALSE( loaded_array.load( in ) );
+    ASSERT_THAT( loaded_array.size(), Eq( 0 ) );
+}
+
+TEST_F( LinePositionArraySave, RejectsEntriesPastTheBlock ) {
+    LinePositionArray small_array;
+    small_array.append( 100 );
+    small_array.append( 140 );
+    small_array.append( 180 );
+    QByteArray bytes = save( small_array );
+    // The last delta becomes the beginning of an absolute position
+    bytes[FIRST_BLOCK_OFFSET + 5] = static_cast<char>( 0xFF );
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_FALSE( loaded_array.load( in ) );
+    ASSERT_THAT( loaded_array.size(), Eq( 0 ) );
+}
+
+TEST_F( LinePositionArraySave, RejectsPositionsNotEndingAtTheLastOne ) {
+    LinePositionArray small_array;
+    small_array.append( 100 );
+    small_array.append( 140 );
+    small_array.append( 180 );
+    QByteArray bytes = save( small_array );
+    bytes[FIRST_BLOCK_OFFSET + 5] = 41;
+
+    LinePositionArray loaded_array;
+    QDataStream in( bytes );
+    ASSERT_FALSE( loaded_array.load( in ) );
+    ASSERT_THAT( loaded_array.size(), Eq( 0 ) );
+}
+
+TEST( LinePositionArrayMemory, ReportsTheMemoryUsed ) {
+    LinePositionArray line_array;
+    uint64_t pos = 0;
+    for ( int i = 0; i < 10000; ++i ) {
+        pos += 40;
+        line_array.append( pos );
+    }
+
+    // 1 byte per line plus the beginning of each block
+    const size_t usage = line_array.storage().memory_usage();
+    ASSERT_THAT( usage, Ge( 10000U ) );
+    ASSERT_THAT( usage, Lt( 12000U ) );
+
+    // An absolute position
+    line_array.append( pos + 20000 );
+    ASSERT_THAT( line_array.storage().memory_usage(), Eq( usage + 6 ) );
+
+    // Replaced by a relative one
+    line_array.setFakeFinalLF();
+    line_array.append( pos + 30 );
+    ASSERT_THAT( line_array.storage().memory_usage(), Eq( usage + 1 ) );
+}
+
+TEST( LinePositionArrayArena, ReadsTheBlocksMovedToTheArena ) {
+    LinePositionArray line_array;
+    for ( uint64_t i = 1; i <= 200; ++i )
+        line_array.append( i * 10 );
+
+    // Read in the block being filled, then finish it and start
+    // another one, reusing its buffer
+    ASSERT_THAT( line_array[100], Eq( 1010U ) );
+    for ( uint64_t i = 201; i <= 300; ++i )
+        line_array.append( i * 20 );
+
+    ASSERT_THAT( line_array[101], Eq( 1020U ) );
+    ASSERT_THAT( line_array[280], Eq( 5620U ) );
+
+    // Enough blocks for several arenas
+    for ( uint64_t i = 301; i <= 1000000; ++i )
+        line_array.append( i * 20 );
+    for ( uint32_t i = 300; i < 1000000; i += 997 )
+        ASSERT_THAT( line_array[i], Eq( ( i + 1 ) * 20ULL ) );
+}
+
+TEST( LinePositionArrayConsecutive, ReadsLongLinesPast4GiB ) {
+    // Some long lines, and the second half past 4 GiB
+    LinePositionArray line_array;
+    uint64_t pos = 0;
+    for ( uint64_t i = 1; i <= 1000; ++i ) {
+        pos += ( i % 5 == 0 ) ? 70000 : 40 + i % 13;
+        if ( i == 500 )
+            pos += 5ULL << 30;
+        line_array.append( pos );
+    }
+
+    vector<uint64_t> positions( 1000 );
+    line_array.get_range( 0, 1000, positions.data() );
+    for ( uint32_t i = 0; i < 1000; ++i )
+        ASSERT_THAT( positions[i], Eq( line_array[i] ) ) << i;
+
+    // Across the first long line
+    line_array.get_range( 495, 10, positions.data() );
+    for ( uint32_t i = 0; i < 10; ++i )
+        ASSERT_THAT( positions[i], Eq( line_array[495 + i] ) ) << i;
+}
+
+TEST( LinePositionArrayConsecutive, SeesTheReplacedFakeLF ) {
+    LinePositionArray line_array;
+    for ( uint64_t i = 1; i <= 100; ++i )
+        line_array.append( i * 40 );
+    line_array.append( 4010 );
+    line_array.setFakeFinalLF();
+
+    uint64_t positions[3];
+    line_array.get_range( 99, 2, positions );
+    ASSERT_THAT( positions[0], Eq( 4000U ) );
+    ASSERT_THAT( positions[1], Eq( 4010U ) );
+
+    // A longer last line, then another one after it
+    line_array.append( 30000 );
+    line_array.append( 30010 );
+    line_array.get_range( 99, 3, positions );
+    ASSERT_THAT( positions[0], Eq( 4000U ) );
+    ASSERT_THAT( positions[1], Eq( 30000U ) );
+    ASSERT_THAT( positions[2], Eq( 30010U ) );
+}
+
+TEST( LinePositionArrayConsecutive, CanBeReadByManyThreads ) {
+    LinePositionArray line_array;
+    for ( uint64_t i = 1; i <= 100000; ++i )
+        line_array.append( i * 70 );
+
+    std::atomic<int> errors( 0 );
+    vector<thread> readers;
+    for ( int t = 0; t < 8; ++t ) {
+        readers.emplace_back( [&line_array, &errors, t]() {
+                uint64_t positions[1000];
+                for ( uint32_t first = t * 1000; first < 100000; first += 1000 ) {
+                    line_array.get_range( first, 1000, positions );
+                    for ( uint32_t i = 0; i < 1000; ++i ) {
+                        if ( positions[i] != ( first + i + 1 ) * 70ULL )
+                            ++errors;
+                    }
+                }
+            } );
+    }
+    for ( thread& reader : readers )
+        reader.join();
+
+    ASSERT_THAT( errors.load(), Eq( 0 ) );
+}
+
+class LinePositionArrayRange: public testing::Test {
+  public:
+    LinePositionArray line_array;
+
+    LinePositionArrayRange() {
+        // Mixing one byte, two bytes and absolute deltas
+        uint64_t pos = 0;
+        for ( int i = 0; i < 2000; ++i ) {
+            pos += ( i % 37 == 0 ) ? 20000 : ( i % 11 == 0 ) ? 300 : 42;
+            line_array.append( pos );
+        }
+    }
+
+    void checkRange( uint32_t first, uint32_t count ) {
+        vector<uint64_t> positions( count );
+        line_array.get_range( first, count, positions.data() );
+        for ( uint32_t i = 0; i < count; ++i )
+            ASSERT_THAT( positions[i], Eq( line_array[first + i] ) )
+                << first << "+" << i;
+    }
+};
+
+TEST_F( LinePositionArrayRange, GetsTheWholeArray ) {
+    checkRange( 0, line_array.size() );
+}
+
+TEST_F( LinePositionArrayRange, GetsPartsOfBlocks ) {
+    checkRange( 0, 1 );
+    checkRange( 3, 10 );
+    checkRange( 250, 12 );
+    checkRange( 511, 514 );
+    checkRange( 1999, 1 );
+}
+
+TEST_F( LinePositionArrayRange, GetsTheBigLines ) {
+    uint64_t pos = (uint64_t) UINT32_MAX + 10LL;
+    for ( int i = 0; i < 600; ++i ) {
+        pos += ( i % 50 == 0 ) ? 70000 : 81;
+        line_array.append( pos );
+    }
+
+    checkRange( 1990, 20 );
+    checkRange( 1500, 1100 );
+}
+
+TEST_F( LinePositionArrayRange, GetsTheRangeFromASnapshot ) {
+    auto snapshot = line_array.storage().snapshot();
+
+    vector<uint64_t> positions( snapshot->size() - 100 );
+    snapshot->get_range( 50, positions.size(), positions.data() );
+    for ( uint32_t i = 0; i < positions.size(); ++i )
+        ASSERT_THAT( positions[i], Eq( line_array[50 + i] ) ) << i;
+}
+
+class LinePositionArrayOffset: public LinePositionArrayRange {
+  public:
+    // Check against a linear search around each line
+    template <typename Array>
+    void checkOffsets( const Array& array ) {
+        ASSERT_THAT( array.line_for_offset( 0 ), Eq( 0 ) );
+        for ( int i = 0; i < array.size(); ++i ) {
+            ASSERT_THAT( array.line_for_offset( array[i] - 1 ), Eq( i ) ) << i;
+            ASSERT_THAT( array.line_for_offset( array[i] ), Eq( i + 1 ) ) << i;
+        }
+        ASSERT_THAT( array.line_for_offset( UINT64_MAX ), Eq( array.size() ) );
+    }
+};
+
+TEST_F( LinePositionArrayOffset, FindsTheLineHoldingAnOffset ) {
+    checkOffsets( line_array );
+}
+
+TEST_F( LinePositionArrayOffset, FindsTheBigLines ) {
+    uint64_t pos = (uint64_t) UINT32_MAX + 10LL;
+    for ( int i = 0; i < 600; ++i ) {
+        pos += ( i % 50 == 0 ) ? 70000 : 81;
+        line_array.append( pos );
+    }
+
+    checkOffsets( line_array );
+}
+
+TEST_F( LinePositionArrayOffset, SearchesTheOtherStorages ) {
+    FastLinePositionArray fast_array;
+    for ( int i = 0; i < line_array.size(); ++i )
+        fast_array.append( line_array[i] );
+
+    checkOffsets( fast_array );
+}
+
+class LinePositionArraySnapshot: public testing::Test {
+  public:
+    LinePositionArray line_array;
+
+    void appendLines( int nb_lines, uint64_t first_pos ) {
+        for ( int i = 0; i < nb_lines; ++i )
+            line_array.append( first_pos + i * 45 );
+    }
+
+    void checkSnapshot(
+            const CompressedLinePositionStorage::Snapshot& snapshot ) {
+        for ( uint32_t i = 0; i < snapshot.size(); ++i )
+            ASSERT_THAT( snapshot.at( i ), Eq( line_array[i] ) ) << i;
+    }
+};
+
+TEST_F( LinePositionArraySnapshot, SeesTheFinishedBlocks ) {
+    appendLines( 1000, 45 );
+
+    // The block holding the last line is not visible
+    auto snapshot = line_array.storage().snapshot();
+    ASSERT_THAT( snapshot->size(), Eq( 768U ) );
+    checkSnapshot( *snapshot );
+
+    // Nor is it if it is finished
+    appendLines( 24, 45 * 1001 );
+    ASSERT_THAT( line_array.storage().snapshot()->size(), Eq( 768U ) );
+}
+
+TEST_F( LinePositionArraySnapshot, IsNotChangedByTheStorage ) {
+    appendLines( 1000, 45 );
+    auto snapshot = line_array.storage().snapshot();
+
+    appendLines( 5000, 45 * 1001 );
+    line_array.setFakeFinalLF();
+    line_array.append( 45 * 6001 + 10 );
+
+    ASSERT_THAT( snapshot->size(), Eq( 768U ) );
+    checkSnapshot( *snapshot );
+
+    auto new_snapshot = line_array.storage().snapshot();
+    ASSERT_THAT( new_snapshot->size(), Eq( 5888U ) );
+    checkSnapshot( *new_snapshot );
+}
+
+TEST_F( LinePositionArraySnapshot, OutlivesTheStorage ) {
+    appendLines( 3000, 45 );
+    auto snapshot = line_array.storage().snapshot();
+    const uint64_t line_2000 = line_array[2000];
+
+    line_array = LinePositionArray();
+
+    ASSERT_THAT( snapshot->size(), Eq( 2816U ) );
+    ASSERT_THAT( snapshot->at( 2000 ), Eq( line_2000 ) );
+    ASSERT_THAT( line_array.storage().snapshot()->size(), Eq( 0U ) );
+}
+
+TEST_F( LinePositionArraySnapshot, SeesTheBigLines ) {
+    appendLines( 300, 45 );
+    appendLines( 600, (uint64_t) UINT32_MAX + 10LL );
+
+    // All the 32 bits table and two blocks of the 64 bits one
+    auto snapshot = line_array.storage().snapshot();
+    ASSERT_THAT( snapshot->size(), Eq( 300U + 512U ) );
+    checkSnapshot( *snapshot );
+}
+
+class SparseLinePositionArrayTest: public testing::Test {
+  public:
+    vector<uint64_t> positions;
+
+    SparseLinePositionArrayTest() {
+        QByteArray content;
+        for ( int i = 0; i < 5000; ++i ) {
+            content.append( QByteArray( i % 37, 'a' ) );
+            content.append( '\n' );
+            positions.push_back( content.size() );
+        }
+        // Unterminated final line
+        content.append( "end" );
+
+        QFile file( TMPDIR "/sparselines.txt" );
+        if ( file.open( QIODevice::WriteOnly ) )
+            file.write( content );
+    }
+
+    // Fill the array like the indexing does, with a fake final LF
+    void fill( SparseLinePositionArray* array ) {
+        FastLinePositionArray new_positions;
+        for ( uint64_t pos : positions )
+            new_positions.append( pos );
+        new_positions.append( positions.back() + 4 );
+        new_positions.setFakeFinalLF();
+
+        array->append_list( new_positions );
+    }
+
+    void check( const SparseLinePositionArray& array ) {
+        ASSERT_THAT( array.size(), Eq( positions.size() + 1 ) );
+        for ( size_t i = 0; i < positions.size(); ++i )
+            ASSERT_THAT( array[i], Eq( positions[i] ) );
+        ASSERT_THAT( array[positions.size()], Eq( positions.back() + 4 ) );
+    }
+};
+
+TEST_F( SparseLinePositionArrayTest, FindsTheLinesInTheFile ) {
+    SparseLinePositionArray array( SparseLinePositionStorage(
+                TMPDIR "/sparselines.txt", 64 ) );
+    fill( &array );
+
+    check( array );
+    // Backward too
+    for ( int i = positions.size() - 1; i >= 0; --i )
+        ASSERT_THAT( array[i], Eq( positions[i] ) );
+}
+
+TEST_F( SparseLinePositionArrayTest, UsesLessMemoryWhenCoarsened ) {
+    SparseLinePositionArray array( SparseLinePositionStorage(
+                TMPDIR "/sparselines.txt", 16 ) );
+    fill( &array );
+
+    const size_t usage = array.storage().memory_usage();
+    array.storage().coarsen();
+    ASSERT_THAT( array.storage().interval(), Eq( 32U ) );
+    ASSERT_THAT( array.storage().memory_usage(), Lt( usage ) );
+
+    check( array );
+}
+
+TEST_F( SparseLinePositionArrayTest, ReplacesTheFakeLF ) {
+    SparseLinePositionArray array( SparseLinePositionStorage(
+                TMPDIR "/sparselines.txt", 64 ) );
+    fill( &array );
+
+    positions.push_back( positions.back() + 10 );
+    array.append( positions.back() );
+
+    ASSERT_THAT( array.size(), Eq( positions.size() ) );
+    for ( size_t i = 0; i < positions.size(); ++i )
+        ASSERT_THAT( array[i], Eq( positions[i] ) );
+}
+
+TEST_F( SparseLinePositionArrayTest, CanBeCopiedFromACompressedArray ) {
+    LinePositionArray compressed;
+    for ( uint64_t pos : positions )
+        compressed.append( pos );
+    compressed.append( positions.back() + 4 );
+    compressed.setFakeFinalLF();
+
+    SparseLinePositionArray array( SparseLinePositionStorage(
+                TMPDIR "/sparselines.txt", 64 ) );
+    array.copy_from( compressed );
+
+    check( array );
+}
+
+TEST_F( SparseLinePositionArrayTest, LoadsTheSavedData ) {
+    SparseLinePositionArray array( SparseLinePositionStorage(
+                TMPDIR "/sparselines.txt", 64 ) );
+    fill( &array );
+
+    QByteArray bytes;
+    QDataStream out( &bytes, QIODevice::WriteOnly );
+    array.save( out );
+
+    SparseLinePositionArray loaded_array( SparseLinePositionStorage(
+                TMPDIR "/sparselines.txt", 1 ) );
+    QDataStream in( bytes );
+    ASSERT_TRUE( loaded_array.load( in ) );
+    ASSERT_THAT( loaded_array.storage().interval(), Eq( 64U ) );
+
+    check( loaded_array );
+}
+
+class EliasFanoLinePositionArrayTest: public testing::Test {
+  public:
+    vector<uint64_t> positions;
+    EliasFanoLinePositionArray array;
+
+    EliasFanoLinePositionArrayTest() {
+        // Lines of very different lengths, over several chunks
+        uint64_t pos = 0;
+        for ( uint32_t i = 0; i < 3000; ++i ) {
+            pos += ( i % 97 == 0 ) ? 100000 : 1 + ( i * 7919 ) % 300;
+            positions.push_back( pos );
+            array.append( pos );
+        }
+    }
+
+    void check() {
+        ASSERT_THAT( array.size(), Eq( static_cast<int>( positions.size() ) ) );
+        for ( size_t i = 0; i < positions.size(); ++i )
+            ASSERT_THAT( array[i], Eq( positions[i] ) ) << i;
+    }
+};
+
+TEST_F( EliasFanoLinePositionArrayTest, RemembersAddedLines ) {
+    check();
+}
+
+TEST_F( EliasFanoLinePositionArrayTest, ReplacesTheFakeLFAfterAChunk ) {
+    // The last line of the tail, then the first of a new one
+    while ( positions.size() % EliasFanoLinePositionStorage::CHUNK_SIZE != 0 ) {
+        positions.push_back( positions.back() + 50 );
+        array.append( positions.back() );
+    }
+
+    for ( int i = 0; i < 2; ++i ) {
+        array.append( positions.back() + 4 );
+        array.setFakeFinalLF();
+        positions.push_back( positions.back() + 30 );
+        array.append( positions.back() );
+    }
+
+    check();
+}
+
+TEST_F( EliasFanoLinePositionArrayTest, StoresTheBigLines ) {
+    uint64_t pos = 5ULL * UINT32_MAX;
+    for ( uint32_t i = 0; i < 2000; ++i ) {
+        pos += 1 + ( i * 31 ) % 200;
+        positions.push_back( pos );
+        array.append( pos );
+    }
+
+    check();
+}
+
+TEST_F( EliasFanoLinePositionArrayTest, FindsTheLineOfAPosition ) {
+    const EliasFanoLinePositionStorage& storage = array.storage();
+
+    ASSERT_THAT( storage.rank( 0 ), Eq( 0U ) );
+    for ( size_t i = 0; i < positions.size(); ++i ) {
+        ASSERT_THAT( storage.rank( positions[i] - 1 ), Eq( i ) ) << i;
+        ASSERT_THAT( storage.rank( positions[i] ), Eq( i + 1 ) ) << i;
+    }
+}
+
+TEST( EliasFanoLinePositionArrayMemory, UsesLessThanTheCompressedArray ) {
+    // Lines from 1 to 300 bytes
+    EliasFanoLinePositionArray array;
+    LinePositionArray compressed;
+    uint64_t pos = 0;
+    for ( uint32_t i = 0; i < 200000; ++i ) {
+        pos += 1 + ( i * 7919 ) % 300;
+        array.append( pos );
+        compressed.append( pos );
+    }
+
+    ASSERT_THAT( array.storage().memory_usage(),
+            Lt( compressed.storage().memory_usage() ) );
+}
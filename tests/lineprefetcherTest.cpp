@@ -0,0 +1,103 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "data/lineprefetcher.h"
+
+using namespace std;
+using namespace testing;
+
+class LinePrefetcherBehaviour: public testing::Test {
+  public:
+    LinePrefetcherBehaviour() : blocked( false ), reading( false ) {}
+
+    // Record the reads, blocking while 'blocked'
+    LinePrefetcher::ReadLines recorder() {
+        return [this]( qint64 first_line, int number ) {
+            unique_lock<mutex> lock( mutex_ );
+            reads.push_back( make_pair( first_line, number ) );
+            reading = true;
+            cond_.notify_all();
+            cond_.wait( lock, [this]() { return ! blocked; } );
+            reading = false;
+        };
+    }
+
+    // Wait until the prefetcher has read nb_lines
+    bool waitForLines( const LinePrefetcher& prefetcher, qint64 nb_lines ) {
+        const auto deadline = chrono::steady_clock::now() + chrono::seconds( 10 );
+        while ( prefetcher.nbLinesRead() < nb_lines ) {
+            if ( chrono::steady_clock::now() > deadline )
+                return false;
+            this_thread::sleep_for( chrono::milliseconds( 1 ) );
+        }
+        return true;
+    }
+
+    void waitUntilReading() {
+        unique_lock<mutex> lock( mutex_ );
+        cond_.wait( lock, [this]() { return reading; } );
+    }
+
+    void unblock() {
+        lock_guard<mutex> lock( mutex_ );
+        blocked = false;
+        cond_.notify_all();
+    }
+
+    vector<pair<qint64, int>> reads;
+    bool blocked;
+    bool reading;
+
+  private:
+    mutex mutex_;
+    condition_variable cond_;
+};
+
+TEST_F( LinePrefetcherBehaviour, ReadsTheRangesInOrder ) {
+    LinePrefetcher prefetcher( recorder() );
+
+    prefetcher.request( { { 0, 100 }, { 500, 10 }, { -1, 10 }, { 20, 0 } } );
+    ASSERT_TRUE( waitForLines( prefetcher, 110 ) );
+
+    ASSERT_THAT( reads, ElementsAre( Pair( 0, 64 ), Pair( 64, 36 ), Pair( 500, 10 ) ) );
+}
+
+TEST_F( LinePrefetcherBehaviour, NewRequestReplacesThePendingLines ) {
+    blocked = true;
+    LinePrefetcher prefetcher( recorder() );
+
+    prefetcher.request( { { 0, 1000 } } );
+    waitUntilReading();
+    prefetcher.request( { { 2000, 10 } } );
+    unblock();
+    ASSERT_TRUE( waitForLines( prefetcher, 74 ) );
+
+    ASSERT_THAT( reads, ElementsAre( Pair( 0, 64 ), Pair( 2000, 10 ) ) );
+}
+
+TEST_F( LinePrefetcherBehaviour, StopsWhenDestroyed ) {
+    blocked = true;
+    thread unblocker;
+    {
+        LinePrefetcher prefetcher( recorder() );
+        prefetcher.request( { { 0, 1000 } } );
+        waitUntilReading();
+        unblocker = thread( [this]() {
+                this_thread::sleep_for( chrono::milliseconds( 10 ) );
+                unblock(); } );
+    }
+    unblocker.join();
+
+    // Only the lines being read when destroyed
+    ASSERT_THAT( reads, ElementsAre( Pair( 0, 64 ) ) );
+}
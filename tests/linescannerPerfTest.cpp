@@ -0,0 +1,128 @@
+#include <QSignalSpy>
+
+#include <cstdio>
+#include <string>
+
+#include "log.h"
+#include "test_utils.h"
+
+#include "data/linescanner.h"
+
+#include "gmock/gmock.h"
+
+using namespace std;
+using namespace testing;
+
+// Same content as the corpus generated by tools/genlogs.sh
+static const int GL_NB_LINES = 4999999;
+static const char* gl_format =
+    "LOGDATA is a part of LogCrawler, we are going to test it thoroughly, this is line %06d\n";
+
+static const int TAB_STOP = 8;
+static const size_t CHUNK_SIZE = 5*1024*1024;
+
+class PerfLineScanner : public testing::Test {
+  public:
+    PerfLineScanner() {
+        FILELog::setReportingLevel( logERROR );
+
+        if ( corpus_.empty() ) {
+            char newLine[100];
+            corpus_.reserve( GL_NB_LINES * 90 );
+            for ( int i = 0; i < GL_NB_LINES; i++ ) {
+                snprintf( newLine, sizeof( newLine ), gl_format, i );
+                corpus_.append( newLine );
+            }
+        }
+    }
+
+    // The byte by byte loop previously used by IndexOperation::doIndex
+    static int legacyScan( const string& data, int* nb_lines ) {
+        qint64 pos = 0;
+        int additional_spaces = 0;
+        int max_length = 0;
+        *nb_lines = 0;
+
+        for ( size_t block_beginning = 0; block_beginning < data.size();
+                block_beginning += CHUNK_SIZE ) {
+            const size_t block_length = min( CHUNK_SIZE, data.size() - block_beginning );
+            const char* block = data.data() + block_beginning;
+            FastLinePositionArray line_positions;
+
+            for ( size_t i = 0; i < block_length; ++i ) {
+                const char c = block[i];
+                if ( c == '\n' ) {
+                    const qint64 end = block_beginning + i;
+                    const int length = end - pos + additional_spaces;
+                    if ( length > max_length )
+                        max_length = length;
+                    pos = end + 1;
+                    additional_spaces = 0;
+                    line_positions.append( pos );
+                }
+                else if ( c == '\t' ) {
+                    additional_spaces += TAB_STOP -
+                        ( ( block_beginning + i - pos + additional_spaces ) % TAB_STOP ) - 1;
+                }
+            }
+            *nb_lines += line_positions.size();
+        }
+
+        return max_length;
+    }
+
+    static int kernelScan( const string& data, LineScanner::Kernel kernel, int* nb_lines ) {
+        LineScanner scanner( TAB_STOP, 0, kernel );
+        int max_length = 0;
+        *nb_lines = 0;
+
+        for ( size_t block_beginning = 0; block_beginning < data.size();
+                block_beginning += CHUNK_SIZE ) {
+            FastLinePositionArray line_positions;
+            scanner.scanBlock( data.data() + block_beginning,
+                    min( CHUNK_SIZE, data.size() - block_beginning ),
+                    block_beginning, &line_positions, &max_length );
+            *nb_lines += line_positions.size();
+        }
+
+        return max_length;
+    }
+
+    void compareWithLegacy( LineScanner::Kernel kernel ) {
+        if ( ! LineScanner::isSupported( kernel ) )
+            return;
+
+        int legacy_lines, legacy_max;
+        {
+            TestTimer t( "legacy loop" );
+            legacy_max = legacyScan( corpus_, &legacy_lines );
+        }
+
+        int kernel_lines, kernel_max;
+        {
+            TestTimer t;
+            kernel_max = kernelScan( corpus_, kernel, &kernel_lines );
+        }
+
+        ASSERT_THAT( legacy_lines, Eq( GL_NB_LINES ) );
+        ASSERT_THAT( kernel_lines, Eq( legacy_lines ) );
+        ASSERT_THAT( kernel_max, Eq( legacy_max ) );
+    }
+
+  private:
+    static string corpus_;
+};
+
+string PerfLineScanner::corpus_;
+
+TEST_F( PerfLineScanner, scalarKernel ) {
+    compareWithLegacy( LineScanner::Kernel::Scalar );
+}
+
+TEST_F( PerfLineScanner, sse2Kernel ) {
+    compareWithLegacy( LineScanner::Kernel::SSE2 );
+}
+
+TEST_F( PerfLineScanner, avx2Kernel ) {
+    compareWithLegacy( LineScanner::Kernel::AVX2 );
+}
@@ -0,0 +1,233 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <cstdlib>
+#include <string>
+
+#include "data/linescanner.h"
+
+using namespace std;
+using namespace testing;
+
+static const int TAB_STOP = 8;
+
+class LineScannerBehaviour: public testing::Test {
+  public:
+    FastLinePositionArray line_positions;
+    int max_length;
+
+    LineScannerBehaviour() : line_positions(), max_length( 0 ) {}
+
+    void scan( const string& data, LineScanner::Kernel kernel ) {
+        LineScanner scanner( TAB_STOP, 0, kernel );
+        scanner.scanBlock( data.data(), data.size(), 0,
+                &line_positions, &max_length );
+    }
+};
+
+TEST_F( LineScannerBehaviour, FindsEndOfLines ) {
+    scan( "abc\nde\n\nfghij\n", LineScanner::Kernel::Scalar );
+
+    ASSERT_THAT( line_positions.size(), Eq( 4 ) );
+    ASSERT_THAT( line_positions[0], Eq( 4 ) );
+    ASSERT_THAT( line_positions[1], Eq( 7 ) );
+    ASSERT_THAT( line_positions[2], Eq( 8 ) );
+    ASSERT_THAT( line_positions[3], Eq( 14 ) );
+    ASSERT_THAT( max_length, Eq( 5 ) );
+}
+
+TEST_F( LineScannerBehaviour, ExpandsTabs ) {
+    // "a\tb" is 'a' + 7 spaces + 'b', "\t\tc" is 16 spaces + 'c'
+    scan( "a\tb\n\t\tc\n", LineScanner::Kernel::Scalar );
+
+    ASSERT_THAT( line_positions.size(), Eq( 2 ) );
+    ASSERT_THAT( max_length, Eq( 17 ) );
+}
+
+TEST_F( LineScannerBehaviour, KeepsStateBetweenBlocks ) {
+    LineScanner scanner( TAB_STOP, 0, LineScanner::Kernel::Scalar );
+
+    const string first = "1234\t6";
+    const string second = "78\nab\n";
+
+    scanner.scanBlock( first.data(), first.size(), 0,
+            &line_positions, &max_length );
+    ASSERT_THAT( line_positions.size(), Eq( 0 ) );
+    ASSERT_THAT( scanner.lineStart(), Eq( 0 ) );
+
+    scanner.scanBlock( second.data(), second.size(), first.size(),
+            &line_positions, &max_length );
+    ASSERT_THAT( line_positions.size(), Eq( 2 ) );
+    ASSERT_THAT( line_positions[0], Eq( 9 ) );
+    ASSERT_THAT( max_length, Eq( 11 ) );
+    ASSERT_THAT( scanner.lineStart(), Eq( 12 ) );
+}
+
+TEST_F( LineScannerBehaviour, RecordsTheAttributesOfTheLines ) {
+    static const char lines[] =
+        "plain\na\tb\nnul\0\ncaf\xc3\xa9\nwindows\r\n\t\xe9\r\n";
+    const string data( lines, sizeof( lines ) - 1 );
+    LineAttributeList attributes;
+
+    LineScanner scanner( TAB_STOP, 0, LineScanner::Kernel::Scalar );
+    scanner.scanBlock( data.data(), data.size(), 0,
+            &line_positions, &attributes, nullptr, &max_length );
+
+    ASSERT_THAT( attributes, ElementsAre( 0,
+                LineAttribute::Expandable,
+                LineAttribute::Expandable,
+                LineAttribute::NonAscii,
+                LineAttribute::CarriageReturn,
+                LineAttribute::Expandable | LineAttribute::NonAscii
+                    | LineAttribute::CarriageReturn ) );
+}
+
+TEST_F( LineScannerBehaviour, RecordsTheExpansionOfTheLines ) {
+    const string data( "plain\na\tb\n\t\tab\tc\nwindows\r\n\tdos\r\nmid\rdle\n" );
+    LineExpansionList expansions;
+
+    LineScanner scanner( TAB_STOP, 0, LineScanner::Kernel::Scalar );
+    scanner.scanBlock( data.data(), data.size(), 0,
+            &line_positions, nullptr, &expansions, &max_length );
+
+    // The spaces added by the tabs, less a carriage return ending the line
+    ASSERT_THAT( expansions, ElementsAre( 0, 6, 19, -1, 6, 0 ) );
+}
+
+TEST_F( LineScannerBehaviour, CarriesOnAnUnfinishedLine ) {
+    LineAttributeList attributes;
+    LineExpansionList expansions;
+
+    LineScanner first_scanner( TAB_STOP, 0, LineScanner::Kernel::Scalar );
+    first_scanner.scanBlock( "a\tb\r", 4, 0, &line_positions, &attributes,
+            &expansions, &max_length );
+    ASSERT_THAT( attributes, IsEmpty() );
+    ASSERT_THAT( first_scanner.openLine().start, Eq( 0 ) );
+    ASSERT_THAT( first_scanner.openLine().additional_spaces, Eq( 6 ) );
+    ASSERT_THAT( first_scanner.openLine().attributes,
+            Eq( LineAttribute::Expandable | LineAttribute::CarriageReturn ) );
+
+    // The line is carried on by another scanner
+    LineScanner scanner( TAB_STOP, first_scanner.openLine() );
+    scanner.scanBlock( "\nd\te\n", 5, 4, &line_positions, &attributes,
+            &expansions, &max_length );
+    ASSERT_THAT( attributes, ElementsAre(
+                LineAttribute::Expandable | LineAttribute::CarriageReturn,
+                LineAttribute::Expandable ) );
+    ASSERT_THAT( expansions, ElementsAre( 5, 6 ) );
+    ASSERT_THAT( max_length, Eq( 10 ) );
+}
+
+TEST_F( LineScannerBehaviour, UnsupportedKernelFallsBackToScalar ) {
+    for ( auto kernel : { LineScanner::Kernel::SSE2, LineScanner::Kernel::AVX2 } ) {
+        LineScanner scanner( TAB_STOP, 0, kernel );
+        if ( ! LineScanner::isSupported( kernel ) )
+            ASSERT_THAT( scanner.kernel(), Eq( LineScanner::Kernel::Scalar ) );
+        else
+            ASSERT_THAT( scanner.kernel(), Eq( kernel ) );
+    }
+}
+
+class LineScannerKernels: public testing::TestWithParam<LineScanner::Kernel> {
+  public:
+    string data;
+
+    LineScannerKernels() {
+        // Random lines containing tabs, of lengths crossing the
+        // 16/32 bytes SIMD boundaries
+        srand( 42 );
+        for ( int i = 0; i < 20000; ++i ) {
+            const int length = rand() % 150;
+            for ( int j = 0; j < length; ++j ) {
+                const int r = rand() % 20;
+                data.push_back( r == 0 ? '\t' : static_cast<char>( 'a' + r ) );
+            }
+            data.push_back( '\n' );
+        }
+        // Unterminated final line
+        data.append( "end\tof file" );
+    }
+};
+
+TEST_P( LineScannerKernels, GiveTheSameResultsAsScalar ) {
+    if ( ! LineScanner::isSupported( GetParam() ) )
+        return;
+
+    FastLinePositionArray scalar_positions;
+    int scalar_max = 0;
+    LineScanner scalar( TAB_STOP, 0, LineScanner::Kernel::Scalar );
+
+    FastLinePositionArray kernel_positions;
+    int kernel_max = 0;
+    LineScanner scanner( TAB_STOP, 0, GetParam() );
+
+    // Odd sized blocks so lines and SIMD words span blocks
+    const size_t block_size = 1001;
+    for ( size_t begin = 0; begin < data.size(); begin += block_size ) {
+        const size_t length = min( block_size, data.size() - begin );
+        scalar.scanBlock( data.data() + begin, length, begin,
+                &scalar_positions, &scalar_max );
+        scanner.scanBlock( data.data() + begin, length, begin,
+                &kernel_positions, &kernel_max );
+    }
+
+    ASSERT_THAT( kernel_positions.size(), Eq( scalar_positions.size() ) );
+    for ( int i = 0; i < scalar_positions.size(); ++i )
+        ASSERT_THAT( kernel_positions[i], Eq( scalar_positions[i] ) );
+    ASSERT_THAT( kernel_max, Eq( scalar_max ) );
+    ASSERT_THAT( scanner.lineStart(), Eq( scalar.lineStart() ) );
+}
+
+TEST_P( LineScannerKernels, GiveTheSameAttributesAsScalar ) {
+    if ( ! LineScanner::isSupported( GetParam() ) )
+        return;
+
+    // Sprinkle the bytes setting an attribute
+    for ( size_t i = 0; i < data.size(); ++i ) {
+        if ( data[i] == '\n' )
+            continue;
+        const int r = rand() % 500;
+        if ( r == 0 )
+            data[i] = '\0';
+        else if ( r == 1 )
+            data[i] = '\xe9';
+        else if ( r == 2 )
+            data[i] = '\r';
+    }
+
+    FastLinePositionArray scalar_positions;
+    LineAttributeList scalar_attributes;
+    LineExpansionList scalar_expansions;
+    int scalar_max = 0;
+    LineScanner scalar( TAB_STOP, 0, LineScanner::Kernel::Scalar );
+
+    FastLinePositionArray kernel_positions;
+    LineAttributeList kernel_attributes;
+    LineExpansionList kernel_expansions;
+    int kernel_max = 0;
+    LineScanner scanner( TAB_STOP, 0, GetParam() );
+
+    const size_t block_size = 1001;
+    for ( size_t begin = 0; begin < data.size(); begin += block_size ) {
+        const size_t length = min( block_size, data.size() - begin );
+        scalar.scanBlock( data.data() + begin, length, begin,
+                &scalar_positions, &scalar_attributes, &scalar_expansions,
+                &scalar_max );
+        scanner.scanBlock( data.data() + begin, length, begin,
+                &kernel_positions, &kernel_attributes, &kernel_expansions,
+                &kernel_max );
+    }
+
+    ASSERT_THAT( scalar_attributes.size(), Eq( scalar_positions.size() ) );
+    ASSERT_THAT( kernel_attributes, Eq( scalar_attributes ) );
+    ASSERT_THAT( kernel_expansions, Eq( scalar_expansions ) );
+    ASSERT_THAT( scanner.openLine().attributes, Eq( scalar.openLine().attributes ) );
+    ASSERT_THAT( scanner.openLine().additional_spaces,
+            Eq( scalar.openLine().additional_spaces ) );
+}
+
+INSTANTIATE_TEST_CASE_P( AllKernels, LineScannerKernels,
+        Values( LineScanner::Kernel::SSE2, LineScanner::Kernel::AVX2 ) );
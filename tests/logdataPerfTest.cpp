@@ -1,10 +1,14 @@
 #include <QTest>
 #include <QSignalSpy>
 
+#include <iostream>
+#include <unistd.h>
+
 #include "log.h"
 #include "test_utils.h"
 
 #include "data/logdata.h"
+#include "data/pagecacheguard.h"
 
 #include "gmock/gmock.h"
 
@@ -68,6 +72,86 @@ TEST_F( PerfLogData, simpleLoad ) {
             static_cast<int>( LoadingStatus::Successful ) );
 }
 
+TEST_F( PerfLogData, pipelinedLoad ) {
+    LogData log_data;
+    log_data.setReadAheadDepth( 2 );
+    QSignalSpy progressSpy( &log_data, SIGNAL( loadingProgressed( int ) ) );
+    QSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+
+    {
+        TestTimer t;
+
+        log_data.attachFile( TMPDIR "/verybiglog.txt" );
+        ASSERT_TRUE( endSpy.wait( 20000 ) );
+    }
+
+    ASSERT_THAT( log_data.getNbLine(), VBL_NB_LINES );
+    ASSERT_THAT( log_data.getMaxLength(), VBL_VISIBLE_LINE_LENGTH );
+    ASSERT_THAT( log_data.getFileSize(), VBL_NB_LINES * (VBL_LINE_LENGTH+1LL) );
+
+    // Same progress reporting as the non pipelined loading
+    ASSERT_THAT( progressSpy.count(), log_data.getFileSize() / (5LL*1024*1024) + 2 );
+}
+
+// Drop the file from the page cache, returns false if it cannot be done
+static bool evictFromPageCache( const QString& file_name, qint64 size )
+{
+    {
+        // Dirty pages cannot be dropped
+        QFile file( file_name );
+        if ( file.open( QIODevice::ReadWrite ) )
+            fsync( file.handle() );
+    }
+
+    // Nothing is cached as far as this guard knows
+    PageCacheGuard guard( file_name, 0, 0 );
+    guard.release( 0, size );
+
+    return PageCacheGuard::residentBytes( file_name, 0, size ) < size / 10;
+}
+
+TEST_F( PerfLogData, pageCacheFriendlyLoad ) {
+    const qint64 file_size = VBL_NB_LINES * (VBL_LINE_LENGTH+1LL);
+    if ( ! PageCacheGuard::isSupported()
+            || ! evictFromPageCache( TMPDIR "/verybiglog.txt", file_size ) )
+        return;
+
+    qint64 usual_resident;
+    {
+        LogData log_data;
+        SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+        {
+            TestTimer t( "usual load" );
+
+            log_data.attachFile( TMPDIR "/verybiglog.txt" );
+            ASSERT_TRUE( endSpy.safeWait( 20000 ) );
+        }
+        usual_resident = PageCacheGuard::residentBytes(
+                TMPDIR "/verybiglog.txt", 0, file_size );
+        std::cout << "Page cache used by the usual load: "
+            << usual_resident / 1024 << " KiB" << std::endl;
+    }
+
+    ASSERT_TRUE( evictFromPageCache( TMPDIR "/verybiglog.txt", file_size ) );
+
+    LogData log_data;
+    log_data.setPreservePageCache( true );
+    SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+    {
+        TestTimer t( "page cache friendly load" );
+
+        log_data.attachFile( TMPDIR "/verybiglog.txt" );
+        ASSERT_TRUE( endSpy.safeWait( 20000 ) );
+    }
+    const qint64 resident = PageCacheGuard::residentBytes(
+            TMPDIR "/verybiglog.txt", 0, file_size );
+    std::cout << "Page cache used by the page cache friendly load: "
+        << resident / 1024 << " KiB" << std::endl;
+
+    ASSERT_THAT( log_data.getNbLine(), VBL_NB_LINES );
+    ASSERT_THAT( resident, testing::Lt( usual_resident / 10 ) );
+}
+
 class PerfLogDataRead : public PerfLogData {
   public:
     PerfLogDataRead() : PerfLogData(), log_data(), endSpy(
@@ -143,3 +227,25 @@ TEST_F( PerfLogDataRead, randomPageReadExpanded ) {
         }
     }
 }
+
+TEST_F( PerfLogDataRead, pageReadPerEncoding ) {
+    ASSERT_THAT( log_data.getNbLine(), VBL_NB_LINES );
+    // ISO-8859-1 and UTF-8 are decoded directly, CP1252 by its codec
+    for ( Encoding encoding : { Encoding::ENCODING_ISO_8859_1,
+            Encoding::ENCODING_UTF8, Encoding::ENCODING_CP1252 } ) {
+        log_data.setDisplayEncoding( encoding );
+
+        QStringList list;
+        {
+            TestTimer t( std::string( "page read, encoding " )
+                    + std::to_string( static_cast<int>( encoding ) ) );
+
+            for ( int page = 0; page < (VBL_NB_LINES/VBL_LINE_PER_PAGE)-1; page++ ) {
+                list = log_data.getLines( page*VBL_LINE_PER_PAGE, VBL_LINE_PER_PAGE );
+                ASSERT_THAT( list.count(), VBL_LINE_PER_PAGE );
+            }
+        }
+
+        ASSERT_THAT( list.at( 0 ).length(), VBL_LINE_LENGTH );
+    }
+}
@@ -2,6 +2,10 @@
 
 #include <QTest>
 #include <QSignalSpy>
+#include <QDir>
+#include <QFileInfo>
+
+#include <zlib.h>
 
 #include "log.h"
 #include "test_utils.h"
@@ -195,6 +199,138 @@ TEST_F( LogDataBehaviour, readFunctions ) {
     ASSERT_THAT( QString::compare( log_data.getExpandedLines( 12, 2 ).at( 0 ), ref ), 0 );
 }
 
+TEST_F( LogDataBehaviour, reloadIndexesWhatHasBeenAppended ) {
+    char newLine[90];
+    LogData log_data;
+    SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+
+    log_data.attachFile( TMPDIR "/smalllog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    QFile file( TMPDIR "/smalllog.txt" );
+    if ( file.open( QIODevice::Append ) ) {
+        for ( int i = 0; i < 100; i++ ) {
+            snprintf( newLine, 89, sl_format, SL_NB_LINES + i );
+            file.write( newLine, qstrlen( newLine ) );
+        }
+    }
+    file.close();
+
+    {
+        SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+        log_data.reload();
+        ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+    }
+
+    ASSERT_THAT( log_data.getNbLine(), SL_NB_LINES + 100 );
+    snprintf( newLine, 89, sl_format, SL_NB_LINES + 99 );
+    ASSERT_THAT( log_data.getLineString( SL_NB_LINES + 99 ),
+            QString( newLine ).trimmed() );
+}
+
+TEST_F( LogDataBehaviour, reloadReindexesAModifiedFile ) {
+    LogData log_data;
+    SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+
+    log_data.attachFile( TMPDIR "/smalllog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    // Split the first line, the size is the same
+    QFile file( TMPDIR "/smalllog.txt" );
+    if ( file.open( QIODevice::ReadWrite ) ) {
+        file.seek( 7 );
+        file.write( "\n" );
+    }
+    file.close();
+
+    {
+        SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+        log_data.reload();
+        ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+    }
+
+    ASSERT_THAT( log_data.getNbLine(), SL_NB_LINES + 1 );
+    ASSERT_THAT( log_data.getLineString( 0 ), QString( "LOGDATA" ) );
+}
+
+TEST_F( LogDataBehaviour, cachesTheExpandedLines ) {
+    LogData log_data;
+    SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+
+    log_data.attachFile( TMPDIR "/smalllog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    const QStringList first_read = log_data.getExpandedLines( 100, SL_LINE_PER_PAGE );
+    const QStringList second_read = log_data.getExpandedLines( 100, SL_LINE_PER_PAGE );
+    ASSERT_THAT( second_read, Eq( first_read ) );
+    ASSERT_THAT( log_data.getExpandedLineString( 120 ), Eq( first_read.at( 20 ) ) );
+
+    LineCache::Statistics statistics = log_data.getLineCacheStatistics();
+    ASSERT_THAT( statistics.misses, Eq( static_cast<quint64>( SL_LINE_PER_PAGE ) ) );
+    ASSERT_THAT( statistics.hits, Eq( static_cast<quint64>( SL_LINE_PER_PAGE + 1 ) ) );
+
+    // Split the first line, the size is the same
+    log_data.getExpandedLineString( 0 );
+    QFile file( TMPDIR "/smalllog.txt" );
+    if ( file.open( QIODevice::ReadWrite ) ) {
+        file.seek( 7 );
+        file.write( "\n" );
+    }
+    file.close();
+
+    {
+        SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+        log_data.reload();
+        ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+    }
+
+    ASSERT_THAT( log_data.getExpandedLineString( 0 ), QString( "LOGDATA" ) );
+    ASSERT_THAT( log_data.getExpandedLineString( 101 ), Eq( first_read.at( 0 ) ) );
+}
+
+TEST_F( LogDataBehaviour, expandsTheLinesFromTheirAttributes ) {
+    // Lines of every kind, so the groups of lines sharing their
+    // attributes hold different ones
+    const QByteArray lines[] = {
+        "plain line", "with\ta tab", QByteArray( "nul\0byte", 8 ), "caf\xe9",
+        "dos line\r", "\tall\xe9 of them\r", };
+    static const char* expanded[] = {
+        "plain line", "with    a tab", "nul byte", "caf\xe9",
+        "dos line", "        all\xe9 of them", };
+    static const int nb_kinds = 6;
+    static const int nb_lines = 100;
+
+    QFile file( TMPDIR "/attributes.txt" );
+    if ( file.open( QIODevice::WriteOnly ) ) {
+        for ( int i = 0; i < nb_lines; i++ ) {
+            const int kind = ( i * 7 ) % nb_kinds;
+            file.write( lines[kind] + "\n" );
+        }
+    }
+    file.close();
+
+    LogData log_data;
+    SafeQSignalSpy endSpy( &log_data, SIGNAL( loadingFinished( LoadingStatus ) ) );
+
+    log_data.attachFile( TMPDIR "/attributes.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+    ASSERT_THAT( log_data.getNbLine(), Eq( nb_lines ) );
+
+    const QStringList expanded_lines = log_data.getExpandedLines( 0, nb_lines );
+    for ( int i = 0; i < nb_lines; i++ ) {
+        const int kind = ( i * 7 ) % nb_kinds;
+        ASSERT_THAT( expanded_lines.at( i ), Eq( QString::fromLatin1( expanded[kind] ) ) );
+        ASSERT_THAT( log_data.getExpandedLineString( i ),
+                Eq( QString::fromLatin1( expanded[kind] ) ) );
+        // Known from the index
+        ASSERT_THAT( log_data.getLineLength( i ),
+                Eq( static_cast<int>( qstrlen( expanded[kind] ) ) ) );
+    }
+
+    // The carriage return is only dropped from the expanded line
+    ASSERT_THAT( log_data.getLineString( 4 ), Eq( QString( "dos line\r" ) ) );
+}
+
 class LogDataMultiByte : public testing::Test {
   public:
     LogDataMultiByte() {
@@ -278,3 +414,539 @@ TEST_F( LogDataMultiByte, readUtf16BE ) {
     ASSERT_THAT( QString::compare( log_data.getLines( 11, 3 ).at( 2 ), QStringLiteral( "DOM CARLOS, frère d'Elvire." ) ), 0 );
     ASSERT_THAT( QString::compare( log_data.getExpandedLines( 0, 3 ).at( 2 ), QStringLiteral( "COMÉDIE" ) ), 0 );
 }
+
+class LogDataParallelIndexing : public testing::Test {
+  public:
+    LogDataParallelIndexing() {
+        generateDataFiles();
+    }
+
+    bool generateDataFiles() {
+        QFile file( TMPDIR "/parallellog.txt" );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            // Lines of various lengths, with tabs and multi-byte characters,
+            // so chunk boundaries fall in the middle of lines and characters.
+            for ( int i = 0; i < 100000; i++ ) {
+                QByteArray line = QString::fromUtf8( u8"Line %1\tcafé" )
+                    .arg( i ).toUtf8();
+                line.append( QByteArray( i % 97, 'x' ) );
+                if ( i % 13 == 0 )
+                    line.append( '\t' );
+                line.append( '\n' );
+                file.write( line );
+            }
+            // A line longer than an indexing chunk
+            file.write( QByteArray( 6*1024*1024, 'y' ) );
+            file.write( "\n" );
+            for ( int i = 0; i < 100000; i++ ) {
+                file.write( QString::fromUtf8( u8"Ligne %1\tdéjà vu\n" )
+                        .arg( i ).toUtf8() );
+            }
+        }
+        else {
+            return false;
+        }
+        file.close();
+
+        return true;
+    }
+};
+
+TEST_F( LogDataParallelIndexing, givesTheSameResultAsSequential ) {
+    LogData sequential_data;
+    SafeQSignalSpy sequentialEndSpy( &sequential_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    SafeQSignalSpy sequentialProgressSpy( &sequential_data,
+            SIGNAL( loadingProgressed( int ) ) );
+
+    LogData parallel_data;
+    parallel_data.setIndexingThreads( 4 );
+    SafeQSignalSpy parallelEndSpy( &parallel_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    SafeQSignalSpy parallelProgressSpy( &parallel_data,
+            SIGNAL( loadingProgressed( int ) ) );
+
+    sequential_data.attachFile( TMPDIR "/parallellog.txt" );
+    ASSERT_TRUE( sequentialEndSpy.safeWait( 10000 ) );
+    parallel_data.attachFile( TMPDIR "/parallellog.txt" );
+    ASSERT_TRUE( parallelEndSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( parallel_data.getNbLine(), sequential_data.getNbLine() );
+    ASSERT_THAT( parallel_data.getMaxLength(), sequential_data.getMaxLength() );
+    ASSERT_THAT( parallel_data.getFileSize(), sequential_data.getFileSize() );
+    ASSERT_THAT( parallel_data.getDetectedEncoding(),
+            EncodingSpeculator::Encoding::UTF8 );
+    ASSERT_THAT( parallel_data.getDetectedEncoding(),
+            sequential_data.getDetectedEncoding() );
+
+    for ( qint64 line = 0; line < sequential_data.getNbLine(); line += 1000 ) {
+        const int nb = qMin( 1000LL, sequential_data.getNbLine() - line );
+        ASSERT_THAT( parallel_data.getExpandedLines( line, nb ),
+                sequential_data.getExpandedLines( line, nb ) );
+    }
+
+    ASSERT_THAT( parallelProgressSpy.count(), sequentialProgressSpy.count() );
+}
+
+TEST_F( LogDataParallelIndexing, givesTheSameResultWhenPreservingThePageCache ) {
+    LogData reference;
+    SafeQSignalSpy referenceEndSpy( &reference,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    reference.attachFile( TMPDIR "/parallellog.txt" );
+    ASSERT_TRUE( referenceEndSpy.safeWait( 10000 ) );
+
+    for ( int nb_threads : { 1, 4 } ) {
+        LogData log_data;
+        log_data.setIndexingThreads( nb_threads );
+        log_data.setPreservePageCache( true );
+        SafeQSignalSpy endSpy( &log_data,
+                SIGNAL( loadingFinished( LoadingStatus ) ) );
+        log_data.attachFile( TMPDIR "/parallellog.txt" );
+        ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+        ASSERT_THAT( log_data.getNbLine(), reference.getNbLine() );
+        ASSERT_THAT( log_data.getMaxLength(), reference.getMaxLength() );
+        for ( qint64 line = 0; line < reference.getNbLine(); line += 5000 )
+            ASSERT_THAT( log_data.getLineString( line ),
+                    reference.getLineString( line ) );
+    }
+}
+
+#define INDEX_CACHE_DIR TMPDIR "/glogg_index_cache"
+
+class LogDataIndexCache : public testing::Test {
+  public:
+    LogDataIndexCache() : index_cache_( INDEX_CACHE_DIR, 0 ) {
+        QDir( INDEX_CACHE_DIR ).removeRecursively();
+        generateDataFile( 20000, 0 );
+    }
+
+    // Generate a file of nb_lines lines (the last one without a LF)
+    void generateDataFile( int nb_lines, int variant ) {
+        QFile file( TMPDIR "/cachedlog.txt" );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            for ( int i = 0; i < nb_lines - 1; i++ ) {
+                QByteArray line = QString::fromUtf8( u8"Line %1\tcafé" )
+                    .arg( i ).toUtf8();
+                line.append( QByteArray( ( i + variant ) % 89, 'x' ) );
+                line.append( '\n' );
+                file.write( line );
+            }
+            file.write( "Partial line" );
+        }
+    }
+
+    void appendToDataFile( int nb_lines ) {
+        QFile file( TMPDIR "/cachedlog.txt" );
+        if ( file.open( QIODevice::Append ) ) {
+            file.write( " completed\n" );
+            for ( int i = 0; i < nb_lines; i++ )
+                file.write( QString( "Appended line %1\n" ).arg( i ).toLatin1() );
+        }
+    }
+
+    void attach( LogData* log_data, bool use_cache ) {
+        if ( use_cache )
+            log_data->setIndexCache( index_cache_ );
+
+        SafeQSignalSpy endSpy( log_data,
+                SIGNAL( loadingFinished( LoadingStatus ) ) );
+        log_data->attachFile( TMPDIR "/cachedlog.txt" );
+        ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+    }
+
+    void compare( const LogData& log_data, const LogData& reference ) {
+        ASSERT_THAT( log_data.getNbLine(), reference.getNbLine() );
+        ASSERT_THAT( log_data.getMaxLength(), reference.getMaxLength() );
+        ASSERT_THAT( log_data.getFileSize(), reference.getFileSize() );
+        ASSERT_THAT( log_data.getDetectedEncoding(),
+                reference.getDetectedEncoding() );
+
+        for ( qint64 line = 0; line < reference.getNbLine(); line += 1000 ) {
+            const int nb = qMin( 1000LL, reference.getNbLine() - line );
+            ASSERT_THAT( log_data.getExpandedLines( line, nb ),
+                    reference.getExpandedLines( line, nb ) );
+        }
+    }
+
+    IndexCache index_cache_;
+};
+
+TEST_F( LogDataIndexCache, reopensAFileFromTheCache ) {
+    {
+        LogData log_data;
+        attach( &log_data, true );
+    }
+    ASSERT_THAT( QDir( INDEX_CACHE_DIR ).entryList( QDir::Files ).size(), Eq( 1 ) );
+
+    LogData cached_data;
+    attach( &cached_data, true );
+
+    LogData reference;
+    attach( &reference, false );
+
+    compare( cached_data, reference );
+    ASSERT_THAT( cached_data.getDetectedEncoding(),
+            EncodingSpeculator::Encoding::UTF8 );
+}
+
+TEST_F( LogDataIndexCache, indexesWhatHasBeenAppendedSinceCached ) {
+    {
+        LogData log_data;
+        attach( &log_data, true );
+    }
+
+    appendToDataFile( 500 );
+
+    LogData cached_data;
+    attach( &cached_data, true );
+
+    LogData reference;
+    attach( &reference, false );
+
+    compare( cached_data, reference );
+    ASSERT_THAT( cached_data.getNbLine(), Eq( 20500LL ) );
+}
+
+TEST_F( LogDataIndexCache, ignoresTheCacheIfTheFileHasChanged ) {
+    {
+        LogData log_data;
+        attach( &log_data, true );
+    }
+
+    // Same number of lines, but different lengths
+    generateDataFile( 20000, 7 );
+
+    LogData cached_data;
+    attach( &cached_data, true );
+
+    LogData reference;
+    attach( &reference, false );
+
+    compare( cached_data, reference );
+}
+
+class LogDataTailFirst : public testing::Test {
+  public:
+    LogDataTailFirst() {
+        generateDataFile();
+    }
+
+    // The default file is big enough to be indexed tail-first
+    void generateDataFile( int nb_lines = 300000 ) {
+        QFile file( TMPDIR "/tailfirstlog.txt" );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            for ( int i = 0; i < nb_lines; i++ ) {
+                QByteArray line = QString( "Line %1\t" ).arg( i ).toLatin1();
+                line.append( QByteArray( i % 61, 'x' ) );
+                line.append( '\n' );
+                file.write( line );
+            }
+        }
+    }
+};
+
+TEST_F( LogDataTailFirst, showsTheEndOfTheFileFirst ) {
+    LogData reference;
+    SafeQSignalSpy referenceEndSpy( &reference,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    reference.attachFile( TMPDIR "/tailfirstlog.txt" );
+    ASSERT_TRUE( referenceEndSpy.safeWait( 10000 ) );
+
+    LogData log_data;
+    log_data.setTailFirstLines( 1000 );
+
+    // Look at the tail as soon as it is available, before the
+    // rest of the file is indexed (the signal is sent from the
+    // indexing thread, which waits for us).
+    qint64 tail_nb_lines = 0;
+    QStringList tail_lines;
+    QObject::connect( &log_data, &LogData::tailLoaded,
+            [&]() {
+                tail_nb_lines = log_data.getNbLine();
+                tail_lines = log_data.getLines( 0, tail_nb_lines );
+            } );
+
+    SafeQSignalSpy tailSpy( &log_data, SIGNAL( tailLoaded() ) );
+    SafeQSignalSpy endSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    log_data.attachFile( TMPDIR "/tailfirstlog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( tailSpy.count(), Eq( 1 ) );
+    ASSERT_THAT( tail_nb_lines, Eq( 1000LL ) );
+    ASSERT_THAT( tail_lines,
+            reference.getLines( reference.getNbLine() - 1000, 1000 ) );
+
+    ASSERT_THAT( log_data.getNbLine(), reference.getNbLine() );
+    ASSERT_THAT( log_data.getMaxLength(), reference.getMaxLength() );
+    ASSERT_THAT( log_data.getFileSize(), reference.getFileSize() );
+    ASSERT_THAT( log_data.getLines( 0, 1000 ), reference.getLines( 0, 1000 ) );
+}
+
+TEST_F( LogDataTailFirst, renumbersTheTailOnceLoaded ) {
+    LogData log_data;
+    log_data.setTailFirstLines( 1000 );
+
+    // The lines are still those of the tail when it is replaced
+    qint64 tail_nb_lines = 0;
+    QObject::connect( &log_data, &LogData::tailLoaded,
+            [&]() { tail_nb_lines = log_data.getNbLine(); } );
+    qint64 nb_lines_at_replacement = 0;
+    bool finished_at_replacement = true;
+    SafeQSignalSpy endSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    QObject::connect( &log_data, &LogData::tailReplaced,
+            [&]() {
+                nb_lines_at_replacement = log_data.getNbLine();
+                finished_at_replacement = ( endSpy.count() > 0 );
+            } );
+
+    SafeQSignalSpy replacedSpy( &log_data,
+            SIGNAL( tailReplaced( qint64, qint64 ) ) );
+    log_data.attachFile( TMPDIR "/tailfirstlog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( tail_nb_lines, Eq( 1000LL ) );
+    ASSERT_THAT( replacedSpy.count(), Eq( 1 ) );
+    ASSERT_FALSE( finished_at_replacement );
+    ASSERT_THAT( nb_lines_at_replacement, Eq( 300000LL ) );
+
+    // The first line of the tail is now 1000 lines from the end
+    const QList<QVariant> arguments = replacedSpy.at( 0 );
+    ASSERT_THAT( arguments.at( 0 ).toLongLong(), Eq( 0LL ) );
+    ASSERT_THAT( arguments.at( 1 ).toLongLong(), Eq( 300000LL - 1000LL ) );
+}
+
+TEST_F( LogDataTailFirst, followsTheTailBeforeLoaded ) {
+    LogData log_data;
+    log_data.setTailFirstLines( 1000 );
+
+    // Lines are appended as soon as the tail is shown, before the rest
+    // of the file is indexed (the indexing thread waits for us)
+    QObject::connect( &log_data, &LogData::tailLoaded,
+            [&]() {
+                QFile file( TMPDIR "/tailfirstlog.txt" );
+                if ( file.open( QIODevice::Append ) ) {
+                    for ( int i = 0; i < 10; i++ )
+                        file.write( QString( "Appended line %1\n" )
+                                .arg( i ).toLatin1() );
+                }
+            } );
+
+    SafeQSignalSpy endSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    qint64 nb_lines_at_update = 0;
+    qint64 size_at_update = 0;
+    QStringList appended_lines;
+    bool finished_at_update = true;
+    QObject::connect( &log_data, &LogData::tailUpdated,
+            [&]() {
+                nb_lines_at_update = log_data.getNbLine();
+                size_at_update = log_data.getFileSize();
+                appended_lines = log_data.getLines( nb_lines_at_update - 10, 10 );
+                finished_at_update = ( endSpy.count() > 0 );
+            } );
+
+    SafeQSignalSpy updatedSpy( &log_data, SIGNAL( tailUpdated() ) );
+    log_data.attachFile( TMPDIR "/tailfirstlog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    // The tail has grown before the loading is finished
+    ASSERT_THAT( updatedSpy.count(), Eq( 1 ) );
+    ASSERT_FALSE( finished_at_update );
+    ASSERT_THAT( nb_lines_at_update, Eq( 1010LL ) );
+    ASSERT_THAT( size_at_update, Eq( QFileInfo( TMPDIR "/tailfirstlog.txt" ).size() ) );
+    ASSERT_THAT( appended_lines.first(), Eq( QString( "Appended line 0" ) ) );
+    ASSERT_THAT( appended_lines.last(), Eq( QString( "Appended line 9" ) ) );
+
+    ASSERT_THAT( log_data.getNbLine(), Eq( 300010LL ) );
+}
+
+TEST_F( LogDataTailFirst, ignoresSmallFiles ) {
+    generateDataFile( 20000 );
+
+    LogData log_data;
+    log_data.setTailFirstLines( 1000 );
+
+    SafeQSignalSpy tailSpy( &log_data, SIGNAL( tailLoaded() ) );
+    SafeQSignalSpy endSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    log_data.attachFile( TMPDIR "/tailfirstlog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( tailSpy.count(), Eq( 0 ) );
+    ASSERT_THAT( log_data.getNbLine(), Eq( 20000LL ) );
+}
+
+TEST( LogDataSparseIndex, givesTheSameResultAsAFullIndex ) {
+    {
+        QFile file( TMPDIR "/sparselog.txt" );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            for ( int i = 0; i < 200000; i++ ) {
+                QByteArray line = QString( "Line %1\t" ).arg( i ).toLatin1();
+                line.append( QByteArray( i % 53, 'x' ) );
+                line.append( '\n' );
+                file.write( line );
+            }
+            file.write( "Partial line" );
+        }
+    }
+
+    LogData reference;
+    SafeQSignalSpy referenceEndSpy( &reference,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    reference.attachFile( TMPDIR "/sparselog.txt" );
+    ASSERT_TRUE( referenceEndSpy.safeWait( 10000 ) );
+
+    // Much less than the 200 KiB of the compressed index
+    LogData log_data;
+    log_data.setIndexMemoryBudget( 16*1024 );
+    SafeQSignalSpy endSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    log_data.attachFile( TMPDIR "/sparselog.txt" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( log_data.getNbLine(), reference.getNbLine() );
+    ASSERT_THAT( log_data.getMaxLength(), reference.getMaxLength() );
+
+    for ( qint64 line = 0; line < reference.getNbLine(); line += 1000 ) {
+        const int nb = qMin( 1000LL, reference.getNbLine() - line );
+        ASSERT_THAT( log_data.getExpandedLines( line, nb ),
+                reference.getExpandedLines( line, nb ) );
+    }
+    ASSERT_THAT( log_data.getLineString( 123457 ),
+            reference.getLineString( 123457 ) );
+}
+
+TEST( LogDataCompressed, givesTheSameContentAsTheUncompressedFile ) {
+    {
+        QFile file( TMPDIR "/compressedlog.txt" );
+        gzFile gz = gzopen( TMPDIR "/compressedlog.txt.gz", "wb" );
+        if ( gz && file.open( QIODevice::WriteOnly ) ) {
+            for ( int i = 0; i < 200000; i++ ) {
+                QByteArray line = QString( "Line %1\t" ).arg( i ).toLatin1();
+                line.append( QByteArray( i % 53, 'x' ) );
+                line.append( '\n' );
+                file.write( line );
+                gzwrite( gz, line.constData(), line.size() );
+            }
+            file.write( "Partial line" );
+            gzwrite( gz, "Partial line", 12 );
+        }
+        gzclose( gz );
+    }
+
+    LogData reference;
+    SafeQSignalSpy referenceEndSpy( &reference,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    reference.attachFile( TMPDIR "/compressedlog.txt" );
+    ASSERT_TRUE( referenceEndSpy.safeWait( 10000 ) );
+
+    LogData log_data;
+    SafeQSignalSpy endSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    log_data.attachFile( TMPDIR "/compressedlog.txt.gz" );
+    ASSERT_TRUE( endSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( log_data.getNbLine(), reference.getNbLine() );
+    ASSERT_THAT( log_data.getMaxLength(), reference.getMaxLength() );
+    ASSERT_THAT( log_data.getFileSize(), reference.getFileSize() );
+
+    // Backward, so the lines are not read sequentially
+    for ( qint64 line = reference.getNbLine() - 1000; line >= 0; line -= 7919 ) {
+        ASSERT_THAT( log_data.getExpandedLines( line, 1000 ),
+                reference.getExpandedLines( line, 1000 ) );
+    }
+    ASSERT_THAT( log_data.getLineString( reference.getNbLine() - 1 ),
+            reference.getLineString( reference.getNbLine() - 1 ) );
+}
+
+class LogDataFileSet : public testing::Test {
+  public:
+    LogDataFileSet() {
+        // The oldest file is compressed
+        QFile::remove( TMPDIR "/rotatedlog.txt.3.gz" );
+        gzFile gz = gzopen( TMPDIR "/rotatedlog.txt.2.gz", "wb" );
+        for ( int i = 0; i < 3000; i++ ) {
+            const QByteArray line = makeLine( i );
+            gzwrite( gz, line.constData(), line.size() );
+        }
+        gzclose( gz );
+
+        writeLines( TMPDIR "/rotatedlog.txt.1", 3000, 5000 );
+        writeLines( TMPDIR "/rotatedlog.txt", 8000, 1000 );
+    }
+
+    static QByteArray makeLine( int i ) {
+        char newLine[90];
+        snprintf( newLine, 89, sl_format, i );
+        return QByteArray( newLine );
+    }
+
+    static void writeLines( const char* file_name, int first, int number ) {
+        QFile file( file_name );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            for ( int i = first; i < first + number; i++ )
+                file.write( makeLine( i ) );
+        }
+    }
+};
+
+TEST_F( LogDataFileSet, findsTheRotatedFiles ) {
+    ASSERT_THAT( LogData::rotatedFileSet( TMPDIR "/rotatedlog.txt" ),
+            QStringList() << TMPDIR "/rotatedlog.txt.2.gz"
+                << TMPDIR "/rotatedlog.txt.1" << TMPDIR "/rotatedlog.txt" );
+}
+
+TEST_F( LogDataFileSet, showsTheFilesAsASingleLog ) {
+    LogData log_data;
+    SafeQSignalSpy finishedSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    log_data.attachFileSet( LogData::rotatedFileSet( TMPDIR "/rotatedlog.txt" ) );
+    ASSERT_TRUE( finishedSpy.safeWait( 10000 ) );
+
+    ASSERT_THAT( finishedSpy.count(), 1 );
+    ASSERT_THAT( log_data.getNbLine(), 9000LL );
+    ASSERT_THAT( log_data.getMaxLength(), SL_LINE_LENGTH );
+    ASSERT_THAT( log_data.getFileSize(), 9000 * ( SL_LINE_LENGTH + 1LL ) );
+
+    // Including across the files
+    for ( int i : { 0, 2999, 3000, 7999, 8000, 8999 } )
+        ASSERT_THAT( log_data.getLineString( i ),
+                QString( makeLine( i ) ).trimmed() );
+    const QStringList lines = log_data.getLines( 2990, 5020 );
+    ASSERT_THAT( lines.size(), 5020 );
+    for ( int i = 0; i < lines.size(); i++ )
+        ASSERT_THAT( lines[i], QString( makeLine( 2990 + i ) ).trimmed() );
+}
+
+TEST_F( LogDataFileSet, keepsTheRotatedFile ) {
+    LogData log_data;
+    SafeQSignalSpy finishedSpy( &log_data,
+            SIGNAL( loadingFinished( LoadingStatus ) ) );
+    log_data.attachFileSet( LogData::rotatedFileSet( TMPDIR "/rotatedlog.txt" ) );
+    ASSERT_TRUE( finishedSpy.safeWait( 10000 ) );
+
+    {
+        SafeQSignalSpy finishedSpy( &log_data,
+                SIGNAL( loadingFinished( LoadingStatus ) ) );
+
+        // Rotate the files and start a new one
+        QFile::rename( TMPDIR "/rotatedlog.txt.2.gz", TMPDIR "/rotatedlog.txt.3.gz" );
+        QFile::rename( TMPDIR "/rotatedlog.txt.1", TMPDIR "/rotatedlog.txt.2" );
+        writeLines( TMPDIR "/rotatedlog.txt.new", 9000, 200 );
+        QFile::rename( TMPDIR "/rotatedlog.txt", TMPDIR "/rotatedlog.txt.1" );
+        QFile::rename( TMPDIR "/rotatedlog.txt.new", TMPDIR "/rotatedlog.txt" );
+
+        ASSERT_TRUE( finishedSpy.safeWait( 10000 ) );
+    }
+
+    ASSERT_THAT( log_data.getNbLine(), 9200LL );
+    for ( int i : { 0, 3000, 8999, 9000, 9199 } )
+        ASSERT_THAT( log_data.getLineString( i ),
+                QString( makeLine( i ) ).trimmed() );
+
+    QFile::remove( TMPDIR "/rotatedlog.txt.2" );
+    QFile::remove( TMPDIR "/rotatedlog.txt.3.gz" );
+}
@@ -0,0 +1,139 @@
+#include <QTest>
+#include <QSignalSpy>
+#include <QDataStream>
+
+#include "log.h"
+#include "test_utils.h"
+
+#include "data/logdataworkerthread.h"
+
+#include "gmock/gmock.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+class LogDataWorkerThreadBehaviour : public testing::Test {
+  public:
+    LogDataWorkerThreadBehaviour() : indexing_data_(), worker_( &indexing_data_ ) {
+        QFile file( TMPDIR "/workerlog.txt" );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            for ( int i = 0; i < 500000; i++ )
+                file.write( QString( "This is line %1 of the file indexed by the worker\n" )
+                        .arg( i ).toLatin1() );
+        }
+        file.close();
+
+        worker_.attachFile( TMPDIR "/workerlog.txt" );
+    }
+
+    IndexingData indexing_data_;
+    LogDataWorkerThread worker_;
+};
+
+TEST_F( LogDataWorkerThreadBehaviour, mergesTheWaitingRequests ) {
+    SafeQSignalSpy finishedSpy( &worker_,
+            SIGNAL( indexingFinished( LoadingStatus, quint64 ) ) );
+
+    // Not started yet, so all the requests wait
+    const quint64 partial = worker_.indexAdditionalLines();
+    ASSERT_THAT( worker_.indexAdditionalLines(), partial );
+    ASSERT_THAT( worker_.indexAll(), partial );
+    ASSERT_THAT( worker_.indexAdditionalLines(), partial );
+
+    worker_.start();
+    ASSERT_TRUE( finishedSpy.safeWait( 10000 ) );
+
+    // A single (full) indexing has been done
+    QTest::qWait( 100 );
+    ASSERT_THAT( finishedSpy.count(), 1 );
+    ASSERT_THAT( finishedSpy.at( 0 ).at( 0 ).toInt(),
+            static_cast<int>( LoadingStatus::Successful ) );
+    ASSERT_THAT( finishedSpy.at( 0 ).at( 1 ).toULongLong(), partial );
+    ASSERT_THAT( indexing_data_.getNbLines(), 500000LL );
+
+    // A new request is a new job
+    ASSERT_THAT( worker_.indexAdditionalLines(), Gt( partial ) );
+}
+
+TEST_F( LogDataWorkerThreadBehaviour, cancelsTheWaitingRequest ) {
+    SafeQSignalSpy finishedSpy( &worker_,
+            SIGNAL( indexingFinished( LoadingStatus, quint64 ) ) );
+
+    const quint64 cancelled = worker_.indexAll();
+    worker_.interrupt();
+    const quint64 requested = worker_.indexAll();
+    ASSERT_THAT( requested, Ne( cancelled ) );
+
+    worker_.start();
+    while ( finishedSpy.count() < 2 && finishedSpy.wait( 10000 ) )
+        ;
+
+    ASSERT_THAT( finishedSpy.count(), 2 );
+    ASSERT_THAT( finishedSpy.at( 0 ).at( 0 ).toInt(),
+            static_cast<int>( LoadingStatus::Interrupted ) );
+    ASSERT_THAT( finishedSpy.at( 0 ).at( 1 ).toULongLong(), cancelled );
+    ASSERT_THAT( finishedSpy.at( 1 ).at( 0 ).toInt(),
+            static_cast<int>( LoadingStatus::Successful ) );
+    ASSERT_THAT( finishedSpy.at( 1 ).at( 1 ).toULongLong(), requested );
+    ASSERT_THAT( indexing_data_.getNbLines(), 500000LL );
+}
+
+class IndexingDataLoading : public testing::Test {
+  public:
+    // Save an index of three lines ending at 10, 20 and 30, with the
+    // passed number of attributes, indexed size and open line
+    QByteArray save( int nb_attributes, qint64 indexed_size,
+            const LineScanner::OpenLine& open_line ) {
+        FastLinePositionArray line_position;
+        for ( int i = 1; i <= 3; i++ )
+            line_position.append( i * 10 );
+
+        IndexingData indexing_data;
+        indexing_data.addAll( indexed_size, 9, line_position,
+                LineAttributeList( nb_attributes, 0 ),
+                LineExpansionList( nb_attributes, 0 ), open_line,
+                EncodingSpeculator::Encoding::ASCII7 );
+
+        QByteArray bytes;
+        QDataStream out( &bytes, QIODevice::WriteOnly );
+        indexing_data.save( out );
+        return bytes;
+    }
+
+    bool load( const QByteArray& bytes, IndexingData* loaded ) {
+        QDataStream in( bytes );
+        return loaded->load( in );
+    }
+};
+
+TEST_F( IndexingDataLoading, loadsWhatIsSaved ) {
+    IndexingData loaded;
+    ASSERT_TRUE( load( save( 3, 35, LineScanner::OpenLine { 30, 0, 0, 33 } ),
+                &loaded ) );
+    ASSERT_THAT( loaded.getNbLines(), 3LL );
+    ASSERT_THAT( loaded.getSize(), 35LL );
+}
+
+TEST_F( IndexingDataLoading, rejectsAttributesOutOfStepWithThePositions ) {
+    IndexingData loaded;
+    ASSERT_FALSE( load( save( 1, 30, LineScanner::OpenLine { 30, 0, 0, -1 } ),
+                &loaded ) );
+}
+
+TEST_F( IndexingDataLoading, rejectsPositionsPastTheIndexedSize ) {
+    IndexingData loaded;
+    ASSERT_FALSE( load( save( 3, 20, LineScanner::OpenLine { 20, 0, 0, -1 } ),
+                &loaded ) );
+}
+
+TEST_F( IndexingDataLoading, rejectsAnOpenLinePastTheIndexedSize ) {
+    IndexingData loaded;
+    ASSERT_FALSE( load( save( 3, 30, LineScanner::OpenLine { 40, 0, 0, -1 } ),
+                &loaded ) );
+
+    IndexingData other_loaded;
+    ASSERT_FALSE( load( save( 3, 30, LineScanner::OpenLine { 30, 0, 0, 30 } ),
+                &other_loaded ) );
+}
@@ -68,3 +68,20 @@ TEST_F( MarksBehaviour, marksAreStored ) {
     ASSERT_TRUE( filtered_data->isLineMarked( 10 ) );
     ASSERT_TRUE( filtered_data->isLineMarked( 25 ) );
 }
+
+TEST_F( MarksBehaviour, marksFollowTheLinesRenumbered ) {
+    filtered_data->addMark( 10 );
+    filtered_data->addMark( 25 );
+    filtered_data->addMark( 40 );
+
+    filtered_data->shiftMarks( 20, 100 );
+
+    ASSERT_TRUE( filtered_data->isLineMarked( 10 ) );
+    ASSERT_TRUE( filtered_data->isLineMarked( 125 ) );
+    ASSERT_TRUE( filtered_data->isLineMarked( 140 ) );
+    ASSERT_FALSE( filtered_data->isLineMarked( 25 ) );
+    ASSERT_FALSE( filtered_data->isLineMarked( 40 ) );
+
+    // Still in order
+    ASSERT_THAT( filtered_data->getMarkAfter( 10 ), testing::Eq( 125 ) );
+}
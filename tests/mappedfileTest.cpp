@@ -0,0 +1,113 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include "data/mappedfile.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+static const char* const MAPPED_FILE = TMPDIR "/mappedfile.txt";
+
+class MappedFileBehaviour: public testing::Test {
+  public:
+    MappedFileBehaviour() {
+        QFile::remove( MAPPED_FILE );
+        append( "first line\nsecond line\n" );
+    }
+
+    void append( const QByteArray& data ) {
+        QFile file( MAPPED_FILE );
+        if ( file.open( QIODevice::WriteOnly | QIODevice::Append ) )
+            file.write( data );
+    }
+
+    void truncate( qint64 size ) {
+        QFile file( MAPPED_FILE );
+        file.resize( size );
+    }
+};
+
+TEST_F( MappedFileBehaviour, ReadsTheContent ) {
+    if ( ! MappedFile::isSupported() )
+        return;
+
+    MappedFile mapped_file( MAPPED_FILE );
+    auto view = mapped_file.view( 23 );
+
+    ASSERT_THAT( view, NotNull() );
+    ASSERT_THAT( view->size(), Ge( 23 ) );
+    ASSERT_THAT( QByteArray( view->data(), 23 ),
+            Eq( QByteArray( "first line\nsecond line\n" ) ) );
+}
+
+TEST_F( MappedFileBehaviour, DoesNotReadPastTheEnd ) {
+    MappedFile mapped_file( MAPPED_FILE );
+
+    ASSERT_THAT( mapped_file.view( 24 ), IsNull() );
+}
+
+TEST_F( MappedFileBehaviour, SeesTheAppendedData ) {
+    if ( ! MappedFile::isSupported() )
+        return;
+
+    MappedFile mapped_file( MAPPED_FILE );
+    auto first_view = mapped_file.view( 23 );
+
+    // Past the room left to grow
+    QByteArray line( 99, 'x' );
+    line.append( '\n' );
+    for ( int i = 0; i < 100; ++i )
+        append( line );
+    auto second_view = mapped_file.view( 10023 );
+
+    ASSERT_THAT( second_view, NotNull() );
+    ASSERT_THAT( QByteArray( second_view->data() + 9923, 100 ), Eq( line ) );
+    // The first view is still readable
+    ASSERT_THAT( QByteArray( first_view->data(), 10 ),
+            Eq( QByteArray( "first line" ) ) );
+}
+
+TEST_F( MappedFileBehaviour, DoesNotReadATruncatedFile ) {
+    if ( ! MappedFile::isSupported() )
+        return;
+
+    MappedFile mapped_file( MAPPED_FILE );
+    ASSERT_THAT( mapped_file.view( 23 ), NotNull() );
+
+    truncate( 11 );
+
+    ASSERT_THAT( mapped_file.view( 23 ), IsNull() );
+    ASSERT_THAT( mapped_file.view( 11 ), NotNull() );
+}
+
+TEST_F( MappedFileBehaviour, ReadsWhatIsLeftOfAFileTruncatedWhileRead ) {
+    if ( ! MappedFile::isSupported() )
+        return;
+
+    // More than a page, whatever the page size
+    append( QByteArray( 256*1024, 'x' ) );
+
+    MappedFile mapped_file( MAPPED_FILE );
+    auto view = mapped_file.view( 23 + 256*1024 );
+    ASSERT_THAT( view, NotNull() );
+
+    truncate( 11 );
+
+    QByteArray content( 23 + 256*1024, '\0' );
+    ASSERT_THAT( view->read( 0, content.size(), content.data() ), Eq( 11 ) );
+    ASSERT_THAT( content.left( 11 ), Eq( QByteArray( "first line\n" ) ) );
+}
+
+TEST_F( MappedFileBehaviour, DoesNotMapAMissingFile ) {
+    MappedFile mapped_file( TMPDIR "/does_not_exist.txt" );
+
+    ASSERT_THAT( mapped_file.view( 1 ), IsNull() );
+}
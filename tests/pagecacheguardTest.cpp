@@ -0,0 +1,101 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <unistd.h>
+
+#include "data/pagecacheguard.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+// A multiple of the page size
+static const qint64 FILE_SIZE = 8*1024*1024;
+
+class PageCacheGuardBehaviour: public testing::Test {
+  public:
+    PageCacheGuardBehaviour() {
+        QFile file( TMPDIR "/pagecacheguard.txt" );
+        if ( file.open( QIODevice::WriteOnly ) ) {
+            QByteArray line( 99, 'x' );
+            line.append( '\n' );
+            for ( qint64 i = 0; i < FILE_SIZE / line.size(); ++i )
+                file.write( line );
+            file.write( QByteArray( FILE_SIZE % line.size(), 'y' ) );
+
+            // Dirty pages cannot be dropped
+            file.flush();
+            fsync( file.handle() );
+        }
+    }
+
+    void readFile() {
+        QFile file( TMPDIR "/pagecacheguard.txt" );
+        if ( file.open( QIODevice::ReadOnly ) )
+            while ( ! file.read( 1024*1024 ).isEmpty() ) {}
+    }
+
+    qint64 residentBytes() {
+        return PageCacheGuard::residentBytes( TMPDIR "/pagecacheguard.txt",
+                0, FILE_SIZE );
+    }
+
+    // Returns false if the file cannot be evicted (e.g. on tmpfs)
+    bool evictFile() {
+        // Nothing is cached as far as this guard knows
+        PageCacheGuard guard( TMPDIR "/pagecacheguard.txt", 0, 0 );
+        guard.release( 0, FILE_SIZE );
+
+        return residentBytes() < FILE_SIZE;
+    }
+};
+
+TEST_F( PageCacheGuardBehaviour, DropsWhatWasNotCached ) {
+    if ( ! PageCacheGuard::isSupported() || ! evictFile() )
+        return;
+
+    PageCacheGuard guard( TMPDIR "/pagecacheguard.txt", 0, FILE_SIZE );
+    readFile();
+    guard.release( 0, FILE_SIZE );
+
+    ASSERT_THAT( guard.droppedBytes(),
+            Eq( FILE_SIZE - guard.cachedBeforeBytes() ) );
+    ASSERT_THAT( residentBytes(), Le( guard.cachedBeforeBytes() ) );
+}
+
+TEST_F( PageCacheGuardBehaviour, KeepsWhatWasCached ) {
+    if ( ! PageCacheGuard::isSupported() )
+        return;
+
+    readFile();
+    PageCacheGuard guard( TMPDIR "/pagecacheguard.txt", 0, FILE_SIZE );
+    ASSERT_THAT( guard.cachedBeforeBytes(), Eq( residentBytes() ) );
+
+    readFile();
+    guard.release( 0, FILE_SIZE );
+
+    ASSERT_THAT( residentBytes(), Ge( guard.cachedBeforeBytes() ) );
+    ASSERT_THAT( guard.droppedBytes(),
+            Eq( FILE_SIZE - guard.cachedBeforeBytes() ) );
+}
+
+TEST_F( PageCacheGuardBehaviour, DropsOnlyTheReleasedRange ) {
+    if ( ! PageCacheGuard::isSupported() || ! evictFile() )
+        return;
+
+    PageCacheGuard guard( TMPDIR "/pagecacheguard.txt", 0, FILE_SIZE );
+    readFile();
+    guard.release( 0, FILE_SIZE / 2 );
+
+    ASSERT_THAT( guard.droppedBytes(), Le( FILE_SIZE / 2 ) );
+    ASSERT_THAT( PageCacheGuard::residentBytes( TMPDIR "/pagecacheguard.txt",
+                FILE_SIZE / 2, FILE_SIZE ),
+            Eq( FILE_SIZE / 2 ) );
+}
@@ -0,0 +1,74 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include "data/pipelinedreader.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+static const qint64 CHUNK_SIZE = 1000;
+
+class PipelinedReaderBehaviour: public testing::TestWithParam<int> {
+  public:
+    QByteArray content;
+
+    PipelinedReaderBehaviour() {
+        for ( int i = 0; i < 12345; ++i )
+            content.append( static_cast<char>( 'a' + i % 26 ) );
+
+        QFile file( TMPDIR "/pipelinedreader.txt" );
+        if ( file.open( QIODevice::WriteOnly ) )
+            file.write( content );
+    }
+
+    // Read everything from position, checking the chunks are contiguous
+    QByteArray readAll( qint64 position, int depth ) {
+        PipelinedReader reader( TMPDIR "/pipelinedreader.txt",
+                position, CHUNK_SIZE, depth );
+        QByteArray result;
+        PipelinedReader::Chunk chunk;
+
+        while ( reader.nextChunk( &chunk ) ) {
+            EXPECT_THAT( chunk.position, Eq( position + result.size() ) );
+            EXPECT_THAT( chunk.length, Le( CHUNK_SIZE ) );
+            result.append( chunk.data, chunk.length );
+        }
+
+        return result;
+    }
+};
+
+TEST_P( PipelinedReaderBehaviour, ReadsTheWholeFileInOrder ) {
+    ASSERT_THAT( readAll( 0, GetParam() ), Eq( content ) );
+}
+
+TEST_P( PipelinedReaderBehaviour, StartsAtThePassedPosition ) {
+    ASSERT_THAT( readAll( 4567, GetParam() ), Eq( content.mid( 4567 ) ) );
+}
+
+TEST_P( PipelinedReaderBehaviour, CanBeDestroyedBeforeTheEnd ) {
+    PipelinedReader reader( TMPDIR "/pipelinedreader.txt", 0, CHUNK_SIZE, GetParam() );
+    PipelinedReader::Chunk chunk;
+
+    ASSERT_TRUE( reader.nextChunk( &chunk ) );
+    ASSERT_THAT( QByteArray( chunk.data, chunk.length ),
+            Eq( content.left( CHUNK_SIZE ) ) );
+}
+
+INSTANTIATE_TEST_CASE_P( Depths, PipelinedReaderBehaviour, Values( 1, 2, 4 ) );
+
+TEST( PipelinedReader, ReturnsNothingForANonExistingFile ) {
+    PipelinedReader reader( TMPDIR "/pipelinedreader_nonexisting.txt", 0, CHUNK_SIZE, 2 );
+    PipelinedReader::Chunk chunk;
+
+    ASSERT_FALSE( reader.isOpen() );
+    ASSERT_FALSE( reader.nextChunk( &chunk ) );
+}
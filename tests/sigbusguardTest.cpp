@@ -0,0 +1,90 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include "data/sigbusguard.h"
+
+#define TMPDIR "/tmp"
+
+using namespace std;
+using namespace testing;
+
+static const char* const GUARDED_FILE = TMPDIR "/sigbusguard.txt";
+
+// More than a page, whatever the page size
+static const qint64 FILE_SIZE = 256*1024;
+
+class SigbusGuardBehaviour: public testing::Test {
+  public:
+    SigbusGuardBehaviour() : file( GUARDED_FILE ), mapped( nullptr ) {
+        QFile::remove( GUARDED_FILE );
+        {
+            QFile writer( GUARDED_FILE );
+            if ( writer.open( QIODevice::WriteOnly ) )
+                writer.write( QByteArray( FILE_SIZE, 'x' ) );
+        }
+
+        if ( file.open( QIODevice::ReadOnly ) )
+            mapped = file.map( 0, FILE_SIZE );
+    }
+
+    ~SigbusGuardBehaviour() {
+        if ( mapped )
+            file.unmap( mapped );
+    }
+
+    // Read the last byte of the mapping through the guard
+    bool readLastByte( char* byte ) {
+        const uchar* last = mapped + FILE_SIZE - 1;
+        return SigbusGuard::run( [last, byte]() { *byte = *last; } );
+    }
+
+    void truncate( qint64 size ) {
+        QFile truncated( GUARDED_FILE );
+        truncated.resize( size );
+    }
+
+    QFile file;
+    uchar* mapped;
+};
+
+TEST_F( SigbusGuardBehaviour, RunsTheFunction ) {
+    ASSERT_THAT( mapped, NotNull() );
+
+    char byte = 0;
+    ASSERT_TRUE( readLastByte( &byte ) );
+    ASSERT_THAT( byte, Eq( 'x' ) );
+}
+
+#ifdef Q_OS_UNIX
+TEST_F( SigbusGuardBehaviour, RecoversFromAReadPastTheEndOfTheFile ) {
+    ASSERT_THAT( mapped, NotNull() );
+
+    truncate( 10 );
+
+    char byte = 0;
+    ASSERT_FALSE( readLastByte( &byte ) );
+    // And again, the signal is not left blocked
+    ASSERT_FALSE( readLastByte( &byte ) );
+    ASSERT_THAT( byte, Eq( 0 ) );
+}
+
+TEST_F( SigbusGuardBehaviour, RecoversInTheInnerGuard ) {
+    ASSERT_THAT( mapped, NotNull() );
+
+    truncate( 10 );
+
+    char byte = 0;
+    bool inner_result = true;
+    const bool outer_result = SigbusGuard::run( [&]() {
+            inner_result = readLastByte( &byte ); } );
+
+    ASSERT_TRUE( outer_result );
+    ASSERT_FALSE( inner_result );
+}
+#endif
@@ -0,0 +1,81 @@
+#include "gmock/gmock.h"
+
+#include "config.h"
+
+#include "log.h"
+
+#include <chrono>
+
+#include "viewtools.h"
+
+using namespace std;
+using namespace testing;
+
+MATCHER_P2( IsRange, first, number, "" ) {
+    return arg.first == first && arg.number == number;
+}
+
+class ReadAheadPlannerBehaviour: public testing::Test {
+  public:
+    ReadAheadPlannerBehaviour() : start( chrono::steady_clock::now() ) {}
+
+    // Move the view to first_line, ms milliseconds after the start
+    vector<LineRange> moveTo( qint64 first_line, int ms ) {
+        return planner.update( first_line, PAGE, NB_LINES,
+                start + chrono::milliseconds( ms ) );
+    }
+
+    static const int PAGE = 50;
+    static const qint64 NB_LINES = 100000;
+
+    ReadAheadPlanner planner;
+    const chrono::steady_clock::time_point start;
+};
+
+TEST_F( ReadAheadPlannerBehaviour, ReadsThePagesAroundAJump ) {
+    ASSERT_THAT( moveTo( 1000, 0 ),
+            ElementsAre( IsRange( 1050, PAGE ), IsRange( 950, PAGE ) ) );
+    ASSERT_THAT( moveTo( 50000, 10 ),
+            ElementsAre( IsRange( 50050, PAGE ), IsRange( 49950, PAGE ) ) );
+    ASSERT_THAT( planner.velocity(), Eq( 0.0 ) );
+}
+
+TEST_F( ReadAheadPlannerBehaviour, ReadsFurtherAheadWhenScrollingFaster ) {
+    moveTo( 1000, 0 );
+
+    // After a pause, the next page only
+    ASSERT_THAT( moveTo( 1050, 2000 ), ElementsAre( IsRange( 1100, PAGE ) ) );
+
+    // 1000 lines per second, 500 lines read in advance (in 10 pages,
+    // but no more than 8)
+    ASSERT_THAT( moveTo( 1100, 2050 ), SizeIs( 8 ) );
+    ASSERT_THAT( planner.velocity(), DoubleEq( 1000.0 ) );
+
+    // 200 lines per second on average
+    const auto ranges = moveTo( 1120, 2250 );
+    ASSERT_THAT( planner.velocity(), DoubleEq( 550.0 ) );
+    ASSERT_THAT( ranges, ElementsAre( IsRange( 1170, PAGE ), IsRange( 1220, PAGE ),
+                IsRange( 1270, PAGE ), IsRange( 1320, PAGE ), IsRange( 1370, PAGE ),
+                IsRange( 1420, PAGE ) ) );
+}
+
+TEST_F( ReadAheadPlannerBehaviour, ReadsInTheDirectionOfTheScrolling ) {
+    moveTo( 1000, 0 );
+    moveTo( 1010, 100 );
+
+    // Going back up at 300 lines per second, 150 lines read in advance
+    ASSERT_THAT( moveTo( 980, 200 ), ElementsAre( IsRange( 930, PAGE ),
+                IsRange( 880, PAGE ), IsRange( 830, PAGE ) ) );
+    ASSERT_THAT( planner.velocity(), DoubleEq( -300.0 ) );
+}
+
+TEST_F( ReadAheadPlannerBehaviour, ReadsOnlyTheLinesOfTheLog ) {
+    ASSERT_THAT( moveTo( 20, 0 ), ElementsAre( IsRange( 70, PAGE ), IsRange( 0, 20 ) ) );
+    ASSERT_THAT( moveTo( NB_LINES - 60, 10000 ),
+            ElementsAre( IsRange( NB_LINES - 10, 10 ), IsRange( NB_LINES - 110, PAGE ) ) );
+}
+
+TEST_F( ReadAheadPlannerBehaviour, ReadsNothingIfTheViewDoesNotMove ) {
+    moveTo( 1000, 0 );
+    ASSERT_THAT( moveTo( 1000, 10 ), IsEmpty() );
+}